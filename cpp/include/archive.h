@@ -0,0 +1,83 @@
+#ifndef CASPER_ARCHIVE_H
+#define CASPER_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace casper {
+
+struct ArchiveOptions {
+    int level = 6;                  // Deflate level, 1 (fastest) .. 9 (smallest)
+    bool recursive = true;          // Zip: descend into directories
+    bool gzip = false;              // Tar create: compress the stream
+    size_t threads = 0;             // 0 = one per hardware thread
+};
+
+struct ArchiveEntry {
+    std::string path;
+    char type = 'f';                // f = file, d = directory, l = symlink, h = hard link, p = fifo
+    std::string link;               // Target of a symlink or hard link
+    uint64_t size = 0;
+    uint64_t compressed = 0;        // Zip only
+    uint32_t mode = 0;              // Permission bits
+    int64_t mtime = 0;
+};
+
+struct ArchiveReport {
+    std::vector<ArchiveEntry> entries;
+    std::vector<std::string> errors;        // "path: message"; the other entries are still processed
+    uint64_t bytes_in = 0;                  // Read from files or the archive
+    uint64_t bytes_out = 0;                 // Written to the archive or files
+};
+
+// In-process tar, zip and gzip. Deflate runs pigz-style: the input is cut into
+// blocks that are compressed independently on a thread pool (each primed with
+// the previous block's tail as dictionary) and joined in order, so one stream
+// uses every core. Zip also compresses small entries in parallel and extracts
+// entries concurrently. Tar and large files are streamed rather than held in
+// memory. Built without zlib, only uncompressed tar is available.
+class Archive {
+public:
+    enum class Format { Unknown, Tar, Gzip, Bzip2, Xz, Zip };
+
+    static bool hasZlib();
+
+    // Sniffs the first bytes; a missing file is Unknown
+    static Format detect(const std::string& path);
+
+    // Inputs are stored under their given paths, minus a leading "/" or "../"
+    static bool createTar(const std::string& archive, const std::vector<std::string>& inputs,
+                          const ArchiveOptions& options, ArchiveReport& report, std::string& error);
+
+    // Plain or gzipped tar, detected from the data
+    static bool extractTar(const std::string& archive, const std::string& dest,
+                           ArchiveReport& report, std::string& error);
+    static bool listTar(const std::string& archive, ArchiveReport& report, std::string& error);
+
+    // Replaces an existing archive
+    static bool createZip(const std::string& archive, const std::vector<std::string>& inputs,
+                          const ArchiveOptions& options, ArchiveReport& report, std::string& error);
+    static bool extractZip(const std::string& archive, const std::string& dest,
+                           const ArchiveOptions& options, ArchiveReport& report, std::string& error);
+
+    // Reads only the central directory
+    static bool listZip(const std::string& archive, ArchiveReport& report, std::string& error);
+
+    // Single files; dest must not exist unless overwrite
+    static bool gzip(const std::string& source, const std::string& dest, bool overwrite,
+                     const ArchiveOptions& options, ArchiveReport& report, std::string& error);
+    static bool gunzip(const std::string& source, const std::string& dest, bool overwrite,
+                       ArchiveReport& report, std::string& error);
+
+    static std::string formatList(const ArchiveReport& report, bool zip, size_t max_lines = 500);
+
+    // "Archived 12 files, 3 directories: 1.2M -> 300K" followed by the errors
+    static std::string formatSummary(const ArchiveReport& report, const std::string& verb,
+                                     size_t max_errors = 20);
+};
+
+} // namespace casper
+
+#endif // CASPER_ARCHIVE_H
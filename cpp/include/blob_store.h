@@ -0,0 +1,44 @@
+#ifndef CASPER_BLOB_STORE_H
+#define CASPER_BLOB_STORE_H
+
+#include <string>
+#include <sqlite3.h>
+
+namespace casper {
+
+// Large session payloads (tool outputs, long messages) kept in the blobs
+// table once per distinct content, keyed by its SHA-256 and deflated with
+// zlib where that helps. Rows refer to a blob by hash instead of holding
+// the text, so a file the model reads twenty times is stored once.
+//
+// Readers go through the inflate_blob(codec, size, data) SQL function,
+// which registerFunctions() adds to a connection.
+class BlobStore {
+public:
+    // Smaller payloads stay inline; a hash and a lookup would cost more than they save
+    static const size_t MIN_SIZE = 1024;
+
+    enum Codec { STORED = 0, ZLIB = 1 };
+
+    // db must outlive the store; put() runs on whichever thread owns it
+    explicit BlobStore(sqlite3* db);
+    ~BlobStore();
+
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+
+    static void registerFunctions(sqlite3* db);
+
+    // Stores data unless a blob with the same content exists; returns its
+    // hash, or "" if it could not be written
+    std::string put(const std::string& data);
+
+private:
+    sqlite3* db_;
+    sqlite3_stmt* exists_stmt_;
+    sqlite3_stmt* insert_stmt_;
+};
+
+} // namespace casper
+
+#endif // CASPER_BLOB_STORE_H
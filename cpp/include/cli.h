@@ -85,6 +85,17 @@ private:
     // License handlers
     void handleLicenseCommand(const std::string& cmd);
 
+    // Session recording
+    void recordToolResults(const std::vector<ToolCall>& calls, const std::vector<ToolResult>& results);
+    void printToolStats(bool all_sessions);
+
+    // Session browsing
+    void printSessionPage(const std::string& after_id);
+    void printSearchResults(const std::string& query);
+    bool resumeSession(const std::string& session_id);
+    void handleHistoryCommand(const std::string& cmd);
+    std::string describeRetention() const;
+
     // Confirmation callback for tools
     bool confirmToolExecution(const std::string& tool_name, const std::string& description);
 
@@ -115,6 +126,9 @@ private:
     bool resume_session_;
     std::string resume_session_id_;
     bool list_sessions_;
+    std::string list_after_;        // --list-sessions continues after this session
+    std::string sessions_cursor_;   // Last session /sessions showed, for /sessions more
+    std::vector<std::string> search_results_;  // Sessions of the last search, for /resume N
     bool export_session_;
     std::string export_format_;  // "json" or "markdown"
 
@@ -0,0 +1,66 @@
+#ifndef CASPER_COMMAND_REGISTRY_H
+#define CASPER_COMMAND_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <ctime>
+
+namespace casper {
+
+// Which executables are on PATH, from one scan of the PATH directories
+// instead of a "command -v" fork per check. The scan can start in the
+// background; lookups wait for it. A miss re-checks the directories'
+// modification times, so anything installed since shows up, and a changed
+// PATH triggers a fresh scan.
+class CommandRegistry {
+public:
+    static CommandRegistry& instance();
+
+    ~CommandRegistry();
+
+    CommandRegistry(const CommandRegistry&) = delete;
+    CommandRegistry& operator=(const CommandRegistry&) = delete;
+
+    // Scan PATH on a background thread unless that has been done already
+    void warmUp();
+
+    // Full path of the executable PATH resolves name to, "" if there is none.
+    // Names containing a slash are checked as given.
+    std::string find(const std::string& name);
+    bool exists(const std::string& name) { return !find(name).empty(); }
+
+    // Drop the cache, e.g. after installing a package
+    void invalidate();
+
+private:
+    struct Directory {
+        std::string path;
+        struct timespec mtime;
+        bool present;
+    };
+
+    CommandRegistry();
+
+    // Callers hold mutex_ and have set scanning_
+    void scan(std::unique_lock<std::mutex>& lock);
+    void rescan(std::unique_lock<std::mutex>& lock);
+    void waitForScan(std::unique_lock<std::mutex>& lock);
+    bool directoriesChanged() const;
+
+    std::mutex mutex_;
+    std::condition_variable scanned_cv_;
+    std::thread warm_thread_;
+    bool scanning_;
+    bool valid_;
+    std::string path_;                                      // PATH the cache was built from
+    std::vector<Directory> directories_;
+    std::unordered_map<std::string, std::string> commands_; // Name -> first directory holding it
+};
+
+} // namespace casper
+
+#endif // CASPER_COMMAND_REGISTRY_H
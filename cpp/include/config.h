@@ -18,6 +18,8 @@ struct MCPServerConfig {
     bool enabled;
     std::string transport;  // "stdio" or "http"
     std::string url;        // For HTTP transport
+    bool read_only = false; // Its tools change nothing, so calls may run alongside others
+    std::vector<std::string> read_only_tools;   // Or only these tools do
 };
 
 class Config {
@@ -65,6 +67,20 @@ public:
     std::string getLicenseServerUrl() const { return license_server_url_; }
     std::string getLicenseKey() const { return license_key_; }
 
+    // Tool execution settings
+    bool getParallelTools() const { return parallel_tools_; }
+    int getMaxParallelTools() const { return max_parallel_tools_; }
+    int getCommandTimeout() const { return command_timeout_; }
+    bool getPersistentShell() const { return persistent_shell_; }
+    std::string getEditBackup() const { return edit_backup_; }
+    bool getFsyncWrites() const { return fsync_writes_; }
+    int getFileCacheMb() const { return file_cache_mb_; }
+    int getSshMasterIdle() const { return ssh_master_idle_; }
+    std::string getSessionDurability() const { return session_durability_; }
+    int getSessionRetentionDays() const { return session_retention_days_; }
+    int getSessionRetentionMaxSessions() const { return session_retention_max_sessions_; }
+    int getSessionRetentionMaxMb() const { return session_retention_max_mb_; }
+
     // Setters
     void setModel(const std::string& model);
     void setOllamaHost(const std::string& host);
@@ -102,6 +118,18 @@ public:
     void setLicenseServerUrl(const std::string& url);
     void setLicenseKey(const std::string& key);
 
+    // Tool execution setters
+    void setParallelTools(bool enabled);
+    void setMaxParallelTools(int count);
+    void setCommandTimeout(int seconds);
+    void setPersistentShell(bool enabled);
+    void setEditBackup(const std::string& mode);
+    void setFsyncWrites(bool enabled);
+    void setFileCacheMb(int mb);
+    void setSshMasterIdle(int seconds);
+    void setSessionDurability(const std::string& mode);
+    void setSessionRetention(int days, int max_sessions, int max_mb);
+
     // Persistence
     bool save();
     bool load();
@@ -171,6 +199,20 @@ private:
     std::string license_server_url_;
     std::string license_key_;
 
+    // Tool execution settings
+    bool parallel_tools_;
+    int max_parallel_tools_;
+    int command_timeout_;        // Seconds, 0 = no limit
+    bool persistent_shell_;      // Bash calls share one long-lived shell
+    std::string edit_backup_;    // "undo" (in memory), "bak" (file.bak) or "none"
+    bool fsync_writes_;          // fsync edited files before renaming them into place
+    int file_cache_mb_;          // File contents kept in memory across tools, 0 = off
+    int ssh_master_idle_;        // Seconds an unused SSH master connection stays open, 0 = no sharing
+    std::string session_durability_;  // "full" (commit every save), "normal" or "off" (background writer)
+    int session_retention_days_;          // Older sessions are archived, 0 = keep
+    int session_retention_max_sessions_;  // Beyond this many the oldest are archived, 0 = no limit
+    int session_retention_max_mb_;        // Likewise for their total size, 0 = no limit
+
     // Allowed commands for safe mode
     std::vector<std::string> allowed_commands_;
 
@@ -0,0 +1,57 @@
+#ifndef CASPER_DNS_CLIENT_H
+#define CASPER_DNS_CLIENT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace casper {
+
+struct DnsRecord {
+    std::string name;
+    std::string type;               // "A", "MX", ... or "TYPE65" when unknown
+    uint32_t ttl = 0;
+    std::string data;               // Presentation form, as dig prints it
+};
+
+struct DnsQuestion {
+    std::string name;
+    std::string type = "A";
+};
+
+struct DnsAnswer {
+    DnsQuestion question;
+    std::string server;             // Server that answered
+    std::string status;             // NOERROR, NXDOMAIN, SERVFAIL, ...
+    std::string error;              // No usable answer (timeout, bad type, ...)
+    std::vector<DnsRecord> records;
+    bool tcp = false;               // Retried over TCP after a truncated reply
+    double rtt_ms = 0;
+};
+
+// Stub resolver speaking DNS directly to the configured nameservers. Every
+// question is sent at once over its own UDP socket and the replies are
+// collected in one poll loop; truncated replies are repeated over TCP.
+class DnsClient {
+public:
+    // "ip", "ip:port" or "[ipv6]:port"; empty = nameservers from /etc/resolv.conf
+    explicit DnsClient(const std::vector<std::string>& servers = {});
+
+    static std::vector<std::string> systemServers();
+    static int typeCode(const std::string& type);      // 0 = unknown
+
+    // "1.2.3.4" -> "4.3.2.1.in-addr.arpa", names pass through unchanged
+    static std::string reverseName(const std::string& address);
+
+    std::vector<DnsAnswer> query(const std::vector<DnsQuestion>& questions, int timeout_ms = 2000, int attempts = 2);
+
+    // dig-style: a ";; name TYPE (status, time, server)" line, then one line per record
+    static std::string format(const std::vector<DnsAnswer>& answers);
+
+private:
+    std::vector<std::string> servers_;
+};
+
+} // namespace casper
+
+#endif // CASPER_DNS_CLIENT_H
@@ -0,0 +1,98 @@
+#ifndef CASPER_FILE_CACHE_H
+#define CASPER_FILE_CACHE_H
+
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/types.h>
+
+namespace casper {
+
+// Identity of one version of a file; any write changes at least one field
+struct FileStamp {
+    dev_t dev = 0;
+    ino_t ino = 0;
+    long long mtime_ns = 0;
+    size_t size = 0;
+    bool regular = false;
+
+    bool operator==(const FileStamp& other) const {
+        return dev == other.dev && ino == other.ino && mtime_ns == other.mtime_ns && size == other.size;
+    }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+struct FileCacheStats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t invalidations = 0;   // Dropped because the file changed
+};
+
+// Session-wide cache of file contents shared by the file tools. Entries are
+// checked against the file's stamp on every lookup and also dropped when
+// inotify reports a change in their directory, so a hit is never stale.
+// Least recently used entries go first once max_bytes is reached.
+class FileCache {
+public:
+    explicit FileCache(size_t max_bytes = 64 * 1024 * 1024, size_t max_file_bytes = 8 * 1024 * 1024);
+    ~FileCache();
+
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    // Contents of a regular file, or nullptr with error set. Files larger
+    // than max_file_bytes are read but not kept.
+    std::shared_ptr<const std::string> read(const std::string& path, std::string& error,
+                                            FileStamp* stamp = nullptr);
+
+    static bool stat(const std::string& path, FileStamp& stamp);
+
+    // Whether read() would keep this file
+    bool cacheable(const FileStamp& stamp) const { return stamp.regular && stamp.size <= max_file_bytes_; }
+
+    void invalidate(const std::string& path);
+    void clear();
+
+    // The version of a file the model last saw, so edits can tell whether
+    // it changed behind its back
+    void noteSeen(const std::string& path, const FileStamp& stamp);
+    bool lastSeen(const std::string& path, FileStamp& stamp) const;
+
+    FileCacheStats stats() const;
+
+private:
+    struct Entry {
+        FileStamp stamp;
+        std::shared_ptr<const std::string> content;
+        std::list<std::string>::iterator lru;
+    };
+
+    void drainEvents();                         // Caller holds mutex_
+    void watchDirectory(const std::string& dir);
+    void erase(const std::string& key);
+
+    size_t max_bytes_;
+    size_t max_file_bytes_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;                // Most recently used first
+    std::map<std::string, FileStamp> seen_;
+    size_t bytes_;
+    size_t hits_;
+    size_t misses_;
+    size_t invalidations_;
+
+    int inotify_fd_;                            // -1 when inotify is unavailable
+    std::unordered_map<int, std::string> watches_;     // Watch descriptor -> directory
+    std::unordered_map<std::string, int> watched_dirs_;
+};
+
+} // namespace casper
+
+#endif // CASPER_FILE_CACHE_H
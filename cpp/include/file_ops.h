@@ -0,0 +1,75 @@
+#ifndef CASPER_FILE_OPS_H
+#define CASPER_FILE_OPS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace casper {
+
+struct FileOpOptions {
+    bool recursive = false;
+    bool force = false;             // Rm: missing paths are not errors
+    bool parents = true;            // Mkdir: create missing parents, existing directories are fine
+    bool dry_run = false;           // Report what would happen, change nothing
+    size_t threads = 0;             // 0 = one per hardware thread
+};
+
+struct FileOpError {
+    std::string path;
+    std::string message;
+    int code = 0;                   // errno, when there was one
+};
+
+struct FileOpReport {
+    std::vector<std::string> actions;       // One line per path given
+    std::vector<FileOpError> errors;
+    size_t files = 0;
+    size_t directories = 0;
+    size_t symlinks = 0;
+    uint64_t bytes = 0;
+    size_t cloned = 0;              // Files shared by reflink instead of copied
+    bool dry_run = false;
+};
+
+// In-process replacements for cp, mv, rm, mkdir, chmod and chown. Trees are
+// walked with the parallel FileWalker and file contents copied on a thread
+// pool, using reflinks or copy_file_range where the filesystem allows. Every
+// path is handled independently, so one failure does not stop the rest and
+// each is reported with its own error.
+class FileOps {
+public:
+    // Shell-style list: whitespace separated, quotes and backslashes honoured,
+    // "~" and unquoted globs expanded (a glob without matches stays as is)
+    static std::vector<std::string> expandPaths(const std::string& list);
+
+    // The same split without touching the filesystem; globs are kept
+    static std::vector<std::string> splitPaths(const std::string& list);
+
+    // Like cp: into dest when it is a directory (required for several sources)
+    static FileOpReport copy(const std::vector<std::string>& sources, const std::string& dest,
+                             const FileOpOptions& options);
+
+    // rename(2), or copy then remove when source and dest are on different filesystems
+    static FileOpReport move(const std::vector<std::string>& sources, const std::string& dest,
+                             const FileOpOptions& options);
+
+    static FileOpReport remove(const std::vector<std::string>& paths, const FileOpOptions& options);
+    static FileOpReport makeDirs(const std::vector<std::string>& paths, const FileOpOptions& options);
+
+    // Octal ("755") or symbolic ("u+x,go-w", "a=rX") modes
+    static bool validMode(const std::string& mode);
+    static FileOpReport changeMode(const std::vector<std::string>& paths, const std::string& mode,
+                                   const FileOpOptions& options);
+
+    // "user", "user:group", ":group", names or numeric ids
+    static FileOpReport changeOwner(const std::vector<std::string>& paths, const std::string& owner,
+                                    const FileOpOptions& options);
+
+    static std::string format(const FileOpReport& report, size_t max_lines = 50);
+};
+
+} // namespace casper
+
+#endif // CASPER_FILE_OPS_H
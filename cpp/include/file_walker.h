@@ -0,0 +1,97 @@
+#ifndef CASPER_FILE_WALKER_H
+#define CASPER_FILE_WALKER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include "glob_matcher.h"
+
+namespace casper {
+
+// Rules from one directory's .gitignore, chained to the parent directory's
+class IgnoreRules {
+public:
+    IgnoreRules(std::shared_ptr<const IgnoreRules> parent, const std::string& dir);
+
+    // Load <dir>/.gitignore if present; returns parent unchanged when there is none
+    static std::shared_ptr<const IgnoreRules> forDirectory(std::shared_ptr<const IgnoreRules> parent,
+                                                           const std::string& dir);
+
+    // Rules from the .gitignore files above dir, up to the enclosing git
+    // repository's root. nullptr outside a repository.
+    static std::shared_ptr<const IgnoreRules> forAncestors(const std::string& dir);
+
+    // Paths passed to isIgnored must be absolute and normalized, like dir
+
+    bool isIgnored(const std::string& path, bool is_dir) const;
+
+private:
+    struct Rule {
+        GlobMatcher matcher;
+        bool negate = false;
+        bool dir_only = false;
+        bool anchored = false;   // Contains a slash: match against the path relative to dir_
+    };
+
+    // 1 = ignored, 0 = explicitly not ignored, -1 = no rule matched
+    int match(const std::string& path, bool is_dir) const;
+
+    std::shared_ptr<const IgnoreRules> parent_;
+    std::string dir_;
+    std::vector<Rule> rules_;
+};
+
+struct WalkEntry {
+    std::string path;
+    bool is_dir;
+    int depth;                   // 0 = directly under the root
+};
+
+struct WalkOptions {
+    bool respect_gitignore = true;
+    bool include_hidden = false;
+    bool prune_vcs = true;          // Skip .git even with include_hidden
+    bool follow_symlinks = false;
+    bool include_dirs = false;      // Also report directories to the visitor
+    bool include_special = false;   // Also report symlinks (unless followed), fifos, sockets, ...
+    int max_depth = -1;             // -1 = unlimited
+    size_t threads = 0;             // 0 = one per hardware thread
+};
+
+// Parallel directory traversal. Each worker keeps its own queue and steals
+// from the others when it runs dry. The visitor is called concurrently from
+// the workers as entries are found; returning false stops the walk.
+class FileWalker {
+public:
+    using Visitor = std::function<bool(const WalkEntry& entry)>;
+
+    explicit FileWalker(const WalkOptions& options = WalkOptions());
+
+    void walk(const std::string& root, const Visitor& visitor);
+
+    // Ask a running walk to finish early (safe to call from the visitor)
+    void stop() { stopped_ = true; }
+    bool stopped() const { return stopped_; }
+
+private:
+    struct Job;
+    struct WorkerQueue;
+
+    void processDirectory(const Job& job, const Visitor& visitor, WorkerQueue& queue);
+    void push(WorkerQueue& queue, Job job);
+
+    // Absolute form of a walk path, for ignore matching
+    std::string absolutePath(const std::string& path) const;
+
+    WalkOptions options_;
+    std::string root_;
+    std::string absolute_root_;
+    std::atomic<bool> stopped_;
+    std::atomic<size_t> pending_;
+};
+
+} // namespace casper
+
+#endif // CASPER_FILE_WALKER_H
@@ -0,0 +1,45 @@
+#ifndef CASPER_GLOB_MATCHER_H
+#define CASPER_GLOB_MATCHER_H
+
+#include <string>
+#include <vector>
+
+namespace casper {
+
+// Compiled glob pattern. Supports *, ?, [abc], [!a-z], {a,b} brace sets
+// (nested) and ** for any number of directories. Patterns without a slash
+// match the file name only, like find -name; others match the whole
+// '/'-separated relative path.
+class GlobMatcher {
+public:
+    GlobMatcher() = default;
+    explicit GlobMatcher(const std::string& pattern);
+
+    bool matches(const std::string& path) const;
+
+    // Leading directories every alternative shares ("src/lib" for "src/lib/**/*.h")
+    std::string literalPrefix() const;
+
+    // Deepest directory level a match can be at (0 = directly under the root),
+    // or -1 when the pattern contains ** or matches names only
+    int maxDepth() const;
+
+    bool matchesNameOnly() const { return name_only_; }
+    const std::string& pattern() const { return pattern_; }
+
+    // fnmatch-style match of a single path segment
+    static bool matchSegment(const char* pattern, const char* text);
+
+private:
+    static std::vector<std::string> expandBraces(const std::string& pattern);
+    bool matchSegments(const std::vector<std::string>& pattern, size_t pi,
+                       const std::vector<std::string>& parts, size_t si) const;
+
+    std::string pattern_;
+    bool name_only_ = true;
+    std::vector<std::vector<std::string>> alternatives_;  // Brace-expanded, split on '/'
+};
+
+} // namespace casper
+
+#endif // CASPER_GLOB_MATCHER_H
@@ -0,0 +1,76 @@
+#ifndef CASPER_GREP_ENGINE_H
+#define CASPER_GREP_ENGINE_H
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <memory>
+#include "file_walker.h"
+
+namespace casper {
+
+class FileCache;
+
+struct GrepOptions {
+    std::string pattern;
+    std::string path = ".";
+    std::string output_mode = "files_with_matches";  // files_with_matches, content, count
+    bool ignore_case = false;
+    bool fixed_strings = false;     // Treat pattern as a literal
+    int before_context = 0;
+    int after_context = 0;
+    std::string glob;               // Only search files matching this glob
+    size_t max_results = 100;       // Lines in content mode, files otherwise
+    bool respect_gitignore = true;
+    bool include_hidden = false;
+    FileCache* cache = nullptr;     // Read files through the session cache when set
+};
+
+struct GrepLine {
+    size_t number;
+    std::string text;
+    bool is_match;                  // false = context line
+};
+
+struct GrepFileResult {
+    std::string path;
+    size_t match_count = 0;
+    std::vector<GrepLine> lines;
+};
+
+struct GrepResult {
+    bool success = false;
+    std::string error;
+    std::vector<GrepFileResult> files;
+    size_t files_searched = 0;
+    bool truncated = false;         // Stopped at max_results
+};
+
+// Native recursive search: a parallel walk over the tree, a memchr/memmem
+// literal prefilter, and std::regex only on candidate lines.
+class GrepEngine {
+public:
+    explicit GrepEngine(const GrepOptions& options);
+
+    GrepResult search();
+
+    // rg-style output: paths, "path:line:text" with "-" for context, or "path:count"
+    static std::string format(const GrepResult& result, const std::string& output_mode);
+
+private:
+    bool compile(std::string& error);
+    bool searchFile(const std::string& path, GrepFileResult& file_result, size_t limit);
+    bool lineMatches(const char* begin, const char* end) const;
+
+    // Longest literal every match must contain, or "" if none can be derived
+    static std::string requiredLiteral(const std::string& pattern);
+
+    GrepOptions options_;
+    std::string literal_;           // Prefilter needle (lowercase when ignore_case)
+    bool literal_only_;             // literal_ match alone decides a line
+    std::unique_ptr<std::regex> regex_;
+};
+
+} // namespace casper
+
+#endif // CASPER_GREP_ENGINE_H
@@ -0,0 +1,64 @@
+#ifndef CASPER_JOB_MANAGER_H
+#define CASPER_JOB_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+
+namespace casper {
+
+struct JobInfo {
+    int id = 0;
+    std::string command;
+    pid_t pid = -1;
+    bool running = false;
+    int exit_code = -1;
+    int term_signal = 0;            // Signal that ended the job, 0 if it exited
+    long elapsed_ms = 0;            // Runtime so far, or total once finished
+    size_t output_bytes = 0;        // Produced in total, including dropped bytes
+};
+
+// Background commands started by the Bash tool. Each job gets a reader
+// thread that drains its pipes into a fixed-size ring buffer, so a chatty
+// build never blocks and only the newest output is kept.
+class JobManager {
+public:
+    explicit JobManager(size_t buffer_bytes = 256 * 1024);
+    ~JobManager();      // Kills jobs that are still running
+
+    JobManager(const JobManager&) = delete;
+    JobManager& operator=(const JobManager&) = delete;
+
+    // Run command through /bin/sh in working_dir (if set); returns the job id, 0 on failure
+    int start(const std::string& command, const std::string& working_dir, std::string& error);
+
+    bool info(int id, JobInfo& info) const;
+    std::vector<JobInfo> list() const;
+
+    // Whether any job, or something it left in the background, is still running
+    bool anyRunning() const;
+
+    // Output not returned by a previous call, or the last tail_lines lines when > 0
+    bool output(int id, int tail_lines, std::string& text);
+
+    // SIGTERM to the job's process group, SIGKILL if it is still there after a grace period
+    bool kill(int id, std::string& error);
+
+private:
+    struct Job;
+
+    std::shared_ptr<Job> find(int id) const;
+    static void drain(Job& job);
+
+    mutable std::mutex mutex_;
+    std::map<int, std::shared_ptr<Job>> jobs_;
+    int next_id_;
+    size_t buffer_bytes_;
+};
+
+} // namespace casper
+
+#endif // CASPER_JOB_MANAGER_H
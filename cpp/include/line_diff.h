@@ -0,0 +1,47 @@
+#ifndef CASPER_LINE_DIFF_H
+#define CASPER_LINE_DIFF_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace casper {
+
+struct DiffLine {
+    char op;                        // ' ' context, '-' removed, '+' added
+    std::string_view text;          // Points into the compared texts, without the newline
+};
+
+struct DiffHunk {
+    size_t old_start = 0;           // 1-based, as in a unified diff header
+    size_t old_count = 0;
+    size_t new_start = 0;
+    size_t new_count = 0;
+    std::vector<DiffLine> lines;
+};
+
+struct DiffResult {
+    std::vector<DiffHunk> hunks;
+    size_t added = 0;
+    size_t removed = 0;
+};
+
+// Line diff using Myers' O(ND) algorithm. Common leading and trailing
+// lines are stripped first, so a local edit in a large file costs one
+// linear pass plus the size of the change.
+class LineDiff {
+public:
+    static DiffResult compute(std::string_view old_text, std::string_view new_text, size_t context = 3);
+
+    // "--- a/path" / "+++ b/path" headers and @@ hunks; at most max_lines
+    // body lines when non-zero. color adds terminal colors.
+    static std::string unified(const DiffResult& diff, const std::string& old_name,
+                               const std::string& new_name, bool color = false, size_t max_lines = 0);
+
+private:
+    static std::vector<std::string_view> splitLines(std::string_view text);
+};
+
+} // namespace casper
+
+#endif // CASPER_LINE_DIFF_H
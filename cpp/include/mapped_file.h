@@ -0,0 +1,60 @@
+#ifndef CASPER_MAPPED_FILE_H
+#define CASPER_MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace casper {
+
+// Read-only view of a file. Regular files are mmap'ed so only the pages
+// that are touched get read; files without a size (/proc, pipes) are
+// read into memory instead.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+
+    // View contents already in memory (from FileCache) instead of a file
+    void assign(std::shared_ptr<const std::string> content);
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // NUL bytes or mostly control characters near the start
+    bool isBinary() const;
+
+    // "ELF executable", "PNG image", ... or "" when the format is not recognised
+    std::string binaryType() const;
+
+    // Byte offset where a 1-based line starts, size() when the file is
+    // shorter. Line starts are indexed as far as the furthest lookup.
+    size_t lineOffset(size_t line);
+
+    // Lines indexed so far; the total once a lookup ran past the end
+    size_t indexedLines() const { return line_starts_.size(); }
+    bool fullyIndexed() const { return indexed_to_ >= size_; }
+
+    // Byte offset where the count-th line from the end starts
+    size_t tailOffset(size_t count) const;
+
+private:
+    void close();
+
+    const char* data_;
+    size_t size_;
+    bool mapped_;
+    std::string buffer_;                // Contents when the file could not be mapped
+    std::shared_ptr<const std::string> shared_;     // Contents given to assign()
+    std::vector<size_t> line_starts_;
+    size_t indexed_to_;                 // Offset up to which line_starts_ is complete
+};
+
+} // namespace casper
+
+#endif // CASPER_MAPPED_FILE_H
@@ -0,0 +1,95 @@
+#ifndef CASPER_NET_PROBE_H
+#define CASPER_NET_PROBE_H
+
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+namespace casper {
+
+struct NetTarget {
+    std::string name;               // As given
+    std::string address;            // Numeric address it resolved to
+    sockaddr_storage addr = {};
+    socklen_t addr_len = 0;
+    std::string error;              // Could not be resolved
+};
+
+struct PingResult {
+    NetTarget target;
+    int sent = 0;
+    int received = 0;
+    double min_ms = 0;
+    double avg_ms = 0;
+    double max_ms = 0;
+    std::string method;             // "icmp", or "udp" when ICMP sockets are not permitted
+    std::string error;
+};
+
+struct TraceHop {
+    int ttl = 0;
+    std::string address;            // "" when no probe came back
+    std::vector<double> rtts_ms;
+    bool reached = false;           // Answered by the destination itself
+    std::string note;               // "!H", "!N", ... for unreachable replies
+};
+
+struct TraceResult {
+    NetTarget target;
+    std::vector<TraceHop> hops;
+    bool reached = false;
+    std::string error;
+};
+
+enum class PortState { Open, Closed, Filtered };
+
+struct PortResult {
+    int port = 0;
+    PortState state = PortState::Filtered;
+    double rtt_ms = 0;
+};
+
+struct ScanResult {
+    NetTarget target;
+    std::vector<PortResult> ports;  // Sorted by port
+};
+
+// Native host and port probing on non-blocking sockets: every target is
+// probed at once from one poll loop, so checking many hosts takes about as
+// long as checking one.
+class NetProbe {
+public:
+    // Hosts separated by commas or spaces; "10.0.0.0/24" and "10.0.0.5-20" expand
+    static bool parseTargets(const std::string& spec, std::vector<std::string>& hosts, std::string& error,
+                             size_t max_hosts = 4096);
+
+    // "22,80,8000-8100"; empty means commonPorts()
+    static bool parsePorts(const std::string& spec, std::vector<int>& ports, std::string& error);
+    static std::vector<int> commonPorts();
+
+    // Resolves names in parallel; literal addresses are used as they are
+    static std::vector<NetTarget> resolve(const std::vector<std::string>& hosts);
+
+    // ICMP echo over an unprivileged or raw socket, else a UDP probe that
+    // counts "port unreachable" replies. IPv6 targets always use UDP.
+    static std::vector<PingResult> ping(const std::vector<NetTarget>& targets, int count,
+                                        int timeout_ms, int interval_ms = 200);
+
+    // UDP probes with rising TTLs, all sent at once, reading the ICMP errors
+    // from the socket error queue (no root needed). Linux and IPv4 only.
+    static bool tracerouteSupported(const NetTarget& target);
+    static TraceResult traceroute(const NetTarget& target, int max_hops, int probes = 3, int timeout_ms = 2000);
+
+    // TCP connect scan with at most `concurrency` connections in flight
+    static std::vector<ScanResult> scan(const std::vector<NetTarget>& targets, const std::vector<int>& ports,
+                                        size_t concurrency, int timeout_ms);
+
+    // replied_only leaves silent hosts out of the listing but not the summary
+    static std::string formatPing(const std::vector<PingResult>& results, bool replied_only = false);
+    static std::string formatTrace(const TraceResult& result);
+    static std::string formatScan(const std::vector<ScanResult>& results, bool show_closed);
+};
+
+} // namespace casper
+
+#endif // CASPER_NET_PROBE_H
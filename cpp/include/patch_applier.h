@@ -0,0 +1,71 @@
+#ifndef CASPER_PATCH_APPLIER_H
+#define CASPER_PATCH_APPLIER_H
+
+#include <string>
+#include <vector>
+
+namespace casper {
+
+struct PatchHunk {
+    size_t old_start = 0;           // 1-based line from the @@ header, a hint only
+    std::vector<std::pair<char, std::string>> lines;    // ' ', '-' or '+' and the text
+    bool old_no_newline = false;    // "\ No newline at end of file" after the old side
+    bool new_no_newline = false;
+};
+
+struct FilePatch {
+    std::string old_path;           // "/dev/null" when the patch creates the file
+    std::string new_path;           // "/dev/null" when it deletes the file
+    std::vector<PatchHunk> hunks;
+
+    bool creates() const { return old_path == "/dev/null"; }
+    bool deletes() const { return new_path == "/dev/null"; }
+    const std::string& path() const { return deletes() ? old_path : new_path; }
+};
+
+struct HunkStatus {
+    bool applied = false;
+    size_t line = 0;                // 1-based line in the original file where it applied
+    long offset = 0;                // Distance from the line in the @@ header
+    int fuzz = 0;                   // Context lines ignored at each end
+    bool whitespace = false;        // Matched only when ignoring whitespace
+};
+
+struct FilePatchResult {
+    std::string path;               // File written (new path when renaming)
+    std::string old_path;           // Different from path for renames
+    bool ok = false;
+    std::string error;              // File level problem (missing, exists, ...)
+    std::vector<HunkStatus> hunks;
+
+    bool existed = false;           // Whether the file was there before
+    std::string original;
+    std::string content;            // Result, written only when every file is ok
+    bool remove = false;            // The patch deletes the file
+};
+
+struct PatchCheck {
+    bool ok = false;
+    std::vector<FilePatchResult> files;
+};
+
+// Unified diffs over any number of files. Every hunk is located first,
+// tolerating moved lines, whitespace changes and a little stale context,
+// so a patch is applied as a whole or not at all.
+class PatchApplier {
+public:
+    static bool parse(const std::string& text, std::vector<FilePatch>& patches, std::string& error);
+
+    // Compute the new contents of every file without writing anything
+    static PatchCheck check(const std::vector<FilePatch>& patches);
+
+    // Per-file, per-hunk summary
+    static std::string report(const PatchCheck& check);
+
+private:
+    static bool applyHunks(const FilePatch& patch, FilePatchResult& result);
+};
+
+} // namespace casper
+
+#endif // CASPER_PATCH_APPLIER_H
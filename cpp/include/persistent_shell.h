@@ -0,0 +1,62 @@
+#ifndef CASPER_PERSISTENT_SHELL_H
+#define CASPER_PERSISTENT_SHELL_H
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include "process_runner.h"
+
+namespace casper {
+
+struct ShellResult {
+    bool started = false;
+    std::string error;               // Why the shell could not be started or fed
+    int exit_code = -1;
+    bool timed_out = false;          // The shell was killed and will be restarted
+    bool shell_exited = false;       // The command ended the shell (exit, exec, set -e)
+
+    std::string stdout_data;
+    std::string stderr_data;
+    bool truncated = false;
+    size_t dropped_bytes = 0;
+    long duration_ms = 0;
+};
+
+// One long-lived bash per session. Commands are written to its stdin and
+// their end is found by a random marker echoed after them on both streams,
+// so cd, exports and functions carry over between calls. A dead or timed
+// out shell is restarted on the next call.
+class PersistentShell {
+public:
+    using OutputCallback = std::function<void(const char* data, size_t size, bool is_stderr)>;
+
+    PersistentShell();
+    ~PersistentShell();
+
+    PersistentShell(const PersistentShell&) = delete;
+    PersistentShell& operator=(const PersistentShell&) = delete;
+
+    ShellResult run(const std::string& command, int timeout_ms,
+                    const OutputCallback& on_output = nullptr,
+                    size_t max_output_bytes = 1024 * 1024);
+
+    bool isRunning();
+    void stop();
+
+    // The shell's current directory, or "" when it is not running or unknown
+    std::string workingDirectory();
+
+private:
+    bool start(std::string& error);
+    bool alive();
+    void kill();
+    std::string newMarker();
+
+    std::mutex mutex_;
+    SpawnedProcess process_;
+    unsigned long commands_;
+};
+
+} // namespace casper
+
+#endif // CASPER_PERSISTENT_SHELL_H
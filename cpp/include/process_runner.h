@@ -0,0 +1,96 @@
+#ifndef CASPER_PROCESS_RUNNER_H
+#define CASPER_PROCESS_RUNNER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <sys/types.h>
+
+namespace casper {
+
+struct ProcessOptions {
+    std::string command;             // Run through /bin/sh -c
+    std::vector<std::string> argv;   // Or exec directly when non-empty
+    std::string stdin_data;          // Written to the child's stdin, then closed
+    bool merge_stderr = false;       // Send stderr into stdout (like 2>&1)
+    bool interactive = false;        // Keep the terminal: inherit stdin, stay in our process group
+    int timeout_ms = 0;              // Wall clock limit, 0 = none
+    int idle_timeout_ms = 0;         // Limit on time without any output, 0 = none
+    size_t max_output_bytes = 1024 * 1024;  // Per stream; the middle is dropped beyond this
+
+    // Called with each chunk as it arrives (is_stderr tells the stream apart)
+    std::function<void(const char* data, size_t size, bool is_stderr)> on_output;
+};
+
+struct ProcessResult {
+    bool started = false;
+    std::string error;               // Why the process could not be started
+    int exit_code = -1;
+    int term_signal = 0;             // Signal that ended the process, 0 if it exited
+    bool timed_out = false;
+    bool idle_timed_out = false;
+
+    std::string stdout_data;
+    std::string stderr_data;
+    size_t stdout_bytes = 0;         // Total produced, including dropped bytes
+    size_t stderr_bytes = 0;
+    bool truncated = false;
+    size_t dropped_bytes = 0;        // Cut from both streams by the output limit
+
+    long duration_ms = 0;
+    double user_cpu_seconds = 0;
+    double system_cpu_seconds = 0;
+    long max_rss_kb = 0;
+};
+
+// Keeps the first and last half of a stream once it exceeds its limit;
+// the beginning and end of a build log are the parts worth reading
+class OutputBuffer {
+public:
+    explicit OutputBuffer(size_t limit);
+
+    void append(const char* data, size_t size);
+    std::string str() const;    // With a "[... N bytes omitted ...]" marker when truncated
+
+    size_t total() const { return total_; }
+    bool truncated() const;
+    size_t dropped() const;     // Bytes between the kept head and tail
+
+private:
+    size_t half_;
+    size_t total_;
+    std::string head_;
+    std::string tail_;
+};
+
+// A child started with all three standard streams connected to pipes
+struct SpawnedProcess {
+    pid_t pid = -1;
+    int stdin_fd = -1;
+    int stdout_fd = -1;
+    int stderr_fd = -1;
+};
+
+// posix_spawn based runner. Output is drained from pipes with poll into
+// bounded buffers; on timeout the whole process group is terminated.
+class ProcessRunner {
+public:
+    static ProcessResult run(const ProcessOptions& options);
+
+    // Start argv (PATH is searched) in its own process group, for callers
+    // that keep talking to the child. Read ends are non-blocking.
+    static bool spawn(const std::vector<std::string>& argv, SpawnedProcess& process, std::string& error);
+
+    // Groups started by spawn stay registered until the caller has reaped
+    // the leader and nothing else in the group is left to signal
+    static void releaseGroup(pid_t pgid);
+
+    // Sends sig to every registered group (the commands run in their own
+    // groups, so a terminal's signals never reach them); sig 0 only checks.
+    // Returns whether any group still exists.
+    static bool signalGroups(int sig);
+};
+
+} // namespace casper
+
+#endif // CASPER_PROCESS_RUNNER_H
@@ -10,6 +10,8 @@
 
 namespace casper {
 
+class FileCache;
+
 // Document chunk for indexing
 struct DocumentChunk {
     std::string content;
@@ -87,6 +89,9 @@ public:
     bool isInitialized() const;
     bool isEnabled() const;
 
+    // Read files through the tools' cache
+    void setFileCache(std::shared_ptr<FileCache> cache);
+
     // Progress callback for long operations
     void setProgressCallback(std::function<void(const std::string&, int, int)> callback);
 
@@ -96,6 +101,7 @@ private:
     RAGConfig config_;
     bool initialized_;
     std::function<void(const std::string&, int, int)> progress_callback_;
+    std::shared_ptr<FileCache> file_cache_;
 
     // Helper methods
     std::vector<DocumentChunk> chunkText(const std::string& text, const std::string& source);
@@ -0,0 +1,70 @@
+#ifndef CASPER_RESULT_CACHE_H
+#define CASPER_RESULT_CACHE_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include "tool_executor.h"
+#include "tool_scheduler.h"
+
+namespace casper {
+
+struct ResultCacheStats {
+    size_t entries = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t invalidations = 0;
+};
+
+// Results of side-effect free tools (Glob, Grep, DBSchema, WebFetch,
+// WebSearch), keyed by tool name and normalized parameters. Entries expire
+// after a per-tool TTL and are dropped as soon as another call may have
+// changed what they depend on: a write to an overlapping path, a call on
+// the same resource (DBExecute for DBSchema), or any barrier such as Bash,
+// an MCP tool or a look at a background job.
+class ResultCache {
+public:
+    explicit ResultCache(size_t max_entries = 200);
+
+    // Seconds a tool's results stay valid; 0 = never cached
+    static int ttlSeconds(const std::string& tool);
+
+    bool lookup(const ToolCall& call, ToolResult& result, long& age_seconds);
+
+    // Record a finished call: cache it, or invalidate what it may have
+    // changed. With local_changing, results that depend on files or
+    // databases are not kept.
+    void update(const ToolCall& call, const ToolResult& result, bool local_changing = false);
+
+    // Drop everything that depends on files or databases, for changes made
+    // outside tool calls (a background job)
+    void invalidateLocal();
+
+    void clear();
+    ResultCacheStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        ToolResult result;
+        ToolAccess access;
+        Clock::time_point stored;
+        Clock::time_point expires;
+    };
+
+    static std::string key(const ToolCall& call);
+    void invalidate(const ToolAccess& changed);     // Caller holds mutex_
+
+    size_t max_entries_;
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    size_t hits_;
+    size_t misses_;
+    size_t invalidations_;
+};
+
+} // namespace casper
+
+#endif // CASPER_RESULT_CACHE_H
@@ -0,0 +1,38 @@
+#ifndef CASPER_SESSION_ARCHIVE_H
+#define CASPER_SESSION_ARCHIVE_H
+
+#include <string>
+#include <cstdint>
+
+namespace casper {
+
+// Where one archived session is kept
+struct ArchiveLocation {
+    std::string file;           // Name within the archive directory
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+// Per-month files of sessions moved out of the session database. Each
+// session is one JSON line appended as its own gzip member, so a month is
+// readable with zcat and a single session is read back by offset without
+// inflating the rest. Built without zlib, the lines are stored as they are.
+class SessionArchive {
+public:
+    explicit SessionArchive(const std::string& dir);
+
+    // Appends line to the file for month ("YYYY-MM") and syncs it
+    bool append(const std::string& month, const std::string& line,
+                ArchiveLocation& location, std::string& error);
+
+    bool read(const ArchiveLocation& location, std::string& line, std::string& error) const;
+
+    const std::string& dir() const { return dir_; }
+
+private:
+    std::string dir_;
+};
+
+} // namespace casper
+
+#endif // CASPER_SESSION_ARCHIVE_H
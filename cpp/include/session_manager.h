@@ -5,6 +5,11 @@
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <sqlite3.h>
 #include "json.hpp"
 
@@ -12,6 +17,9 @@ namespace casper {
 
 using json = nlohmann::json;
 
+class BlobStore; // Forward declaration
+class SessionArchive;
+
 // Represents a single message in the conversation
 struct Message {
     std::string role;        // "user", "assistant", "tool"
@@ -29,11 +37,45 @@ struct ToolExecution {
     std::string output;
     int exit_code;
     std::string timestamp;
+    int64_t id = 0;             // Row id once loaded from the database
+    bool output_loaded = true;  // Resumed executions leave output on disk; see getToolOutput()
 
     json toJson() const;
     static ToolExecution fromJson(const json& j);
 };
 
+// Timing and resource use of one tool call
+struct ToolSpan {
+    std::string tool_name;
+    std::string parameters;         // JSON, cut to a few hundred bytes
+    long wall_ms = 0;
+    double cpu_seconds = 0;         // Child processes
+    double thread_cpu_seconds = 0;  // The executing thread itself
+    long max_rss_kb = 0;
+    size_t output_bytes = 0;        // Handed back to the model
+    size_t truncated_bytes = 0;     // Dropped by output limits
+    bool cache_hit = false;
+    bool success = false;
+    int exit_code = 0;
+    std::string timestamp;          // Set when recorded
+};
+
+// Per-tool summary of recorded spans
+struct ToolStats {
+    std::string tool_name;
+    int calls = 0;
+    int failures = 0;
+    int cache_hits = 0;
+    long total_ms = 0;
+    long p50_ms = 0;
+    long p95_ms = 0;
+    long max_ms = 0;
+    double cpu_seconds = 0;         // Child processes plus the executing thread
+    long max_rss_kb = 0;
+    uint64_t output_bytes = 0;
+    uint64_t truncated_bytes = 0;
+};
+
 // Represents a file modification
 struct FileModification {
     std::string file_path;
@@ -44,6 +86,37 @@ struct FileModification {
     static FileModification fromJson(const json& j);
 };
 
+// One row of the session list; the counts are kept up to date on every save
+struct SessionSummary {
+    std::string session_id;
+    std::string created_at;
+    std::string updated_at;     // Last activity
+    std::string model;
+    std::string working_directory;
+    std::string summary;
+    bool is_active = false;
+    int message_count = 0;
+    int tool_count = 0;
+    uint64_t size_bytes = 0;    // Message, tool and file row contents
+};
+
+// A message or tool call that matched a search
+struct SearchHit {
+    std::string session_id;
+    std::string updated_at;     // Of the session
+    std::string source;         // Message role, the tool's name, or "archived"
+    std::string snippet;        // Matched terms between the caller's marks
+    std::string timestamp;
+    double score = 0;           // bm25, lower is better; 0 without the full-text index
+};
+
+// Past these limits the oldest sessions are moved to the archive; 0 means no limit
+struct RetentionPolicy {
+    int max_age_days = 0;       // Since last activity
+    int max_sessions = 0;
+    uint64_t max_bytes = 0;     // Of session contents, as in SessionSummary::size_bytes
+};
+
 // Represents a complete session
 struct Session {
     std::string session_id;
@@ -66,12 +139,24 @@ public:
     SessionManager();
     ~SessionManager();
 
-    // Initialize session manager with database
-    bool initialize(const std::string& db_path = "");
+    // Initialize session manager with database. durability:
+    //   "full"   - every save is committed before it returns
+    //   "normal" - saves are queued and group-committed by a background
+    //              writer every few milliseconds (WAL, synchronous=NORMAL)
+    //   "off"    - like normal, without syncing (an OS crash may lose data)
+    // Queued writes are flushed on close, on SIGINT/SIGTERM/SIGHUP and by flush().
+    bool initialize(const std::string& db_path = "", const std::string& durability = "normal");
+
+    // Wait until every queued write is committed
+    void flush();
 
-    // Session lifecycle
+    // Session lifecycle. loadSession closes the current session and resumes
+    // another with only its newest messages in memory; older ones come in
+    // with loadOlderMessages(). An unknown id leaves the current one open.
     std::string createSession(const std::string& model, const std::string& working_dir);
     bool loadSession(const std::string& session_id);
+    int loadOlderMessages(int count = 50);      // Returns how many were loaded
+    size_t olderMessageCount() const { return older_messages_; }
     bool saveSession();
     bool closeSession();
 
@@ -90,6 +175,16 @@ public:
                            const std::string& output,
                            int exit_code);
 
+    // Tool spans are written straight to their own table, not kept in the session
+    void recordToolSpan(const ToolSpan& span);
+
+    // Slowest tools first; this session only unless all_sessions
+    std::vector<ToolStats> getToolStats(bool all_sessions = false);
+    std::vector<ToolSpan> getSlowestToolSpans(int limit, bool all_sessions = false);
+
+    // Output of a tool execution, read from the database if it was not loaded
+    std::string getToolOutput(const ToolExecution& te) const;
+
     // File modification tracking
     void recordFileModification(const std::string& file_path,
                                const std::string& operation);
@@ -97,12 +192,31 @@ public:
     // Get conversation context for AI (last N messages)
     std::vector<Message> getConversationContext(int max_messages = 10) const;
 
-    // Session listing and management
+    // Session listing and management. listSessionPage returns the most
+    // recently active sessions first, continuing after after_id if given.
+    std::vector<SessionSummary> listSessionPage(int limit, const std::string& after_id = "");
     std::vector<std::string> listSessions() const;
     std::vector<std::string> listActiveSessions() const;
     std::string getLastActiveSession() const;
     bool deleteSession(const std::string& session_id);
 
+    // Retention. Once started, a background thread applies the policy a few
+    // MB at a time, moving the oldest sessions into compressed per-month
+    // files under getArchiveDir(); the session in use is never moved.
+    // Archived sessions are still found by searchSessions() and come back
+    // with loadSession().
+    void startRetention(const RetentionPolicy& policy);
+    bool isArchived(const std::string& session_id) const;
+    bool restoreSession(const std::string& session_id);
+    std::string getArchiveDir() const;
+
+    // Full-text search over all sessions' messages and tool calls, best
+    // matches first. Every word must match; "word*" matches a prefix.
+    // Archived sessions match on their summary and user messages.
+    std::vector<SearchHit> searchSessions(const std::string& query, int limit = 20,
+                                          const std::string& open_mark = "[",
+                                          const std::string& close_mark = "]");
+
     // Generate session summary using AI
     void generateSessionSummary(const std::string& summary);
     std::string getSessionSummary() const;
@@ -112,7 +226,7 @@ public:
     bool generateDecisionsMd(const std::string& output_path = "") const;
     bool generateSessionReport(const std::string& output_path = "") const;
 
-    // Export session data
+    // Export session data, including history not loaded into memory
     bool exportSessionToJson(const std::string& file_path) const;
     bool exportSessionToMarkdown(const std::string& file_path) const;
 
@@ -130,22 +244,103 @@ public:
 private:
     void initializeDatabase();
     void createTables();
+    void addSummaryColumns();
+    void createBlobStorage();
+    void createSearchIndex();
+    std::vector<SearchHit> searchWithLike(const std::string& query, int limit,
+                                          const std::string& open_mark, const std::string& close_mark);
     std::string generateSessionId() const;
     std::string getCurrentTimestamp() const;
 
+    // Rows appended to a session since the previous save, with its metadata
+    // as of that save (has_session), and tool spans
+    struct PendingWrite {
+        bool has_session = false;
+        Session rows;
+        std::vector<ToolSpan> spans;
+    };
+
     // Database operations
     bool saveSessionToDb();
     bool loadSessionFromDb(const std::string& session_id);
-    bool saveMessages();
-    bool saveToolExecutions();
-    bool saveFileModifications();
-    bool loadMessages(const std::string& session_id);
+    bool sessionExists(const std::string& session_id) const;
+    void submit(PendingWrite write);
+    bool writeBatch(const std::vector<PendingWrite>& batch);
+    bool saveMessages(const Session& rows);
+    bool saveToolExecutions(const Session& rows);
+    bool saveFileModifications(const Session& rows);
+    bool saveToolSpans(const std::string& session_id, const std::vector<ToolSpan>& spans);
+    int loadMessages(const std::string& session_id, int limit);
+    Session fullSession(bool with_outputs = true) const;   // Everything, loaded or not
     bool loadToolExecutions(const std::string& session_id);
     bool loadFileModifications(const std::string& session_id);
 
+    // Background writer
+    void writerLoop();
+    void stopWriter();
+
+    // Retention, on archive_db_
+    void retentionLoop();
+    void stopRetention();
+    int archiveStep(uint64_t byte_budget);     // Returns how many sessions were archived
+    bool compactStep();                         // True while free pages remain
+    bool archiveSession(const std::string& session_id, const std::string& updated_at);
+    bool readSession(sqlite3* db, const std::string& session_id, Session& session) const;
+    void setOpenSession(const std::string& session_id);
+
+    // Statements run on write_db_; they are prepared once and reset for each use
+    sqlite3_stmt* cachedStatement(sqlite3_stmt*& cached, const char* sql);
+    void finalizeStatements();
+    bool execute(sqlite3* db, const char* sql);
+
     sqlite3* db_;
+    sqlite3* write_db_;             // The writer's own connection, or db_ with "full" durability
     std::unique_ptr<Session> current_session_;
     std::string db_path_;
+    std::string durability_;
+    bool search_index_;             // FTS5 is available; otherwise search falls back to LIKE
+
+    // Rows of the current session already written or queued. Messages, tool
+    // executions and file modifications are only ever appended, so a save
+    // takes what lies past these.
+    size_t saved_messages_;
+    size_t saved_tool_executions_;
+    size_t saved_file_modifications_;
+
+    // Messages of a resumed session still only on disk, all older than oldest_message_id_
+    size_t older_messages_;
+    int64_t oldest_message_id_;
+
+    sqlite3_stmt* upsert_session_stmt_;
+    sqlite3_stmt* insert_message_stmt_;
+    sqlite3_stmt* insert_tool_stmt_;
+    sqlite3_stmt* insert_file_stmt_;
+    sqlite3_stmt* insert_span_stmt_;
+    std::unique_ptr<BlobStore> blobs_;  // Payloads of MIN_SIZE and up, on write_db_
+
+    std::thread writer_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;      // Work queued, or a flush or stop requested
+    std::condition_variable drained_cv_;    // Room in the queue, or a batch committed
+    std::deque<PendingWrite> queue_;
+    bool writing_;
+    bool stop_writer_;
+    int flush_requests_;
+    int failed_commits_;            // Group commits in a row that failed; see writerLoop()
+
+    sqlite3* archive_db_;           // The retention thread's own connection
+    std::unique_ptr<SessionArchive> archive_;
+    RetentionPolicy retention_;
+    std::thread retention_thread_;
+    std::mutex retention_mutex_;
+    std::condition_variable retention_cv_;
+    bool stop_retention_;
+
+    // The session in use, which retention leaves alone. Held while a session
+    // is archived, and by loadSession across a restore, so neither sees the
+    // other halfway.
+    std::recursive_mutex open_session_mutex_;
+    std::string open_session_id_;
 };
 
 } // namespace casper
@@ -0,0 +1,58 @@
+#ifndef CASPER_SSH_MULTIPLEXER_H
+#define CASPER_SSH_MULTIPLEXER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ctime>
+
+namespace casper {
+
+struct SshMaster {
+    std::string target;             // user@host:port, or user@host:default
+    std::string socket;
+};
+
+// One OpenSSH ControlMaster per user@host:port, so SSH, Scp and Rsync calls
+// share an authenticated connection instead of paying a handshake each time.
+// Masters run detached with ControlPersist and exit on their own after
+// idle_seconds without clients; they outlive casper, so a later run picks
+// them up again. Sockets live under socket_dir, which has to be a private
+// directory (0700, ours, not a symlink); otherwise nothing is multiplexed.
+class SshMultiplexer {
+public:
+    explicit SshMultiplexer(const std::string& socket_dir);
+
+    // ssh options ("-o ControlPath='...'") that route a connection to the
+    // target through its master, starting one when none is running. "" when
+    // the master could not be started; the caller then connects directly.
+    // Port 0 leaves the port to ssh, so a Port in ~/.ssh/config applies.
+    std::string options(const std::string& user, const std::string& host, int port, int idle_seconds);
+
+    // Splits the remote side of an scp/rsync operand, "[user@]host:path".
+    // false for local paths.
+    static bool parseRemote(const std::string& operand, std::string& user, std::string& host);
+
+    // Masters with a live socket; stale sockets are cleaned up
+    std::vector<SshMaster> list();
+
+    // Ask masters to exit: the one for target ("host", "user@host" or
+    // "user@host:port"), or all of them when target is empty. Returns how many.
+    int close(const std::string& target);
+
+private:
+    std::string socketPath(const std::string& target) const;
+    bool start(const std::string& user, const std::string& host, int port,
+               const std::string& socket, int idle_seconds);
+
+    std::string socket_dir_;
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<std::mutex>> starting_;   // Per target, so one caller starts it
+    std::map<std::string, std::time_t> failed_;                     // Targets to connect to directly for a while
+};
+
+} // namespace casper
+
+#endif // CASPER_SSH_MULTIPLEXER_H
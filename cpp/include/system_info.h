@@ -0,0 +1,85 @@
+#ifndef CASPER_SYSTEM_INFO_H
+#define CASPER_SYSTEM_INFO_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace casper {
+
+struct SocketEntry {
+    std::string proto;              // tcp, tcp6, udp, udp6
+    std::string local;              // "addr:port"
+    std::string remote;             // "addr:port", "*:*" when unconnected
+    std::string state;              // ESTABLISHED, LISTEN, UNCONN, ...
+    unsigned long inode = 0;
+    uint32_t send_queue = 0;
+    uint32_t recv_queue = 0;
+    int pid = 0;                    // 0 = not looked up or not visible
+    std::string program;
+};
+
+struct InterfaceInfo {
+    std::string name;
+    std::vector<std::string> flags;         // UP, LOOPBACK, RUNNING, ...
+    int mtu = 0;
+    std::string mac;
+    std::vector<std::string> addresses;     // "inet 10.0.0.2/24", "inet6 fe80::1/64"
+    bool has_stats = false;
+    uint64_t rx_bytes = 0, rx_packets = 0, rx_errors = 0, rx_dropped = 0;
+    uint64_t tx_bytes = 0, tx_packets = 0, tx_errors = 0, tx_dropped = 0;
+};
+
+struct RouteEntry {
+    std::string destination;        // "default" or "10.0.0.0/8"
+    std::string gateway;            // "" when directly connected
+    std::string iface;
+    int metric = 0;
+};
+
+struct ArpEntry {
+    std::string address;
+    std::string mac;
+    std::string iface;
+    std::string state;              // complete, incomplete, permanent
+};
+
+struct DiskUsage {
+    std::string device;
+    std::string fs_type;
+    std::string mount_point;
+    uint64_t total = 0;             // Bytes
+    uint64_t used = 0;
+    uint64_t available = 0;         // For unprivileged users
+    uint64_t inodes = 0;
+    uint64_t inodes_used = 0;
+};
+
+// Network and disk state read straight from the kernel (/proc, getifaddrs,
+// statvfs), so Netstat, Ifconfig, ARP and Df work without net-tools or a
+// child process. The /proc readers return false where /proc is missing
+// (macOS) and callers fall back to the system commands.
+class SystemInfo {
+public:
+    // pids costs a scan of /proc/*/fd, so it is only done when asked
+    static bool sockets(bool tcp, bool udp, bool listening_only, bool pids,
+                        std::vector<SocketEntry>& entries, std::string& error);
+    static bool routes(std::vector<RouteEntry>& entries, std::string& error);
+    static bool arpTable(std::vector<ArpEntry>& entries, std::string& error);
+
+    // All interfaces, or just `only`
+    static bool interfaces(const std::string& only, std::vector<InterfaceInfo>& entries, std::string& error);
+
+    // Mounted filesystems with real storage, or the one holding `path`
+    static bool diskUsage(const std::string& path, std::vector<DiskUsage>& entries, std::string& error);
+
+    static std::string formatSockets(const std::vector<SocketEntry>& entries, size_t max_lines);
+    static std::string formatRoutes(const std::vector<RouteEntry>& entries);
+    static std::string formatArp(const std::vector<ArpEntry>& entries);
+    static std::string formatInterfaces(const std::vector<InterfaceInfo>& entries);
+    static std::string formatDiskUsage(const std::vector<DiskUsage>& entries, bool human);
+};
+
+} // namespace casper
+
+#endif // CASPER_SYSTEM_INFO_H
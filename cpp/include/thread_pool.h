@@ -0,0 +1,48 @@
+#ifndef CASPER_THREAD_POOL_H
+#define CASPER_THREAD_POOL_H
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace casper {
+
+// Fixed-size worker pool for running independent tasks concurrently
+class ThreadPool {
+public:
+    // 0 threads = one per hardware thread
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task for execution on a worker thread
+    void submit(std::function<void()> task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    size_t size() const { return workers_.size(); }
+
+    static size_t defaultThreadCount();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable task_cv_;
+    std::condition_variable done_cv_;
+    size_t active_;
+    bool stopping_;
+};
+
+} // namespace casper
+
+#endif // CASPER_THREAD_POOL_H
@@ -13,17 +13,42 @@ class MCPClient; // Forward declaration
 class SearchClient; // Forward declaration
 class DBClient; // Forward declaration
 class RAGEngine; // Forward declaration
+struct ProcessOptions; // Forward declaration
+struct ProcessResult; // Forward declaration
+class PersistentShell; // Forward declaration
+class JobManager; // Forward declaration
+class UndoStore; // Forward declaration
+class FileCache; // Forward declaration
+class ResultCache; // Forward declaration
+class SshMultiplexer; // Forward declaration
+class MappedFile; // Forward declaration
+struct FileStamp; // Forward declaration
 
 struct ToolResult {
     bool success;
     int exit_code;
     std::string output;
     std::string error;
+
+    // Resource usage of the commands the tool ran
+    long duration_ms = 0;
+    double cpu_seconds = 0;
+    long max_rss_kb = 0;
+    bool timed_out = false;
+    bool truncated = false;        // Output exceeded the cap and was shortened
+
+    // The whole execute() call
+    long wall_ms = 0;
+    double thread_cpu_seconds = 0; // Spent on the calling thread itself (in-process tools)
+    size_t output_bytes = 0;       // Output and error as handed back to the model
+    size_t truncated_bytes = 0;    // Dropped by the output cap
+    bool cache_hit = false;
 };
 
 class ToolExecutor {
 public:
     explicit ToolExecutor(Config& config);
+    ~ToolExecutor();
 
     // Execute a single tool call
     ToolResult execute(const ToolCall& tool_call);
@@ -44,6 +69,17 @@ public:
     void setDBClient(DBClient* client);
     void setRAGEngine(RAGEngine* engine);
 
+    // Drop the persistent Bash shell; the next command starts a fresh one
+    void resetShell();
+
+    // File changes made by Edit and Write, for /undo
+    UndoStore& undoStore() { return *undo_; }
+    FileCache& fileCache() { return *file_cache_; }
+    ResultCache& resultCache() { return *result_cache_; }
+
+    // Shared connections of SSH, Scp and Rsync, for /ssh
+    SshMultiplexer& sshMultiplexer() { return *ssh_mux_; }
+
 private:
     Config& config_;
     ConfirmCallback confirm_callback_;
@@ -51,6 +87,14 @@ private:
     SearchClient* search_client_;
     DBClient* db_client_;
     RAGEngine* rag_engine_;
+    std::unique_ptr<PersistentShell> shell_;    // Started by the first Bash call
+    std::unique_ptr<JobManager> jobs_;          // Bash calls with run_in_background
+    std::unique_ptr<UndoStore> undo_;
+    std::shared_ptr<FileCache> file_cache_;     // Shared with the RAG engine
+    std::unique_ptr<ResultCache> result_cache_;
+    std::unique_ptr<SshMultiplexer> ssh_mux_;
+
+    ToolResult dispatch(const ToolCall& tool_call);
 
     // Tool implementations
     ToolResult executeBash(const ToolCall& tool_call);
@@ -59,8 +103,16 @@ private:
     ToolResult executeEdit(const ToolCall& tool_call);
     ToolResult executeGlob(const ToolCall& tool_call);
     ToolResult executeGrep(const ToolCall& tool_call);
+    ToolResult executeApplyPatch(const ToolCall& tool_call);
+    ToolResult executeReadMany(const ToolCall& tool_call);
     ToolResult executeMCPTool(const ToolCall& tool_call);
 
+    // Background job tools
+    ToolResult startBackgroundJob(const std::string& command);
+    ToolResult executeJobStatus(const ToolCall& tool_call);
+    ToolResult executeJobOutput(const ToolCall& tool_call);
+    ToolResult executeJobKill(const ToolCall& tool_call);
+
     // Search tools
     ToolResult executeWebSearch(const ToolCall& tool_call);
     ToolResult executeWebFetch(const ToolCall& tool_call);
@@ -80,6 +132,7 @@ private:
     ToolResult executePing(const ToolCall& tool_call);
     ToolResult executeTraceroute(const ToolCall& tool_call);
     ToolResult executeNmap(const ToolCall& tool_call);
+    ToolResult executeNativeScan(const ToolCall& tool_call, const std::string& target, bool discovery);
     ToolResult executeDig(const ToolCall& tool_call);
     ToolResult executeWhois(const ToolCall& tool_call);
     ToolResult executeNetstat(const ToolCall& tool_call);
@@ -119,7 +172,13 @@ private:
     // Helpers
     bool isCommandSafe(const std::string& command);
     bool requestConfirmation(const std::string& tool_name, const std::string& description);
-    std::string executeCommand(const std::string& command, int& exit_code);
+    std::string executeCommand(const std::string& command, int& exit_code);  // stdout+stderr merged
+    ProcessOptions commandOptions(const std::string& command);
+    void recordUsage(const ProcessResult& process);
+    void backupBeforeWrite(const std::string& path, const std::string& tool, bool existed,
+                           const std::string& previous, const std::string& written);
+    // Through the file cache when the file fits in it, mapped otherwise
+    bool openFile(const std::string& path, MappedFile& file, std::string& error, FileStamp* stamp = nullptr);
 
     // Tool availability helpers
     bool ensureToolAvailable(const std::string& tool_name, const std::string& package_name = "");
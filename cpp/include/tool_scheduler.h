@@ -0,0 +1,47 @@
+#ifndef CASPER_TOOL_SCHEDULER_H
+#define CASPER_TOOL_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include "tool_parser.h"
+
+namespace casper {
+
+// What a tool call touches, used to decide which calls may overlap
+struct ToolAccess {
+    std::vector<std::string> reads;       // Normalized paths read
+    std::vector<std::string> writes;      // Normalized paths modified
+    std::vector<std::string> resources;   // Named resources used exclusively (db, rag, ssh:host, ...)
+    bool barrier = false;                 // Arbitrary side effects: run alone, in order
+};
+
+// Runs tool calls concurrently while keeping conflicting calls in their
+// original order. Two calls conflict when either is a barrier, they share
+// an exclusive resource, or one writes a path the other reads or writes.
+class ToolScheduler {
+public:
+    // read_only_mcp names MCP servers ("server") and tools ("server__tool")
+    // declared read-only; every other MCP tool is a barrier
+    explicit ToolScheduler(size_t max_workers, std::set<std::string> read_only_mcp = {});
+
+    static ToolAccess classify(const ToolCall& call, const std::set<std::string>& read_only_mcp = {});
+    static bool conflicts(const ToolAccess& a, const ToolAccess& b);
+
+    // For each call, the indices of earlier calls it has to wait for
+    static std::vector<std::vector<size_t>> buildDependencies(const std::vector<ToolCall>& calls,
+                                                              const std::set<std::string>& read_only_mcp = {});
+
+    // Invoke task(i) for every call, each as soon as its dependencies finished.
+    // Returns once all tasks are done.
+    void run(const std::vector<ToolCall>& calls, const std::function<void(size_t)>& task);
+
+private:
+    size_t max_workers_;
+    std::set<std::string> read_only_mcp_;
+};
+
+} // namespace casper
+
+#endif // CASPER_TOOL_SCHEDULER_H
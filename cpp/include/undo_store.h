@@ -0,0 +1,49 @@
+#ifndef CASPER_UNDO_STORE_H
+#define CASPER_UNDO_STORE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <ctime>
+
+namespace casper {
+
+struct UndoEntry {
+    std::string path;
+    std::string tool;               // Tool that made the change
+    bool existed = true;            // false: the tool created the file
+    std::string content;            // File contents before the change
+    size_t content_size = 0;        // Kept when list() leaves the contents out
+    size_t written_size = 0;        // What the tool left behind, to notice later changes
+    size_t written_hash = 0;
+    std::time_t time = 0;
+};
+
+// Bounded in-memory history of file changes made by tools, replacing .bak
+// files. The oldest entries are dropped beyond max_entries or max_bytes.
+class UndoStore {
+public:
+    explicit UndoStore(size_t max_entries = 50, size_t max_bytes = 64 * 1024 * 1024);
+
+    // Remember the state before a change; written is the new content
+    void record(const std::string& path, const std::string& tool, bool existed,
+                std::string previous, const std::string& written);
+
+    std::vector<UndoEntry> list() const;    // Newest first, without contents
+
+    // Restore the newest change. Refuses when the file changed since the
+    // tool wrote it, unless force is set.
+    bool undoLast(std::string& message, bool force = false);
+
+private:
+    mutable std::mutex mutex_;
+    std::deque<UndoEntry> entries_;
+    size_t max_entries_;
+    size_t max_bytes_;
+    size_t bytes_;
+};
+
+} // namespace casper
+
+#endif // CASPER_UNDO_STORE_H
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <ostream>
+#include <mutex>
 
 namespace casper {
 namespace utils {
@@ -13,6 +15,8 @@ std::vector<std::string> split(const std::string& str, char delimiter);
 bool startsWith(const std::string& str, const std::string& prefix);
 bool endsWith(const std::string& str, const std::string& suffix);
 std::string toLower(const std::string& str);
+std::string formatSize(unsigned long long bytes);  // du -h style: 512, 4.0K, 1.2M, 3.0G
+std::string sha256Hex(const std::string& data);     // 64 lowercase hex digits
 
 // File utilities
 bool fileExists(const std::string& path);
@@ -20,12 +24,16 @@ bool dirExists(const std::string& path);
 bool createDir(const std::string& path);
 std::string readFile(const std::string& path);
 bool writeFile(const std::string& path, const std::string& content);
+// Write a temp file next to path and rename it over; keeps mode and owner, errno set on failure
+bool writeFileAtomic(const std::string& path, const std::string& content, bool sync = false);
 
 // Path utilities
 std::string getHomeDir();
 std::string joinPath(const std::string& p1, const std::string& p2);
 std::string getBasename(const std::string& path);
 std::string getDirname(const std::string& path);
+std::string normalizePath(const std::string& path);  // Absolute, with "." and ".." resolved lexically
+bool pathsOverlap(const std::string& a, const std::string& b);  // Same path or one contains the other
 
 // System utilities
 std::string getUsername();
@@ -61,6 +69,15 @@ namespace terminal {
     void printSuccess(const std::string& text);
     void printWarning(const std::string& text);
     void printInfo(const std::string& text);
+
+    // Output redirection for code running on worker threads. While a thread
+    // has an output stream set, out() and the print helpers write there
+    // instead of the terminal, so concurrent tools don't interleave.
+    void setThreadOutput(std::ostream* stream);
+    std::ostream& out();
+
+    // Held while writing a block of output or prompting the user
+    std::recursive_mutex& consoleMutex();
 }
 
 } // namespace utils
@@ -22,6 +22,10 @@ Agent AgentRegistry::getExplorerAgent() {
 **Read** - Read file contents
   - file_path: Path to file
 
+**ReadMany** - Read several files at once (use this instead of one Read per file)
+  - paths: Files separated by spaces; "file:10-40" reads only those lines
+  - pattern: Glob selecting the files instead (optional)
+
 **Glob** - Find files by pattern
   - pattern: File pattern (e.g., "**/*.py")
   - path: Directory to search (optional)
@@ -47,7 +51,7 @@ Agent AgentRegistry::getExplorerAgent() {
 
 IMPORTANT: You CANNOT modify files or run commands. Only explore and report.
 )";
-    agent.allowedTools = {"Read", "Glob", "Grep"};
+    agent.allowedTools = {"Read", "ReadMany", "Glob", "Grep"};
     agent.temperatureOverride = 0.3f;
     return agent;
 }
@@ -71,14 +75,21 @@ Agent AgentRegistry::getCoderAgent() {
 **Read** - Read file contents (ALWAYS read before editing!)
   - file_path: Path to file
 
+**ReadMany** - Read several related files in one call
+  - paths: Files separated by spaces; "file:10-40" reads only those lines
+
 **Write** - Create new files
   - file_path: Path to file
   - content: Complete file content
 
 **Edit** - Modify existing files
   - file_path: Path to file
-  - old_string: Exact text to replace
+  - old_string: Exact text to replace (must be unique in the file)
   - new_string: Replacement text
+  - replace_all: "true" to replace every occurrence (optional)
+
+**ApplyPatch** - Change several files at once with a unified diff (prefer this for multi-file edits)
+  - patch: The diff, with ---/+++ headers per file and @@ hunks
 
 **Glob** - Find files by pattern
   - pattern: File pattern (e.g., "**/*.cpp")
@@ -99,7 +110,7 @@ Agent AgentRegistry::getCoderAgent() {
 
 IMPORTANT: You CANNOT run shell commands. Focus on code changes only.
 )";
-    agent.allowedTools = {"Read", "Write", "Edit", "Glob"};
+    agent.allowedTools = {"Read", "ReadMany", "Write", "Edit", "ApplyPatch", "Glob"};
     agent.temperatureOverride = 0.2f;
     return agent;
 }
@@ -123,9 +134,15 @@ Agent AgentRegistry::getRunnerAgent() {
 **Bash** - Execute shell commands
   - command: The shell command to run
   - description: Brief description of what it does
+  - run_in_background: "true" for long builds and test suites; returns a job id at once
+
+**JobStatus** / **JobOutput** / **JobKill** - Check on, read or stop a background job
+  - id: Job id (JobOutput also takes tail: last N lines)
 
 **Read** - Read files (for checking logs, output files)
   - file_path: Path to file
+  - offset: First line, or negative for the last N lines of a log (optional)
+  - limit: Number of lines (optional)
 
 ## Tool Usage Format
 
@@ -144,7 +161,7 @@ Agent AgentRegistry::getRunnerAgent() {
 
 IMPORTANT: Focus on execution and reporting. For code changes, use the coder agent.
 )";
-    agent.allowedTools = {"Bash", "Read"};
+    agent.allowedTools = {"Bash", "JobStatus", "JobOutput", "JobKill", "Read"};
     agent.temperatureOverride = 0.1f;
     return agent;
 }
@@ -384,29 +401,35 @@ Agent AgentRegistry::getNetworkAgent() {
 
 ## Available Tools
 
-**Ping** - Test host reachability
-  - host: Hostname or IP address
+**Ping** - Test host reachability (all hosts are pinged at once)
+  - host: Hostnames or IPs, comma separated; CIDR ("10.0.0.0/24") and ranges ("10.0.0.5-20") work
   - count: Number of pings (default: 4, max: 20)
+  - timeout: Seconds to wait for replies (default: 2)
 
 **Traceroute** - Trace network path to host
   - host: Hostname or IP address
   - max_hops: Maximum hops (default: 30)
 
-**Nmap** - Port scanning (requires nmap installed)
-  - target: Host or IP to scan
-  - ports: Port range (e.g., "22,80,443" or "1-1000")
-  - scan_type: "tcp", "syn", "udp", "ping", "version", "os"
+**Nmap** - Port scanning
+  - target: Hosts, CIDR or ranges as for Ping
+  - ports: Port range (e.g., "22,80,443" or "1-1000"; default: common service ports)
+  - scan_type: "tcp" (default) or "ping" run built in; "syn", "udp", "version", "os" need nmap installed
+  - concurrency: Connections in flight for tcp scans (default: 256)
+  - timeout: Seconds before a port counts as filtered (default: 1)
+  - show_closed: true to list closed and filtered ports too
 
-**Dig** - DNS lookup
-  - domain: Domain name to query
-  - type: Record type (A, AAAA, MX, NS, TXT, CNAME, etc.)
+**Dig** - DNS lookup (queries run in parallel)
+  - domain: Domain names to query, comma separated; an IP address does a reverse (PTR) lookup
+  - type: Record types (A, AAAA, MX, NS, TXT, CNAME, SOA, SRV, CAA, etc.), comma separated
+  - server: Nameserver to ask, e.g. "1.1.1.1" or "127.0.0.1:5353" (default: system resolvers)
 
 **Whois** - Domain registration info
   - domain: Domain name to lookup
 
-**Netstat** - Network statistics
-  - flags: Command flags (default: "-an")
-  - filter: Filter output (e.g., "LISTEN", "ESTABLISHED")
+**Netstat** - Sockets or routes, read directly from the kernel
+  - flags: netstat-style letters (default: "-an"): t = TCP, u = UDP, l = listening only,
+    p = owning process, r = routing table instead of sockets
+  - filter: Keep only matching lines (e.g., "LISTEN", "ESTABLISHED", ":443")
 
 **Curl** - HTTP requests
   - url: URL to request
@@ -434,8 +457,8 @@ Agent AgentRegistry::getNetworkAgent() {
 **Ifconfig** - Show network interfaces
   - interface: Specific interface (optional)
 
-**ARP** - Show ARP table
-  - flags: Command flags (default: "-a")
+**ARP** - Show ARP table (address, MAC, interface, state)
+  - flags: Command flags (default: "-a"; others such as -d run the arp command)
 
 ## Tool Usage Format
 
@@ -0,0 +1,2212 @@
+#include "archive.h"
+#include "file_walker.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace casper {
+
+static const size_t IO_BUFFER_SIZE = 1 << 20;
+static const size_t TAR_BLOCK_SIZE = 512;
+static const size_t TAR_RECORD_SIZE = 10240;
+static const uint64_t TAR_MAX_META_SIZE = 1 << 20;         // Long names and pax headers
+#ifdef HAVE_ZLIB
+static const size_t DEFLATE_BLOCK_SIZE = 128 * 1024;
+static const size_t DEFLATE_DICT_SIZE = 32 * 1024;
+static const size_t DEFLATE_BLOCKS_PER_THREAD = 4;
+static const uint64_t ZIP_SMALL_ENTRY = 4 << 20;            // Read and compressed whole by one worker
+static const uint64_t ZIP_WINDOW_BYTES = 32 << 20;          // Small entries held in memory at once
+static const size_t ZIP_WINDOW_ENTRIES = 1024;
+static const size_t ZIP_ENTRIES_PER_TASK = 16;
+static const uint64_t ZIP64_LOCAL_THRESHOLD = 0xFF000000;   // Leaves room for deflate overhead
+static const uint32_t ZIP_MAX32 = 0xFFFFFFFF;
+static const uint64_t ZIP_MAX_LINK_SIZE = 64 * 1024;
+#endif
+
+namespace {
+
+std::string errnoText(const std::string& what) {
+    return what + ": " + (errno ? strerror(errno) : "unexpected end of file");
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Up to size bytes, short only at end of file; -1 on error
+ssize_t readFull(int fd, char* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+#ifdef HAVE_ZLIB
+
+// errno is 0 when the file ends first
+bool preadFull(int fd, char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pread(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) {
+            errno = 0;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// Zip and gzip fields are little-endian
+void put16(std::string& out, uint32_t value) {
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+}
+
+void put32(std::string& out, uint32_t value) {
+    put16(out, value & 0xFFFF);
+    put16(out, value >> 16);
+}
+
+void put64(std::string& out, uint64_t value) {
+    put32(out, static_cast<uint32_t>(value));
+    put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+uint32_t get16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t get32(const unsigned char* p) {
+    return get16(p) | (static_cast<uint32_t>(get16(p + 2)) << 16);
+}
+
+uint64_t get64(const unsigned char* p) {
+    return get32(p) | (static_cast<uint64_t>(get32(p + 4)) << 32);
+}
+
+#endif // HAVE_ZLIB
+
+mode_t currentUmask() {
+    mode_t mask = umask(022);
+    umask(mask);
+    return mask;
+}
+
+bool isRoot() {
+    return geteuid() == 0;
+}
+
+// Path inside an archive: relative, without "." components or a way above the root
+std::string memberName(const std::string& path) {
+    std::vector<std::string> parts;
+    for (const auto& part : utils::split(path, '/')) {
+        if (part.empty() || part == ".") continue;
+        if (part == "..") {
+            if (!parts.empty()) parts.pop_back();
+            continue;
+        }
+        parts.push_back(part);
+    }
+    std::string name;
+    for (const auto& part : parts) {
+        if (!name.empty()) name += '/';
+        name += part;
+    }
+    return name;
+}
+
+// A member name made relative to the extraction directory; false when it
+// would climb out of it
+bool safeMember(const std::string& name, std::string& relative) {
+    relative.clear();
+    for (const auto& part : utils::split(name, '/')) {
+        if (part.empty() || part == ".") continue;
+        if (part == "..") return false;
+        if (!relative.empty()) relative += '/';
+        relative += part;
+    }
+    return true;
+}
+
+// mkdir -p, remembering what exists so a tree of files costs one check per directory
+bool makeDirs(const std::string& dir, std::set<std::string>& made, std::string& error) {
+    if (dir.empty() || made.count(dir)) return true;
+    std::string parent = utils::getDirname(dir);
+    if (parent != dir && !makeDirs(parent, made, error)) return false;
+    if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+        error = errnoText(dir + ": cannot create directory");
+        return false;
+    }
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        error = dir + ": exists and is not a directory";
+        return false;
+    }
+    made.insert(dir);
+    return true;
+}
+
+// Make way for a new file or link, the way tar and unzip -o replace what is there
+bool clearTarget(const std::string& target, std::string& error) {
+    struct stat st;
+    if (lstat(target.c_str(), &st) != 0) return true;
+    if (S_ISDIR(st.st_mode)) {
+        error = target + ": a directory is in the way";
+        return false;
+    }
+    if (unlink(target.c_str()) != 0) {
+        error = errnoText(target + ": cannot replace");
+        return false;
+    }
+    return true;
+}
+
+void setTimes(int fd, const std::string& path, int64_t mtime) {
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = static_cast<time_t>(mtime);
+    times[1].tv_nsec = 0;
+    if (fd >= 0) {
+        futimens(fd, times);
+    } else {
+        utimensat(AT_FDCWD, path.c_str(), times, AT_SYMLINK_NOFOLLOW);
+    }
+}
+
+struct DirMeta {
+    std::string path;
+    uint32_t mode;
+    int64_t mtime;
+};
+
+// Directories are created writable and get their real mode and time once
+// their contents are in place, deepest first
+void finishDirectories(const std::vector<DirMeta>& dirs) {
+    mode_t mask = isRoot() ? 0 : currentUmask();
+    for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+        chmod(it->path.c_str(), (it->mode & (isRoot() ? 07777 : 0777)) & ~mask);
+        setTimes(-1, it->path, it->mtime);
+    }
+}
+
+struct SourceEntry {
+    std::string path;
+    std::string name;
+    struct stat st;
+};
+
+// Each input and, for directories, everything below it; sorted by name so
+// directories come before their contents. The archive itself is left out.
+std::vector<SourceEntry> collectInputs(const std::vector<std::string>& inputs, bool recursive, size_t threads,
+                                       const struct stat& archive, ArchiveReport& report) {
+    std::vector<SourceEntry> entries;
+    std::mutex mutex;
+    for (const auto& input : inputs) {
+        std::string path = input;
+        while (path.size() > 1 && path.back() == '/') path.pop_back();
+
+        std::vector<SourceEntry> found;
+        SourceEntry root;
+        if (lstat(path.c_str(), &root.st) != 0) {
+            report.errors.push_back(errnoText(input + ": cannot stat"));
+            continue;
+        }
+        root.path = path;
+        root.name = memberName(path);
+        if (!root.name.empty()) found.push_back(root);
+
+        if (S_ISDIR(root.st.st_mode) && recursive) {
+            WalkOptions walk;
+            walk.respect_gitignore = false;
+            walk.include_hidden = true;
+            walk.prune_vcs = false;     // An archived repository stays a repository
+            walk.include_dirs = true;
+            walk.include_special = true;
+            walk.threads = threads;
+
+            size_t skip = path == "/" ? 1 : path.size() + 1;
+            FileWalker walker(walk);
+            walker.walk(path, [&](const WalkEntry& walked) {
+                SourceEntry entry;
+                bool ok = lstat(walked.path.c_str(), &entry.st) == 0;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok) {
+                    report.errors.push_back(errnoText(walked.path + ": cannot stat"));
+                    return true;
+                }
+                std::string relative = walked.path.substr(skip);
+                entry.path = walked.path;
+                entry.name = root.name.empty() ? relative : root.name + "/" + relative;
+                found.push_back(std::move(entry));
+                return true;
+            });
+        }
+
+        std::sort(found.begin(), found.end(), [](const SourceEntry& a, const SourceEntry& b) {
+            return a.name < b.name;
+        });
+        for (auto& entry : found) {
+            if (entry.st.st_dev == archive.st_dev && entry.st.st_ino == archive.st_ino) continue;
+            entries.push_back(std::move(entry));
+        }
+    }
+    return entries;
+}
+
+ArchiveEntry describe(const std::string& path, char type, const struct stat& st, uint64_t size,
+                      const std::string& link = "") {
+    ArchiveEntry entry;
+    entry.path = path;
+    entry.type = type;
+    entry.link = link;
+    entry.size = size;
+    entry.mode = st.st_mode & 07777;
+    entry.mtime = st.st_mtime;
+    return entry;
+}
+
+// ---------------------------------------------------------------------------
+// Byte streams
+// ---------------------------------------------------------------------------
+
+class Sink {
+public:
+    virtual ~Sink() = default;
+    virtual bool write(const char* data, size_t size) = 0;
+
+    bool put(const std::string& data) { return write(data.data(), data.size()); }
+};
+
+// Buffered writes to a file, counting the bytes written
+class FileSink : public Sink {
+public:
+    explicit FileSink(int fd) : fd_(fd) { buffer_.reserve(IO_BUFFER_SIZE); }
+
+    bool write(const char* data, size_t size) override {
+        if (failed_) return false;
+        offset_ += size;
+        if (buffer_.size() + size > IO_BUFFER_SIZE) {
+            if (!flush()) return false;
+            if (size >= IO_BUFFER_SIZE) return check(writeAll(fd_, data, size));
+        }
+        buffer_.append(data, size);
+        return true;
+    }
+
+    bool flush() {
+        if (failed_) return false;
+        bool ok = writeAll(fd_, buffer_.data(), buffer_.size());
+        buffer_.clear();
+        return check(ok);
+    }
+
+    // Overwrite bytes already written, such as sizes in a zip local header
+    bool patch(uint64_t offset, const std::string& data) {
+        if (!flush()) return false;
+        bool ok = pwrite(fd_, data.data(), data.size(), static_cast<off_t>(offset)) ==
+                  static_cast<ssize_t>(data.size());
+        return check(ok);
+    }
+
+    // Drop everything from offset on
+    bool rewind(uint64_t offset) {
+        if (!flush()) return false;
+        bool ok = ftruncate(fd_, static_cast<off_t>(offset)) == 0 &&
+                  lseek(fd_, static_cast<off_t>(offset), SEEK_SET) >= 0;
+        offset_ = offset;
+        return check(ok);
+    }
+
+    uint64_t offset() const { return offset_; }
+    const std::string& error() const { return error_; }
+
+private:
+    bool check(bool ok) {
+        if (!ok && !failed_) {
+            failed_ = true;
+            error_ = errnoText("cannot write archive");
+        }
+        return ok;
+    }
+
+    int fd_;
+    std::string buffer_;
+    uint64_t offset_ = 0;
+    bool failed_ = false;
+    std::string error_;
+};
+
+class Source {
+public:
+    virtual ~Source() = default;
+
+    // Up to size bytes; 0 at the end, -1 on error
+    virtual ssize_t read(char* data, size_t size) = 0;
+
+    virtual bool skip(uint64_t size) {
+        char buffer[64 * 1024];
+        while (size > 0) {
+            ssize_t n = read(buffer, static_cast<size_t>(std::min<uint64_t>(size, sizeof(buffer))));
+            if (n <= 0) {
+                if (n == 0) error_ = "unexpected end of archive";
+                return false;
+            }
+            size -= static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+
+protected:
+    std::string error_;
+};
+
+// Exactly size bytes unless the data ends first; -1 on error
+ssize_t readExact(Source& in, char* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = in.read(data + done, size - done);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+class FileSource : public Source {
+public:
+    FileSource(int fd, uint64_t size) : fd_(fd), size_(size) {}
+
+    ssize_t read(char* data, size_t size) override {
+        for (;;) {
+            ssize_t n = ::read(fd_, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) error_ = errnoText("cannot read archive");
+            return n;
+        }
+    }
+
+    // Seek past data nobody needs, so listing a plain tar reads only the headers
+    bool skip(uint64_t size) override {
+        off_t pos = lseek(fd_, static_cast<off_t>(size), SEEK_CUR);
+        if (pos < 0) return Source::skip(size);
+        if (static_cast<uint64_t>(pos) > size_) {
+            error_ = "unexpected end of archive";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int fd_;
+    uint64_t size_;
+};
+
+#ifdef HAVE_ZLIB
+
+// Raw deflate of a stream in blocks compressed independently on a pool. Each
+// block is primed with the tail of the one before and ends on a byte boundary
+// (sync flush), so the pieces concatenate into a single valid stream.
+class ParallelDeflate {
+public:
+    ParallelDeflate(Sink& out, int level, ThreadPool* pool)
+        : out_(out), level_(level), pool_(pool),
+          batch_(pool ? pool->size() * DEFLATE_BLOCKS_PER_THREAD : 1),
+          crc_(crc32(0, Z_NULL, 0)) {
+        blocks_.reserve(batch_);
+    }
+
+    bool write(const char* data, size_t size) {
+        while (size > 0) {
+            if (blocks_.empty() || blocks_.back().input.size() == DEFLATE_BLOCK_SIZE) {
+                if (blocks_.size() == batch_ && !flushBatch()) return false;
+                blocks_.emplace_back();
+                blocks_.back().input.reserve(DEFLATE_BLOCK_SIZE);
+            }
+            std::string& input = blocks_.back().input;
+            size_t n = std::min(size, DEFLATE_BLOCK_SIZE - input.size());
+            input.append(data, n);
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool finish() {
+        if (!flushBatch()) return false;
+        static const char final_block[] = {0x03, 0x00};     // Empty fixed-Huffman block, BFINAL set
+        return out_.write(final_block, sizeof(final_block));
+    }
+
+    uint32_t crc() const { return crc_; }
+    uint64_t size() const { return size_; }
+
+private:
+    struct Block {
+        std::string input;
+        std::string output;
+        uint32_t crc = 0;
+        bool ok = false;
+    };
+
+    static void compress(Block& block, const std::string& previous, int level) {
+        block.crc = crc32(0, reinterpret_cast<const Bytef*>(block.input.data()),
+                          static_cast<uInt>(block.input.size()));
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return;
+        if (!previous.empty()) {
+            size_t n = std::min(previous.size(), DEFLATE_DICT_SIZE);
+            deflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(previous.data() + previous.size() - n),
+                                 static_cast<uInt>(n));
+        }
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.input.data()));
+        zs.avail_in = static_cast<uInt>(block.input.size());
+        block.output.resize(deflateBound(&zs, zs.avail_in) + 64);
+
+        size_t done = 0;
+        for (;;) {
+            zs.next_out = reinterpret_cast<Bytef*>(&block.output[done]);
+            zs.avail_out = static_cast<uInt>(block.output.size() - done);
+            int rc = deflate(&zs, Z_SYNC_FLUSH);
+            done = block.output.size() - zs.avail_out;
+            if (rc != Z_OK && rc != Z_BUF_ERROR) break;
+            if (zs.avail_out != 0) {
+                block.ok = true;
+                break;
+            }
+            block.output.resize(block.output.size() * 2);
+        }
+        deflateEnd(&zs);
+        block.output.resize(done);
+    }
+
+    bool flushBatch() {
+        if (blocks_.empty()) return true;
+        if (blocks_.size() == 1 || !pool_) {
+            for (size_t i = 0; i < blocks_.size(); i++) {
+                compress(blocks_[i], i == 0 ? dictionary_ : blocks_[i - 1].input, level_);
+            }
+        } else {
+            for (size_t i = 0; i < blocks_.size(); i++) {
+                pool_->submit([this, i]() {
+                    compress(blocks_[i], i == 0 ? dictionary_ : blocks_[i - 1].input, level_);
+                });
+            }
+            pool_->wait();
+        }
+
+        for (const Block& block : blocks_) {
+            if (!block.ok) return false;
+            if (!out_.write(block.output.data(), block.output.size())) return false;
+            crc_ = crc32_combine(crc_, block.crc, static_cast<z_off_t>(block.input.size()));
+            size_ += block.input.size();
+        }
+        const std::string& last = blocks_.back().input;
+        dictionary_.assign(last, last.size() - std::min(last.size(), DEFLATE_DICT_SIZE), std::string::npos);
+        blocks_.clear();
+        return true;
+    }
+
+    Sink& out_;
+    int level_;
+    ThreadPool* pool_;
+    size_t batch_;
+    std::vector<Block> blocks_;
+    std::string dictionary_;
+    uint32_t crc_;
+    uint64_t size_ = 0;
+};
+
+// One gzip member around a ParallelDeflate
+class GzipSink : public Sink {
+public:
+    GzipSink(Sink& out, int level, ThreadPool* pool) : out_(out), level_(level), deflate_(out, level, pool) {}
+
+    bool start(const std::string& name, int64_t mtime) {
+        std::string header = {'\x1f', '\x8b', 8, static_cast<char>(name.empty() ? 0 : 8)};
+        put32(header, mtime > 0 && mtime <= 0xFFFFFFFFLL ? static_cast<uint32_t>(mtime) : 0);
+        header += static_cast<char>(level_ == 9 ? 2 : level_ == 1 ? 4 : 0);
+        header += '\x03';                                   // Unix
+        if (!name.empty()) {
+            header += name;
+            header += '\0';
+        }
+        return out_.put(header);
+    }
+
+    bool write(const char* data, size_t size) override { return deflate_.write(data, size); }
+
+    bool finish() {
+        if (!deflate_.finish()) return false;
+        std::string trailer;
+        put32(trailer, deflate_.crc());
+        put32(trailer, static_cast<uint32_t>(deflate_.size()));
+        return out_.put(trailer);
+    }
+
+private:
+    Sink& out_;
+    int level_;
+    ParallelDeflate deflate_;
+};
+
+// Inflates gzip data; concatenated members read as one stream, like gunzip
+class GzipSource : public Source {
+public:
+    explicit GzipSource(Source& in) : in_(in), buffer_(IO_BUFFER_SIZE) {
+        memset(&zs_, 0, sizeof(zs_));
+        ready_ = inflateInit2(&zs_, 16 + MAX_WBITS) == Z_OK;
+    }
+
+    ~GzipSource() override {
+        if (ready_) inflateEnd(&zs_);
+    }
+
+    ssize_t read(char* data, size_t size) override {
+        if (!ready_) {
+            error_ = "cannot initialise inflate";
+            return -1;
+        }
+        zs_.next_out = reinterpret_cast<Bytef*>(data);
+        zs_.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT_MAX));
+        size_t produced = 0;
+        while (zs_.avail_out > 0 && !done_) {
+            if (zs_.avail_in == 0) {
+                ssize_t n = in_.read(buffer_.data(), buffer_.size());
+                if (n < 0) {
+                    error_ = in_.error();
+                    return -1;
+                }
+                if (n == 0) {
+                    if (produced > 0) break;
+                    error_ = "unexpected end of gzip data";
+                    return -1;
+                }
+                zs_.next_in = reinterpret_cast<Bytef*>(buffer_.data());
+                zs_.avail_in = static_cast<uInt>(n);
+            }
+            uInt before = zs_.avail_out;
+            int rc = inflate(&zs_, Z_NO_FLUSH);
+            produced += before - zs_.avail_out;
+            if (rc == Z_STREAM_END) {
+                if (nextMember()) {
+                    inflateReset(&zs_);
+                } else {
+                    done_ = true;
+                }
+            } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                error_ = std::string("corrupt gzip data") + (zs_.msg ? std::string(": ") + zs_.msg : "");
+                return -1;
+            }
+        }
+        return static_cast<ssize_t>(produced);
+    }
+
+private:
+    // Another member follows; anything else after the first is ignored
+    bool nextMember() {
+        while (zs_.avail_in < 2) {
+            if (zs_.avail_in == 1) buffer_[0] = static_cast<char>(*zs_.next_in);
+            ssize_t n = in_.read(buffer_.data() + zs_.avail_in, buffer_.size() - zs_.avail_in);
+            if (n <= 0) return false;
+            zs_.next_in = reinterpret_cast<Bytef*>(buffer_.data());
+            zs_.avail_in += static_cast<uInt>(n);
+        }
+        return zs_.next_in[0] == 0x1f && zs_.next_in[1] == 0x8b;
+    }
+
+    Source& in_;
+    std::vector<char> buffer_;
+    z_stream zs_;
+    bool ready_ = false;
+    bool done_ = false;
+};
+
+#endif // HAVE_ZLIB
+
+// ---------------------------------------------------------------------------
+// Tar
+// ---------------------------------------------------------------------------
+
+// width - 1 octal digits and a NUL, or GNU base-256 when the value is too big
+void putNumber(char* field, size_t width, uint64_t value) {
+    if (value >> (3 * (width - 1))) {
+        memset(field, 0, width);
+        for (size_t i = width - 1; i > 0 && value; i--) {
+            field[i] = static_cast<char>(value & 0xFF);
+            value >>= 8;
+        }
+        field[0] = static_cast<char>(0x80);
+        return;
+    }
+    snprintf(field, width, "%0*llo", static_cast<int>(width - 1), static_cast<unsigned long long>(value));
+}
+
+uint64_t parseNumber(const char* field, size_t width) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(field);
+    uint64_t value = 0;
+    if (p[0] & 0x80) {
+        value = p[0] & 0x7F;
+        for (size_t i = 1; i < width; i++) value = (value << 8) | p[i];
+        return value;
+    }
+    size_t i = 0;
+    while (i < width && p[i] == ' ') i++;
+    for (; i < width && p[i] >= '0' && p[i] <= '7'; i++) value = value * 8 + (p[i] - '0');
+    return value;
+}
+
+// NUL-terminated field, or the full width when it is not
+std::string fieldText(const char* field, size_t width) {
+    return std::string(field, strnlen(field, width));
+}
+
+void setChecksum(char* block) {
+    memset(block + 148, ' ', 8);
+    unsigned sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) sum += static_cast<unsigned char>(block[i]);
+    snprintf(block + 148, 8, "%06o", sum);
+    block[155] = ' ';
+}
+
+// Old tars summed signed chars, so both are accepted
+bool checksumOk(const char* block) {
+    uint64_t stored = parseNumber(block + 148, 8);
+    unsigned sum = 0;
+    int signed_sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+        char c = (i >= 148 && i < 156) ? ' ' : block[i];
+        sum += static_cast<unsigned char>(c);
+        signed_sum += static_cast<signed char>(c);
+    }
+    return stored == sum || static_cast<int64_t>(stored) == signed_sum;
+}
+
+// ustar splits long paths into a 155 byte prefix and a 100 byte name at a slash
+bool splitName(const std::string& name, std::string& prefix, std::string& base) {
+    if (name.size() <= 100) {
+        prefix.clear();
+        base = name;
+        return true;
+    }
+    size_t slash = name.find('/', name.size() - 101);
+    if (slash == std::string::npos || slash == 0 || slash > 155 || slash == name.size() - 1) return false;
+    prefix = name.substr(0, slash);
+    base = name.substr(slash + 1);
+    return true;
+}
+
+// Writes ustar headers, with GNU long-name records for paths that do not fit
+class TarWriter {
+public:
+    TarWriter(Sink& out, ArchiveReport& report) : out_(out), report_(report), buffer_(IO_BUFFER_SIZE) {}
+
+    // false only when the archive itself can no longer be written
+    bool add(const std::string& path, const std::string& name, const struct stat& st) {
+        if (S_ISDIR(st.st_mode)) {
+            report_.entries.push_back(describe(name + "/", 'd', st, 0));
+            return header(name + "/", "", '5', st, 0);
+        }
+        if (S_ISLNK(st.st_mode)) {
+            char target[PATH_MAX];
+            ssize_t n = readlink(path.c_str(), target, sizeof(target));
+            if (n < 0) {
+                report_.errors.push_back(errnoText(path + ": cannot read link"));
+                return true;
+            }
+            std::string link(target, static_cast<size_t>(n));
+            report_.entries.push_back(describe(name, 'l', st, 0, link));
+            return header(name, link, '2', st, 0);
+        }
+        if (S_ISFIFO(st.st_mode)) {
+            report_.entries.push_back(describe(name, 'p', st, 0));
+            return header(name, "", '6', st, 0);
+        }
+        if (!S_ISREG(st.st_mode)) {
+            report_.errors.push_back(path + ": special file skipped");
+            return true;
+        }
+
+        std::pair<dev_t, ino_t> key(st.st_dev, st.st_ino);
+        if (st.st_nlink > 1) {
+            auto it = hard_links_.find(key);
+            if (it != hard_links_.end()) {
+                report_.entries.push_back(describe(name, 'h', st, 0, it->second));
+                return header(name, it->second, '1', st, 0);
+            }
+        }
+
+        int fd = open(path.c_str(), O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            report_.errors.push_back(errnoText(path + ": cannot open"));
+            return true;
+        }
+        uint64_t size = static_cast<uint64_t>(st.st_size);
+        if (!header(name, "", '0', st, size)) {
+            close(fd);
+            return false;
+        }
+        if (st.st_nlink > 1) hard_links_[key] = name;
+        report_.entries.push_back(describe(name, 'f', st, size));
+
+        // The header promised size bytes; a file that shrinks is padded with zeros
+        uint64_t remaining = size;
+        bool ok = true;
+        while (remaining > 0 && ok) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(remaining, buffer_.size()));
+            ssize_t n = readFull(fd, buffer_.data(), want);
+            if (n <= 0) {
+                report_.errors.push_back(n < 0 ? errnoText(path + ": read failed")
+                                               : path + ": file shrank while being archived");
+                std::fill(buffer_.begin(), buffer_.end(), 0);
+                while (remaining > 0 && ok) {
+                    size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, buffer_.size()));
+                    ok = emit(buffer_.data(), chunk);
+                    remaining -= chunk;
+                }
+                break;
+            }
+            ok = emit(buffer_.data(), static_cast<size_t>(n));
+            remaining -= static_cast<uint64_t>(n);
+            report_.bytes_in += static_cast<uint64_t>(n);
+        }
+        close(fd);
+        return ok && pad(size);
+    }
+
+    // End-of-archive blocks, padded to a full record like tar
+    bool finish() {
+        static const char zeros[TAR_BLOCK_SIZE * 2] = {};
+        if (!emit(zeros, sizeof(zeros))) return false;
+        std::string fill(static_cast<size_t>((TAR_RECORD_SIZE - written_ % TAR_RECORD_SIZE) % TAR_RECORD_SIZE), '\0');
+        return emit(fill.data(), fill.size());
+    }
+
+private:
+    bool emit(const char* data, size_t size) {
+        written_ += size;
+        return out_.write(data, size);
+    }
+
+    bool pad(uint64_t size) {
+        static const char zeros[TAR_BLOCK_SIZE] = {};
+        size_t rest = static_cast<size_t>(size % TAR_BLOCK_SIZE);
+        return rest == 0 || emit(zeros, TAR_BLOCK_SIZE - rest);
+    }
+
+    bool longRecord(char type, const std::string& value) {
+        struct stat st;
+        memset(&st, 0, sizeof(st));
+        std::string data = value + '\0';
+        return header("././@LongLink", "", type, st, data.size()) && emit(data.data(), data.size()) &&
+               pad(data.size());
+    }
+
+    bool header(const std::string& name, const std::string& link, char type, const struct stat& st,
+                uint64_t size) {
+        if (link.size() > 100 && !longRecord('K', link)) return false;
+        std::string prefix, base;
+        if (!splitName(name, prefix, base)) {
+            if (!longRecord('L', name)) return false;
+            prefix.clear();
+            base = name.substr(0, 100);
+        }
+
+        char block[TAR_BLOCK_SIZE];
+        memset(block, 0, sizeof(block));
+        memcpy(block, base.data(), std::min<size_t>(base.size(), 100));
+        putNumber(block + 100, 8, st.st_mode & 07777);
+        putNumber(block + 108, 8, st.st_uid);
+        putNumber(block + 116, 8, st.st_gid);
+        putNumber(block + 124, 12, size);
+        putNumber(block + 136, 12, st.st_mtime > 0 ? static_cast<uint64_t>(st.st_mtime) : 0);
+        block[156] = type;
+        memcpy(block + 157, link.data(), std::min<size_t>(link.size(), 100));
+        memcpy(block + 257, "ustar", 6);
+        memcpy(block + 263, "00", 2);
+        if (type != 'L' && type != 'K') {
+            std::string user = userName(st.st_uid);
+            std::string group = groupName(st.st_gid);
+            memcpy(block + 265, user.data(), std::min<size_t>(user.size(), 31));
+            memcpy(block + 297, group.data(), std::min<size_t>(group.size(), 31));
+        }
+        memcpy(block + 345, prefix.data(), std::min<size_t>(prefix.size(), 155));
+        setChecksum(block);
+        return emit(block, sizeof(block));
+    }
+
+    std::string userName(uid_t uid) {
+        auto it = users_.find(uid);
+        if (it != users_.end()) return it->second;
+        struct passwd* pw = getpwuid(uid);
+        return users_[uid] = pw ? pw->pw_name : "";
+    }
+
+    std::string groupName(gid_t gid) {
+        auto it = groups_.find(gid);
+        if (it != groups_.end()) return it->second;
+        struct group* gr = getgrgid(gid);
+        return groups_[gid] = gr ? gr->gr_name : "";
+    }
+
+    Sink& out_;
+    ArchiveReport& report_;
+    std::vector<char> buffer_;
+    uint64_t written_ = 0;
+    std::map<std::pair<dev_t, ino_t>, std::string> hard_links_;
+    std::map<uid_t, std::string> users_;
+    std::map<gid_t, std::string> groups_;
+};
+
+// "len key=value\n" records; only the keys tar members need
+void parsePax(const std::string& data, std::map<std::string, std::string>& values) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t space = data.find(' ', pos);
+        if (space == std::string::npos) return;
+        size_t length = strtoull(data.c_str() + pos, nullptr, 10);
+        if (length == 0 || pos + length > data.size()) return;
+        std::string record = data.substr(space + 1, pos + length - space - 2);
+        size_t equals = record.find('=');
+        if (equals != std::string::npos) values[record.substr(0, equals)] = record.substr(equals + 1);
+        pos += length;
+    }
+}
+
+// Lists, or extracts into dest when it is given
+bool readTar(const std::string& archive, const std::string* dest, ArchiveReport& report, std::string& error) {
+    Archive::Format format = Archive::detect(archive);
+    if (format != Archive::Format::Tar && format != Archive::Format::Gzip) {
+        error = format == Archive::Format::Unknown && !utils::fileExists(archive)
+                    ? archive + ": no such file"
+                    : archive + ": not a tar archive this build can read";
+        return false;
+    }
+#ifndef HAVE_ZLIB
+    if (format == Archive::Format::Gzip) {
+        error = "gzip support was not built in (zlib missing)";
+        return false;
+    }
+#endif
+
+    int fd = open(archive.c_str(), O_RDONLY);
+    struct stat archive_st;
+    if (fd < 0 || fstat(fd, &archive_st) != 0) {
+        error = errnoText(archive + ": cannot open");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    report.bytes_in = static_cast<uint64_t>(archive_st.st_size);
+
+    FileSource file(fd, static_cast<uint64_t>(archive_st.st_size));
+    Source* in = &file;
+#ifdef HAVE_ZLIB
+    std::unique_ptr<GzipSource> gzip;
+    if (format == Archive::Format::Gzip) {
+        gzip.reset(new GzipSource(file));
+        in = gzip.get();
+    }
+#endif
+
+    bool root = isRoot();
+    std::set<std::string> made;
+    std::vector<DirMeta> dirs;
+    std::vector<std::pair<ArchiveEntry, std::string>> links;    // Made last, so no entry writes through one
+    std::vector<char> buffer(IO_BUFFER_SIZE);
+    std::string long_name, long_link;
+    std::map<std::string, std::string> pax;
+    bool ok = true;
+
+    if (dest && !makeDirs(*dest, made, error)) {
+        close(fd);
+        return false;
+    }
+
+    char block[TAR_BLOCK_SIZE];
+    for (;;) {
+        ssize_t got = readExact(*in, block, sizeof(block));
+        if (got < 0) {
+            error = in->error();
+            ok = false;
+            break;
+        }
+        if (got == 0) break;
+        if (static_cast<size_t>(got) < sizeof(block)) {
+            error = "truncated archive";
+            ok = false;
+            break;
+        }
+        if (std::all_of(block, block + sizeof(block), [](char c) { return c == 0; })) break;
+        if (!checksumOk(block)) {
+            error = "corrupt tar header (bad checksum)";
+            ok = false;
+            break;
+        }
+
+        char type = block[156];
+        uint64_t size = parseNumber(block + 124, 12);
+        uint64_t padded = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+        if (type == 'L' || type == 'K' || type == 'x' || type == 'g') {
+            if (size > TAR_MAX_META_SIZE) {
+                error = "tar metadata record too large";
+                ok = false;
+                break;
+            }
+            std::string data(static_cast<size_t>(padded), '\0');
+            if (readExact(*in, &data[0], data.size()) != static_cast<ssize_t>(data.size())) {
+                error = in->error().empty() ? "truncated archive" : in->error();
+                ok = false;
+                break;
+            }
+            data.resize(static_cast<size_t>(size));
+            if (type == 'L') long_name = fieldText(data.data(), data.size());
+            else if (type == 'K') long_link = fieldText(data.data(), data.size());
+            else if (type == 'x') parsePax(data, pax);
+            continue;
+        }
+
+        ArchiveEntry entry;
+        std::string prefix = memcmp(block + 257, "ustar", 5) == 0 ? fieldText(block + 345, 155) : "";
+        entry.path = fieldText(block, 100);
+        if (!prefix.empty()) entry.path = prefix + "/" + entry.path;
+        if (!long_name.empty()) entry.path = long_name;
+        entry.link = long_link.empty() ? fieldText(block + 157, 100) : long_link;
+        entry.mode = static_cast<uint32_t>(parseNumber(block + 100, 8) & 07777);
+        entry.mtime = static_cast<int64_t>(parseNumber(block + 136, 12));
+        if (pax.count("path")) entry.path = pax["path"];
+        if (pax.count("linkpath")) entry.link = pax["linkpath"];
+        if (pax.count("size")) size = strtoull(pax["size"].c_str(), nullptr, 10);
+        if (pax.count("mtime")) entry.mtime = strtoll(pax["mtime"].c_str(), nullptr, 10);
+        uid_t uid = static_cast<uid_t>(parseNumber(block + 108, 8));
+        gid_t gid = static_cast<gid_t>(parseNumber(block + 116, 8));
+        long_name.clear();
+        long_link.clear();
+        pax.clear();
+
+        switch (type) {
+            case '0': case '\0': case '7': entry.type = utils::endsWith(entry.path, "/") ? 'd' : 'f'; break;
+            case '5': entry.type = 'd'; break;
+            case '2': entry.type = 'l'; break;
+            case '1': entry.type = 'h'; break;
+            case '6': entry.type = 'p'; break;
+            default: entry.type = 'u'; break;
+        }
+        uint64_t data_size = (entry.type == 'f' || entry.type == 'u') ? size : 0;
+        padded = (data_size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+        entry.size = data_size;
+
+        if (!dest || entry.type == 'u') {
+            if (entry.type == 'u') {
+                report.errors.push_back(entry.path + ": unsupported entry type '" + std::string(1, type) + "' skipped");
+            } else {
+                report.entries.push_back(entry);
+            }
+            if (!in->skip(padded)) {
+                error = in->error();
+                ok = false;
+                break;
+            }
+            continue;
+        }
+
+        std::string relative, message;
+        if (!safeMember(entry.path, relative)) {
+            report.errors.push_back(entry.path + ": path leaves the destination, skipped");
+            if (!in->skip(padded)) {
+                error = in->error();
+                ok = false;
+                break;
+            }
+            continue;
+        }
+        std::string target = relative.empty() ? *dest : utils::joinPath(*dest, relative);
+
+        if (entry.type == 'd') {
+            if (makeDirs(target, made, message)) {
+                dirs.push_back({target, entry.mode, entry.mtime});
+                report.entries.push_back(entry);
+            } else {
+                report.errors.push_back(message);
+            }
+            continue;
+        }
+        if (entry.type == 'l' || entry.type == 'h') {
+            links.emplace_back(entry, target);
+            continue;
+        }
+
+        int out = -1;
+        bool placed = makeDirs(utils::getDirname(target), made, message) && clearTarget(target, message);
+        if (placed && entry.type == 'p') {
+            if (mkfifo(target.c_str(), entry.mode & 0777) != 0) message = errnoText(target + ": cannot create fifo");
+            else report.entries.push_back(entry);
+        } else if (placed) {
+            out = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, entry.mode & 0777);
+            if (out < 0) message = errnoText(target + ": cannot create");
+        }
+
+        // The data is always consumed, written out or not
+        uint64_t remaining = data_size;
+        while (remaining > 0) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+            ssize_t n = readExact(*in, buffer.data(), want);
+            if (n != static_cast<ssize_t>(want)) {
+                error = in->error().empty() ? "truncated archive" : in->error();
+                ok = false;
+                break;
+            }
+            if (out >= 0 && !writeAll(out, buffer.data(), want)) {
+                message = errnoText(target + ": write failed");
+                close(out);
+                out = -1;
+                unlink(target.c_str());
+            }
+            remaining -= want;
+        }
+        if (ok && !in->skip(padded - data_size)) {
+            error = in->error();
+            ok = false;
+        }
+        if (out >= 0) {
+            if (root) {
+                if (fchown(out, uid, gid) != 0) message = errnoText(target + ": cannot set owner");
+                fchmod(out, entry.mode & 07777);
+            }
+            setTimes(out, target, entry.mtime);
+            close(out);
+            report.entries.push_back(entry);
+            report.bytes_out += data_size;
+        }
+        if (!message.empty()) report.errors.push_back(message);
+        if (!ok) break;
+    }
+    close(fd);
+
+    for (const auto& link : links) {
+        const ArchiveEntry& entry = link.first;
+        const std::string& target = link.second;
+        std::string message;
+        if (!makeDirs(utils::getDirname(target), made, message) || !clearTarget(target, message)) {
+            report.errors.push_back(message);
+            continue;
+        }
+        if (entry.type == 'l') {
+            if (symlink(entry.link.c_str(), target.c_str()) != 0) {
+                report.errors.push_back(errnoText(target + ": cannot create symlink"));
+                continue;
+            }
+            setTimes(-1, target, entry.mtime);
+        } else {
+            std::string relative;
+            if (!safeMember(entry.link, relative) || relative.empty()) {
+                report.errors.push_back(target + ": hard link target leaves the destination, skipped");
+                continue;
+            }
+            if (::link(utils::joinPath(*dest, relative).c_str(), target.c_str()) != 0) {
+                report.errors.push_back(errnoText(target + ": cannot create hard link"));
+                continue;
+            }
+        }
+        report.entries.push_back(entry);
+    }
+    finishDirectories(dirs);
+    return ok;
+}
+
+#ifdef HAVE_ZLIB
+
+// ---------------------------------------------------------------------------
+// Zip
+// ---------------------------------------------------------------------------
+
+void dosTime(int64_t mtime, uint16_t& time, uint16_t& date) {
+    time_t t = static_cast<time_t>(mtime);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    if (tm.tm_year < 80) {
+        time = 0;
+        date = (1 << 5) | 1;
+        return;
+    }
+    time = static_cast<uint16_t>((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+    date = static_cast<uint16_t>(((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+}
+
+int64_t fromDosTime(uint32_t time, uint32_t date) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = static_cast<int>((date >> 9) + 80);
+    tm.tm_mon = static_cast<int>(((date >> 5) & 0xF) - 1);
+    tm.tm_mday = static_cast<int>(date & 0x1F);
+    tm.tm_hour = static_cast<int>(time >> 11);
+    tm.tm_min = static_cast<int>((time >> 5) & 0x3F);
+    tm.tm_sec = static_cast<int>((time & 0x1F) * 2);
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// One central directory record
+struct ZipRecord {
+    std::string name;
+    uint16_t method = 0;            // 0 = stored, 8 = deflated
+    uint16_t flags = 0;
+    uint32_t crc = 0;
+    uint64_t compressed = 0;
+    uint64_t size = 0;
+    uint64_t offset = 0;
+    uint32_t mode = 0;              // st_mode, file type included
+    int64_t mtime = 0;
+    bool zip64 = false;             // Local header carries zip64 sizes
+};
+
+void timestampExtra(std::string& extra, int64_t mtime) {
+    put16(extra, 0x5455);
+    put16(extra, 5);
+    extra += '\x01';
+    put32(extra, static_cast<uint32_t>(mtime));
+}
+
+std::string localHeader(const ZipRecord& record) {
+    uint16_t time, date;
+    dosTime(record.mtime, time, date);
+    std::string extra;
+    if (record.zip64) {
+        put16(extra, 0x0001);
+        put16(extra, 16);
+        put64(extra, record.size);
+        put64(extra, record.compressed);
+    }
+    timestampExtra(extra, record.mtime);
+
+    std::string header;
+    put32(header, 0x04034b50);
+    put16(header, record.zip64 ? 45 : 20);
+    put16(header, record.flags);
+    put16(header, record.method);
+    put16(header, time);
+    put16(header, date);
+    put32(header, record.crc);
+    put32(header, record.zip64 ? ZIP_MAX32 : static_cast<uint32_t>(record.compressed));
+    put32(header, record.zip64 ? ZIP_MAX32 : static_cast<uint32_t>(record.size));
+    put16(header, static_cast<uint32_t>(record.name.size()));
+    put16(header, static_cast<uint32_t>(extra.size()));
+    return header + record.name + extra;
+}
+
+std::string centralHeader(const ZipRecord& record) {
+    bool big_size = record.size >= ZIP_MAX32;
+    bool big_compressed = record.compressed >= ZIP_MAX32;
+    bool big_offset = record.offset >= ZIP_MAX32;
+    bool zip64 = record.zip64 || big_size || big_compressed || big_offset;
+    uint16_t time, date;
+    dosTime(record.mtime, time, date);
+
+    std::string extra;
+    if (big_size || big_compressed || big_offset) {
+        std::string values;
+        if (big_size) put64(values, record.size);
+        if (big_compressed) put64(values, record.compressed);
+        if (big_offset) put64(values, record.offset);
+        put16(extra, 0x0001);
+        put16(extra, static_cast<uint32_t>(values.size()));
+        extra += values;
+    }
+    timestampExtra(extra, record.mtime);
+
+    std::string header;
+    put32(header, 0x02014b50);
+    put16(header, (3 << 8) | (zip64 ? 45 : 20));       // Made on Unix
+    put16(header, zip64 ? 45 : 20);
+    put16(header, record.flags);
+    put16(header, record.method);
+    put16(header, time);
+    put16(header, date);
+    put32(header, record.crc);
+    put32(header, big_compressed ? ZIP_MAX32 : static_cast<uint32_t>(record.compressed));
+    put32(header, big_size ? ZIP_MAX32 : static_cast<uint32_t>(record.size));
+    put16(header, static_cast<uint32_t>(record.name.size()));
+    put16(header, static_cast<uint32_t>(extra.size()));
+    put16(header, 0);                                   // Comment
+    put16(header, 0);                                   // Disk
+    put16(header, 0);                                   // Internal attributes
+    put32(header, (record.mode << 16) | (S_ISDIR(record.mode) ? 0x10 : 0));
+    put32(header, big_offset ? ZIP_MAX32 : static_cast<uint32_t>(record.offset));
+    return header + record.name + extra;
+}
+
+ZipRecord newRecord(const SourceEntry& entry) {
+    ZipRecord record;
+    record.name = entry.name + (S_ISDIR(entry.st.st_mode) ? "/" : "");
+    record.mode = entry.st.st_mode;
+    record.mtime = entry.st.st_mtime;
+    if (std::any_of(record.name.begin(), record.name.end(), [](char c) { return c & 0x80; })) {
+        record.flags |= 1 << 11;                        // UTF-8 name
+    }
+    return record;
+}
+
+class ZipWriter {
+public:
+    ZipWriter(FileSink& out, int level, ThreadPool& pool, ArchiveReport& report)
+        : out_(out), level_(level), pool_(pool), report_(report) {}
+
+    // Small entries: read and compressed whole, one per worker, then written in order
+    bool addWindow(const std::vector<SourceEntry>& entries, size_t begin, size_t end) {
+        std::vector<Prepared> prepared(end - begin);
+        for (size_t start = begin; start < end; start += ZIP_ENTRIES_PER_TASK) {
+            pool_.submit([&, start]() {
+                size_t stop = std::min(end, start + ZIP_ENTRIES_PER_TASK);
+                for (size_t i = start; i < stop; i++) prepare(entries[i], prepared[i - begin]);
+            });
+        }
+        pool_.wait();
+
+        for (auto& item : prepared) {
+            if (!item.error.empty()) {
+                report_.errors.push_back(item.error);
+                continue;
+            }
+            item.record.offset = out_.offset();
+            if (!out_.put(localHeader(item.record)) || !out_.put(item.data)) return false;
+            commit(item.record);
+        }
+        return true;
+    }
+
+    // Large files stream through a block-parallel deflate; sizes are patched in afterwards
+    bool addLarge(const SourceEntry& entry) {
+        int fd = open(entry.path.c_str(), O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            report_.errors.push_back(errnoText(entry.path + ": cannot open"));
+            return true;
+        }
+        ZipRecord record = newRecord(entry);
+        record.method = 8;
+        record.zip64 = static_cast<uint64_t>(entry.st.st_size) >= ZIP64_LOCAL_THRESHOLD;
+        record.offset = out_.offset();
+        if (!out_.put(localHeader(record))) {
+            close(fd);
+            return false;
+        }
+        uint64_t data_start = out_.offset();
+
+        ParallelDeflate deflate(out_, level_, &pool_);
+        std::vector<char> buffer(IO_BUFFER_SIZE);
+        uint64_t remaining = static_cast<uint64_t>(entry.st.st_size);
+        std::string read_error;
+        while (remaining > 0) {
+            ssize_t n = readFull(fd, buffer.data(), static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size())));
+            if (n < 0) read_error = errnoText(entry.path + ": read failed");
+            if (n <= 0) break;
+            if (!deflate.write(buffer.data(), static_cast<size_t>(n))) {
+                close(fd);
+                return false;
+            }
+            remaining -= static_cast<uint64_t>(n);
+        }
+        close(fd);
+
+        if (!read_error.empty()) {
+            report_.errors.push_back(read_error);
+            return out_.rewind(record.offset);
+        }
+        if (!deflate.finish()) return false;
+        record.crc = deflate.crc();
+        record.size = deflate.size();
+        record.compressed = out_.offset() - data_start;
+
+        std::string crc;
+        put32(crc, record.crc);
+        std::string sizes;
+        if (record.zip64) {
+            put64(sizes, record.size);
+            put64(sizes, record.compressed);
+            if (!out_.patch(record.offset + 14, crc) ||
+                !out_.patch(record.offset + 30 + record.name.size() + 4, sizes)) {
+                return false;
+            }
+        } else {
+            put32(sizes, static_cast<uint32_t>(record.compressed));
+            put32(sizes, static_cast<uint32_t>(record.size));
+            if (!out_.patch(record.offset + 14, crc + sizes)) return false;
+        }
+        commit(record);
+        return true;
+    }
+
+    bool finish() {
+        uint64_t directory_offset = out_.offset();
+        for (const auto& record : central_) {
+            if (!out_.put(centralHeader(record))) return false;
+        }
+        uint64_t directory_size = out_.offset() - directory_offset;
+        uint64_t count = central_.size();
+
+        std::string end;
+        if (count >= 0xFFFF || directory_offset >= ZIP_MAX32 || directory_size >= ZIP_MAX32) {
+            uint64_t zip64_end = out_.offset();
+            put32(end, 0x06064b50);
+            put64(end, 44);
+            put16(end, (3 << 8) | 45);
+            put16(end, 45);
+            put32(end, 0);
+            put32(end, 0);
+            put64(end, count);
+            put64(end, count);
+            put64(end, directory_size);
+            put64(end, directory_offset);
+            put32(end, 0x07064b50);                     // Locator
+            put32(end, 0);
+            put64(end, zip64_end);
+            put32(end, 1);
+        }
+        put32(end, 0x06054b50);
+        put16(end, 0);
+        put16(end, 0);
+        put16(end, static_cast<uint32_t>(std::min<uint64_t>(count, 0xFFFF)));
+        put16(end, static_cast<uint32_t>(std::min<uint64_t>(count, 0xFFFF)));
+        put32(end, static_cast<uint32_t>(std::min<uint64_t>(directory_size, ZIP_MAX32)));
+        put32(end, static_cast<uint32_t>(std::min<uint64_t>(directory_offset, ZIP_MAX32)));
+        put16(end, 0);
+        return out_.put(end) && out_.flush();
+    }
+
+private:
+    struct Prepared {
+        ZipRecord record;
+        std::string data;
+        std::string error;
+    };
+
+    void prepare(const SourceEntry& entry, Prepared& item) const {
+        item.record = newRecord(entry);
+        const struct stat& st = entry.st;
+        std::string content;
+        if (S_ISDIR(st.st_mode)) {
+            return;
+        } else if (S_ISLNK(st.st_mode)) {
+            char target[PATH_MAX];
+            ssize_t n = readlink(entry.path.c_str(), target, sizeof(target));
+            if (n < 0) {
+                item.error = errnoText(entry.path + ": cannot read link");
+                return;
+            }
+            content.assign(target, static_cast<size_t>(n));
+        } else if (S_ISREG(st.st_mode)) {
+            int fd = open(entry.path.c_str(), O_RDONLY | O_NOCTTY);
+            if (fd < 0) {
+                item.error = errnoText(entry.path + ": cannot open");
+                return;
+            }
+            content.resize(static_cast<size_t>(st.st_size));
+            ssize_t n = readFull(fd, &content[0], content.size());
+            if (n < 0) item.error = errnoText(entry.path + ": read failed");
+            close(fd);
+            if (n < 0) return;
+            content.resize(static_cast<size_t>(n));
+        } else {
+            item.error = entry.path + ": special file skipped";
+            return;
+        }
+
+        item.record.size = content.size();
+        item.record.crc = crc32(0, reinterpret_cast<const Bytef*>(content.data()), static_cast<uInt>(content.size()));
+        if (!content.empty() && S_ISREG(st.st_mode)) {
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            if (deflateInit2(&zs, level_, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+                std::string packed(deflateBound(&zs, static_cast<uLong>(content.size())), '\0');
+                zs.next_in = reinterpret_cast<Bytef*>(&content[0]);
+                zs.avail_in = static_cast<uInt>(content.size());
+                zs.next_out = reinterpret_cast<Bytef*>(&packed[0]);
+                zs.avail_out = static_cast<uInt>(packed.size());
+                int rc = deflate(&zs, Z_FINISH);
+                packed.resize(packed.size() - zs.avail_out);
+                deflateEnd(&zs);
+                // Stored when deflate does not help, as zip does
+                if (rc == Z_STREAM_END && packed.size() < content.size()) {
+                    item.record.method = 8;
+                    content.swap(packed);
+                }
+            }
+        }
+        item.record.compressed = content.size();
+        item.data.swap(content);
+    }
+
+    void commit(const ZipRecord& record) {
+        char type = S_ISDIR(record.mode) ? 'd' : S_ISLNK(record.mode) ? 'l' : 'f';
+        ArchiveEntry entry;
+        entry.path = record.name;
+        entry.type = type;
+        entry.size = record.size;
+        entry.compressed = record.compressed;
+        entry.mode = record.mode & 07777;
+        entry.mtime = record.mtime;
+        report_.entries.push_back(entry);
+        if (type == 'f') report_.bytes_in += record.size;
+        central_.push_back(record);
+    }
+
+    FileSink& out_;
+    int level_;
+    ThreadPool& pool_;
+    ArchiveReport& report_;
+    std::vector<ZipRecord> central_;
+};
+
+struct ZipMember {
+    std::string name;
+    uint16_t made_by = 0;
+    uint16_t flags = 0;
+    uint16_t method = 0;
+    uint32_t crc = 0;
+    uint64_t compressed = 0;
+    uint64_t size = 0;
+    uint64_t offset = 0;
+    int64_t mtime = 0;
+    char type = 'f';
+    uint32_t mode = 0;
+};
+
+// The whole index comes from the end of central directory record and the
+// directory it points at; no member data is read
+bool readCentralDirectory(int fd, uint64_t file_size, std::vector<ZipMember>& members, std::string& error) {
+    size_t tail_size = static_cast<size_t>(std::min<uint64_t>(file_size, 0xFFFF + 22));
+    std::string tail(tail_size, '\0');
+    if (tail_size < 22 || !preadFull(fd, &tail[0], tail_size, file_size - tail_size)) {
+        error = "not a zip archive";
+        return false;
+    }
+    const unsigned char* t = reinterpret_cast<const unsigned char*>(tail.data());
+    ssize_t pos = static_cast<ssize_t>(tail_size) - 22;
+    while (pos >= 0 && get32(t + pos) != 0x06054b50) pos--;
+    if (pos < 0) {
+        error = "not a zip archive (no end of central directory)";
+        return false;
+    }
+    uint64_t count = get16(t + pos + 10);
+    uint64_t directory_size = get32(t + pos + 12);
+    uint64_t directory_offset = get32(t + pos + 16);
+    if (pos >= 20 && get32(t + pos - 20) == 0x07064b50) {
+        unsigned char record[56];
+        if (preadFull(fd, reinterpret_cast<char*>(record), sizeof(record), get64(t + pos - 20 + 8)) &&
+            get32(record) == 0x06064b50) {
+            count = get64(record + 32);
+            directory_size = get64(record + 40);
+            directory_offset = get64(record + 48);
+        }
+    }
+    if (directory_offset + directory_size > file_size) {
+        error = "corrupt zip central directory";
+        return false;
+    }
+
+    std::string directory(static_cast<size_t>(directory_size), '\0');
+    if (directory_size > 0 && !preadFull(fd, &directory[0], directory.size(), directory_offset)) {
+        error = errnoText("cannot read zip central directory");
+        return false;
+    }
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(directory.data());
+    size_t p = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (p + 46 > directory.size() || get32(c + p) != 0x02014b50) {
+            error = "corrupt zip central directory";
+            return false;
+        }
+        ZipMember member;
+        member.made_by = static_cast<uint16_t>(get16(c + p + 4));
+        member.flags = static_cast<uint16_t>(get16(c + p + 8));
+        member.method = static_cast<uint16_t>(get16(c + p + 10));
+        uint32_t time = get16(c + p + 12);
+        uint32_t date = get16(c + p + 14);
+        member.crc = get32(c + p + 16);
+        member.compressed = get32(c + p + 20);
+        member.size = get32(c + p + 24);
+        size_t name_length = get16(c + p + 28);
+        size_t extra_length = get16(c + p + 30);
+        size_t comment_length = get16(c + p + 32);
+        uint32_t external = get32(c + p + 38);
+        member.offset = get32(c + p + 42);
+        size_t record_size = 46 + name_length + extra_length + comment_length;
+        if (p + record_size > directory.size()) {
+            error = "corrupt zip central directory";
+            return false;
+        }
+        member.name = directory.substr(p + 46, name_length);
+        member.mtime = fromDosTime(time, date);
+
+        size_t q = p + 46 + name_length;
+        size_t extra_end = q + extra_length;
+        while (q + 4 <= extra_end) {
+            uint32_t id = get16(c + q);
+            size_t size = get16(c + q + 2);
+            const unsigned char* data = c + q + 4;
+            if (q + 4 + size > extra_end) break;
+            if (id == 0x0001) {
+                size_t used = 0;
+                if (member.size == ZIP_MAX32 && used + 8 <= size) { member.size = get64(data + used); used += 8; }
+                if (member.compressed == ZIP_MAX32 && used + 8 <= size) { member.compressed = get64(data + used); used += 8; }
+                if (member.offset == ZIP_MAX32 && used + 8 <= size) { member.offset = get64(data + used); used += 8; }
+            } else if (id == 0x5455 && size >= 5 && (data[0] & 1)) {
+                member.mtime = get32(data + 1);
+            }
+            q += 4 + size;
+        }
+
+        uint32_t unix_mode = external >> 16;
+        if ((member.made_by >> 8) == 3 && unix_mode != 0) {
+            member.type = S_ISDIR(unix_mode) ? 'd' : S_ISLNK(unix_mode) ? 'l' : 'f';
+            member.mode = unix_mode & 07777;
+        } else {
+            member.type = (external & 0x10) ? 'd' : 'f';
+            member.mode = member.type == 'd' ? 0755 : 0644;
+        }
+        if (utils::endsWith(member.name, "/")) member.type = 'd';
+        members.push_back(std::move(member));
+        p += record_size;
+    }
+    return true;
+}
+
+// Streams one member's data to emit, checking size and CRC
+bool decodeMember(int fd, const ZipMember& member, const std::function<bool(const char*, size_t)>& emit,
+                  std::string& error) {
+    if (member.flags & 1) {
+        error = member.name + ": encrypted entries are not supported";
+        return false;
+    }
+    if (member.method != 0 && member.method != 8) {
+        error = member.name + ": unsupported compression method " + std::to_string(member.method);
+        return false;
+    }
+    unsigned char local[30];
+    if (!preadFull(fd, reinterpret_cast<char*>(local), sizeof(local), member.offset) ||
+        get32(local) != 0x04034b50) {
+        error = member.name + ": corrupt local header";
+        return false;
+    }
+    uint64_t offset = member.offset + 30 + get16(local + 26) + get16(local + 28);
+
+    std::vector<char> input(256 * 1024);
+    std::vector<char> output(member.method == 8 ? 256 * 1024 : 0);
+    uint32_t crc = crc32(0, Z_NULL, 0);
+    uint64_t total = 0;
+    uint64_t remaining = member.compressed;
+
+    if (member.method == 0) {
+        while (remaining > 0) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, input.size()));
+            if (!preadFull(fd, input.data(), n, offset)) {
+                error = errnoText(member.name + ": cannot read");
+                return false;
+            }
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(input.data()), static_cast<uInt>(n));
+            if (!emit(input.data(), n)) return false;
+            offset += n;
+            remaining -= n;
+            total += n;
+        }
+    } else {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+            error = member.name + ": cannot initialise inflate";
+            return false;
+        }
+        int rc = Z_OK;
+        bool ok = true;
+        while (rc != Z_STREAM_END && ok) {
+            if (zs.avail_in == 0) {
+                if (remaining == 0) {
+                    error = member.name + ": compressed data is truncated";
+                    ok = false;
+                    break;
+                }
+                size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, input.size()));
+                if (!preadFull(fd, input.data(), n, offset)) {
+                    error = errnoText(member.name + ": cannot read");
+                    ok = false;
+                    break;
+                }
+                offset += n;
+                remaining -= n;
+                zs.next_in = reinterpret_cast<Bytef*>(input.data());
+                zs.avail_in = static_cast<uInt>(n);
+            }
+            zs.next_out = reinterpret_cast<Bytef*>(output.data());
+            zs.avail_out = static_cast<uInt>(output.size());
+            rc = inflate(&zs, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+                error = member.name + ": corrupt data" + (zs.msg ? std::string(": ") + zs.msg : "");
+                ok = false;
+                break;
+            }
+            size_t produced = output.size() - zs.avail_out;
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(output.data()), static_cast<uInt>(produced));
+            total += produced;
+            if (produced > 0 && !emit(output.data(), produced)) ok = false;
+        }
+        inflateEnd(&zs);
+        if (!ok) return false;
+    }
+
+    if (total != member.size) {
+        error = member.name + ": size mismatch";
+        return false;
+    }
+    if (crc != member.crc) {
+        error = member.name + ": CRC mismatch";
+        return false;
+    }
+    return true;
+}
+
+bool extractMember(int fd, const ZipMember& member, const std::string& target, std::string& error) {
+    if (!clearTarget(target, error)) return false;
+    int out = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, member.mode & 0777);
+    if (out < 0) {
+        error = errnoText(target + ": cannot create");
+        return false;
+    }
+    bool ok = decodeMember(fd, member, [&](const char* data, size_t size) {
+        if (writeAll(out, data, size)) return true;
+        error = errnoText(target + ": write failed");
+        return false;
+    }, error);
+    if (ok) {
+        if (isRoot()) fchmod(out, member.mode & 07777);
+        setTimes(out, target, member.mtime);
+    }
+    close(out);
+    if (!ok) unlink(target.c_str());
+    return ok;
+}
+
+ArchiveEntry describeMember(const ZipMember& member) {
+    ArchiveEntry entry;
+    entry.path = member.name;
+    entry.type = member.type;
+    entry.size = member.size;
+    entry.compressed = member.compressed;
+    entry.mode = member.mode;
+    entry.mtime = member.mtime;
+    return entry;
+}
+
+#endif // HAVE_ZLIB
+
+std::string modeString(const ArchiveEntry& entry) {
+    std::string text = entry.type == 'd' ? "d" : entry.type == 'l' ? "l" : entry.type == 'p' ? "p" : "-";
+    const char* bits = "rwxrwxrwx";
+    for (int i = 0; i < 9; i++) text += (entry.mode & (0400 >> i)) ? bits[i] : '-';
+    return text;
+}
+
+} // anonymous namespace
+
+bool Archive::hasZlib() {
+#ifdef HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+Archive::Format Archive::detect(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return Format::Unknown;
+    char block[TAR_BLOCK_SIZE];
+    ssize_t n = readFull(fd, block, sizeof(block));
+    close(fd);
+    if (n < 0) return Format::Unknown;
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(block);
+    if (n >= 2 && b[0] == 0x1f && b[1] == 0x8b) return Format::Gzip;
+    if (n >= 3 && memcmp(block, "BZh", 3) == 0) return Format::Bzip2;
+    if (n >= 6 && memcmp(block, "\xfd" "7zXZ\0", 6) == 0) return Format::Xz;
+    if (n >= 4 && (memcmp(block, "PK\x03\x04", 4) == 0 || memcmp(block, "PK\x05\x06", 4) == 0)) return Format::Zip;
+    if (n == static_cast<ssize_t>(TAR_BLOCK_SIZE) && (memcmp(block + 257, "ustar", 5) == 0 || checksumOk(block))) {
+        return Format::Tar;
+    }
+    return Format::Unknown;
+}
+
+bool Archive::createTar(const std::string& archive, const std::vector<std::string>& inputs,
+                        const ArchiveOptions& options, ArchiveReport& report, std::string& error) {
+#ifndef HAVE_ZLIB
+    if (options.gzip) {
+        error = "gzip support was not built in (zlib missing)";
+        return false;
+    }
+#endif
+    int fd = open(archive.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    struct stat archive_st;
+    if (fd < 0 || fstat(fd, &archive_st) != 0) {
+        error = errnoText(archive + ": cannot create");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    std::vector<SourceEntry> entries = collectInputs(inputs, true, options.threads, archive_st, report);
+    FileSink file(fd);
+    Sink* out = &file;
+#ifdef HAVE_ZLIB
+    std::unique_ptr<ThreadPool> pool;
+    std::unique_ptr<GzipSink> gzip;
+    if (options.gzip) {
+        pool.reset(new ThreadPool(options.threads));
+        gzip.reset(new GzipSink(file, options.level, pool.get()));
+        out = gzip.get();
+    }
+    bool ok = !gzip || gzip->start("", 0);
+#else
+    bool ok = true;
+#endif
+
+    TarWriter tar(*out, report);
+    for (size_t i = 0; i < entries.size() && ok; i++) {
+        ok = tar.add(entries[i].path, entries[i].name, entries[i].st);
+    }
+    ok = ok && tar.finish();
+#ifdef HAVE_ZLIB
+    if (gzip) ok = ok && gzip->finish();
+#endif
+    ok = ok && file.flush();
+    close(fd);
+
+    if (!ok) {
+        error = file.error().empty() ? "compression failed" : file.error();
+        unlink(archive.c_str());
+        return false;
+    }
+    report.bytes_out = file.offset();
+    return true;
+}
+
+bool Archive::extractTar(const std::string& archive, const std::string& dest,
+                         ArchiveReport& report, std::string& error) {
+    return readTar(archive, &dest, report, error);
+}
+
+bool Archive::listTar(const std::string& archive, ArchiveReport& report, std::string& error) {
+    return readTar(archive, nullptr, report, error);
+}
+
+bool Archive::createZip(const std::string& archive, const std::vector<std::string>& inputs,
+                        const ArchiveOptions& options, ArchiveReport& report, std::string& error) {
+#ifdef HAVE_ZLIB
+    int fd = open(archive.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    struct stat archive_st;
+    if (fd < 0 || fstat(fd, &archive_st) != 0) {
+        error = errnoText(archive + ": cannot create");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    std::vector<SourceEntry> entries = collectInputs(inputs, options.recursive, options.threads, archive_st, report);
+    ThreadPool pool(options.threads);
+    FileSink out(fd);
+    ZipWriter zip(out, options.level, pool, report);
+    bool ok = true;
+
+    size_t i = 0;
+    while (i < entries.size() && ok) {
+        auto large = [](const SourceEntry& entry) {
+            return S_ISREG(entry.st.st_mode) && static_cast<uint64_t>(entry.st.st_size) > ZIP_SMALL_ENTRY;
+        };
+        if (large(entries[i])) {
+            ok = zip.addLarge(entries[i]);
+            i++;
+            continue;
+        }
+        size_t end = i;
+        uint64_t bytes = 0;
+        while (end < entries.size() && end - i < ZIP_WINDOW_ENTRIES && !large(entries[end])) {
+            uint64_t size = S_ISREG(entries[end].st.st_mode) ? static_cast<uint64_t>(entries[end].st.st_size) : 0;
+            if (end > i && bytes + size > ZIP_WINDOW_BYTES) break;
+            bytes += size;
+            end++;
+        }
+        ok = zip.addWindow(entries, i, end);
+        i = end;
+    }
+    ok = ok && zip.finish();
+    close(fd);
+
+    if (!ok) {
+        error = out.error().empty() ? "compression failed" : out.error();
+        unlink(archive.c_str());
+        return false;
+    }
+    report.bytes_out = out.offset();
+    return true;
+#else
+    (void)archive; (void)inputs; (void)options; (void)report;
+    error = "zip support was not built in (zlib missing)";
+    return false;
+#endif
+}
+
+bool Archive::extractZip(const std::string& archive, const std::string& dest,
+                         const ArchiveOptions& options, ArchiveReport& report, std::string& error) {
+#ifdef HAVE_ZLIB
+    int fd = open(archive.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        error = errnoText(archive + ": cannot open");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    std::vector<ZipMember> members;
+    if (!readCentralDirectory(fd, static_cast<uint64_t>(st.st_size), members, error)) {
+        close(fd);
+        return false;
+    }
+    report.bytes_in = static_cast<uint64_t>(st.st_size);
+
+    // Directories first, then file data in parallel, then symlinks
+    std::set<std::string> made;
+    std::vector<DirMeta> dirs;
+    std::vector<std::pair<const ZipMember*, std::string>> files, links;
+    if (!makeDirs(dest, made, error)) {
+        close(fd);
+        return false;
+    }
+    for (const auto& member : members) {
+        std::string relative, message;
+        if (!safeMember(member.name, relative)) {
+            report.errors.push_back(member.name + ": path leaves the destination, skipped");
+            continue;
+        }
+        if (relative.empty()) continue;
+        std::string target = utils::joinPath(dest, relative);
+        if (member.type == 'd') {
+            if (makeDirs(target, made, message)) {
+                dirs.push_back({target, member.mode, member.mtime});
+                report.entries.push_back(describeMember(member));
+            } else {
+                report.errors.push_back(message);
+            }
+        } else if (!makeDirs(utils::getDirname(target), made, message)) {
+            report.errors.push_back(message);
+        } else if (member.type == 'l') {
+            links.emplace_back(&member, target);
+        } else {
+            files.emplace_back(&member, target);
+        }
+    }
+
+    std::mutex mutex;
+    auto extract = [&](size_t start, size_t stop) {
+        for (size_t i = start; i < stop; i++) {
+            std::string message;
+            bool ok = extractMember(fd, *files[i].first, files[i].second, message);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                report.entries.push_back(describeMember(*files[i].first));
+                report.bytes_out += files[i].first->size;
+            } else {
+                report.errors.push_back(message);
+            }
+        }
+    };
+    if (files.size() <= ZIP_ENTRIES_PER_TASK) {
+        extract(0, files.size());
+    } else {
+        size_t tasks = (files.size() + ZIP_ENTRIES_PER_TASK - 1) / ZIP_ENTRIES_PER_TASK;
+        size_t threads = options.threads ? options.threads : ThreadPool::defaultThreadCount();
+        ThreadPool pool(std::min(threads, tasks));
+        for (size_t start = 0; start < files.size(); start += ZIP_ENTRIES_PER_TASK) {
+            pool.submit([&, start]() { extract(start, std::min(files.size(), start + ZIP_ENTRIES_PER_TASK)); });
+        }
+        pool.wait();
+    }
+
+    for (const auto& link : links) {
+        const ZipMember& member = *link.first;
+        std::string target = link.second;
+        std::string content, message;
+        bool ok = member.size <= ZIP_MAX_LINK_SIZE && decodeMember(fd, member, [&](const char* data, size_t size) {
+            content.append(data, size);
+            return true;
+        }, message);
+        if (!ok) {
+            report.errors.push_back(message.empty() ? member.name + ": symlink target too long" : message);
+            continue;
+        }
+        if (!clearTarget(target, message)) {
+            report.errors.push_back(message);
+            continue;
+        }
+        if (symlink(content.c_str(), target.c_str()) != 0) {
+            report.errors.push_back(errnoText(target + ": cannot create symlink"));
+            continue;
+        }
+        setTimes(-1, target, member.mtime);
+        ArchiveEntry entry = describeMember(member);
+        entry.link = content;
+        report.entries.push_back(entry);
+    }
+    close(fd);
+    finishDirectories(dirs);
+    return true;
+#else
+    (void)archive; (void)dest; (void)options; (void)report;
+    error = "zip support was not built in (zlib missing)";
+    return false;
+#endif
+}
+
+bool Archive::listZip(const std::string& archive, ArchiveReport& report, std::string& error) {
+#ifdef HAVE_ZLIB
+    int fd = open(archive.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        error = errnoText(archive + ": cannot open");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    std::vector<ZipMember> members;
+    bool ok = readCentralDirectory(fd, static_cast<uint64_t>(st.st_size), members, error);
+    close(fd);
+    for (const auto& member : members) report.entries.push_back(describeMember(member));
+    report.bytes_in = static_cast<uint64_t>(st.st_size);
+    return ok;
+#else
+    (void)archive; (void)report;
+    error = "zip support was not built in (zlib missing)";
+    return false;
+#endif
+}
+
+bool Archive::gzip(const std::string& source, const std::string& dest, bool overwrite,
+                   const ArchiveOptions& options, ArchiveReport& report, std::string& error) {
+#ifdef HAVE_ZLIB
+    struct stat st;
+    if (lstat(source.c_str(), &st) != 0) {
+        error = errnoText(source + ": cannot stat");
+        return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        error = source + ": not a regular file";
+        return false;
+    }
+    int in = open(source.c_str(), O_RDONLY | O_NOCTTY);
+    if (in < 0) {
+        error = errnoText(source + ": cannot open");
+        return false;
+    }
+    int out = open(dest.c_str(), O_WRONLY | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), 0600);
+    if (out < 0) {
+        error = errno == EEXIST ? dest + ": already exists" : errnoText(dest + ": cannot create");
+        close(in);
+        return false;
+    }
+
+    // A pool only pays off once there is more than one block
+    std::unique_ptr<ThreadPool> pool;
+    if (static_cast<uint64_t>(st.st_size) > DEFLATE_BLOCK_SIZE) pool.reset(new ThreadPool(options.threads));
+    FileSink file(out);
+    GzipSink gz(file, options.level, pool.get());
+    bool ok = gz.start(utils::getBasename(source), st.st_mtime);
+
+    std::vector<char> buffer(IO_BUFFER_SIZE);
+    std::string read_error;
+    while (ok) {
+        ssize_t n = readFull(in, buffer.data(), buffer.size());
+        if (n < 0) read_error = errnoText(source + ": read failed");
+        if (n <= 0) break;
+        ok = gz.write(buffer.data(), static_cast<size_t>(n));
+        report.bytes_in += static_cast<uint64_t>(n);
+    }
+    ok = ok && read_error.empty() && gz.finish() && file.flush();
+    if (ok) {
+        fchmod(out, st.st_mode & 07777);
+        setTimes(out, dest, st.st_mtime);
+    }
+    close(in);
+    close(out);
+
+    if (!ok) {
+        error = !read_error.empty() ? read_error : !file.error().empty() ? file.error() : "compression failed";
+        unlink(dest.c_str());
+        return false;
+    }
+    report.bytes_out = file.offset();
+    report.entries.push_back(describe(dest, 'f', st, report.bytes_in));
+    return true;
+#else
+    (void)source; (void)dest; (void)overwrite; (void)options; (void)report;
+    error = "gzip support was not built in (zlib missing)";
+    return false;
+#endif
+}
+
+bool Archive::gunzip(const std::string& source, const std::string& dest, bool overwrite,
+                     ArchiveReport& report, std::string& error) {
+#ifdef HAVE_ZLIB
+    int in = open(source.c_str(), O_RDONLY | O_NOCTTY);
+    struct stat st;
+    if (in < 0 || fstat(in, &st) != 0) {
+        error = errnoText(source + ": cannot open");
+        if (in >= 0) close(in);
+        return false;
+    }
+    if (detect(source) != Format::Gzip) {
+        error = source + ": not in gzip format";
+        close(in);
+        return false;
+    }
+    int out = open(dest.c_str(), O_WRONLY | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), 0600);
+    if (out < 0) {
+        error = errno == EEXIST ? dest + ": already exists" : errnoText(dest + ": cannot create");
+        close(in);
+        return false;
+    }
+
+    FileSource file(in, static_cast<uint64_t>(st.st_size));
+    GzipSource gz(file);
+    std::vector<char> buffer(IO_BUFFER_SIZE);
+    bool ok = true;
+    for (;;) {
+        ssize_t n = gz.read(buffer.data(), buffer.size());
+        if (n < 0) {
+            error = source + ": " + gz.error();
+            ok = false;
+            break;
+        }
+        if (n == 0) break;
+        if (!writeAll(out, buffer.data(), static_cast<size_t>(n))) {
+            error = errnoText(dest + ": write failed");
+            ok = false;
+            break;
+        }
+        report.bytes_out += static_cast<uint64_t>(n);
+    }
+    if (ok) {
+        fchmod(out, st.st_mode & 07777);
+        setTimes(out, dest, st.st_mtime);
+    }
+    close(in);
+    close(out);
+    if (!ok) {
+        unlink(dest.c_str());
+        return false;
+    }
+    report.bytes_in = static_cast<uint64_t>(st.st_size);
+    report.entries.push_back(describe(dest, 'f', st, report.bytes_out));
+    return true;
+#else
+    (void)source; (void)dest; (void)overwrite; (void)report;
+    error = "gzip support was not built in (zlib missing)";
+    return false;
+#endif
+}
+
+std::string Archive::formatList(const ArchiveReport& report, bool zip, size_t max_lines) {
+    std::ostringstream out;
+    uint64_t total = 0, compressed = 0;
+    for (size_t i = 0; i < report.entries.size(); i++) {
+        const ArchiveEntry& entry = report.entries[i];
+        total += entry.size;
+        compressed += entry.compressed;
+        if (i >= max_lines) continue;
+
+        char date[32];
+        time_t t = static_cast<time_t>(entry.mtime);
+        struct tm tm;
+        localtime_r(&t, &tm);
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", &tm);
+        char sizes[48];
+        if (zip) {
+            snprintf(sizes, sizeof(sizes), "%12llu %12llu", static_cast<unsigned long long>(entry.size),
+                     static_cast<unsigned long long>(entry.compressed));
+        } else {
+            snprintf(sizes, sizeof(sizes), "%12llu", static_cast<unsigned long long>(entry.size));
+        }
+        out << modeString(entry) << " " << sizes << "  " << date << "  " << entry.path;
+        if (entry.type == 'l' && !entry.link.empty()) out << " -> " << entry.link;
+        if (entry.type == 'h') out << " link to " << entry.link;
+        out << "\n";
+    }
+    if (report.entries.size() > max_lines) {
+        out << "... " << (report.entries.size() - max_lines) << " more entries\n";
+    }
+    out << report.entries.size() << " entries, " << utils::formatSize(total);
+    if (zip) out << " (" << utils::formatSize(compressed) << " compressed)";
+    out << "\n";
+    for (const auto& message : report.errors) out << "error: " << message << "\n";
+    return out.str();
+}
+
+std::string Archive::formatSummary(const ArchiveReport& report, const std::string& verb, size_t max_errors) {
+    size_t files = 0, dirs = 0, links = 0;
+    for (const auto& entry : report.entries) {
+        if (entry.type == 'd') dirs++;
+        else if (entry.type == 'l' || entry.type == 'h') links++;
+        else files++;
+    }
+    std::ostringstream out;
+    out << verb << " " << files << (files == 1 ? " file" : " files");
+    if (dirs) out << ", " << dirs << (dirs == 1 ? " directory" : " directories");
+    if (links) out << ", " << links << (links == 1 ? " link" : " links");
+    out << ": read " << utils::formatSize(report.bytes_in) << ", wrote " << utils::formatSize(report.bytes_out) << "\n";
+
+    if (!report.errors.empty()) {
+        out << report.errors.size() << (report.errors.size() == 1 ? " error:\n" : " errors:\n");
+        for (size_t i = 0; i < report.errors.size() && i < max_errors; i++) {
+            out << "  " << report.errors[i] << "\n";
+        }
+        if (report.errors.size() > max_errors) {
+            out << "  ... " << (report.errors.size() - max_errors) << " more\n";
+        }
+    }
+    return out.str();
+}
+
+} // namespace casper
@@ -0,0 +1,115 @@
+#include "blob_store.h"
+#include "utils.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace casper {
+
+namespace {
+
+// Fast settings: outputs are written on every tool call, and logs and
+// source text still shrink three to five times
+#ifdef HAVE_ZLIB
+const int COMPRESSION_LEVEL = 3;
+#endif
+
+// inflate_blob(codec, size, data): the text of a blob row
+void inflateBlob(sqlite3_context* context, int, sqlite3_value** args) {
+    int codec = sqlite3_value_int(args[0]);
+    sqlite3_int64 size = sqlite3_value_int64(args[1]);
+    const void* data = sqlite3_value_blob(args[2]);
+    int data_size = sqlite3_value_bytes(args[2]);
+
+    if (codec == BlobStore::STORED) {
+        sqlite3_result_text(context, static_cast<const char*>(data), data_size, SQLITE_TRANSIENT);
+        return;
+    }
+#ifdef HAVE_ZLIB
+    if (codec == BlobStore::ZLIB && size >= 0) {
+        // Inflated straight into the buffer SQLite takes over
+        char* text = static_cast<char*>(sqlite3_malloc64(static_cast<sqlite3_uint64>(size) + 1));
+        if (!text) {
+            sqlite3_result_error_nomem(context);
+            return;
+        }
+        uLongf text_size = static_cast<uLongf>(size);
+        if (uncompress(reinterpret_cast<Bytef*>(text), &text_size,
+                       static_cast<const Bytef*>(data), static_cast<uLong>(data_size)) == Z_OK &&
+            text_size == static_cast<uLongf>(size)) {
+            sqlite3_result_text64(context, text, static_cast<sqlite3_uint64>(size), sqlite3_free, SQLITE_UTF8);
+            return;
+        }
+        sqlite3_free(text);
+    }
+#else
+    (void)size;
+#endif
+    sqlite3_result_error(context, "inflate_blob: unreadable blob", -1);
+}
+
+} // anonymous namespace
+
+BlobStore::BlobStore(sqlite3* db)
+    : db_(db)
+    , exists_stmt_(nullptr)
+    , insert_stmt_(nullptr)
+{
+}
+
+BlobStore::~BlobStore() {
+    sqlite3_finalize(exists_stmt_);
+    sqlite3_finalize(insert_stmt_);
+}
+
+void BlobStore::registerFunctions(sqlite3* db) {
+    sqlite3_create_function_v2(db, "inflate_blob", 3, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                               nullptr, inflateBlob, nullptr, nullptr, nullptr);
+}
+
+std::string BlobStore::put(const std::string& data) {
+    if (!exists_stmt_ &&
+        sqlite3_prepare_v2(db_, "SELECT 1 FROM blobs WHERE hash = ?", -1, &exists_stmt_, nullptr) != SQLITE_OK) {
+        return "";
+    }
+    if (!insert_stmt_ &&
+        sqlite3_prepare_v2(db_, "INSERT OR IGNORE INTO blobs (hash, codec, size, data) VALUES (?, ?, ?, ?)",
+                           -1, &insert_stmt_, nullptr) != SQLITE_OK) {
+        return "";
+    }
+
+    std::string hash = utils::sha256Hex(data);
+
+    // Seen before: nothing to compress or write
+    sqlite3_bind_text(exists_stmt_, 1, hash.c_str(), -1, SQLITE_STATIC);
+    bool exists = sqlite3_step(exists_stmt_) == SQLITE_ROW;
+    sqlite3_reset(exists_stmt_);
+    sqlite3_clear_bindings(exists_stmt_);
+    if (exists) return hash;
+
+    int codec = STORED;
+    const void* stored = data.data();
+    size_t stored_size = data.size();
+#ifdef HAVE_ZLIB
+    std::string deflated(compressBound(static_cast<uLong>(data.size())), '\0');
+    uLongf deflated_size = static_cast<uLongf>(deflated.size());
+    if (compress2(reinterpret_cast<Bytef*>(&deflated[0]), &deflated_size,
+                  reinterpret_cast<const Bytef*>(data.data()), static_cast<uLong>(data.size()),
+                  COMPRESSION_LEVEL) == Z_OK && deflated_size < data.size()) {
+        codec = ZLIB;
+        stored = deflated.data();
+        stored_size = deflated_size;
+    }
+#endif
+
+    sqlite3_bind_text(insert_stmt_, 1, hash.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(insert_stmt_, 2, codec);
+    sqlite3_bind_int64(insert_stmt_, 3, static_cast<sqlite3_int64>(data.size()));
+    sqlite3_bind_blob64(insert_stmt_, 4, stored, static_cast<sqlite3_uint64>(stored_size), SQLITE_STATIC);
+    bool done = sqlite3_step(insert_stmt_) == SQLITE_DONE;
+    sqlite3_reset(insert_stmt_);
+    sqlite3_clear_bindings(insert_stmt_);
+    return done ? hash : "";
+}
+
+} // namespace casper
@@ -3,10 +3,16 @@
 #include "command_menu.h"
 #include "agent.h"
 #include "task_suggester.h"
+#include "undo_store.h"
+#include "file_cache.h"
+#include "result_cache.h"
+#include "ssh_multiplexer.h"
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <cstring>
 #include <chrono>
+#include <ctime>
 #include <unistd.h>
 #include <termios.h>
 
@@ -22,6 +28,9 @@ CLI::CLI()
     , temperature_override_(-1.0)
     , auto_approve_override_(false)
     , unsafe_mode_override_(false)
+    , resume_session_(false)
+    , list_sessions_(false)
+    , export_session_(false)
 {
     config_ = std::make_unique<Config>();
     config_->initialize();
@@ -29,6 +38,20 @@ CLI::CLI()
     client_ = std::make_unique<OllamaClient>(config_->getOllamaHost());
     parser_ = std::make_unique<ToolParser>();
     executor_ = std::make_unique<ToolExecutor>(*config_);
+
+    // Session database; tools still run without it
+    session_manager_ = std::make_unique<SessionManager>();
+    if (!session_manager_->initialize("", config_->getSessionDurability())) {
+        session_manager_.reset();
+    } else {
+        // Old sessions move to the archive in the background
+        RetentionPolicy retention;
+        retention.max_age_days = config_->getSessionRetentionDays();
+        retention.max_sessions = config_->getSessionRetentionMaxSessions();
+        retention.max_bytes = static_cast<uint64_t>(std::max(0, config_->getSessionRetentionMaxMb())) * 1024 * 1024;
+        session_manager_->startRetention(retention);
+    }
+
     command_menu_ = std::make_unique<CommandMenu>();
     mcp_client_ = std::make_unique<MCPClient>();
     task_suggester_ = std::make_unique<TaskSuggester>();
@@ -95,6 +118,16 @@ bool CLI::parseArgs(int argc, char* argv[]) {
             config_->setSafeMode(false);
         } else if (arg == "--mcp") {
             config_->setMCPEnabled(true);
+        } else if (arg == "--list-sessions") {
+            list_sessions_ = true;
+            if (i + 1 < argc && utils::startsWith(argv[i + 1], "session_")) {
+                list_after_ = argv[++i];
+            }
+        } else if (arg == "--resume") {
+            resume_session_ = true;
+            if (i + 1 < argc && utils::startsWith(argv[i + 1], "session_")) {
+                resume_session_id_ = argv[++i];
+            }
         } else {
             // Collect remaining args as prompt
             for (int j = i; j < argc; j++) {
@@ -133,6 +166,8 @@ OPTIONS:
     -a, --auto-approve      Auto-approve all tool executions
     --unsafe                Disable safe mode (allow all commands)
     --mcp                   Enable MCP servers on startup
+    --list-sessions [AFTER] List recent sessions, continuing after session AFTER
+    --resume [SESSION]      Continue a session (default: the most recent one)
     -v, --version           Show version
     -h, --help              Show this help
 
@@ -145,6 +180,21 @@ INTERACTIVE COMMANDS (use /command):
     /temp NUM               Set temperature
     /safe [on|off]          Toggle safe mode
     /auto [on|off]          Toggle auto-approve
+    /parallel [on|off|N]    Run independent tool calls concurrently (N workers)
+    /shell [on|off|restart] Share one shell across Bash calls, or restart it
+    /undo [list|force]      Revert the last Edit/Write, or list what can be undone
+    /cache [clear]          Show or empty the file and tool result caches
+    /tools stats [all]      Time, CPU and output per tool (this session or all)
+    /ssh                    List shared SSH connections used by SSH, Scp and Rsync
+    /ssh close [HOST]       Close one or all shared SSH connections
+    /ssh idle SECONDS       Idle time before a shared connection closes (0 = off)
+    /sessions [more]        List recent sessions, or the next page
+    /sessions search QUERY  Find past sessions by what was said or what tools output
+    /sessions retention [DAYS SESSIONS MB]  Archive sessions past these limits (0 = none)
+    /resume [SESSION|N]     Switch to an earlier session, or to search result N
+    /history [older]        Show this session's messages, or load earlier ones
+    /history tools          List this session's tool calls
+    /history output N       Show the output of tool call N
     /mcp                    Show MCP status and tools
     /mcp on                 Enable MCP and connect servers
     /mcp off                Disable MCP and disconnect servers
@@ -220,6 +270,9 @@ void CLI::printConfig() {
     std::cout << "  Max Tokens:   " << config_->getMaxTokens() << "\n";
     std::cout << "  Safe Mode:    " << (config_->getSafeMode() ? "true" : "false") << "\n";
     std::cout << "  Auto Approve: " << (config_->getAutoApprove() ? "true" : "false") << "\n";
+    std::cout << "  Parallel:     " << (config_->getParallelTools() ? "up to " + std::to_string(config_->getMaxParallelTools()) : "off") << "\n";
+    std::cout << "  Shell:        " << (config_->getPersistentShell() ? "persistent" : "fresh per command") << "\n";
+    std::cout << "  Retention:    " << describeRetention() << "\n";
     std::cout << "  MCP Enabled:  " << (config_->getMCPEnabled() ? std::string(utils::terminal::GREEN) + "true" : "false") << utils::terminal::RESET << "\n";
     std::cout << "  Agent Mode:   " << (agentModeEnabled_ ? std::string(utils::terminal::GREEN) + "enabled" : "disabled") << utils::terminal::RESET << "\n";
     std::cout << "  Current Agent:" << utils::terminal::GREEN << " " << currentAgent_.getDisplayName() << utils::terminal::RESET << "\n";
@@ -440,6 +493,8 @@ void CLI::initializeMCP() {
         mcp_config.enabled = server.enabled;
         mcp_config.transport = server.transport;
         mcp_config.url = server.url;
+        mcp_config.read_only = server.read_only;
+        mcp_config.read_only_tools = server.read_only_tools;
         mcp_client_->addServer(mcp_config);
     }
 
@@ -690,12 +745,33 @@ CRITICAL: When the user asks you to do something that requires a tool, you MUST
 
 ## Core Tools
 
-**Bash** - Execute shell commands
+**Bash** - Execute shell commands (one shell for the session: cd and exports persist)
   - command: The shell command to run
   - description: What the command does
+  - timeout: Seconds before the command is killed (optional)
+  - run_in_background: "true" to start a long build/test/download as a job and return at once
+
+**JobStatus** - List background jobs, or show one
+  - id: Job id (optional)
+
+**JobOutput** - Output of a background job since the last JobOutput call
+  - id: Job id
+  - tail: Show only the last N lines instead (optional)
 
-**Read** - Read file contents
+**JobKill** - Stop a background job
+  - id: Job id
+
+**Read** - Read file contents (large files are returned in parts)
   - file_path: Path to file
+  - offset: First line to read, 1-based; negative reads the last N lines (optional)
+  - limit: Number of lines (optional, default 2000)
+  - byte_offset, byte_limit: Read a byte range instead (optional)
+
+**ReadMany** - Read several files in one call (prefer this over repeated Read when exploring)
+  - paths: Files separated by spaces or commas; "file:10-40" reads lines 10-40, globs allowed
+  - pattern: Glob selecting files instead, e.g. "src/**/*.h" (optional, with path as its root)
+  - max_bytes: Total size budget shared by all files (optional, default 256 KB)
+  - max_files: Maximum number of files (optional, default 50)
 
 **Write** - Write/create files
   - file_path: Path to file
@@ -703,17 +779,25 @@ CRITICAL: When the user asks you to do something that requires a tool, you MUST
 
 **Edit** - Edit existing files
   - file_path: Path to file
-  - old_string: Text to replace
+  - old_string: Text to replace (must match exactly once)
   - new_string: Replacement text
+  - replace_all: "true" to replace every occurrence (optional)
 
-**Glob** - Find files by pattern
-  - pattern: File pattern (e.g., "*.py")
+**ApplyPatch** - Apply a unified diff to one or more files in one step (all hunks or nothing)
+  - patch: The diff, with ---/+++ headers per file and @@ hunks; /dev/null creates or deletes
+  - check: "true" to only test whether it applies (optional)
+
+**Glob** - Find files by pattern (respects .gitignore)
+  - pattern: File pattern, e.g. "*.py", "src/**/*.{h,cpp}"
   - path: Directory to search (optional)
 
-**Grep** - Search in files (uses ripgrep if available)
-  - pattern: Text to find
+**Grep** - Search in files (regex, respects .gitignore, skips binary files)
+  - pattern: Text or regex to find
   - path: Where to search (optional)
-  - output_mode: "content" or "files_with_matches" (optional)
+  - output_mode: "content", "files_with_matches" or "count" (optional)
+  - glob: Only search matching file names, e.g. "*.cpp" (optional)
+  - ignore_case: true for case-insensitive search (optional)
+  - context: Lines of context around matches in content mode (optional)
 
 ## Package Manager Tools
 
@@ -753,45 +837,61 @@ CRITICAL: When the user asks you to do something that requires a tool, you MUST
 ## File Operation Tools
 
 **Cp** - Copy files/directories
-  - source: Source path
-  - destination: Destination path
+  - source: Source path(s), space separated; globs allowed
+  - destination: Destination path (must be a directory for several sources)
   - recursive: true/false for directories
+  - dry_run: true to report what would be copied
 
 **Mv** - Move/rename files
-  - source: Source path
+  - source: Source path(s), space separated; globs allowed
   - destination: Destination path
+  - dry_run: true to report what would be moved
 
 **Rm** - Remove files/directories
-  - path: Path to remove
+  - path: Path(s) to remove, space separated; globs allowed
   - recursive: true/false for directories
+  - force: true to ignore missing paths
+  - dry_run: true to list what would be removed
 
 **Mkdir** - Create directories
-  - path: Directory path
-  - parents: true/false to create parent dirs
+  - path: Directory path(s), space separated
+  - parents: true/false to create parent dirs (default true)
+  - dry_run: true to report what would be created
 
 **Chmod** - Change file permissions
-  - path: File path
-  - mode: Permission mode (e.g., "755", "+x")
+  - path: File path(s), space separated; globs allowed
+  - mode: Octal or symbolic mode (e.g., "755", "+x", "u+rw,go-w", "a=rX")
+  - recursive: true/false to apply to directory contents
+  - dry_run: true to report the changes only
 
 **Chown** - Change file ownership
-  - path: File path
-  - owner: Owner name
+  - path: File path(s), space separated; globs allowed
+  - owner: Owner name or "owner:group"
   - group: Group name (optional)
+  - recursive: true/false to apply to directory contents
+  - dry_run: true to report the changes only
 
 **Tar** - Archive files
   - action: create, extract, list
   - archive: Archive file path
-  - files: Files to archive
-  - compression: gzip, bzip2, xz, none
+  - files: Files to archive, space separated; globs allowed
+  - destination: Extract destination (default: current directory)
+  - compression: gzip, bzip2, xz, none (default: from the archive name)
+  - level: Compression level 1-9 (optional)
 
 **Zip** / **Unzip** - ZIP archives
   - archive: Archive path
-  - files: Files to add/extract
+  - files: Files to add, space separated; globs allowed
   - destination: Extract destination
+  - list: true to list the contents only
+  - level: Compression level 1-9 (optional)
 
 **Gzip** - Gzip compression
   - action: compress, decompress
-  - file: File to process
+  - file: File(s) to process, space separated; globs allowed
+  - keep: true to keep the original
+  - force: true to overwrite an existing output file
+  - level: Compression level 1-9 (optional)
 
 **Rsync** - Sync files/directories
   - source: Source path
@@ -814,7 +914,7 @@ CRITICAL: When the user asks you to do something that requires a tool, you MUST
 ## Network Tools (use /net agent for full network suite)
 
 **Ping** - Test connectivity
-  - host: Hostname or IP
+  - host: Hostnames or IPs, comma separated (CIDR like 10.0.0.0/24 works)
   - count: Number of pings
 
 **Curl** - HTTP requests
@@ -917,6 +1017,9 @@ void CLI::processResponse(const std::string& response, int iteration) {
 
     // Extract and display response text
     std::string responseText = parser_->extractResponseText(response);
+    if (session_manager_) {
+        session_manager_->addAssistantMessage(response);
+    }
     if (!responseText.empty()) {
         std::cout << utils::terminal::GREEN << responseText << utils::terminal::RESET << "\n\n";
     }
@@ -955,6 +1058,7 @@ void CLI::processResponse(const std::string& response, int iteration) {
               << utils::terminal::RESET << "\n\n";
 
     auto results = executor_->executeAll(toolCalls);
+    recordToolResults(toolCalls, results);
 
     // Build results summary for next AI iteration
     std::ostringstream resultsSummary;
@@ -1002,6 +1106,9 @@ void CLI::processResponseWithMessages(json& messages, const std::string& respons
 
     // Extract and display response text
     std::string responseText = parser_->extractResponseText(response);
+    if (session_manager_) {
+        session_manager_->addAssistantMessage(response);
+    }
     if (!responseText.empty()) {
         std::cout << utils::terminal::GREEN << responseText << utils::terminal::RESET << "\n\n";
     }
@@ -1109,6 +1216,7 @@ void CLI::processResponseWithMessages(json& messages, const std::string& respons
               << utils::terminal::RESET << "\n\n";
 
     auto results = executor_->executeAll(toolsToExecute);
+    recordToolResults(toolsToExecute, results);
 
     // Build results summary for next AI iteration
     std::ostringstream resultsSummary;
@@ -1168,6 +1276,9 @@ void CLI::singlePromptMode(const std::string& prompt) {
     }
 
     auto start = std::chrono::steady_clock::now();
+    if (session_manager_) {
+        session_manager_->addUserMessage(trimmedPrompt);
+    }
 
     json messages = buildMessages(trimmedPrompt);
 
@@ -1252,6 +1363,119 @@ void CLI::handleCommand(const std::string& input) {
     } else if (cmd == "auto off") {
         config_->setAutoApprove(false);
         utils::terminal::printSuccess("Auto-approve disabled");
+    } else if (cmd == "parallel on") {
+        config_->setParallelTools(true);
+        utils::terminal::printSuccess("Parallel tool execution enabled");
+    } else if (cmd == "parallel off") {
+        config_->setParallelTools(false);
+        utils::terminal::printSuccess("Parallel tool execution disabled");
+    } else if (utils::startsWith(cmd, "parallel ")) {
+        int workers = std::atoi(cmd.substr(9).c_str());
+        if (workers < 1) {
+            utils::terminal::printError("Usage: /parallel [on|off|N]");
+        } else {
+            config_->setMaxParallelTools(workers);
+            utils::terminal::printSuccess("Parallel tool workers set to: " + std::to_string(workers));
+        }
+    } else if (cmd == "shell on") {
+        config_->setPersistentShell(true);
+        utils::terminal::printSuccess("Bash commands share one persistent shell");
+    } else if (cmd == "shell off") {
+        config_->setPersistentShell(false);
+        executor_->resetShell();
+        utils::terminal::printSuccess("Bash commands run in a fresh shell each time");
+    } else if (cmd == "shell restart") {
+        executor_->resetShell();
+        utils::terminal::printSuccess("Shell restarted");
+    } else if (cmd == "undo" || cmd == "undo force") {
+        std::string message;
+        if (executor_->undoStore().undoLast(message, cmd == "undo force")) {
+            executor_->resultCache().clear();
+            utils::terminal::printSuccess(message);
+        } else {
+            utils::terminal::printError(message);
+        }
+    } else if (cmd == "undo list") {
+        auto entries = executor_->undoStore().list();
+        if (entries.empty()) {
+            std::cout << "Nothing to undo\n";
+        }
+        for (const auto& entry : entries) {
+            char when[16];
+            std::strftime(when, sizeof(when), "%H:%M:%S", std::localtime(&entry.time));
+            std::cout << "  " << when << "  " << entry.tool << "  " << entry.path
+                      << (entry.existed ? " (" + utils::formatSize(entry.content_size) + " before)" : " (new file)") << "\n";
+        }
+    } else if (cmd == "cache") {
+        FileCacheStats stats = executor_->fileCache().stats();
+        std::cout << "File cache: " << stats.entries << " files, " << utils::formatSize(stats.bytes)
+                  << " of " << config_->getFileCacheMb() << " MB\n"
+                  << "  " << stats.hits << " hits, " << stats.misses << " misses, "
+                  << stats.invalidations << " dropped after changes\n";
+        ResultCacheStats results = executor_->resultCache().stats();
+        std::cout << "Tool results: " << results.entries << " cached (Glob, Grep, DBSchema, WebFetch, WebSearch)\n"
+                  << "  " << results.hits << " hits, " << results.misses << " misses, "
+                  << results.invalidations << " dropped after writes\n";
+    } else if (cmd == "cache clear") {
+        executor_->fileCache().clear();
+        executor_->resultCache().clear();
+        utils::terminal::printSuccess("Caches cleared");
+    } else if (cmd == "ssh") {
+        auto masters = executor_->sshMultiplexer().list();
+        if (masters.empty()) {
+            std::cout << "No open SSH master connections\n";
+        }
+        for (const auto& master : masters) {
+            std::cout << "  " << master.target << "  " << master.socket << "\n";
+        }
+        int idle = config_->getSshMasterIdle();
+        std::cout << (idle > 0 ? "Idle masters close after " + std::to_string(idle) + "s\n"
+                               : "Connection sharing is off\n");
+    } else if (cmd == "ssh close" || utils::startsWith(cmd, "ssh close ")) {
+        std::string target = cmd == "ssh close" ? "" : utils::trim(cmd.substr(10));
+        int closed = executor_->sshMultiplexer().close(target);
+        utils::terminal::printSuccess("Closed " + std::to_string(closed) + " SSH master connection(s)");
+    } else if (utils::startsWith(cmd, "ssh idle ")) {
+        int seconds = std::atoi(cmd.substr(9).c_str());
+        config_->setSshMasterIdle(std::max(0, seconds));
+        utils::terminal::printSuccess(seconds > 0 ? "New SSH masters close after " + std::to_string(seconds) + "s idle"
+                                                  : "SSH connection sharing disabled");
+    } else if (cmd == "tools stats" || cmd == "tools stats all") {
+        printToolStats(cmd == "tools stats all");
+    } else if (utils::startsWith(cmd, "sessions search ")) {
+        printSearchResults(utils::trim(cmd.substr(16)));
+    } else if (cmd == "sessions retention" || utils::startsWith(cmd, "sessions retention ")) {
+        std::istringstream args(cmd.substr(18));
+        int days = 0;
+        int sessions = 0;
+        int mb = 0;
+        if (cmd == "sessions retention") {
+            std::cout << "Sessions are " << (describeRetention() == "never" ? "never archived" : "archived " + describeRetention())
+                      << "\n";
+        } else if (!(args >> days >> sessions >> mb) || days < 0 || sessions < 0 || mb < 0) {
+            utils::terminal::printError("Usage: /sessions retention DAYS SESSIONS MB (0 = no limit)");
+        } else {
+            config_->setSessionRetention(days, sessions, mb);
+            utils::terminal::printSuccess(describeRetention() == "never" ? "From the next start, sessions are not archived"
+                                          : "From the next start, sessions are archived " + describeRetention());
+        }
+    } else if (cmd == "sessions" || cmd == "sessions more") {
+        if (cmd == "sessions more" && sessions_cursor_.empty()) {
+            std::cout << "No more sessions\n";
+        } else {
+            printSessionPage(cmd == "sessions more" ? sessions_cursor_ : "");
+        }
+    } else if (cmd == "resume" || utils::startsWith(cmd, "resume ")) {
+        std::string target = cmd == "resume" ? "" : utils::trim(cmd.substr(7));
+        // A number picks from the last /sessions search
+        size_t result = static_cast<size_t>(std::atoi(target.c_str()));
+        if (result > 0 && result <= search_results_.size() &&
+            target.find_first_not_of("0123456789") == std::string::npos) {
+            target = search_results_[result - 1];
+        }
+        resumeSession(target);
+    } else if (cmd == "history" || utils::startsWith(cmd, "history ")) {
+        handleHistoryCommand(cmd);
     } else if (utils::startsWith(cmd, "mcp")) {
         handleMCPCommand(cmd);
     } else if (utils::startsWith(cmd, "agent") || cmd == "explore" || cmd == "code" ||
@@ -1558,6 +1782,278 @@ void CLI::handleLicenseCommand(const std::string& cmd) {
     }
 }
 
+static std::string formatMs(long ms) {
+    if (ms < 1000) return std::to_string(ms) + "ms";
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(ms < 10000 ? 2 : 1) << ms / 1000.0 << "s";
+    return out.str();
+}
+
+void CLI::recordToolResults(const std::vector<ToolCall>& calls, const std::vector<ToolResult>& results) {
+    if (!session_manager_) return;
+
+    for (size_t i = 0; i < calls.size() && i < results.size(); i++) {
+        const ToolResult& result = results[i];
+        session_manager_->recordToolExecution(calls[i].name, json(calls[i].parameters),
+                                              result.success ? result.output : result.error + "\n" + result.output,
+                                              result.exit_code);
+
+        ToolSpan span;
+        span.tool_name = calls[i].name;
+        span.parameters = json(calls[i].parameters).dump();
+        if (span.parameters.size() > 300) {
+            span.parameters = span.parameters.substr(0, 300) + "...";
+        }
+        span.wall_ms = result.wall_ms;
+        span.cpu_seconds = result.cpu_seconds;
+        span.thread_cpu_seconds = result.thread_cpu_seconds;
+        span.max_rss_kb = result.max_rss_kb;
+        span.output_bytes = result.output_bytes;
+        span.truncated_bytes = result.truncated_bytes;
+        span.cache_hit = result.cache_hit;
+        span.success = result.success;
+        span.exit_code = result.exit_code;
+        session_manager_->recordToolSpan(span);
+    }
+}
+
+void CLI::printToolStats(bool all_sessions) {
+    if (!session_manager_) {
+        utils::terminal::printError("Session database is not available");
+        return;
+    }
+
+    auto stats = session_manager_->getToolStats(all_sessions);
+    if (stats.empty()) {
+        std::cout << "No tool calls recorded" << (all_sessions ? "" : " in this session") << "\n";
+        return;
+    }
+
+    std::cout << utils::terminal::BOLD << "Tool stats (" << (all_sessions ? "all sessions" : "this session")
+              << ", slowest total first)" << utils::terminal::RESET << "\n";
+    std::cout << "  " << std::left << std::setw(14) << "Tool" << std::right
+              << std::setw(7) << "Calls" << std::setw(6) << "Fail" << std::setw(7) << "Cached"
+              << std::setw(9) << "p50" << std::setw(9) << "p95" << std::setw(9) << "Max"
+              << std::setw(9) << "Total" << std::setw(9) << "CPU" << std::setw(9) << "RSS"
+              << std::setw(9) << "Output" << std::setw(9) << "Cut" << "\n";
+    for (const auto& tool : stats) {
+        std::cout << "  " << std::left << std::setw(14) << tool.tool_name << std::right
+                  << std::setw(7) << tool.calls << std::setw(6) << tool.failures << std::setw(7) << tool.cache_hits
+                  << std::setw(9) << formatMs(tool.p50_ms) << std::setw(9) << formatMs(tool.p95_ms)
+                  << std::setw(9) << formatMs(tool.max_ms) << std::setw(9) << formatMs(tool.total_ms)
+                  << std::setw(9) << formatMs(static_cast<long>(tool.cpu_seconds * 1000))
+                  << std::setw(9) << utils::formatSize(static_cast<unsigned long long>(tool.max_rss_kb) * 1024)
+                  << std::setw(9) << utils::formatSize(tool.output_bytes)
+                  << std::setw(9) << utils::formatSize(tool.truncated_bytes) << "\n";
+    }
+
+    auto slowest = session_manager_->getSlowestToolSpans(5, all_sessions);
+    if (!slowest.empty()) {
+        std::cout << "\n" << utils::terminal::BOLD << "Slowest calls" << utils::terminal::RESET << "\n";
+        for (const auto& span : slowest) {
+            std::string params = span.parameters.size() > 80 ? span.parameters.substr(0, 77) + "..." : span.parameters;
+            std::cout << "  " << std::setw(8) << formatMs(span.wall_ms) << "  " << span.tool_name << " " << params
+                      << (span.success ? "" : " (failed)") << "\n";
+        }
+    }
+}
+
+// First line of text, cut to width, for one-line listings
+static std::string firstLine(const std::string& text, size_t width) {
+    std::string line = text.substr(0, text.find('\n'));
+    return line.size() > width ? line.substr(0, width - 3) + "..." : line;
+}
+
+static const int SESSION_PAGE = 20;
+
+// "after 90 days idle, or beyond 1024 MB in total"
+std::string CLI::describeRetention() const {
+    std::vector<std::string> limits;
+    if (config_->getSessionRetentionDays() > 0) {
+        limits.push_back("after " + std::to_string(config_->getSessionRetentionDays()) + " days idle");
+    }
+    if (config_->getSessionRetentionMaxSessions() > 0) {
+        limits.push_back("beyond the newest " + std::to_string(config_->getSessionRetentionMaxSessions()));
+    }
+    if (config_->getSessionRetentionMaxMb() > 0) {
+        limits.push_back("beyond " + std::to_string(config_->getSessionRetentionMaxMb()) + " MB in total");
+    }
+    if (limits.empty()) return "never";
+
+    std::string text = limits[0];
+    for (size_t i = 1; i < limits.size(); i++) text += ", or " + limits[i];
+    return text;
+}
+
+void CLI::printSessionPage(const std::string& after_id) {
+    if (!session_manager_) {
+        utils::terminal::printError("Session database is not available");
+        return;
+    }
+
+    auto page = session_manager_->listSessionPage(SESSION_PAGE, after_id);
+    if (page.empty()) {
+        std::cout << (after_id.empty() ? "No sessions recorded\n" : "No more sessions\n");
+        sessions_cursor_.clear();
+        return;
+    }
+
+    std::cout << utils::terminal::BOLD << "Sessions (most recent first)" << utils::terminal::RESET << "\n";
+    std::cout << "  " << std::left << std::setw(30) << "Session" << std::setw(21) << "Last activity"
+              << std::right << std::setw(7) << "Msgs" << std::setw(7) << "Tools" << std::setw(8) << "Size"
+              << "  Summary\n";
+    for (const auto& session : page) {
+        std::string summary = session.summary.empty() ? session.working_directory : session.summary;
+        std::cout << "  " << std::left << std::setw(30) << session.session_id << std::setw(21) << session.updated_at
+                  << std::right << std::setw(7) << session.message_count << std::setw(7) << session.tool_count
+                  << std::setw(8) << utils::formatSize(session.size_bytes) << "  " << firstLine(summary, 40) << "\n";
+    }
+
+    sessions_cursor_ = static_cast<int>(page.size()) == SESSION_PAGE ? page.back().session_id : "";
+    if (!sessions_cursor_.empty()) {
+        std::cout << utils::terminal::YELLOW << "More: /sessions more, or casper --list-sessions "
+                  << sessions_cursor_ << utils::terminal::RESET << "\n";
+    }
+}
+
+void CLI::printSearchResults(const std::string& query) {
+    if (!session_manager_) {
+        utils::terminal::printError("Session database is not available");
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto hits = session_manager_->searchSessions(query, 50, std::string(utils::terminal::BOLD) + utils::terminal::YELLOW,
+                                                 utils::terminal::RESET);
+    long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (hits.empty()) {
+        std::cout << "No sessions match \"" << query << "\"\n";
+        return;
+    }
+
+    // Sessions in order of their best match, with a few matches each
+    search_results_.clear();
+    std::vector<std::vector<const SearchHit*>> grouped;
+    for (const auto& hit : hits) {
+        auto it = std::find(search_results_.begin(), search_results_.end(), hit.session_id);
+        if (it == search_results_.end()) {
+            if (search_results_.size() == 10) continue;
+            search_results_.push_back(hit.session_id);
+            grouped.emplace_back();
+            it = search_results_.end() - 1;
+        }
+        auto& matches = grouped[it - search_results_.begin()];
+        if (matches.size() < 3) matches.push_back(&hit);
+    }
+
+    for (size_t i = 0; i < search_results_.size(); i++) {
+        std::cout << utils::terminal::BOLD << "[" << i + 1 << "] " << search_results_[i] << utils::terminal::RESET
+                  << "  (last active " << grouped[i].front()->updated_at << ")\n";
+        for (const SearchHit* hit : grouped[i]) {
+            std::string snippet = hit->snippet;
+            std::replace(snippet.begin(), snippet.end(), '\n', ' ');
+            std::cout << "    " << utils::terminal::CYAN << hit->source << utils::terminal::RESET << ": " << snippet << "\n";
+        }
+    }
+    std::cout << utils::terminal::YELLOW << "Resume one with /resume N" << utils::terminal::RESET
+              << " (" << elapsed << " ms)\n";
+}
+
+bool CLI::resumeSession(const std::string& session_id) {
+    if (!session_manager_) {
+        utils::terminal::printError("Session database is not available");
+        return false;
+    }
+
+    const Session* current = session_manager_->getCurrentSession();
+    std::string id = session_id;
+    if (id.empty()) {
+        // The most recent session other than this one
+        for (const auto& session : session_manager_->listSessionPage(2)) {
+            if (!current || session.session_id != current->session_id) {
+                id = session.session_id;
+                break;
+            }
+        }
+    }
+    if (current && id == current->session_id) {
+        std::cout << "Already in session " << id << "\n";
+        return true;
+    }
+    if (!id.empty() && session_manager_->isArchived(id)) {
+        std::cout << "Restoring " << id << " from the archive...\n";
+    }
+    if (id.empty() || !session_manager_->loadSession(id)) {
+        utils::terminal::printError(id.empty() ? "No earlier session to resume" : "No session " + id);
+        return false;
+    }
+
+    const Session* session = session_manager_->getCurrentSession();
+    utils::terminal::printSuccess("Resumed " + session->session_id + " (" +
+                                  std::to_string(session_manager_->getMessageCount()) + " messages, " +
+                                  std::to_string(session->tool_executions.size()) + " tool calls)");
+    size_t shown = std::min<size_t>(session->messages.size(), 6);
+    for (size_t i = session->messages.size() - shown; i < session->messages.size(); i++) {
+        const Message& msg = session->messages[i];
+        std::cout << "  " << utils::terminal::CYAN << msg.role << utils::terminal::RESET << ": "
+                  << firstLine(msg.content, 100) << "\n";
+    }
+    if (session_manager_->olderMessageCount() > 0 || session->messages.size() > shown) {
+        std::cout << utils::terminal::YELLOW << "Earlier messages: /history older" << utils::terminal::RESET << "\n";
+    }
+    return true;
+}
+
+void CLI::handleHistoryCommand(const std::string& cmd) {
+    const Session* session = session_manager_ ? session_manager_->getCurrentSession() : nullptr;
+    if (!session) {
+        utils::terminal::printError("No session is being recorded");
+        return;
+    }
+
+    if (cmd == "history" || cmd == "history older") {
+        size_t shown = session->messages.size();
+        if (cmd == "history older") {
+            shown = session_manager_->loadOlderMessages();
+            if (shown == 0) {
+                std::cout << "No earlier messages\n";
+                return;
+            }
+        }
+        // A loaded page comes in at the front
+        for (size_t i = 0; i < shown; i++) {
+            const Message& msg = session->messages[i];
+            std::cout << utils::terminal::CYAN << "[" << msg.timestamp << "] " << msg.role << utils::terminal::RESET
+                      << ": " << firstLine(msg.content, 120) << "\n";
+        }
+        size_t older = session_manager_->olderMessageCount();
+        if (older > 0) {
+            std::cout << utils::terminal::YELLOW << older << " earlier message(s): /history older"
+                      << utils::terminal::RESET << "\n";
+        }
+    } else if (cmd == "history tools") {
+        if (session->tool_executions.empty()) {
+            std::cout << "No tool calls in this session\n";
+        }
+        for (size_t i = 0; i < session->tool_executions.size(); i++) {
+            const ToolExecution& te = session->tool_executions[i];
+            std::cout << "  " << std::setw(4) << i + 1 << "  [" << te.timestamp << "] " << te.tool_name << " "
+                      << firstLine(te.parameters.dump(), 70) << (te.exit_code != 0 ? " (failed)" : "") << "\n";
+        }
+    } else if (utils::startsWith(cmd, "history output ")) {
+        size_t index = static_cast<size_t>(std::atoi(cmd.substr(15).c_str()));
+        if (index == 0 || index > session->tool_executions.size()) {
+            utils::terminal::printError("No tool call " + utils::trim(cmd.substr(15)) + "; see /history tools");
+            return;
+        }
+        const ToolExecution& te = session->tool_executions[index - 1];
+        std::cout << utils::terminal::BOLD << te.tool_name << " " << te.parameters.dump() << utils::terminal::RESET << "\n"
+                  << session_manager_->getToolOutput(te) << "\n";
+    } else {
+        utils::terminal::printError("Usage: /history [older|tools|output N]");
+    }
+}
+
 bool CLI::confirmToolExecution(const std::string& tool_name, const std::string& description) {
     return true; // Handled in tool_executor already
 }
@@ -1644,6 +2140,7 @@ void CLI::interactiveMode() {
         if (input.empty()) continue;
 
         if (input == "/exit" || input == "/quit") {
+            if (session_manager_) session_manager_->flush();
             std::cout << utils::terminal::GREEN << "👋 Goodbye!" << utils::terminal::RESET << "\n";
             break;
         }
@@ -1656,6 +2153,9 @@ void CLI::interactiveMode() {
 
         // Process as AI prompt
         std::cout << "\n";
+        if (session_manager_) {
+            session_manager_->addUserMessage(input);
+        }
 
         // Use agent selection flow if enabled, otherwise direct execution
         if (agentModeEnabled_) {
@@ -1690,6 +2190,15 @@ void CLI::interactiveMode() {
 }
 
 int CLI::run() {
+    if (list_sessions_) {
+        if (!session_manager_) {
+            utils::terminal::printError("Session database is not available");
+            return 1;
+        }
+        printSessionPage(list_after_);
+        return 0;
+    }
+
     // Test Ollama connection
     if (!client_->testConnection()) {
         utils::terminal::printError("Failed to connect to Ollama at " + config_->getOllamaHost());
@@ -1700,6 +2209,12 @@ int CLI::run() {
     // Initialize MCP if enabled
     initializeMCP();
 
+    if (session_manager_ && (!resume_session_ || !resumeSession(resume_session_id_))) {
+        char cwd[4096];
+        std::string working_dir = getcwd(cwd, sizeof(cwd)) ? cwd : "";
+        session_manager_->createSession(model_override_.empty() ? config_->getModel() : model_override_, working_dir);
+    }
+
     // Single prompt mode or interactive mode
     if (!direct_prompt_.empty()) {
         singlePromptMode(direct_prompt_);
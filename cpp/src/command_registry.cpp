@@ -0,0 +1,155 @@
+#include "command_registry.h"
+#include "utils.h"
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace casper {
+
+namespace {
+
+std::string currentPath() {
+    const char* path = getenv("PATH");
+    return path ? path : "/usr/local/bin:/usr/bin:/bin";
+}
+
+bool isExecutable(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+struct timespec modificationTime(const struct stat& st) {
+#ifdef __APPLE__
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+}
+
+} // anonymous namespace
+
+CommandRegistry& CommandRegistry::instance() {
+    static CommandRegistry registry;
+    return registry;
+}
+
+CommandRegistry::CommandRegistry()
+    : scanning_(false)
+    , valid_(false)
+{
+}
+
+CommandRegistry::~CommandRegistry() {
+    if (warm_thread_.joinable()) warm_thread_.join();
+}
+
+void CommandRegistry::warmUp() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (valid_ || scanning_ || warm_thread_.joinable()) return;
+    scanning_ = true;
+    warm_thread_ = std::thread([this]() {
+        std::unique_lock<std::mutex> scan_lock(mutex_);
+        scan(scan_lock);
+    });
+}
+
+std::string CommandRegistry::find(const std::string& name) {
+    if (name.empty()) return "";
+    if (name.find('/') != std::string::npos) return isExecutable(name) ? name : "";
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitForScan(lock);
+    bool rescanned = false;
+    if (!valid_ || path_ != currentPath()) {
+        rescan(lock);
+        rescanned = true;
+    }
+
+    for (;;) {
+        auto it = commands_.find(name);
+        if (it != commands_.end()) {
+            std::string full = it->second + "/" + name;
+            if (isExecutable(full)) return full;
+            // Shadowed by a file that is not executable; look further down PATH
+            for (const auto& dir : directories_) {
+                full = dir.path + "/" + name;
+                if (isExecutable(full)) return full;
+            }
+        }
+        // Something may have been installed or removed since the scan
+        if (rescanned || !directoriesChanged()) return "";
+        rescan(lock);
+        rescanned = true;
+    }
+}
+
+void CommandRegistry::invalidate() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitForScan(lock);
+    valid_ = false;
+}
+
+void CommandRegistry::scan(std::unique_lock<std::mutex>& lock) {
+    std::string path = currentPath();
+    lock.unlock();
+
+    std::vector<Directory> directories;
+    std::unordered_map<std::string, std::string> commands;
+    for (const auto& dir : utils::split(path, ':')) {
+        // The shell reads an empty entry as the current directory; that is not worth trusting here
+        if (dir.empty()) continue;
+        Directory entry;
+        entry.path = dir;
+        struct stat st;
+        entry.present = stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        entry.mtime = entry.present ? modificationTime(st) : timespec{0, 0};
+        directories.push_back(entry);
+        if (!entry.present) continue;
+
+        DIR* handle = opendir(dir.c_str());
+        if (!handle) continue;
+        while (struct dirent* found = readdir(handle)) {
+            std::string name = found->d_name;
+            if (name == "." || name == "..") continue;
+            commands.emplace(name, dir);            // The first directory on PATH wins
+        }
+        closedir(handle);
+    }
+
+    lock.lock();
+    path_ = path;
+    directories_ = std::move(directories);
+    commands_ = std::move(commands);
+    valid_ = true;
+    scanning_ = false;
+    scanned_cv_.notify_all();
+}
+
+void CommandRegistry::rescan(std::unique_lock<std::mutex>& lock) {
+    // Another caller may have started one while the lock was free
+    if (scanning_) {
+        waitForScan(lock);
+        return;
+    }
+    scanning_ = true;
+    scan(lock);
+}
+
+void CommandRegistry::waitForScan(std::unique_lock<std::mutex>& lock) {
+    scanned_cv_.wait(lock, [this]() { return !scanning_; });
+}
+
+bool CommandRegistry::directoriesChanged() const {
+    for (const auto& dir : directories_) {
+        struct stat st;
+        bool present = stat(dir.path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        if (present != dir.present) return true;
+        if (!present) continue;
+        struct timespec mtime = modificationTime(st);
+        if (mtime.tv_sec != dir.mtime.tv_sec || mtime.tv_nsec != dir.mtime.tv_nsec) return true;
+    }
+    return false;
+}
+
+} // namespace casper
@@ -41,6 +41,19 @@ Config::Config()
     // License settings
     , license_server_url_("http://10.19.0.128:5000")
     , license_key_("")
+    // Tool execution settings
+    , parallel_tools_(true)
+    , max_parallel_tools_(4)
+    , command_timeout_(600)
+    , persistent_shell_(true)
+    , edit_backup_("undo")
+    , fsync_writes_(false)
+    , file_cache_mb_(64)
+    , ssh_master_idle_(600)
+    , session_durability_("normal")
+    , session_retention_days_(90)
+    , session_retention_max_sessions_(0)
+    , session_retention_max_mb_(1024)
 {
     // Default allowed commands
     allowed_commands_ = {
@@ -208,6 +221,19 @@ bool Config::load() {
         // License settings
         else if (key == "license_server_url") license_server_url_ = value;
         else if (key == "license_key") license_key_ = value;
+        // Tool execution settings
+        else if (key == "parallel_tools") parallel_tools_ = (value == "true" || value == "1");
+        else if (key == "max_parallel_tools") max_parallel_tools_ = std::stoi(value);
+        else if (key == "command_timeout") command_timeout_ = std::stoi(value);
+        else if (key == "persistent_shell") persistent_shell_ = (value == "true" || value == "1");
+        else if (key == "edit_backup") edit_backup_ = value;
+        else if (key == "fsync_writes") fsync_writes_ = (value == "true" || value == "1");
+        else if (key == "file_cache_mb") file_cache_mb_ = std::stoi(value);
+        else if (key == "ssh_master_idle") ssh_master_idle_ = std::stoi(value);
+        else if (key == "session_durability") session_durability_ = value;
+        else if (key == "session_retention_days") session_retention_days_ = std::stoi(value);
+        else if (key == "session_retention_max_sessions") session_retention_max_sessions_ = std::stoi(value);
+        else if (key == "session_retention_max_mb") session_retention_max_mb_ = std::stoi(value);
     }
 
     sqlite3_finalize(stmt);
@@ -272,6 +298,20 @@ bool Config::save() {
     saveValue("license_server_url", license_server_url_);
     saveValue("license_key", license_key_);
 
+    // Tool execution settings
+    saveValue("parallel_tools", parallel_tools_ ? "true" : "false");
+    saveValue("max_parallel_tools", std::to_string(max_parallel_tools_));
+    saveValue("command_timeout", std::to_string(command_timeout_));
+    saveValue("persistent_shell", persistent_shell_ ? "true" : "false");
+    saveValue("edit_backup", edit_backup_);
+    saveValue("fsync_writes", fsync_writes_ ? "true" : "false");
+    saveValue("file_cache_mb", std::to_string(file_cache_mb_));
+    saveValue("ssh_master_idle", std::to_string(ssh_master_idle_));
+    saveValue("session_durability", session_durability_);
+    saveValue("session_retention_days", std::to_string(session_retention_days_));
+    saveValue("session_retention_max_sessions", std::to_string(session_retention_max_sessions_));
+    saveValue("session_retention_max_mb", std::to_string(session_retention_max_mb_));
+
     return true;
 }
 
@@ -442,6 +482,59 @@ void Config::setLicenseKey(const std::string& key) {
     save();
 }
 
+// Tool execution setters
+void Config::setParallelTools(bool enabled) {
+    parallel_tools_ = enabled;
+    save();
+}
+
+void Config::setMaxParallelTools(int count) {
+    max_parallel_tools_ = count;
+    save();
+}
+
+void Config::setCommandTimeout(int seconds) {
+    command_timeout_ = seconds;
+    save();
+}
+
+void Config::setPersistentShell(bool enabled) {
+    persistent_shell_ = enabled;
+    save();
+}
+
+void Config::setEditBackup(const std::string& mode) {
+    edit_backup_ = mode;
+    save();
+}
+
+void Config::setFsyncWrites(bool enabled) {
+    fsync_writes_ = enabled;
+    save();
+}
+
+void Config::setFileCacheMb(int mb) {
+    file_cache_mb_ = mb;
+    save();
+}
+
+void Config::setSshMasterIdle(int seconds) {
+    ssh_master_idle_ = seconds;
+    save();
+}
+
+void Config::setSessionDurability(const std::string& mode) {
+    session_durability_ = mode;
+    save();
+}
+
+void Config::setSessionRetention(int days, int max_sessions, int max_mb) {
+    session_retention_days_ = days;
+    session_retention_max_sessions_ = max_sessions;
+    session_retention_max_mb_ = max_mb;
+    save();
+}
+
 // MCP Server management
 std::vector<MCPServerConfig> Config::getMCPServers() const {
     return mcp_servers_;
@@ -520,6 +613,11 @@ void Config::loadMCPServers() {
                     sc.env = server["env"].get<std::map<std::string, std::string>>();
                 }
 
+                sc.read_only = server.value("readOnly", false);
+                if (server.contains("readOnlyTools") && server["readOnlyTools"].is_array()) {
+                    sc.read_only_tools = server["readOnlyTools"].get<std::vector<std::string>>();
+                }
+
                 mcp_servers_.push_back(sc);
             }
         }
@@ -542,6 +640,12 @@ void Config::saveMCPServers() {
         if (!sc.url.empty()) {
             server["url"] = sc.url;
         }
+        if (sc.read_only) {
+            server["readOnly"] = true;
+        }
+        if (!sc.read_only_tools.empty()) {
+            server["readOnlyTools"] = sc.read_only_tools;
+        }
         config["mcpServers"][sc.name] = server;
     }
 
@@ -0,0 +1,544 @@
+#include "dns_client.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0      // Not on macOS
+#endif
+
+namespace casper {
+
+using Clock = std::chrono::steady_clock;
+
+static const std::map<std::string, int> kTypes = {
+    {"A", 1}, {"NS", 2}, {"CNAME", 5}, {"SOA", 6}, {"PTR", 12}, {"MX", 15}, {"TXT", 16},
+    {"AAAA", 28}, {"SRV", 33}, {"NAPTR", 35}, {"DS", 43}, {"DNSKEY", 48}, {"CAA", 257}, {"ANY", 255},
+};
+
+static const char* kStatus[] = {"NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED"};
+
+namespace {
+
+double elapsedMs(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+std::string typeName(int code) {
+    for (const auto& type : kTypes) {
+        if (type.second == code) return type.first;
+    }
+    return "TYPE" + std::to_string(code);
+}
+
+bool parseServer(const std::string& spec, sockaddr_storage& addr, socklen_t& len) {
+    std::string host = spec;
+    int port = 53;
+    if (!host.empty() && host[0] == '[') {
+        size_t close = host.find(']');
+        if (close == std::string::npos) return false;
+        if (close + 2 < host.size() && host[close + 1] == ':') port = std::atoi(host.c_str() + close + 2);
+        host = host.substr(1, close - 1);
+    } else if (std::count(host.begin(), host.end(), ':') == 1) {
+        port = std::atoi(host.c_str() + host.find(':') + 1);
+        host = host.substr(0, host.find(':'));
+    }
+    if (port <= 0 || port > 65535) return false;
+
+    memset(&addr, 0, sizeof(addr));
+    sockaddr_in* v4 = reinterpret_cast<sockaddr_in*>(&addr);
+    sockaddr_in6* v6 = reinterpret_cast<sockaddr_in6*>(&addr);
+    if (inet_pton(AF_INET, host.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(static_cast<uint16_t>(port));
+        len = sizeof(sockaddr_in);
+        return true;
+    }
+    if (inet_pton(AF_INET6, host.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(static_cast<uint16_t>(port));
+        len = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+void put16(std::string& out, uint16_t value) {
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value & 0xff);
+}
+
+uint16_t get16(const unsigned char* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+uint32_t get32(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+bool buildQuery(uint16_t id, const std::string& name, int type, std::string& packet) {
+    packet.clear();
+    put16(packet, id);
+    put16(packet, 0x0100);      // Recursion desired
+    put16(packet, 1);           // One question
+    put16(packet, 0);
+    put16(packet, 0);
+    put16(packet, 1);           // EDNS0 OPT record below
+
+    size_t total = 0;
+    for (const auto& label : utils::split(name, '.')) {
+        if (label.empty()) continue;
+        if (label.size() > 63) return false;
+        packet += static_cast<char>(label.size());
+        packet += label;
+        total += label.size() + 1;
+    }
+    if (total > 253) return false;
+    packet += '\0';
+    put16(packet, static_cast<uint16_t>(type));
+    put16(packet, 1);           // IN
+
+    // OPT: accept UDP replies up to 1232 bytes before falling back to TCP
+    packet += '\0';
+    put16(packet, 41);
+    put16(packet, 1232);
+    put16(packet, 0);
+    put16(packet, 0);
+    put16(packet, 0);
+    return true;
+}
+
+// Name at pos, following compression pointers; pos moves past the name as stored
+bool readName(const unsigned char* msg, size_t len, size_t& pos, std::string& name) {
+    name.clear();
+    size_t cursor = pos;
+    bool jumped = false;
+    for (int hops = 0; hops < 128; hops++) {
+        if (cursor >= len) return false;
+        unsigned char size = msg[cursor];
+        if (size == 0) {
+            if (!jumped) pos = cursor + 1;
+            if (name.empty()) name = ".";
+            return true;
+        }
+        if ((size & 0xc0) == 0xc0) {
+            if (cursor + 1 >= len) return false;
+            if (!jumped) pos = cursor + 2;
+            jumped = true;
+            cursor = ((size & 0x3f) << 8) | msg[cursor + 1];
+            continue;
+        }
+        if (cursor + 1 + size > len) return false;
+        name.append(reinterpret_cast<const char*>(msg + cursor + 1), size);
+        name += '.';
+        cursor += 1 + size;
+    }
+    return false;
+}
+
+std::string rdataText(const unsigned char* msg, size_t len, size_t pos, size_t rdlen, int type) {
+    const unsigned char* rd = msg + pos;
+    std::string name;
+    std::ostringstream out;
+    size_t cursor = pos;
+
+    switch (type) {
+    case 1:
+    case 28: {
+        char text[INET6_ADDRSTRLEN];
+        if ((type == 1 && rdlen != 4) || (type == 28 && rdlen != 16)) break;
+        inet_ntop(type == 1 ? AF_INET : AF_INET6, rd, text, sizeof(text));
+        return text;
+    }
+    case 2:
+    case 5:
+    case 12:
+        if (readName(msg, len, cursor, name)) return name;
+        break;
+    case 15:
+        if (rdlen < 3) break;
+        cursor += 2;
+        if (readName(msg, len, cursor, name)) return std::to_string(get16(rd)) + " " + name;
+        break;
+    case 16: {
+        for (size_t i = 0; i < rdlen; ) {
+            size_t size = rd[i];
+            if (i + 1 + size > rdlen) break;
+            if (i > 0) out << ' ';
+            out << '"' << std::string(reinterpret_cast<const char*>(rd + i + 1), size) << '"';
+            i += 1 + size;
+        }
+        return out.str();
+    }
+    case 6: {
+        std::string rname;
+        if (!readName(msg, len, cursor, name) || !readName(msg, len, cursor, rname) || cursor + 20 > pos + rdlen) break;
+        out << name << " " << rname;
+        for (int i = 0; i < 5; i++) out << " " << get32(msg + cursor + i * 4);
+        return out.str();
+    }
+    case 33:
+        if (rdlen < 7) break;
+        cursor += 6;
+        if (readName(msg, len, cursor, name)) {
+            out << get16(rd) << " " << get16(rd + 2) << " " << get16(rd + 4) << " " << name;
+            return out.str();
+        }
+        break;
+    case 257:
+        if (rdlen < 2 || 2u + rd[1] > rdlen) break;
+        out << static_cast<int>(rd[0]) << " " << std::string(reinterpret_cast<const char*>(rd + 2), rd[1]) << " \""
+            << std::string(reinterpret_cast<const char*>(rd + 2 + rd[1]), rdlen - 2 - rd[1]) << '"';
+        return out.str();
+    }
+
+    // RFC 3597 form for anything else
+    out << "\\# " << rdlen;
+    char hex[3];
+    for (size_t i = 0; i < rdlen; i++) {
+        if (i % 32 == 0) out << ' ';
+        snprintf(hex, sizeof(hex), "%02x", rd[i]);
+        out << hex;
+    }
+    return out.str();
+}
+
+// 1 = answer parsed, 0 = not a reply to this query, -1 = malformed
+int parseReply(const unsigned char* msg, size_t len, uint16_t id, DnsAnswer& answer, bool& truncated) {
+    if (len < 12 || get16(msg) != id || !(msg[2] & 0x80)) return 0;
+    truncated = (msg[2] & 0x02) != 0;
+    int rcode = msg[3] & 0x0f;
+    answer.status = rcode < 6 ? kStatus[rcode] : "RCODE" + std::to_string(rcode);
+    answer.records.clear();
+
+    size_t pos = 12;
+    std::string name;
+    for (int i = 0; i < get16(msg + 4); i++) {
+        if (!readName(msg, len, pos, name) || pos + 4 > len) return -1;
+        pos += 4;
+    }
+    for (int i = 0; i < get16(msg + 6); i++) {
+        DnsRecord record;
+        if (!readName(msg, len, pos, record.name) || pos + 10 > len) return -1;
+        int type = get16(msg + pos);
+        record.type = typeName(type);
+        record.ttl = get32(msg + pos + 4);
+        size_t rdlen = get16(msg + pos + 8);
+        pos += 10;
+        if (pos + rdlen > len) return -1;
+        record.data = rdataText(msg, len, pos, rdlen, type);
+        pos += rdlen;
+        answer.records.push_back(record);
+    }
+    return 1;
+}
+
+std::string serverText(const sockaddr_storage& addr) {
+    char text[INET6_ADDRSTRLEN] = "";
+    int port;
+    if (addr.ss_family == AF_INET) {
+        const sockaddr_in* v4 = reinterpret_cast<const sockaddr_in*>(&addr);
+        inet_ntop(AF_INET, &v4->sin_addr, text, sizeof(text));
+        port = ntohs(v4->sin_port);
+    } else {
+        const sockaddr_in6* v6 = reinterpret_cast<const sockaddr_in6*>(&addr);
+        inet_ntop(AF_INET6, &v6->sin6_addr, text, sizeof(text));
+        port = ntohs(v6->sin6_port);
+    }
+    return port == 53 ? text : std::string(text) + "#" + std::to_string(port);
+}
+
+int openSocket(const sockaddr_storage& addr, socklen_t len, int type) {
+    int fd = socket(addr.ss_family, type, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), len) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Wait for fd to become ready; false on timeout
+bool waitFor(int fd, short events, Clock::time_point deadline) {
+    pollfd pfd = {fd, events, 0};
+    while (true) {
+        int left = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count());
+        if (left <= 0) return false;
+        int ready = poll(&pfd, 1, left);
+        if (ready > 0) return true;
+        if (ready < 0 && errno != EINTR) return false;
+    }
+}
+
+// One query over TCP with the two byte length prefix
+bool tcpExchange(const sockaddr_storage& addr, socklen_t len, const std::string& packet, int timeout_ms,
+                 std::string& reply, std::string& error) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    int fd = openSocket(addr, len, SOCK_STREAM);
+    if (fd < 0) {
+        error = std::string("TCP connect failed: ") + strerror(errno);
+        return false;
+    }
+
+    std::string framed;
+    put16(framed, static_cast<uint16_t>(packet.size()));
+    framed += packet;
+    size_t sent = 0;
+    while (sent < framed.size()) {
+        if (!waitFor(fd, POLLOUT, deadline)) { error = "TCP query timed out"; close(fd); return false; }
+        ssize_t n = send(fd, framed.data() + sent, framed.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            error = std::string("TCP send failed: ") + strerror(errno);
+            close(fd);
+            return false;
+        }
+        if (n > 0) sent += static_cast<size_t>(n);
+    }
+
+    reply.clear();
+    size_t expected = 0;
+    char buffer[4096];
+    while (expected == 0 || reply.size() < expected + 2) {
+        if (!waitFor(fd, POLLIN, deadline)) { error = "TCP reply timed out"; close(fd); return false; }
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            error = "TCP connection closed early";
+            close(fd);
+            return false;
+        }
+        if (n > 0) reply.append(buffer, static_cast<size_t>(n));
+        if (expected == 0 && reply.size() >= 2) {
+            expected = get16(reinterpret_cast<const unsigned char*>(reply.data()));
+        }
+    }
+    close(fd);
+    reply = reply.substr(2, expected);
+    return true;
+}
+
+} // namespace
+
+DnsClient::DnsClient(const std::vector<std::string>& servers)
+    : servers_(servers.empty() ? systemServers() : servers)
+{
+}
+
+std::vector<std::string> DnsClient::systemServers() {
+    std::vector<std::string> servers;
+    std::ifstream resolv("/etc/resolv.conf");
+    std::string line;
+    while (std::getline(resolv, line)) {
+        std::istringstream words(line);
+        std::string keyword, address;
+        if (words >> keyword >> address && keyword == "nameserver") {
+            // Scoped link-local addresses ("fe80::1%eth0") are not supported
+            if (address.find('%') == std::string::npos) servers.push_back(address);
+        }
+    }
+    if (servers.empty()) {
+        servers.push_back("127.0.0.1");     // resolv.conf's documented default
+    }
+    return servers;
+}
+
+int DnsClient::typeCode(const std::string& type) {
+    std::string upper = type;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    auto it = kTypes.find(upper);
+    if (it != kTypes.end()) return it->second;
+    if (utils::startsWith(upper, "TYPE") && upper.size() > 4) return std::atoi(upper.c_str() + 4);
+    return 0;
+}
+
+std::string DnsClient::reverseName(const std::string& address) {
+    unsigned char bytes[16];
+    std::ostringstream name;
+    if (inet_pton(AF_INET, address.c_str(), bytes) == 1) {
+        for (int i = 3; i >= 0; i--) name << static_cast<int>(bytes[i]) << ".";
+        name << "in-addr.arpa";
+        return name.str();
+    }
+    if (inet_pton(AF_INET6, address.c_str(), bytes) == 1) {
+        const char* hex = "0123456789abcdef";
+        for (int i = 15; i >= 0; i--) {
+            name << hex[bytes[i] & 0x0f] << "." << hex[bytes[i] >> 4] << ".";
+        }
+        name << "ip6.arpa";
+        return name.str();
+    }
+    return address;
+}
+
+std::vector<DnsAnswer> DnsClient::query(const std::vector<DnsQuestion>& questions, int timeout_ms, int attempts) {
+    std::vector<DnsAnswer> answers(questions.size());
+
+    std::vector<sockaddr_storage> servers;
+    std::vector<socklen_t> lengths;
+    for (const auto& spec : servers_) {
+        sockaddr_storage addr;
+        socklen_t len;
+        if (parseServer(spec, addr, len)) {
+            servers.push_back(addr);
+            lengths.push_back(len);
+        }
+    }
+
+    struct Pending {
+        int fd = -1;
+        uint16_t id = 0;
+        std::string packet;
+        int tries = 0;
+        Clock::time_point sent;
+        Clock::time_point deadline;
+        bool active = false;
+        bool truncated = false;
+    };
+    std::vector<Pending> pending(questions.size());
+    std::mt19937 random(std::random_device{}());
+    int max_tries = std::max(1, attempts) * static_cast<int>(std::max<size_t>(servers.size(), 1));
+
+    auto server = [&](const Pending& p) { return static_cast<size_t>(p.tries - 1) % servers.size(); };
+
+    // (Re)send to the next server; false once every try is used up
+    auto send = [&](size_t i) {
+        Pending& p = pending[i];
+        if (p.fd >= 0) close(p.fd);
+        p.fd = -1;
+        while (p.tries < max_tries) {
+            p.tries++;
+            size_t s = server(p);
+            p.fd = openSocket(servers[s], lengths[s], SOCK_DGRAM);
+            if (p.fd >= 0 && ::send(p.fd, p.packet.data(), p.packet.size(), 0) == static_cast<ssize_t>(p.packet.size())) {
+                p.sent = Clock::now();
+                p.deadline = p.sent + std::chrono::milliseconds(timeout_ms);
+                return true;
+            }
+            if (p.fd >= 0) close(p.fd);
+            p.fd = -1;
+        }
+        return false;
+    };
+
+    for (size_t i = 0; i < questions.size(); i++) {
+        DnsAnswer& answer = answers[i];
+        answer.question = questions[i];
+        int type = typeCode(questions[i].type);
+        std::string name = type == 12 ? reverseName(questions[i].name) : questions[i].name;
+        answer.question.name = name;
+
+        if (servers.empty()) {
+            answer.error = "No usable nameserver";
+        } else if (type <= 0 || type > 65535) {
+            answer.error = "Unknown record type " + questions[i].type;
+        } else if (!buildQuery(static_cast<uint16_t>(random()), name, type, pending[i].packet)) {
+            answer.error = "Invalid domain name " + name;
+        } else {
+            pending[i].id = get16(reinterpret_cast<const unsigned char*>(pending[i].packet.data()));
+            pending[i].active = send(i);
+            if (!pending[i].active) answer.error = std::string("Cannot reach nameserver: ") + strerror(errno);
+        }
+    }
+
+    unsigned char buffer[65536];
+    while (true) {
+        std::vector<pollfd> fds;
+        std::vector<size_t> owners;
+        Clock::time_point next = Clock::time_point::max();
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (!pending[i].active) continue;
+            fds.push_back({pending[i].fd, POLLIN, 0});
+            owners.push_back(i);
+            next = std::min(next, pending[i].deadline);
+        }
+        if (fds.empty()) break;
+
+        int wait = static_cast<int>(std::max<long long>(0,
+            std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count() + 1));
+        int ready = poll(fds.data(), fds.size(), wait);
+        if (ready < 0 && errno != EINTR) break;
+
+        for (size_t k = 0; k < fds.size(); k++) {
+            size_t i = owners[k];
+            Pending& p = pending[i];
+            DnsAnswer& answer = answers[i];
+
+            if (fds[k].revents & (POLLIN | POLLERR)) {
+                ssize_t n = recv(p.fd, buffer, sizeof(buffer), 0);
+                if (n < 0 && errno == ECONNREFUSED) {
+                    // Nothing listening there; move on without waiting out the timeout
+                    p.active = send(i);
+                    if (!p.active) answer.error = "Connection refused by every nameserver";
+                    continue;
+                }
+                if (n <= 0) continue;
+                int parsed = parseReply(buffer, static_cast<size_t>(n), p.id, answer, p.truncated);
+                if (parsed == 0) continue;
+                answer.server = serverText(servers[server(p)]);
+                answer.rtt_ms = elapsedMs(p.sent);
+                if (parsed < 0) answer.error = "Malformed reply";
+                close(p.fd);
+                p.fd = -1;
+                p.active = false;
+            } else if (Clock::now() >= p.deadline) {
+                p.active = send(i);
+                if (!p.active) answer.error = "No reply within " + std::to_string(timeout_ms) + " ms";
+            }
+        }
+    }
+
+    // Truncated answers are asked again over TCP, one after the other
+    for (size_t i = 0; i < pending.size(); i++) {
+        Pending& p = pending[i];
+        if (!p.truncated) continue;
+        size_t s = server(p);
+        std::string reply, error;
+        Clock::time_point start = Clock::now();
+        if (!tcpExchange(servers[s], lengths[s], p.packet, timeout_ms, reply, error)) {
+            answers[i].error = error + " (UDP reply was truncated)";
+            continue;
+        }
+        bool truncated = false;
+        // The truncated UDP reply may have left a "Malformed reply" behind
+        answers[i].error.clear();
+        if (parseReply(reinterpret_cast<const unsigned char*>(reply.data()), reply.size(), p.id, answers[i], truncated) <= 0) {
+            answers[i].error = "Malformed TCP reply";
+        }
+        answers[i].tcp = true;
+        answers[i].rtt_ms += elapsedMs(start);
+    }
+    return answers;
+}
+
+std::string DnsClient::format(const std::vector<DnsAnswer>& answers) {
+    std::ostringstream out;
+    for (const auto& answer : answers) {
+        out << ";; " << answer.question.name << " " << answer.question.type << ": ";
+        if (!answer.error.empty() && answer.status.empty()) {
+            out << "ERROR - " << answer.error << "\n";
+            continue;
+        }
+        char rtt[32];
+        snprintf(rtt, sizeof(rtt), "%.1f ms", answer.rtt_ms);
+        out << answer.status << ", " << answer.records.size() << " record(s), " << rtt
+            << " from " << answer.server << (answer.tcp ? " over TCP" : "");
+        if (!answer.error.empty()) out << " (" << answer.error << ")";
+        out << "\n";
+        for (const auto& record : answer.records) {
+            out << record.name << "\t" << record.ttl << "\tIN\t" << record.type << "\t" << record.data << "\n";
+        }
+    }
+    return out.str();
+}
+
+} // namespace casper
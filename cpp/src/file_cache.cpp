@@ -0,0 +1,236 @@
+#include "file_cache.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace casper {
+
+// Directories watched at most; past this, stamps alone catch changes
+static const size_t MAX_WATCHED_DIRS = 1024;
+
+FileCache::FileCache(size_t max_bytes, size_t max_file_bytes)
+    : max_bytes_(max_bytes)
+    , max_file_bytes_(std::min(max_file_bytes, max_bytes))
+    , bytes_(0)
+    , hits_(0)
+    , misses_(0)
+    , invalidations_(0)
+    , inotify_fd_(-1)
+{
+#ifdef __linux__
+    if (max_bytes_ > 0) {
+        inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+#endif
+}
+
+FileCache::~FileCache() {
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+    }
+}
+
+bool FileCache::stat(const std::string& path, FileStamp& stamp) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    stamp.dev = st.st_dev;
+    stamp.ino = st.st_ino;
+#ifdef __APPLE__
+    stamp.mtime_ns = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    stamp.size = static_cast<size_t>(st.st_size);
+    stamp.regular = S_ISREG(st.st_mode);
+    return true;
+}
+
+std::shared_ptr<const std::string> FileCache::read(const std::string& path, std::string& error, FileStamp* stamp) {
+    std::string key = utils::normalizePath(path);
+    FileStamp current;
+    if (!stat(path, current)) {
+        error = "Cannot open " + path + ": " + strerror(errno);
+        std::lock_guard<std::mutex> lock(mutex_);
+        erase(key);
+        return nullptr;
+    }
+    if (!current.regular) {
+        error = utils::dirExists(path) ? path + " is a directory" : path + " is not a regular file";
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        drainEvents();
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            if (it->second.stamp == current) {
+                hits_++;
+                lru_.splice(lru_.begin(), lru_, it->second.lru);
+                if (stamp) *stamp = current;
+                return it->second.content;
+            }
+            invalidations_++;
+            erase(key);
+        }
+        misses_++;
+    }
+
+    // Read without the lock so other tools are not held up by slow disks
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "Cannot open " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+    std::string data;
+    data.resize(current.size);
+    size_t total = 0;
+    ssize_t n = 0;
+    while (total < data.size() && (n = ::read(fd, &data[total], data.size() - total)) > 0) {
+        total += static_cast<size_t>(n);
+    }
+    close(fd);
+    if (n < 0) {
+        error = "Cannot read " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+    data.resize(total);
+
+    // A file written while it was read is returned but not kept
+    FileStamp after;
+    bool stable = stat(path, after) && after == current && total == current.size;
+    auto content = std::make_shared<const std::string>(std::move(data));
+    if (stamp) *stamp = current;
+
+    if (stable && max_bytes_ > 0 && cacheable(current)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        watchDirectory(utils::getDirname(key));
+        erase(key);
+        lru_.push_front(key);
+        entries_[key] = Entry{current, content, lru_.begin()};
+        bytes_ += content->size();
+        while (bytes_ > max_bytes_ && !lru_.empty()) {
+            erase(lru_.back());
+        }
+    }
+    return content;
+}
+
+void FileCache::erase(const std::string& key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) return;
+    bytes_ -= it->second.content->size();
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+void FileCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    erase(utils::normalizePath(path));
+}
+
+void FileCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    bytes_ = 0;
+}
+
+void FileCache::noteSeen(const std::string& path, const FileStamp& stamp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    seen_[utils::normalizePath(path)] = stamp;
+}
+
+bool FileCache::lastSeen(const std::string& path, FileStamp& stamp) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = seen_.find(utils::normalizePath(path));
+    if (it == seen_.end()) return false;
+    stamp = it->second;
+    return true;
+}
+
+FileCacheStats FileCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FileCacheStats stats;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.invalidations = invalidations_;
+    return stats;
+}
+
+void FileCache::watchDirectory(const std::string& dir) {
+#ifdef __linux__
+    if (inotify_fd_ < 0 || watched_dirs_.count(dir) || watched_dirs_.size() >= MAX_WATCHED_DIRS) return;
+    int wd = inotify_add_watch(inotify_fd_, dir.c_str(),
+                               IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO |
+                               IN_DELETE | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd < 0) return;
+    watches_[wd] = dir;
+    watched_dirs_[dir] = wd;
+#else
+    (void)dir;
+#endif
+}
+
+void FileCache::drainEvents() {
+#ifdef __linux__
+    if (inotify_fd_ < 0) return;
+    alignas(struct inotify_event) char buffer[16384];
+    ssize_t n;
+    while ((n = ::read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + n; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; nothing cached can be trusted
+                invalidations_ += entries_.size();
+                entries_.clear();
+                lru_.clear();
+                bytes_ = 0;
+                continue;
+            }
+
+            auto watch = watches_.find(event->wd);
+            if (watch == watches_.end()) continue;
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // The directory itself went away; drop everything under it
+                std::string prefix = watch->second + "/";
+                for (auto it = entries_.begin(); it != entries_.end(); ) {
+                    auto next = std::next(it);
+                    if (utils::startsWith(it->first, prefix)) {
+                        invalidations_++;
+                        erase(it->first);
+                    }
+                    it = next;
+                }
+                if (event->mask & IN_IGNORED) {
+                    watched_dirs_.erase(watch->second);
+                    watches_.erase(watch);
+                }
+                continue;
+            }
+            if (event->len > 0) {
+                std::string key = utils::joinPath(watch->second, event->name);
+                if (entries_.count(key)) {
+                    invalidations_++;
+                    erase(key);
+                }
+            }
+        }
+    }
+#endif
+}
+
+} // namespace casper
@@ -0,0 +1,823 @@
+#include "file_ops.h"
+#include "file_walker.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <fcntl.h>
+#include <glob.h>
+#include <grp.h>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#ifdef __APPLE__
+#include <copyfile.h>
+#endif
+
+namespace casper {
+
+static const size_t COPY_BUFFER_SIZE = 1 << 20;
+static const size_t ENTRIES_PER_TASK = 64;
+
+namespace {
+
+struct TreeEntry {
+    std::string path;
+    std::string relative;           // Below the root, starting with '/'
+    struct stat st;
+};
+
+// Thread-safe collector for one operation's counts and errors
+class Tally {
+public:
+    explicit Tally(FileOpReport& report) : report_(report) {}
+
+    void fail(const std::string& path, const std::string& message, int code = 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        report_.errors.push_back({path, message, code});
+    }
+
+    void failErrno(const std::string& path, const std::string& what) {
+        int code = errno;
+        fail(path, what + ": " + strerror(code), code);
+    }
+
+    void count(const struct stat& st, uint64_t bytes = 0, bool cloned = false) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (S_ISDIR(st.st_mode)) report_.directories++;
+        else if (S_ISLNK(st.st_mode)) report_.symlinks++;
+        else report_.files++;
+        report_.bytes += bytes;
+        if (cloned) report_.cloned++;
+    }
+
+    size_t errors() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return report_.errors.size();
+    }
+
+private:
+    FileOpReport& report_;
+    std::mutex mutex_;
+};
+
+std::string stripSlashes(std::string path) {
+    while (path.size() > 1 && path.back() == '/') path.pop_back();
+    return path;
+}
+
+bool isInside(const std::string& child, const std::string& parent) {
+    std::string c = utils::normalizePath(child);
+    std::string p = utils::normalizePath(parent);
+    return c == p || (c.compare(0, p.size(), p) == 0 && (p == "/" || c[p.size()] == '/'));
+}
+
+// Every entry below root (not root itself), lstat'ed, in no particular order
+std::vector<TreeEntry> listTree(const std::string& root, const FileOpOptions& options, Tally& tally) {
+    std::vector<TreeEntry> entries;
+    std::mutex mutex;
+
+    WalkOptions walk;
+    walk.respect_gitignore = false;
+    walk.include_hidden = true;
+    walk.prune_vcs = false;     // A copy or removal of a repository includes its .git
+    walk.include_dirs = true;
+    walk.include_special = true;
+    walk.threads = options.threads;
+
+    FileWalker walker(walk);
+    walker.walk(root, [&](const WalkEntry& found) {
+        TreeEntry entry;
+        if (lstat(found.path.c_str(), &entry.st) != 0) {
+            tally.failErrno(found.path, "cannot stat");
+            return true;
+        }
+        entry.path = found.path;
+        entry.relative = found.path.substr(root.size());
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back(std::move(entry));
+        return true;
+    });
+    return entries;
+}
+
+// Runs fn over items on a pool, a batch of entries per task
+template <typename Fn>
+void forEachParallel(const std::vector<const TreeEntry*>& items, const FileOpOptions& options, Fn fn) {
+    if (items.size() <= ENTRIES_PER_TASK) {
+        for (const TreeEntry* item : items) fn(*item);
+        return;
+    }
+    size_t tasks = (items.size() + ENTRIES_PER_TASK - 1) / ENTRIES_PER_TASK;
+    size_t threads = options.threads ? options.threads : ThreadPool::defaultThreadCount();
+    ThreadPool pool(std::min(threads, tasks));
+    for (size_t start = 0; start < items.size(); start += ENTRIES_PER_TASK) {
+        pool.submit([&items, &fn, start]() {
+            size_t end = std::min(items.size(), start + ENTRIES_PER_TASK);
+            for (size_t i = start; i < end; i++) fn(*items[i]);
+        });
+    }
+    pool.wait();
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 1 = cloned, 0 = copied, -1 = failed with errno set
+int copyData(int in, int out, off_t size) {
+#ifdef FICLONE
+    // Shares extents on btrfs, XFS and friends: no data is read or written
+    if (size > 0 && ioctl(out, FICLONE, in) == 0) return 1;
+#endif
+#ifdef __linux__
+    // Copies inside the kernel (or server side on NFS and SMB)
+    off_t done = 0;
+    bool fallback = false;
+    while (done < size) {
+        ssize_t n = copy_file_range(in, nullptr, out, nullptr, static_cast<size_t>(size - done), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (done == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                              errno == EOPNOTSUPP || errno == EPERM)) {
+                fallback = true;
+                break;
+            }
+            return -1;
+        }
+        if (n == 0) break;
+        done += n;
+    }
+    if (!fallback) return 0;
+#elif defined(__APPLE__)
+    (void)size;
+    return fcopyfile(in, out, nullptr, COPYFILE_DATA) == 0 ? 0 : -1;
+#else
+    (void)size;
+#endif
+    std::vector<char> buffer(COPY_BUFFER_SIZE);
+    while (true) {
+        ssize_t n = read(in, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) return 0;
+        if (!writeAll(out, buffer.data(), static_cast<size_t>(n))) return -1;
+    }
+}
+
+// One file or symlink; directories are handled by the callers
+bool copyEntry(const std::string& src, const std::string& dst, const struct stat& st, Tally& tally) {
+    if (S_ISLNK(st.st_mode)) {
+        std::vector<char> target(st.st_size > 0 ? static_cast<size_t>(st.st_size) + 1 : PATH_MAX);
+        ssize_t n = readlink(src.c_str(), target.data(), target.size());
+        if (n < 0) {
+            tally.failErrno(src, "cannot read link");
+            return false;
+        }
+        if (unlink(dst.c_str()) != 0 && errno != ENOENT) {
+            tally.failErrno(dst, "cannot replace");
+            return false;
+        }
+        if (symlink(std::string(target.data(), static_cast<size_t>(n)).c_str(), dst.c_str()) != 0) {
+            tally.failErrno(dst, "cannot create link");
+            return false;
+        }
+        tally.count(st);
+        return true;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        tally.fail(src, "not a regular file, directory or symlink; skipped");
+        return false;
+    }
+
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        tally.failErrno(src, "cannot open");
+        return false;
+    }
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+    if (out < 0) {
+        tally.failErrno(dst, "cannot create");
+        close(in);
+        return false;
+    }
+    int copied = copyData(in, out, st.st_size);
+    if (copied < 0) tally.failErrno(dst, "copy failed");
+    close(in);
+    if (close(out) != 0 && copied >= 0) {
+        tally.failErrno(dst, "write failed");
+        copied = -1;
+    }
+    if (copied < 0) return false;
+    tally.count(st, static_cast<uint64_t>(st.st_size), copied == 1);
+    return true;
+}
+
+std::string sizeText(uint64_t bytes) {
+    return bytes < 1024 ? std::to_string(bytes) + (bytes == 1 ? " byte" : " bytes") : utils::formatSize(bytes);
+}
+
+std::string describe(const FileOpReport& before, const FileOpReport& after) {
+    std::vector<std::string> parts;
+    size_t files = after.files - before.files;
+    size_t dirs = after.directories - before.directories;
+    size_t links = after.symlinks - before.symlinks;
+    if (files) parts.push_back(std::to_string(files) + (files == 1 ? " file" : " files"));
+    if (dirs) parts.push_back(std::to_string(dirs) + (dirs == 1 ? " directory" : " directories"));
+    if (links) parts.push_back(std::to_string(links) + (links == 1 ? " symlink" : " symlinks"));
+    if (after.bytes > before.bytes) parts.push_back(sizeText(after.bytes - before.bytes));
+    if (after.errors.size() > before.errors.size()) {
+        parts.push_back(std::to_string(after.errors.size() - before.errors.size()) + " failed");
+    }
+    if (parts.empty()) return "";
+    std::string text = " (";
+    for (size_t i = 0; i < parts.size(); i++) text += (i ? ", " : "") + parts[i];
+    return text + ")";
+}
+
+// Counts a tree for a dry run
+void countTree(const struct stat& root, const std::vector<TreeEntry>& entries, Tally& tally, bool with_bytes) {
+    tally.count(root);
+    for (const auto& entry : entries) {
+        tally.count(entry.st, with_bytes && S_ISREG(entry.st.st_mode) ? static_cast<uint64_t>(entry.st.st_size) : 0);
+    }
+}
+
+// cp and mv: into dest when it is a directory
+bool resolveTargets(const std::vector<std::string>& sources, const std::string& dest,
+                    std::vector<std::string>& targets, Tally& tally) {
+    struct stat st;
+    bool dest_is_dir = stat(dest.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    if (sources.size() > 1 && !dest_is_dir) {
+        tally.fail(dest, "not a directory; several sources need a directory destination", ENOTDIR);
+        return false;
+    }
+    for (const auto& source : sources) {
+        targets.push_back(dest_is_dir ? utils::joinPath(stripSlashes(dest), utils::getBasename(stripSlashes(source)))
+                                      : stripSlashes(dest));
+    }
+    return true;
+}
+
+bool sameFile(const struct stat& st, const std::string& path) {
+    struct stat other;
+    return stat(path.c_str(), &other) == 0 && other.st_dev == st.st_dev && other.st_ino == st.st_ino;
+}
+
+void copyOne(const std::string& source, const std::string& target, const FileOpOptions& options, Tally& tally) {
+    std::string src = stripSlashes(source);
+    struct stat st;
+    if (lstat(src.c_str(), &st) != 0) {
+        tally.failErrno(src, "cannot copy");
+        return;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        if (sameFile(st, target)) {
+            tally.fail(src, "'" + src + "' and '" + target + "' are the same file");
+        } else if (options.dry_run) {
+            tally.count(st, S_ISREG(st.st_mode) ? static_cast<uint64_t>(st.st_size) : 0);
+        } else {
+            copyEntry(src, target, st, tally);
+        }
+        return;
+    }
+
+    if (!options.recursive) {
+        tally.fail(src, "is a directory (pass recursive=true)", EISDIR);
+        return;
+    }
+    if (isInside(target, src)) {
+        tally.fail(src, "cannot copy a directory into itself ('" + target + "')");
+        return;
+    }
+
+    std::vector<TreeEntry> entries = listTree(src, options, tally);
+    if (options.dry_run) {
+        countTree(st, entries, tally, true);
+        return;
+    }
+
+    // Directories first (parents before children) and writable until the files are in
+    struct stat target_st;
+    if (mkdir(target.c_str(), 0700) != 0 && !(errno == EEXIST && stat(target.c_str(), &target_st) == 0 &&
+                                               S_ISDIR(target_st.st_mode))) {
+        tally.failErrno(target, "cannot create directory");
+        return;
+    }
+    tally.count(st);
+
+    std::vector<const TreeEntry*> dirs, files;
+    for (const auto& entry : entries) (S_ISDIR(entry.st.st_mode) ? dirs : files).push_back(&entry);
+    std::sort(dirs.begin(), dirs.end(), [](const TreeEntry* a, const TreeEntry* b) { return a->relative < b->relative; });
+    for (const TreeEntry* dir : dirs) {
+        std::string path = target + dir->relative;
+        if (mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) {
+            tally.failErrno(path, "cannot create directory");
+            continue;
+        }
+        tally.count(dir->st);
+    }
+
+    forEachParallel(files, options, [&](const TreeEntry& file) {
+        copyEntry(file.path, target + file.relative, file.st, tally);
+    });
+
+    for (const TreeEntry* dir : dirs) chmod((target + dir->relative).c_str(), dir->st.st_mode & 07777);
+    chmod(target.c_str(), st.st_mode & 07777);
+}
+
+void removeOne(const std::string& path_given, const FileOpOptions& options, Tally& tally) {
+    std::string path = stripSlashes(path_given);
+    std::string base = utils::getBasename(path);
+    if (base == "." || base == ".." || utils::normalizePath(path) == "/") {
+        tally.fail(path, "refusing to remove '.', '..' or '/'");
+        return;
+    }
+
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        if (!(options.force && errno == ENOENT)) tally.failErrno(path, "cannot remove");
+        return;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        if (options.dry_run) {
+            tally.count(st, S_ISREG(st.st_mode) ? static_cast<uint64_t>(st.st_size) : 0);
+        } else if (unlink(path.c_str()) != 0) {
+            tally.failErrno(path, "cannot remove");
+        } else {
+            tally.count(st, S_ISREG(st.st_mode) ? static_cast<uint64_t>(st.st_size) : 0);
+        }
+        return;
+    }
+    if (!options.recursive) {
+        tally.fail(path, "is a directory (pass recursive=true)", EISDIR);
+        return;
+    }
+
+    std::vector<TreeEntry> entries = listTree(path, options, tally);
+    if (options.dry_run) {
+        countTree(st, entries, tally, true);
+        return;
+    }
+
+    size_t errors_before = tally.errors();
+    std::vector<const TreeEntry*> dirs, files;
+    for (const auto& entry : entries) (S_ISDIR(entry.st.st_mode) ? dirs : files).push_back(&entry);
+
+    forEachParallel(files, options, [&](const TreeEntry& file) {
+        if (unlink(file.path.c_str()) != 0) {
+            if (errno != ENOENT) tally.failErrno(file.path, "cannot remove");
+            return;
+        }
+        tally.count(file.st, S_ISREG(file.st.st_mode) ? static_cast<uint64_t>(file.st.st_size) : 0);
+    });
+
+    // Children have longer paths than their parents
+    std::sort(dirs.begin(), dirs.end(), [](const TreeEntry* a, const TreeEntry* b) { return a->path.size() > b->path.size(); });
+    bool failed_below = tally.errors() > errors_before;
+    for (const TreeEntry* dir : dirs) {
+        if (rmdir(dir->path.c_str()) == 0) {
+            tally.count(dir->st);
+        } else if (!(failed_below && (errno == ENOTEMPTY || errno == EEXIST))) {
+            // A directory left non-empty by an earlier failure is not news
+            tally.failErrno(dir->path, "cannot remove directory");
+        }
+    }
+    if (rmdir(path.c_str()) == 0) {
+        tally.count(st);
+    } else if (!(tally.errors() > errors_before && (errno == ENOTEMPTY || errno == EEXIST))) {
+        tally.failErrno(path, "cannot remove directory");
+    }
+}
+
+// Applies a chmod mode to `mode`; false when the spec is malformed
+bool applyMode(const std::string& spec, mode_t mode, bool is_dir, mode_t& result) {
+    if (!spec.empty() && spec.size() <= 4 && spec.find_first_not_of("01234567") == std::string::npos) {
+        result = static_cast<mode_t>(std::strtol(spec.c_str(), nullptr, 8));
+        return true;
+    }
+
+    const mode_t all_bits = S_IRWXU | S_IRWXG | S_IRWXO | S_ISUID | S_ISGID | S_ISVTX;
+    mode_t perms = mode & 07777;
+    for (const auto& clause : utils::split(spec, ',')) {
+        size_t i = 0;
+        mode_t who = 0;
+        for (; i < clause.size() && strchr("ugoa", clause[i]); i++) {
+            if (clause[i] == 'u') who |= S_IRWXU | S_ISUID;
+            if (clause[i] == 'g') who |= S_IRWXG | S_ISGID;
+            if (clause[i] == 'o') who |= S_IRWXO | S_ISVTX;
+            if (clause[i] == 'a') who |= all_bits;
+        }
+        if (who == 0) who = all_bits;
+        if (i == clause.size()) return false;
+
+        while (i < clause.size()) {
+            char op = clause[i++];
+            if (op != '+' && op != '-' && op != '=') return false;
+            mode_t bits = 0;
+            for (; i < clause.size() && strchr("rwxXst", clause[i]); i++) {
+                switch (clause[i]) {
+                case 'r': bits |= S_IRUSR | S_IRGRP | S_IROTH; break;
+                case 'w': bits |= S_IWUSR | S_IWGRP | S_IWOTH; break;
+                case 'x': bits |= S_IXUSR | S_IXGRP | S_IXOTH; break;
+                case 'X':
+                    // Execute only for directories and files some class can already run
+                    if (is_dir || (perms & (S_IXUSR | S_IXGRP | S_IXOTH))) bits |= S_IXUSR | S_IXGRP | S_IXOTH;
+                    break;
+                case 's': bits |= S_ISUID | S_ISGID; break;
+                case 't': bits |= S_ISVTX; break;
+                }
+            }
+            bits &= who;
+            if (op == '+') perms |= bits;
+            else if (op == '-') perms &= ~bits;
+            else perms = (perms & ~who) | bits;
+        }
+    }
+    result = perms;
+    return true;
+}
+
+bool parseOwner(const std::string& spec, uid_t& uid, gid_t& gid, std::string& error) {
+    uid = static_cast<uid_t>(-1);
+    gid = static_cast<gid_t>(-1);
+    size_t colon = spec.find_first_of(":.");
+    std::string user = spec.substr(0, colon);
+    std::string group = colon == std::string::npos ? "" : spec.substr(colon + 1);
+
+    if (!user.empty()) {
+        if (user.find_first_not_of("0123456789") == std::string::npos) {
+            uid = static_cast<uid_t>(std::strtoul(user.c_str(), nullptr, 10));
+        } else if (struct passwd* pw = getpwnam(user.c_str())) {
+            uid = pw->pw_uid;
+            // "user:" means the user's login group
+            if (colon != std::string::npos && group.empty()) gid = pw->pw_gid;
+        } else {
+            error = "unknown user: " + user;
+            return false;
+        }
+    }
+    if (!group.empty()) {
+        if (group.find_first_not_of("0123456789") == std::string::npos) {
+            gid = static_cast<gid_t>(std::strtoul(group.c_str(), nullptr, 10));
+        } else if (struct group* gr = getgrnam(group.c_str())) {
+            gid = gr->gr_gid;
+        } else {
+            error = "unknown group: " + group;
+            return false;
+        }
+    }
+    if (uid == static_cast<uid_t>(-1) && gid == static_cast<gid_t>(-1)) {
+        error = "no user or group given";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<std::string> FileOps::splitPaths(const std::string& list) {
+    std::vector<std::string> paths;
+    std::string current;
+    bool in_word = false;
+    char quote = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+        char c = list[i];
+        if (quote) {
+            if (c == quote) quote = 0;
+            else if (c == '\\' && quote == '"' && i + 1 < list.size()) current += list[++i];
+            else current += c;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            in_word = true;
+        } else if (c == '\\' && i + 1 < list.size()) {
+            current += list[++i];
+            in_word = true;
+        } else if (isspace(static_cast<unsigned char>(c))) {
+            if (in_word) paths.push_back(current);
+            current.clear();
+            in_word = false;
+        } else {
+            current += c;
+            in_word = true;
+        }
+    }
+    if (in_word) paths.push_back(current);
+    return paths;
+}
+
+std::vector<std::string> FileOps::expandPaths(const std::string& list) {
+    std::vector<std::string> paths;
+    for (const auto& word : splitPaths(list)) {
+        std::string path = word;
+        if (path == "~" || utils::startsWith(path, "~/")) path = utils::getHomeDir() + path.substr(1);
+        // Quoted wildcards are taken literally when the file exists under that name
+        struct stat st;
+        if (path.find_first_of("*?[") == std::string::npos || lstat(path.c_str(), &st) == 0) {
+            paths.push_back(path);
+            continue;
+        }
+        glob_t matches;
+        if (glob(path.c_str(), 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; i++) paths.push_back(matches.gl_pathv[i]);
+        } else {
+            paths.push_back(path);
+        }
+        globfree(&matches);
+    }
+    return paths;
+}
+
+FileOpReport FileOps::copy(const std::vector<std::string>& sources, const std::string& dest,
+                           const FileOpOptions& options) {
+    FileOpReport report;
+    report.dry_run = options.dry_run;
+    Tally tally(report);
+    std::vector<std::string> targets;
+    if (!resolveTargets(sources, dest, targets, tally)) return report;
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        FileOpReport before = report;
+        copyOne(sources[i], targets[i], options, tally);
+        bool did_something = report.files + report.directories + report.symlinks >
+                             before.files + before.directories + before.symlinks;
+        if (did_something) {
+            report.actions.push_back(std::string(options.dry_run ? "would copy " : "copied ") + sources[i] + " -> " +
+                                     targets[i] + describe(before, report));
+        }
+    }
+    return report;
+}
+
+FileOpReport FileOps::move(const std::vector<std::string>& sources, const std::string& dest,
+                           const FileOpOptions& options) {
+    FileOpReport report;
+    report.dry_run = options.dry_run;
+    Tally tally(report);
+    std::vector<std::string> targets;
+    if (!resolveTargets(sources, dest, targets, tally)) return report;
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::string src = stripSlashes(sources[i]);
+        const std::string& target = targets[i];
+        struct stat st;
+        if (lstat(src.c_str(), &st) != 0) {
+            tally.failErrno(src, "cannot move");
+            continue;
+        }
+        if (S_ISDIR(st.st_mode) && isInside(target, src)) {
+            tally.fail(src, "cannot move a directory into itself ('" + target + "')");
+            continue;
+        }
+        if (options.dry_run) {
+            tally.count(st);
+            report.actions.push_back("would move " + src + " -> " + target);
+            continue;
+        }
+        if (rename(src.c_str(), target.c_str()) == 0) {
+            tally.count(st);
+            report.actions.push_back("moved " + src + " -> " + target);
+            continue;
+        }
+        if (errno != EXDEV) {
+            tally.failErrno(src, "cannot move to " + target);
+            continue;
+        }
+
+        // Different filesystems: copy, and remove the source only if every copy succeeded
+        FileOpOptions across = options;
+        across.recursive = true;
+        FileOpReport before = report;
+        copyOne(src, target, across, tally);
+        if (report.errors.size() > before.errors.size()) {
+            tally.fail(src, "not removed because the copy to " + target + " was incomplete");
+            continue;
+        }
+        std::string copied = describe(before, report);
+        FileOpReport removed;
+        Tally remove_tally(removed);
+        removeOne(src, across, remove_tally);
+        report.errors.insert(report.errors.end(), removed.errors.begin(), removed.errors.end());
+        report.actions.push_back("moved " + src + " -> " + target + " across filesystems" + copied);
+    }
+    return report;
+}
+
+FileOpReport FileOps::remove(const std::vector<std::string>& paths, const FileOpOptions& options) {
+    FileOpReport report;
+    report.dry_run = options.dry_run;
+    Tally tally(report);
+    for (const auto& path : paths) {
+        FileOpReport before = report;
+        removeOne(path, options, tally);
+        if (report.files + report.directories + report.symlinks > before.files + before.directories + before.symlinks) {
+            report.actions.push_back(std::string(options.dry_run ? "would remove " : "removed ") + path +
+                                     describe(before, report));
+        }
+    }
+    return report;
+}
+
+FileOpReport FileOps::makeDirs(const std::vector<std::string>& paths, const FileOpOptions& options) {
+    FileOpReport report;
+    report.dry_run = options.dry_run;
+    Tally tally(report);
+    for (const auto& given : paths) {
+        std::string path = stripSlashes(given);
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            if (S_ISDIR(st.st_mode) && options.parents) {
+                report.actions.push_back("exists " + path);
+            } else {
+                tally.fail(path, "already exists", EEXIST);
+            }
+            continue;
+        }
+        if (options.dry_run) {
+            report.directories++;
+            report.actions.push_back("would create " + path);
+            continue;
+        }
+
+        size_t created = 0;
+        bool ok = true;
+        if (options.parents) {
+            // Each missing ancestor in turn, like mkdir -p
+            for (size_t slash = path.find('/', 1); ok; slash = path.find('/', slash + 1)) {
+                std::string prefix = slash == std::string::npos ? path : path.substr(0, slash);
+                if (mkdir(prefix.c_str(), 0777) == 0) {
+                    created++;
+                } else if (errno != EEXIST || stat(prefix.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+                    if (errno == EEXIST) errno = ENOTDIR;
+                    tally.failErrno(prefix, "cannot create directory");
+                    ok = false;
+                }
+                if (slash == std::string::npos) break;
+            }
+        } else if (mkdir(path.c_str(), 0777) == 0) {
+            created++;
+        } else {
+            tally.failErrno(path, "cannot create directory");
+            ok = false;
+        }
+        report.directories += created;
+        if (ok) report.actions.push_back("created " + path);
+    }
+    return report;
+}
+
+bool FileOps::validMode(const std::string& mode) {
+    mode_t result;
+    return !mode.empty() && applyMode(mode, 0, false, result);
+}
+
+FileOpReport FileOps::changeMode(const std::vector<std::string>& paths, const std::string& mode,
+                                 const FileOpOptions& options) {
+    FileOpReport report;
+    report.dry_run = options.dry_run;
+    Tally tally(report);
+    if (!validMode(mode)) {
+        tally.fail(mode, "invalid mode (use octal like 755 or symbolic like u+x,go-w)", EINVAL);
+        return report;
+    }
+
+    auto apply = [&](const std::string& path, const struct stat& st) {
+        mode_t wanted;
+        applyMode(mode, st.st_mode, S_ISDIR(st.st_mode), wanted);
+        if (wanted == (st.st_mode & 07777)) return;
+        if (!options.dry_run && chmod(path.c_str(), wanted) != 0) {
+            tally.failErrno(path, "cannot change mode");
+            return;
+        }
+        tally.count(st);
+    };
+
+    for (const auto& given : paths) {
+        std::string path = stripSlashes(given);
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            tally.failErrno(path, "cannot change mode");
+            continue;
+        }
+        FileOpReport before = report;
+        if (options.recursive && S_ISDIR(st.st_mode)) {
+            // Contents first and directories deepest first, so taking away
+            // access from a directory cannot block the entries inside it
+            std::vector<TreeEntry> entries = listTree(path, options, tally);
+            std::vector<const TreeEntry*> dirs, files;
+            for (const auto& entry : entries) {
+                if (S_ISDIR(entry.st.st_mode)) dirs.push_back(&entry);
+                else if (!S_ISLNK(entry.st.st_mode)) files.push_back(&entry);   // chmod -R skips links too
+            }
+            forEachParallel(files, options, [&](const TreeEntry& file) { apply(file.path, file.st); });
+            std::sort(dirs.begin(), dirs.end(), [](const TreeEntry* a, const TreeEntry* b) { return a->path.size() > b->path.size(); });
+            for (const TreeEntry* dir : dirs) apply(dir->path, dir->st);
+        }
+        apply(path, st);
+
+        size_t changed = report.files + report.directories - before.files - before.directories;
+        report.actions.push_back(std::string(options.dry_run ? "would change " : "changed ") + path + ": " +
+                                 std::to_string(changed) + (changed == 1 ? " entry" : " entries") +
+                                 (report.errors.size() > before.errors.size() ? ", some failed" : ""));
+    }
+    return report;
+}
+
+FileOpReport FileOps::changeOwner(const std::vector<std::string>& paths, const std::string& owner,
+                                  const FileOpOptions& options) {
+    FileOpReport report;
+    report.dry_run = options.dry_run;
+    Tally tally(report);
+    uid_t uid;
+    gid_t gid;
+    std::string error;
+    if (!parseOwner(owner, uid, gid, error)) {
+        tally.fail(owner, error, EINVAL);
+        return report;
+    }
+
+    // Links themselves inside trees, what they point to at the top (as chown -R does)
+    auto apply = [&](const std::string& path, const struct stat& st, bool top) {
+        bool same_uid = uid == static_cast<uid_t>(-1) || st.st_uid == uid;
+        bool same_gid = gid == static_cast<gid_t>(-1) || st.st_gid == gid;
+        if (same_uid && same_gid) return;
+        if (!options.dry_run && (top ? chown(path.c_str(), uid, gid) : lchown(path.c_str(), uid, gid)) != 0) {
+            tally.failErrno(path, "cannot change owner");
+            return;
+        }
+        tally.count(st);
+    };
+
+    for (const auto& given : paths) {
+        std::string path = stripSlashes(given);
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            tally.failErrno(path, "cannot change owner");
+            continue;
+        }
+        FileOpReport before = report;
+        if (options.recursive && S_ISDIR(st.st_mode)) {
+            std::vector<TreeEntry> entries = listTree(path, options, tally);
+            std::vector<const TreeEntry*> items;
+            for (const auto& entry : entries) items.push_back(&entry);
+            forEachParallel(items, options, [&](const TreeEntry& entry) { apply(entry.path, entry.st, false); });
+        }
+        apply(path, st, true);
+
+        size_t changed = report.files + report.directories + report.symlinks -
+                         before.files - before.directories - before.symlinks;
+        report.actions.push_back(std::string(options.dry_run ? "would change " : "changed ") + path + ": " +
+                                 std::to_string(changed) + (changed == 1 ? " entry" : " entries") +
+                                 (report.errors.size() > before.errors.size() ? ", some failed" : ""));
+    }
+    return report;
+}
+
+std::string FileOps::format(const FileOpReport& report, size_t max_lines) {
+    std::ostringstream out;
+    for (size_t i = 0; i < report.actions.size() && i < max_lines; i++) out << report.actions[i] << "\n";
+    if (report.actions.size() > max_lines) out << "... " << report.actions.size() - max_lines << " more\n";
+    for (size_t i = 0; i < report.errors.size() && i < max_lines; i++) {
+        out << "ERROR " << report.errors[i].path << ": " << report.errors[i].message << "\n";
+    }
+    if (report.errors.size() > max_lines) out << "... " << report.errors.size() - max_lines << " more errors\n";
+
+    std::vector<std::string> parts;
+    if (report.files) parts.push_back(std::to_string(report.files) + (report.files == 1 ? " file" : " files"));
+    if (report.directories) {
+        parts.push_back(std::to_string(report.directories) + (report.directories == 1 ? " directory" : " directories"));
+    }
+    if (report.symlinks) parts.push_back(std::to_string(report.symlinks) + (report.symlinks == 1 ? " symlink" : " symlinks"));
+    if (report.bytes) parts.push_back(sizeText(report.bytes));
+    if (report.cloned) parts.push_back(std::to_string(report.cloned) + " reflinked");
+
+    out << "[" << (report.dry_run ? "Dry run, nothing changed: " : "");
+    if (parts.empty()) out << "nothing to do";
+    for (size_t i = 0; i < parts.size(); i++) out << (i ? ", " : "") << parts[i];
+    if (!report.errors.empty()) out << "; " << report.errors.size() << (report.errors.size() == 1 ? " error" : " errors");
+    out << "]\n";
+    return out.str();
+}
+
+} // namespace casper
@@ -0,0 +1,363 @@
+#include "file_walker.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <fstream>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace casper {
+
+// Files handed to the visitor per job, so one huge directory still spreads
+// across workers
+static const size_t FILE_BATCH_SIZE = 64;
+
+IgnoreRules::IgnoreRules(std::shared_ptr<const IgnoreRules> parent, const std::string& dir)
+    : parent_(std::move(parent))
+    , dir_(dir)
+{
+    std::ifstream file(utils::joinPath(dir, ".gitignore"));
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        line = utils::trim(line);
+        if (line.empty() || line[0] == '#') continue;
+
+        Rule rule;
+        if (line[0] == '!') {
+            rule.negate = true;
+            line = line.substr(1);
+        } else if (line[0] == '\\') {
+            line = line.substr(1);
+        }
+        if (!line.empty() && line.back() == '/') {
+            rule.dir_only = true;
+            line.pop_back();
+        }
+        if (line.find('/') != std::string::npos) {
+            rule.anchored = true;
+            if (line[0] == '/') line = line.substr(1);
+        }
+        if (line.empty()) continue;
+
+        rule.matcher = GlobMatcher(line);
+        rules_.push_back(rule);
+    }
+}
+
+std::shared_ptr<const IgnoreRules> IgnoreRules::forDirectory(std::shared_ptr<const IgnoreRules> parent,
+                                                             const std::string& dir) {
+    struct stat st;
+    if (stat(utils::joinPath(dir, ".gitignore").c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return parent;
+    }
+
+    auto rules = std::make_shared<IgnoreRules>(parent, dir);
+    if (rules->rules_.empty()) {
+        return parent;
+    }
+    return rules;
+}
+
+std::shared_ptr<const IgnoreRules> IgnoreRules::forAncestors(const std::string& dir) {
+    std::vector<std::string> ancestors;
+    std::string current = dir;
+    bool in_repo = false;
+
+    while (true) {
+        struct stat st;
+        if (stat(utils::joinPath(current, ".git").c_str(), &st) == 0) {
+            in_repo = true;
+            break;
+        }
+        if (current == "/") break;
+        current = utils::getDirname(current);
+        ancestors.push_back(current);
+    }
+    if (!in_repo) {
+        return nullptr;
+    }
+
+    // Outermost first, so nearer .gitignore files take precedence
+    std::shared_ptr<const IgnoreRules> rules;
+    for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+        rules = forDirectory(rules, *it);
+    }
+    return rules;
+}
+
+int IgnoreRules::match(const std::string& path, bool is_dir) const {
+    std::string relative = path;
+    if (utils::startsWith(path, dir_ + "/")) {
+        relative = path.substr(dir_.size() + 1);
+    }
+
+    // Later rules override earlier ones
+    for (auto it = rules_.rbegin(); it != rules_.rend(); ++it) {
+        if (it->dir_only && !is_dir) continue;
+
+        bool matched;
+        if (it->anchored) {
+            // "/name" only matches directly inside dir_
+            matched = it->matcher.matches(relative) &&
+                      (!it->matcher.matchesNameOnly() || relative.find('/') == std::string::npos);
+        } else {
+            matched = it->matcher.matches(path);
+        }
+        if (matched) {
+            return it->negate ? 0 : 1;
+        }
+    }
+    return -1;
+}
+
+bool IgnoreRules::isIgnored(const std::string& path, bool is_dir) const {
+    // The nearest .gitignore with a matching rule decides
+    for (const IgnoreRules* rules = this; rules; rules = rules->parent_.get()) {
+        int result = rules->match(path, is_dir);
+        if (result >= 0) {
+            return result == 1;
+        }
+    }
+    return false;
+}
+
+struct FileWalker::Job {
+    std::string dir;                            // Directory to list, or
+    std::vector<WalkEntry> entries;             // a batch of files to report
+    std::shared_ptr<const IgnoreRules> ignore;
+    int depth = 0;
+};
+
+struct FileWalker::WorkerQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+};
+
+namespace {
+
+// Calls fn(name, d_type) for each entry in dir except "." and ".."
+template <typename Fn>
+bool listDirectory(const std::string& dir, Fn fn) {
+#ifdef __linux__
+    // getdents64 returns many entries per syscall with their types, and
+    // avoids the per-entry overhead of readdir's DIR stream
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct LinuxDirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];     // NUL-terminated, extends to d_reclen
+    };
+
+    alignas(8) char buffer[32 * 1024];
+    while (true) {
+        long n = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        for (long offset = 0; offset < n;) {
+            auto* entry = reinterpret_cast<LinuxDirent64*>(buffer + offset);
+            offset += entry->d_reclen;
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            if (!fn(name, entry->d_type)) {
+                close(fd);
+                return true;
+            }
+        }
+    }
+    close(fd);
+    return true;
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) return false;
+
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != nullptr) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        if (!fn(name, entry->d_type)) break;
+    }
+    closedir(handle);
+    return true;
+#endif
+}
+
+} // namespace
+
+FileWalker::FileWalker(const WalkOptions& options)
+    : options_(options)
+    , stopped_(false)
+    , pending_(0)
+{
+}
+
+void FileWalker::push(WorkerQueue& queue, Job job) {
+    pending_++;
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+}
+
+void FileWalker::processDirectory(const Job& job, const Visitor& visitor, WorkerQueue& queue) {
+    auto ignore = job.ignore;
+    std::string absolute_dir;
+    if (options_.respect_gitignore) {
+        absolute_dir = absolutePath(job.dir);
+        ignore = IgnoreRules::forDirectory(ignore, absolute_dir);
+    }
+
+    std::vector<WalkEntry> batch;
+
+    listDirectory(job.dir, [&](const char* name, unsigned char type) {
+        if (stopped_) return false;
+        if (name[0] == '.' && (!options_.include_hidden || (options_.prune_vcs && strcmp(name, ".git") == 0))) return true;
+
+        std::string path = job.dir == "/" ? "/" + std::string(name) : job.dir + "/" + name;
+
+        // d_type saves a stat for most entries
+        bool is_dir = type == DT_DIR;
+        bool is_file = type == DT_REG;
+        if (type == DT_UNKNOWN || (type == DT_LNK && options_.follow_symlinks)) {
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) return true;
+            is_dir = S_ISDIR(st.st_mode);
+            is_file = S_ISREG(st.st_mode);
+        }
+        if (!is_dir && !is_file && !options_.include_special) return true;
+
+        if (ignore && ignore->isIgnored((absolute_dir == "/" ? "" : absolute_dir) + "/" + name, is_dir)) return true;
+
+        if (is_dir) {
+            if (options_.include_dirs) {
+                if (!visitor({path, true, job.depth})) {
+                    stopped_ = true;
+                    return false;
+                }
+            }
+            if (options_.max_depth < 0 || job.depth < options_.max_depth) {
+                Job sub;
+                sub.dir = std::move(path);
+                sub.ignore = ignore;
+                sub.depth = job.depth + 1;
+                push(queue, std::move(sub));
+            }
+        } else {
+            batch.push_back({std::move(path), false, job.depth});
+            if (batch.size() >= FILE_BATCH_SIZE) {
+                Job files;
+                files.entries = std::move(batch);
+                push(queue, std::move(files));
+                batch.clear();
+            }
+        }
+        return true;
+    });
+
+    for (const auto& entry : batch) {
+        if (stopped_ || !visitor(entry)) {
+            stopped_ = true;
+            return;
+        }
+    }
+}
+
+std::string FileWalker::absolutePath(const std::string& path) const {
+    if (root_ == "/") return path;
+    std::string rest = path.substr(root_.size());
+    if (absolute_root_ == "/") return rest.empty() ? "/" : rest;
+    return absolute_root_ + rest;
+}
+
+void FileWalker::walk(const std::string& root, const Visitor& visitor) {
+    stopped_ = false;
+    pending_ = 0;
+
+    struct stat st;
+    if (stat(root.c_str(), &st) != 0) {
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        visitor({root, false, 0});
+        return;
+    }
+
+    std::string start = root;
+    while (start.size() > 1 && start.back() == '/') start.pop_back();
+    root_ = start;
+    absolute_root_ = utils::normalizePath(start);
+
+    size_t thread_count = options_.threads ? options_.threads : ThreadPool::defaultThreadCount();
+    std::vector<WorkerQueue> queues(thread_count);
+
+    Job first;
+    first.dir = start;
+    if (options_.respect_gitignore) {
+        first.ignore = IgnoreRules::forAncestors(absolute_root_);
+    }
+    push(queues[0], std::move(first));
+
+    auto worker = [&](size_t id) {
+        while (pending_ > 0) {
+            Job job;
+            bool found = false;
+
+            // Own queue from the back (depth first, cache friendly),
+            // other queues from the front (largest remaining subtrees)
+            for (size_t i = 0; i < queues.size() && !found; i++) {
+                WorkerQueue& queue = queues[(id + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.jobs.empty()) continue;
+                if (i == 0) {
+                    job = std::move(queue.jobs.back());
+                    queue.jobs.pop_back();
+                } else {
+                    job = std::move(queue.jobs.front());
+                    queue.jobs.pop_front();
+                }
+                found = true;
+            }
+
+            if (!found) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+
+            if (!stopped_) {
+                if (!job.dir.empty()) {
+                    processDirectory(job, visitor, queues[id]);
+                } else {
+                    for (const auto& entry : job.entries) {
+                        if (stopped_ || !visitor(entry)) {
+                            stopped_ = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            pending_--;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace casper
@@ -0,0 +1,236 @@
+#include "glob_matcher.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace casper {
+
+GlobMatcher::GlobMatcher(const std::string& pattern)
+    : pattern_(pattern)
+{
+    for (const auto& alternative : expandBraces(pattern)) {
+        std::string expanded = alternative;
+        if (utils::startsWith(expanded, "./")) expanded = expanded.substr(2);
+        if (!expanded.empty() && expanded[0] == '/') expanded = expanded.substr(1);
+
+        std::vector<std::string> segments;
+        for (const auto& segment : utils::split(expanded, '/')) {
+            if (segment.empty()) continue;
+            // Collapse runs of ** so matching stays linear in practice
+            if (segment == "**" && !segments.empty() && segments.back() == "**") continue;
+            segments.push_back(segment);
+        }
+        if (segments.size() > 1) {
+            name_only_ = false;
+        }
+        alternatives_.push_back(segments);
+    }
+}
+
+std::vector<std::string> GlobMatcher::expandBraces(const std::string& pattern) {
+    // Find the first top-level {...} containing a comma
+    size_t open = std::string::npos;
+    int depth = 0;
+    bool has_comma = false;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+        if (c == '\\') { i++; continue; }
+        if (c == '{') {
+            if (depth++ == 0) { open = i; has_comma = false; }
+        } else if (c == ',' && depth == 1) {
+            has_comma = true;
+        } else if (c == '}' && depth > 0) {
+            if (--depth == 0 && has_comma) {
+                std::string prefix = pattern.substr(0, open);
+                std::string suffix = pattern.substr(i + 1);
+
+                // Split the body on top-level commas
+                std::vector<std::string> options;
+                std::string current;
+                int inner = 0;
+                for (size_t j = open + 1; j < i; j++) {
+                    char b = pattern[j];
+                    if (b == '\\' && j + 1 < i) { current += b; current += pattern[++j]; continue; }
+                    if (b == '{') inner++;
+                    if (b == '}') inner--;
+                    if (b == ',' && inner == 0) {
+                        options.push_back(current);
+                        current.clear();
+                    } else {
+                        current += b;
+                    }
+                }
+                options.push_back(current);
+
+                std::vector<std::string> result;
+                for (const auto& option : options) {
+                    for (const auto& expanded : expandBraces(prefix + option + suffix)) {
+                        result.push_back(expanded);
+                    }
+                }
+                return result;
+            }
+        }
+    }
+    return {pattern};
+}
+
+bool GlobMatcher::matchSegment(const char* p, const char* s) {
+    // Iterative wildcard match; on mismatch resume from the last '*'
+    const char* star_p = nullptr;
+    const char* star_s = nullptr;
+
+    while (*s) {
+        if (*p == '*') {
+            star_p = ++p;
+            star_s = s;
+            continue;
+        }
+
+        bool matched = false;
+        const char* next = p + 1;
+
+        if (*p == '?') {
+            matched = true;
+        } else if (*p == '[') {
+            const char* q = p + 1;
+            bool negate = (*q == '!' || *q == '^');
+            if (negate) q++;
+            bool in_set = false;
+            bool first = true;
+            while (*q && (*q != ']' || first)) {
+                char lo = *q;
+                if (lo == '\\' && q[1]) lo = *++q;
+                char hi = lo;
+                if (q[1] == '-' && q[2] && q[2] != ']') {
+                    hi = q[2];
+                    if (hi == '\\' && q[3]) { hi = q[3]; q++; }
+                    q += 2;
+                }
+                if (*s >= lo && *s <= hi) in_set = true;
+                q++;
+                first = false;
+            }
+            if (*q == ']') {
+                matched = (in_set != negate);
+                next = q + 1;
+            } else {
+                // Unterminated class: treat '[' literally
+                matched = (*s == '[');
+            }
+        } else if (*p == '\\' && p[1]) {
+            matched = (*s == p[1]);
+            next = p + 2;
+        } else if (*p) {
+            matched = (*p == *s);
+        }
+
+        if (matched) {
+            p = next;
+            s++;
+        } else if (star_p) {
+            p = star_p;
+            s = ++star_s;
+        } else {
+            return false;
+        }
+    }
+
+    while (*p == '*') p++;
+    return *p == '\0';
+}
+
+bool GlobMatcher::matchSegments(const std::vector<std::string>& pattern, size_t pi,
+                                const std::vector<std::string>& parts, size_t si) const {
+    while (pi < pattern.size()) {
+        if (pattern[pi] == "**") {
+            // Zero or more directories
+            for (size_t skip = si; skip <= parts.size(); skip++) {
+                if (matchSegments(pattern, pi + 1, parts, skip)) return true;
+            }
+            return false;
+        }
+        if (si >= parts.size() || !matchSegment(pattern[pi].c_str(), parts[si].c_str())) {
+            return false;
+        }
+        pi++;
+        si++;
+    }
+    return si == parts.size();
+}
+
+bool GlobMatcher::matches(const std::string& path) const {
+    if (name_only_) {
+        std::string name = utils::getBasename(path);
+        for (const auto& alternative : alternatives_) {
+            if (alternative.empty()) continue;
+            if (alternative[0] == "**" || matchSegment(alternative[0].c_str(), name.c_str())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Most paths fail on the file name; check it before splitting the path
+    std::string name = utils::getBasename(path);
+    std::vector<std::string> parts;
+
+    for (const auto& alternative : alternatives_) {
+        if (alternative.empty()) continue;
+        if (alternative.back() != "**" && !matchSegment(alternative.back().c_str(), name.c_str())) {
+            continue;
+        }
+
+        if (parts.empty()) {
+            std::string relative = path;
+            if (utils::startsWith(relative, "./")) relative = relative.substr(2);
+            for (const auto& part : utils::split(relative, '/')) {
+                if (!part.empty()) parts.push_back(part);
+            }
+        }
+        if (matchSegments(alternative, 0, parts, 0)) return true;
+    }
+    return false;
+}
+
+std::string GlobMatcher::literalPrefix() const {
+    if (name_only_ || alternatives_.empty()) return "";
+
+    auto isLiteral = [](const std::string& segment) {
+        return segment.find_first_of("*?[\\") == std::string::npos;
+    };
+
+    std::vector<std::string> prefix;
+    const auto& first = alternatives_[0];
+    for (size_t i = 0; i + 1 < first.size() && isLiteral(first[i]); i++) {
+        bool shared = true;
+        for (const auto& alternative : alternatives_) {
+            if (i + 1 >= alternative.size() || alternative[i] != first[i]) {
+                shared = false;
+                break;
+            }
+        }
+        if (!shared) break;
+        prefix.push_back(first[i]);
+    }
+
+    std::string result;
+    for (const auto& segment : prefix) {
+        result += (result.empty() ? "" : "/") + segment;
+    }
+    return result;
+}
+
+int GlobMatcher::maxDepth() const {
+    if (name_only_) return -1;
+
+    int depth = 0;
+    for (const auto& alternative : alternatives_) {
+        for (const auto& segment : alternative) {
+            if (segment == "**") return -1;
+        }
+        depth = std::max(depth, static_cast<int>(alternative.size()) - 1);
+    }
+    return depth;
+}
+
+} // namespace casper
@@ -0,0 +1,414 @@
+#include "grep_engine.h"
+#include "file_cache.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace casper {
+
+static const size_t BINARY_PROBE_BYTES = 8192;
+static const size_t MAX_FILE_SIZE = 64 * 1024 * 1024;
+static const size_t MAX_LINE_LENGTH = 500;
+
+static bool readWholeFile(const std::string& path, std::string& content) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || static_cast<size_t>(st.st_size) > MAX_FILE_SIZE) {
+        close(fd);
+        return false;
+    }
+
+    content.resize(static_cast<size_t>(st.st_size));
+    size_t total = 0;
+    while (total < content.size()) {
+        ssize_t n = read(fd, &content[total], content.size() - total);
+        if (n <= 0) break;
+        total += static_cast<size_t>(n);
+    }
+    content.resize(total);
+    close(fd);
+    return true;
+}
+
+static std::string lowerCopy(const char* data, size_t size) {
+    std::string lower(data, size);
+    for (char& c : lower) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return lower;
+}
+
+GrepEngine::GrepEngine(const GrepOptions& options)
+    : options_(options)
+    , literal_only_(false)
+{
+}
+
+std::string GrepEngine::requiredLiteral(const std::string& pattern) {
+    // Alternation means no single literal is required
+    int depth = 0;
+    bool in_class = false;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+        if (c == '\\') { i++; continue; }
+        if (in_class) { if (c == ']') in_class = false; continue; }
+        if (c == '[') in_class = true;
+        else if (c == '(') depth++;
+        else if (c == ')') depth--;
+        else if (c == '|') return "";
+    }
+
+    std::string best;
+    std::string current;
+    auto endRun = [&]() {
+        if (current.size() > best.size()) best = current;
+        current.clear();
+    };
+
+    depth = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+        char literal = 0;
+
+        if (c == '\\') {
+            // Classes, assertions, back references and \x41, \u0041, \cM
+            // codes; escaped punctuation is left to the regex as well
+            endRun();
+            if (i + 1 >= pattern.size()) continue;
+            char next = pattern[++i];
+            size_t digits = next == 'x' ? 2 : next == 'u' ? 4 : 0;
+            if (next == 'c') {
+                i++;
+            } else if (isdigit(static_cast<unsigned char>(next))) {
+                while (i + 1 < pattern.size() && isdigit(static_cast<unsigned char>(pattern[i + 1]))) i++;
+            }
+            while (digits-- > 0 && i + 1 < pattern.size() && isxdigit(static_cast<unsigned char>(pattern[i + 1]))) i++;
+            continue;
+        } else if (c == '[') {
+            endRun();
+            if (i + 1 < pattern.size() && pattern[i + 1] == ']') i++;
+            while (i + 1 < pattern.size() && pattern[++i] != ']') {
+                if (pattern[i] == '\\') i++;
+            }
+            continue;
+        } else if (c == '(') {
+            endRun();
+            depth++;
+            continue;
+        } else if (c == ')') {
+            endRun();
+            depth--;
+            continue;
+        } else if (strchr(".^$*+?{}", c)) {
+            // A quantifier makes the preceding character optional or repeated
+            if ((c == '*' || c == '?' || c == '{') && !current.empty()) {
+                current.pop_back();
+            }
+            endRun();
+            // The counts in {n,m} are not text to look for
+            if (c == '{') {
+                while (i + 1 < pattern.size() && pattern[++i] != '}') {}
+            }
+            continue;
+        } else {
+            literal = c;
+        }
+
+        if (depth > 0) continue;
+
+        // Lookahead: a following quantifier may make this character optional
+        if (i + 1 < pattern.size() && (pattern[i + 1] == '*' || pattern[i + 1] == '?' || pattern[i + 1] == '{')) {
+            endRun();
+            continue;
+        }
+        current += literal;
+    }
+    endRun();
+    return best;
+}
+
+bool GrepEngine::compile(std::string& error) {
+    if (options_.pattern.empty()) {
+        error = "Empty pattern";
+        return false;
+    }
+
+    bool has_meta = options_.pattern.find_first_of(".^$*+?()[]{}|\\") != std::string::npos;
+
+    if (options_.fixed_strings || !has_meta) {
+        literal_ = options_.pattern;
+        literal_only_ = true;
+    } else {
+        auto flags = std::regex::ECMAScript | std::regex::optimize;
+        if (options_.ignore_case) flags |= std::regex::icase;
+        try {
+            regex_ = std::make_unique<std::regex>(options_.pattern, flags);
+        } catch (const std::regex_error& e) {
+            error = "Invalid pattern: " + std::string(e.what());
+            return false;
+        }
+        literal_ = requiredLiteral(options_.pattern);
+    }
+
+    if (options_.ignore_case) {
+        literal_ = lowerCopy(literal_.data(), literal_.size());
+    }
+    return true;
+}
+
+bool GrepEngine::lineMatches(const char* begin, const char* end) const {
+    if (!regex_) return true;
+    return std::regex_search(begin, end, *regex_);
+}
+
+bool GrepEngine::searchFile(const std::string& path, GrepFileResult& file_result, size_t limit) {
+    std::string owned;
+    std::shared_ptr<const std::string> cached;
+    FileStamp stamp;
+    if (options_.cache && FileCache::stat(path, stamp) && options_.cache->cacheable(stamp)) {
+        std::string error;
+        cached = options_.cache->read(path, error);
+        if (!cached) return false;
+    } else if (!readWholeFile(path, owned)) {
+        return false;
+    }
+    const std::string& content = cached ? *cached : owned;
+    if (content.empty()) {
+        return false;
+    }
+
+    // Binary files contain NUL bytes early on
+    if (memchr(content.data(), '\0', std::min(content.size(), BINARY_PROBE_BYTES)) != nullptr) {
+        return false;
+    }
+
+    std::string lowered;
+    if (options_.ignore_case && !literal_.empty()) {
+        lowered = lowerCopy(content.data(), content.size());
+    }
+    const char* text = content.data();
+    const char* haystack = lowered.empty() ? text : lowered.data();
+    size_t size = content.size();
+
+    struct Match { size_t start; size_t end; size_t number; };
+    std::vector<Match> matches;
+
+    size_t pos = 0;
+    size_t counted_to = 0;      // Newlines counted up to this offset
+    size_t line_number = 1;
+
+    while (pos < size && matches.size() < limit) {
+        size_t line_start, line_end;
+
+        if (!literal_.empty()) {
+            // memmem/memchr are vectorized in libc; jump straight to candidate lines
+            const void* hit = memmem(haystack + pos, size - pos, literal_.data(), literal_.size());
+            if (!hit) break;
+            size_t offset = static_cast<const char*>(hit) - haystack;
+
+            line_start = offset;
+            while (line_start > pos && haystack[line_start - 1] != '\n') line_start--;
+            const void* nl = memchr(haystack + offset, '\n', size - offset);
+            line_end = nl ? static_cast<const char*>(nl) - haystack : size;
+        } else {
+            line_start = pos;
+            const void* nl = memchr(text + pos, '\n', size - pos);
+            line_end = nl ? static_cast<const char*>(nl) - text : size;
+        }
+
+        if (literal_only_ || lineMatches(text + line_start, text + line_end)) {
+            line_number += std::count(text + counted_to, text + line_start, '\n');
+            counted_to = line_start;
+            matches.push_back({line_start, line_end, line_number});
+        }
+
+        pos = line_end + 1;
+    }
+
+    if (matches.empty()) {
+        return false;
+    }
+
+    file_result.path = path;
+    file_result.match_count = matches.size();
+
+    if (options_.output_mode != "content") {
+        return true;
+    }
+
+    auto lineText = [&](size_t start, size_t end) {
+        std::string line(text + start, end - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.size() > MAX_LINE_LENGTH) {
+            line = line.substr(0, MAX_LINE_LENGTH) + "...";
+        }
+        return line;
+    };
+
+    if (options_.before_context <= 0 && options_.after_context <= 0) {
+        for (const auto& m : matches) {
+            file_result.lines.push_back({m.number, lineText(m.start, m.end), true});
+        }
+        return true;
+    }
+
+    // Context needs random access to lines
+    std::vector<size_t> starts = {0};
+    for (const char* p = text; (p = static_cast<const char*>(memchr(p, '\n', text + size - p))) != nullptr; p++) {
+        starts.push_back(p - text + 1);
+    }
+    if (starts.back() == size) starts.pop_back();
+
+    auto lineEnd = [&](size_t index) {
+        return index + 1 < starts.size() ? starts[index + 1] - 1 : size;
+    };
+
+    size_t next_line = 0;       // First line index not yet emitted
+    for (size_t i = 0; i < matches.size(); i++) {
+        size_t index = matches[i].number - 1;
+        size_t from = index > static_cast<size_t>(options_.before_context) ? index - options_.before_context : 0;
+        from = std::max(from, next_line);
+
+        for (size_t l = from; l < index; l++) {
+            file_result.lines.push_back({l + 1, lineText(starts[l], lineEnd(l)), false});
+        }
+        file_result.lines.push_back({index + 1, lineText(starts[index], lineEnd(index)), true});
+
+        size_t to = std::min(starts.size(), index + 1 + options_.after_context);
+        if (i + 1 < matches.size()) {
+            to = std::min(to, matches[i + 1].number - 1);
+        }
+        for (size_t l = index + 1; l < to; l++) {
+            file_result.lines.push_back({l + 1, lineText(starts[l], lineEnd(l)), false});
+        }
+        next_line = std::max(to, index + 1);
+    }
+    return true;
+}
+
+GrepResult GrepEngine::search() {
+    GrepResult result;
+
+    if (!compile(result.error)) {
+        return result;
+    }
+
+    WalkOptions walk_options;
+    walk_options.respect_gitignore = options_.respect_gitignore;
+    walk_options.include_hidden = options_.include_hidden;
+    FileWalker walker(walk_options);
+
+    bool content_mode = options_.output_mode == "content";
+    bool count_mode = options_.output_mode == "count";
+
+    std::mutex mutex;
+    std::atomic<size_t> found(0);
+    std::atomic<size_t> searched(0);
+
+    GlobMatcher glob(options_.glob);
+    std::string root = options_.path;
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+
+    walker.walk(options_.path, [&](const WalkEntry& entry) {
+        const std::string& path = entry.path;
+        if (!options_.glob.empty()) {
+            // Globs with a slash are relative to the search root, as in Glob
+            std::string relative = path.size() > root.size() && utils::startsWith(path, root)
+                ? path.substr(root == "/" ? 1 : root.size() + 1)
+                : path;
+            if (!glob.matches(relative)) {
+                return true;
+            }
+        }
+
+        size_t so_far = found.load();
+        if (so_far >= options_.max_results) {
+            return false;
+        }
+        size_t limit = content_mode ? options_.max_results - so_far : (count_mode ? SIZE_MAX : 1);
+
+        GrepFileResult file_result;
+        searched++;
+        if (!searchFile(path, file_result, limit)) {
+            return true;
+        }
+
+        size_t added = content_mode ? file_result.match_count : 1;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result.files.push_back(std::move(file_result));
+        }
+        return found.fetch_add(added) + added < options_.max_results;
+    });
+
+    std::sort(result.files.begin(), result.files.end(),
+              [](const GrepFileResult& a, const GrepFileResult& b) { return a.path < b.path; });
+
+    // Concurrent files may overshoot the cap slightly
+    size_t total = 0;
+    for (size_t i = 0; i < result.files.size(); i++) {
+        size_t count = content_mode ? result.files[i].match_count : 1;
+        if (total + count > options_.max_results) {
+            if (content_mode && total < options_.max_results) {
+                auto& file = result.files[i];
+                size_t keep_matches = options_.max_results - total;
+                size_t kept = 0;
+                size_t cut = 0;
+                while (cut < file.lines.size() && kept < keep_matches) {
+                    if (file.lines[cut++].is_match) kept++;
+                }
+                file.lines.resize(cut);
+                file.match_count = kept;
+                i++;
+            }
+            result.files.resize(i);
+            result.truncated = true;
+            break;
+        }
+        total += count;
+    }
+
+    result.truncated = result.truncated || walker.stopped();
+    result.files_searched = searched;
+    result.success = true;
+    return result;
+}
+
+std::string GrepEngine::format(const GrepResult& result, const std::string& output_mode) {
+    std::ostringstream out;
+
+    for (size_t f = 0; f < result.files.size(); f++) {
+        const auto& file = result.files[f];
+
+        if (output_mode == "count") {
+            out << file.path << ":" << file.match_count << "\n";
+        } else if (output_mode == "content") {
+            bool has_context = std::any_of(file.lines.begin(), file.lines.end(),
+                                           [](const GrepLine& l) { return !l.is_match; });
+            if (has_context && f > 0) out << "--\n";
+
+            size_t previous = 0;
+            for (const auto& line : file.lines) {
+                if (has_context && previous && line.number > previous + 1) out << "--\n";
+                out << file.path << (line.is_match ? ":" : "-") << line.number
+                    << (line.is_match ? ":" : "-") << line.text << "\n";
+                previous = line.number;
+            }
+        } else {
+            out << file.path << "\n";
+        }
+    }
+
+    return out.str();
+}
+
+} // namespace casper
@@ -0,0 +1,327 @@
+#include "job_manager.h"
+#include "process_runner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <condition_variable>
+#include <cstring>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace casper {
+
+namespace {
+
+const size_t READ_CHUNK = 64 * 1024;
+const int KILL_GRACE_MS = 2000;
+const int REAP_INTERVAL_MS = 250;
+
+// Keeps the newest capacity bytes of a stream, addressed by absolute offset
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) : data_(std::max<size_t>(capacity, 1)), total_(0) {}
+
+    void append(const char* bytes, size_t size) {
+        size_t capacity = data_.size();
+        if (size > capacity) {
+            total_ += size - capacity;
+            bytes += size - capacity;
+            size = capacity;
+        }
+        size_t at = total_ % capacity;
+        size_t first = std::min(size, capacity - at);
+        memcpy(&data_[at], bytes, first);
+        memcpy(&data_[0], bytes + first, size - first);
+        total_ += size;
+    }
+
+    // Bytes from offset to the end; dropped says how many were already overwritten
+    std::string read(size_t offset, size_t& dropped) const {
+        size_t oldest = total_ > data_.size() ? total_ - data_.size() : 0;
+        size_t from = std::max(offset, oldest);
+        dropped = from - std::min(offset, from);
+
+        std::string text;
+        text.reserve(total_ - from);
+        for (size_t pos = from; pos < total_; ) {
+            size_t at = pos % data_.size();
+            size_t run = std::min(total_ - pos, data_.size() - at);
+            text.append(&data_[at], run);
+            pos += run;
+        }
+        return text;
+    }
+
+    size_t total() const { return total_; }
+    size_t oldest() const { return total_ > data_.size() ? total_ - data_.size() : 0; }
+
+private:
+    std::vector<char> data_;
+    size_t total_;
+};
+
+std::string shellQuote(const std::string& value) {
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
+}
+
+} // namespace
+
+struct JobManager::Job {
+    int id;
+    std::string command;
+    SpawnedProcess process;
+    std::chrono::steady_clock::time_point started;
+    std::thread reader;
+    std::atomic<bool> abandoned{false};     // Stop reading, the manager is going away
+
+    std::mutex mutex;               // Guards everything below
+    std::condition_variable finished_cv;
+    RingBuffer output;
+    size_t read_offset = 0;         // Where the next unread output starts
+    bool running = true;
+    bool draining = true;           // Something in the job's process group still holds the pipes
+    int exit_code = -1;
+    int term_signal = 0;
+    std::chrono::steady_clock::time_point finished;
+
+    explicit Job(size_t buffer_bytes) : output(buffer_bytes) {}
+};
+
+JobManager::JobManager(size_t buffer_bytes)
+    : next_id_(1)
+    , buffer_bytes_(buffer_bytes)
+{
+}
+
+JobManager::~JobManager() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : jobs_) {
+        Job& job = *entry.second;
+        {
+            std::lock_guard<std::mutex> job_lock(job.mutex);
+            // The group outlives its leader while children it started in the background still run
+            if (job.running || job.draining) {
+                ::kill(-job.process.pid, SIGKILL);
+            }
+        }
+        job.abandoned = true;
+        if (job.reader.joinable()) {
+            job.reader.join();
+        }
+    }
+}
+
+void JobManager::drain(Job& job) {
+    int fds[2] = {job.process.stdout_fd, job.process.stderr_fd};
+    std::vector<char> chunk(READ_CHUNK);
+    bool reaped = false;
+
+    auto readAvailable = [&](int& fd) {
+        ssize_t n;
+        while ((n = read(fd, chunk.data(), chunk.size())) > 0) {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.output.append(chunk.data(), static_cast<size_t>(n));
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            close(fd);
+            fd = -1;
+        }
+    };
+
+    auto finish = [&](int status) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.running = false;
+        job.finished = std::chrono::steady_clock::now();
+        if (WIFEXITED(status)) {
+            job.exit_code = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            job.term_signal = WTERMSIG(status);
+            job.exit_code = 128 + job.term_signal;
+        }
+        job.finished_cv.notify_all();
+    };
+
+    // Children the job left running in the background may hold the pipes
+    // open after it exits, so the exit is checked for separately
+    while ((fds[0] >= 0 || fds[1] >= 0) && !job.abandoned) {
+        struct pollfd pfds[2];
+        nfds_t count = 0;
+        int* polled[2];
+        for (auto& fd : fds) {
+            if (fd < 0) continue;
+            pfds[count].fd = fd;
+            pfds[count].events = POLLIN;
+            pfds[count].revents = 0;
+            polled[count++] = &fd;
+        }
+
+        if (poll(pfds, count, REAP_INTERVAL_MS) < 0 && errno != EINTR) {
+            break;
+        }
+        for (nfds_t i = 0; i < count; i++) {
+            if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                readAvailable(*polled[i]);
+            }
+        }
+
+        int status = 0;
+        if (!reaped && waitpid(job.process.pid, &status, WNOHANG) == job.process.pid) {
+            reaped = true;
+            for (auto& fd : fds) {
+                if (fd >= 0) readAvailable(fd);
+            }
+            finish(status);
+        }
+    }
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.draining = false;
+    }
+
+    if (!reaped) {
+        int status = 0;
+        while (waitpid(job.process.pid, &status, 0) < 0 && errno == EINTR) {}
+        finish(status);
+    }
+    ProcessRunner::releaseGroup(job.process.pid);
+}
+
+int JobManager::start(const std::string& command, const std::string& working_dir, std::string& error) {
+    std::string script = command;
+    if (!working_dir.empty()) {
+        script = "cd " + shellQuote(working_dir) + " || exit 1\n" + command;
+    }
+
+    auto job = std::make_shared<Job>(buffer_bytes_);
+    job->command = command;
+    if (!ProcessRunner::spawn({"/bin/sh", "-c", script}, job->process, error)) {
+        return 0;
+    }
+    // Nothing is ever typed into a background job
+    close(job->process.stdin_fd);
+    job->process.stdin_fd = -1;
+    job->started = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->id = next_id_++;
+    jobs_[job->id] = job;
+    Job* raw = job.get();
+    job->reader = std::thread([raw]() { drain(*raw); });
+    return job->id;
+}
+
+std::shared_ptr<JobManager::Job> JobManager::find(int id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    return it == jobs_.end() ? nullptr : it->second;
+}
+
+bool JobManager::info(int id, JobInfo& info) const {
+    auto job = find(id);
+    if (!job) return false;
+
+    std::lock_guard<std::mutex> lock(job->mutex);
+    auto end = job->running ? std::chrono::steady_clock::now() : job->finished;
+    info.id = job->id;
+    info.command = job->command;
+    info.pid = job->process.pid;
+    info.running = job->running;
+    info.exit_code = job->exit_code;
+    info.term_signal = job->term_signal;
+    info.elapsed_ms = static_cast<long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - job->started).count());
+    info.output_bytes = job->output.total();
+    return true;
+}
+
+std::vector<JobInfo> JobManager::list() const {
+    std::vector<int> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : jobs_) {
+            ids.push_back(entry.first);
+        }
+    }
+
+    std::vector<JobInfo> infos;
+    for (int id : ids) {
+        JobInfo job_info;
+        if (info(id, job_info)) {
+            infos.push_back(job_info);
+        }
+    }
+    return infos;
+}
+
+bool JobManager::anyRunning() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : jobs_) {
+        std::lock_guard<std::mutex> job_lock(entry.second->mutex);
+        if (entry.second->running || entry.second->draining) return true;
+    }
+    return false;
+}
+
+bool JobManager::output(int id, int tail_lines, std::string& text) {
+    auto job = find(id);
+    if (!job) return false;
+
+    std::lock_guard<std::mutex> lock(job->mutex);
+    size_t dropped = 0;
+
+    if (tail_lines > 0) {
+        text = job->output.read(job->output.oldest(), dropped);
+        size_t pos = text.size();
+        if (pos > 0 && text[pos - 1] == '\n') pos--;
+        for (int lines = 0; lines < tail_lines && pos != std::string::npos && pos > 0; lines++) {
+            pos = text.rfind('\n', pos - 1);
+        }
+        if (pos != std::string::npos && pos > 0) {
+            text.erase(0, pos + 1);
+        }
+    } else {
+        text = job->output.read(job->read_offset, dropped);
+        if (dropped > 0) {
+            text = "[... " + std::to_string(dropped) + " bytes dropped ...]\n" + text;
+        }
+    }
+    job->read_offset = job->output.total();
+    return true;
+}
+
+bool JobManager::kill(int id, std::string& error) {
+    auto job = find(id);
+    if (!job) {
+        error = "No such job: " + std::to_string(id);
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    if (!job->running) {
+        error = "Job " + std::to_string(id) + " has already finished";
+        return false;
+    }
+
+    ::kill(-job->process.pid, SIGTERM);
+    if (!job->finished_cv.wait_for(lock, std::chrono::milliseconds(KILL_GRACE_MS),
+                                   [&job]() { return !job->running; })) {
+        ::kill(-job->process.pid, SIGKILL);
+        job->finished_cv.wait_for(lock, std::chrono::milliseconds(KILL_GRACE_MS),
+                                  [&job]() { return !job->running; });
+    }
+    return true;
+}
+
+} // namespace casper
@@ -0,0 +1,230 @@
+#include "line_diff.h"
+#include "utils.h"
+#include <algorithm>
+#include <functional>
+#include <sstream>
+
+namespace casper {
+
+// Beyond this many edits Myers' trace gets large; the changed block is
+// then reported as removed and re-added, which is still a correct diff
+static const int MAX_EDIT_DISTANCE = 2000;
+
+std::vector<std::string_view> LineDiff::splitLines(std::string_view text) {
+    std::vector<std::string_view> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t newline = text.find('\n', start);
+        if (newline == std::string_view::npos) {
+            lines.push_back(text.substr(start));
+            break;
+        }
+        lines.push_back(text.substr(start, newline - start));
+        start = newline + 1;
+    }
+    return lines;
+}
+
+// Edit script for a[0..n) -> b[0..m) as '=', '-' and '+' operations
+static std::vector<char> myers(const std::string_view* a, size_t n, const std::string_view* b, size_t m) {
+    std::vector<char> ops;
+    if (n == 0 || m == 0) {
+        ops.assign(n, '-');
+        ops.insert(ops.end(), m, '+');
+        return ops;
+    }
+
+    std::hash<std::string_view> hasher;
+    std::vector<size_t> ha(n), hb(m);
+    for (size_t i = 0; i < n; i++) ha[i] = hasher(a[i]);
+    for (size_t i = 0; i < m; i++) hb[i] = hasher(b[i]);
+    auto equal = [&](int x, int y) { return ha[x] == hb[y] && a[x] == b[y]; };
+
+    int N = static_cast<int>(n);
+    int M = static_cast<int>(m);
+    int max_d = std::min(N + M, MAX_EDIT_DISTANCE);
+    int offset = max_d + 1;
+    std::vector<int> v(2 * static_cast<size_t>(max_d) + 3, 0);
+    std::vector<std::vector<int>> trace;    // trace[d] = v over [-d+1, d-1] before step d
+
+    int found = -1;
+    for (int d = 0; d <= max_d && found < 0; d++) {
+        if (d == 0) {
+            trace.emplace_back();
+        } else {
+            trace.emplace_back(v.begin() + offset - d + 1, v.begin() + offset + d);
+        }
+
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) {
+                x = v[offset + k + 1];
+            } else {
+                x = v[offset + k - 1] + 1;
+            }
+            int y = x - k;
+            while (x < N && y < M && equal(x, y)) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= N && y >= M) {
+                found = d;
+                break;
+            }
+        }
+    }
+
+    if (found < 0) {
+        ops.assign(n, '-');
+        ops.insert(ops.end(), m, '+');
+        return ops;
+    }
+
+    // Walk the trace back from (N, M)
+    int x = N;
+    int y = M;
+    for (int d = found; d > 0; d--) {
+        const std::vector<int>& previous = trace[d];
+        auto at = [&](int k) { return previous[k + d - 1]; };
+
+        int k = x - y;
+        int prev_k = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+        int prev_x = at(prev_k);
+        int prev_y = prev_x - prev_k;
+
+        while (x > prev_x && y > prev_y) {
+            ops.push_back('=');
+            x--;
+            y--;
+        }
+        ops.push_back(x == prev_x ? '+' : '-');
+        x = prev_x;
+        y = prev_y;
+    }
+    while (x > 0 && y > 0) {
+        ops.push_back('=');
+        x--;
+        y--;
+    }
+
+    std::reverse(ops.begin(), ops.end());
+    return ops;
+}
+
+DiffResult LineDiff::compute(std::string_view old_text, std::string_view new_text, size_t context) {
+    DiffResult result;
+    std::vector<std::string_view> a = splitLines(old_text);
+    std::vector<std::string_view> b = splitLines(new_text);
+
+    size_t prefix = 0;
+    while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) {
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+           a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) {
+        suffix++;
+    }
+
+    std::vector<char> ops(prefix, '=');
+    std::vector<char> middle = myers(a.data() + prefix, a.size() - prefix - suffix,
+                                     b.data() + prefix, b.size() - prefix - suffix);
+    ops.insert(ops.end(), middle.begin(), middle.end());
+    ops.insert(ops.end(), suffix, '=');
+
+    // Group changes into hunks with up to `context` unchanged lines around them
+    size_t n = ops.size();
+    size_t idx = 0, i = 0, j = 0;
+    size_t last_end = 0;
+
+    while (true) {
+        while (idx < n && ops[idx] == '=') {
+            idx++;
+            i++;
+            j++;
+        }
+        if (idx == n) break;
+
+        DiffHunk hunk;
+        size_t lead = std::min(context, idx - last_end);
+        hunk.old_start = i - lead + 1;
+        hunk.new_start = j - lead + 1;
+        for (size_t t = lead; t > 0; t--) {
+            hunk.lines.push_back({' ', a[i - t]});
+        }
+        hunk.old_count = hunk.new_count = lead;
+
+        while (true) {
+            while (idx < n && ops[idx] != '=') {
+                if (ops[idx] == '-') {
+                    hunk.lines.push_back({'-', a[i++]});
+                    hunk.old_count++;
+                    result.removed++;
+                } else {
+                    hunk.lines.push_back({'+', b[j++]});
+                    hunk.new_count++;
+                    result.added++;
+                }
+                idx++;
+            }
+
+            size_t equal = 0;
+            while (idx + equal < n && ops[idx + equal] == '=') equal++;
+
+            // Close enough to the next change to share the hunk
+            bool join = idx + equal < n && equal <= 2 * context;
+            size_t take = join ? equal : std::min(equal, context);
+            for (size_t t = 0; t < take; t++) {
+                hunk.lines.push_back({' ', a[i++]});
+                j++;
+            }
+            idx += take;
+            hunk.old_count += take;
+            hunk.new_count += take;
+            if (!join) break;
+        }
+
+        // An empty side is addressed by the line before it
+        if (hunk.old_count == 0) hunk.old_start--;
+        if (hunk.new_count == 0) hunk.new_start--;
+        last_end = idx;
+        result.hunks.push_back(std::move(hunk));
+    }
+
+    return result;
+}
+
+std::string LineDiff::unified(const DiffResult& diff, const std::string& old_name,
+                              const std::string& new_name, bool color, size_t max_lines) {
+    std::ostringstream out;
+    const char* red = color ? utils::terminal::RED : "";
+    const char* green = color ? utils::terminal::GREEN : "";
+    const char* cyan = color ? utils::terminal::CYAN : "";
+    const char* reset = color ? utils::terminal::RESET : "";
+
+    out << "--- " << old_name << "\n";
+    out << "+++ " << new_name << "\n";
+
+    size_t total = 0;
+    for (const auto& hunk : diff.hunks) total += hunk.lines.size();
+
+    size_t written = 0;
+    for (const auto& hunk : diff.hunks) {
+        out << cyan << "@@ -" << hunk.old_start << "," << hunk.old_count
+            << " +" << hunk.new_start << "," << hunk.new_count << " @@" << reset << "\n";
+
+        for (const auto& line : hunk.lines) {
+            if (max_lines > 0 && written == max_lines) {
+                out << "... (" << total - written << " more diff lines)\n";
+                return out.str();
+            }
+            const char* tint = line.op == '-' ? red : (line.op == '+' ? green : "");
+            out << tint << line.op << line.text << (*tint ? reset : "") << "\n";
+            written++;
+        }
+    }
+    return out.str();
+}
+
+} // namespace casper
@@ -0,0 +1,183 @@
+#include "mapped_file.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace casper {
+
+static const size_t BINARY_PROBE_BYTES = 8192;
+
+MappedFile::MappedFile()
+    : data_(nullptr)
+    , size_(0)
+    , mapped_(false)
+    , indexed_to_(0)
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::close() {
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    buffer_.clear();
+    shared_.reset();
+    line_starts_.clear();
+    indexed_to_ = 0;
+}
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "Cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        error = "Cannot stat " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        error = path + " is a directory";
+        ::close(fd);
+        return false;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            data_ = static_cast<const char*>(map);
+            size_ = static_cast<size_t>(st.st_size);
+            mapped_ = true;
+            ::close(fd);
+            return true;
+        }
+    }
+
+    // Size unknown up front (/proc, pipes) or mmap refused
+    char chunk[65536];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer_.append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    if (n < 0) {
+        error = "Cannot read " + path + ": " + strerror(errno);
+        buffer_.clear();
+        return false;
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
+
+void MappedFile::assign(std::shared_ptr<const std::string> content) {
+    close();
+    shared_ = std::move(content);
+    data_ = shared_->data();
+    size_ = shared_->size();
+}
+
+bool MappedFile::isBinary() const {
+    size_t probe = std::min(size_, BINARY_PROBE_BYTES);
+    if (probe == 0) return false;
+    if (memchr(data_, '\0', probe) != nullptr) return true;
+
+    // Tabs, newlines, form feeds and ANSI escapes are text; other control bytes are not
+    size_t control = 0;
+    for (size_t i = 0; i < probe; i++) {
+        unsigned char c = static_cast<unsigned char>(data_[i]);
+        if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != 0x1b) {
+            control++;
+        }
+    }
+    return control * 10 > probe;
+}
+
+std::string MappedFile::binaryType() const {
+    struct Magic {
+        const char* bytes;
+        size_t length;
+        const char* type;
+    };
+    static const Magic magics[] = {
+        {"\x7f" "ELF", 4, "ELF executable"},
+        {"\xcf\xfa\xed\xfe", 4, "Mach-O executable"},
+        {"MZ", 2, "Windows executable"},
+        {"\x89PNG", 4, "PNG image"},
+        {"\xff\xd8\xff", 3, "JPEG image"},
+        {"GIF8", 4, "GIF image"},
+        {"%PDF", 4, "PDF document"},
+        {"PK\x03\x04", 4, "Zip archive"},
+        {"\x1f\x8b", 2, "gzip archive"},
+        {"BZh", 3, "bzip2 archive"},
+        {"\xfd" "7zXZ", 5, "xz archive"},
+        {"\x28\xb5\x2f\xfd", 4, "zstd archive"},
+        {"SQLite format 3", 15, "SQLite database"},
+        {"\xca\xfe\xba\xbe", 4, "Java class or universal binary"},
+        {"\0asm", 4, "WebAssembly module"},
+    };
+
+    for (const auto& magic : magics) {
+        if (size_ >= magic.length && memcmp(data_, magic.bytes, magic.length) == 0) {
+            return magic.type;
+        }
+    }
+    if (size_ > 262 && memcmp(data_ + 257, "ustar", 5) == 0) {
+        return "tar archive";
+    }
+    return "";
+}
+
+size_t MappedFile::lineOffset(size_t line) {
+    if (line_starts_.empty() && size_ > 0) {
+        line_starts_.push_back(0);
+    }
+
+    while (line_starts_.size() < line && indexed_to_ < size_) {
+        const void* newline = memchr(data_ + indexed_to_, '\n', size_ - indexed_to_);
+        if (!newline) {
+            indexed_to_ = size_;
+            break;
+        }
+        indexed_to_ = static_cast<size_t>(static_cast<const char*>(newline) - data_) + 1;
+        if (indexed_to_ < size_) {
+            line_starts_.push_back(indexed_to_);
+        }
+    }
+
+    if (line == 0) return 0;
+    return line <= line_starts_.size() ? line_starts_[line - 1] : size_;
+}
+
+size_t MappedFile::tailOffset(size_t count) const {
+    if (count == 0) return size_;
+
+    size_t pos = size_;
+    if (pos > 0 && data_[pos - 1] == '\n') pos--;     // The final newline ends the last line
+
+    size_t found = 0;
+    while (pos > 0) {
+        if (data_[pos - 1] == '\n' && ++found == count) {
+            return pos;
+        }
+        pos--;
+    }
+    return 0;
+}
+
+} // namespace casper
@@ -673,6 +673,11 @@ bool MCPClient::loadConfig(const std::string& configPath) {
                     sc.env = server["env"].get<std::map<std::string, std::string>>();
                 }
 
+                sc.read_only = server.value("readOnly", false);
+                if (server.contains("readOnlyTools") && server["readOnlyTools"].is_array()) {
+                    sc.read_only_tools = server["readOnlyTools"].get<std::vector<std::string>>();
+                }
+
                 addServer(sc);
             }
         }
@@ -698,6 +703,12 @@ bool MCPClient::saveConfig(const std::string& configPath) {
         if (!sc.url.empty()) {
             server["url"] = sc.url;
         }
+        if (sc.read_only) {
+            server["readOnly"] = true;
+        }
+        if (!sc.read_only_tools.empty()) {
+            server["readOnlyTools"] = sc.read_only_tools;
+        }
         config["mcpServers"][name] = server;
     }
 
@@ -0,0 +1,774 @@
+#include "net_probe.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
+namespace casper {
+
+using Clock = std::chrono::steady_clock;
+
+// Sockets open at once while pinging; larger target lists go in batches
+static const size_t PING_BATCH = 256;
+static const int UDP_PROBE_PORT = 33434;       // Traceroute's traditional base port
+static const int TRACE_PROBE_SPACING_MS = 50;
+
+static const std::map<int, const char*> kServices = {
+    {21, "ftp"}, {22, "ssh"}, {23, "telnet"}, {25, "smtp"}, {53, "domain"}, {80, "http"},
+    {81, "http-alt"}, {88, "kerberos"}, {110, "pop3"}, {111, "rpcbind"}, {135, "msrpc"},
+    {139, "netbios-ssn"}, {143, "imap"}, {389, "ldap"}, {443, "https"}, {445, "microsoft-ds"},
+    {465, "smtps"}, {587, "submission"}, {631, "ipp"}, {636, "ldaps"}, {873, "rsync"},
+    {993, "imaps"}, {995, "pop3s"}, {1080, "socks"}, {1433, "mssql"}, {1521, "oracle"},
+    {1723, "pptp"}, {2049, "nfs"}, {2375, "docker"}, {2376, "docker-tls"}, {3000, "http-dev"},
+    {3306, "mysql"}, {3389, "rdp"}, {4443, "https-alt"}, {5000, "upnp"}, {5432, "postgresql"},
+    {5601, "kibana"}, {5672, "amqp"}, {5900, "vnc"}, {5984, "couchdb"}, {6379, "redis"},
+    {6443, "kubernetes"}, {7001, "weblogic"}, {8000, "http-alt"}, {8008, "http-alt"},
+    {8080, "http-proxy"}, {8081, "http-alt"}, {8088, "http-alt"}, {8443, "https-alt"},
+    {8888, "http-alt"}, {9000, "http-alt"}, {9042, "cassandra"}, {9090, "prometheus"},
+    {9092, "kafka"}, {9200, "elasticsearch"}, {9300, "elasticsearch"}, {9418, "git"},
+    {10250, "kubelet"}, {11211, "memcached"}, {11434, "ollama"}, {15672, "rabbitmq"},
+    {27017, "mongodb"},
+};
+
+namespace {
+
+double elapsedMs(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+int msUntil(Clock::time_point when) {
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(when - Clock::now()).count();
+    return static_cast<int>(std::max<long long>(0, ms + 1));
+}
+
+int openSocket(int family, int type, int protocol) {
+    int fd = socket(family, type, protocol);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+void setPort(sockaddr_storage& addr, int port) {
+    if (addr.ss_family == AF_INET) {
+        reinterpret_cast<sockaddr_in*>(&addr)->sin_port = htons(static_cast<uint16_t>(port));
+    } else {
+        reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port = htons(static_cast<uint16_t>(port));
+    }
+}
+
+uint16_t checksum(const unsigned char* data, size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) sum += (data[i] << 8) | data[i + 1];
+    if (len & 1) sum += data[len - 1] << 8;
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return static_cast<uint16_t>(~sum);
+}
+
+bool parseIPv4(const std::string& text, uint32_t& value) {
+    in_addr addr;
+    if (inet_pton(AF_INET, text.c_str(), &addr) != 1) return false;
+    value = ntohl(addr.s_addr);
+    return true;
+}
+
+std::string formatIPv4(uint32_t value) {
+    in_addr addr;
+    addr.s_addr = htonl(value);
+    char text[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr, text, sizeof(text));
+    return text;
+}
+
+std::string formatMs(double ms) {
+    char text[32];
+    snprintf(text, sizeof(text), ms < 10 ? "%.3f" : "%.1f", ms);
+    return text;
+}
+
+std::string label(const NetTarget& target) {
+    if (target.address.empty() || target.address == target.name) return target.name;
+    return target.name + " (" + target.address + ")";
+}
+
+} // namespace
+
+bool NetProbe::parseTargets(const std::string& spec, std::vector<std::string>& hosts, std::string& error,
+                            size_t max_hosts) {
+    std::string list = spec;
+    std::replace(list.begin(), list.end(), ',', ' ');
+    std::istringstream tokens(list);
+    std::string token;
+
+    while (tokens >> token) {
+        size_t slash = token.find('/');
+        size_t dash = token.rfind('-');
+        uint32_t base;
+
+        if (slash != std::string::npos && parseIPv4(token.substr(0, slash), base)) {
+            int prefix = std::atoi(token.c_str() + slash + 1);
+            if (prefix < 0 || prefix > 32 || token.find_first_not_of("0123456789", slash + 1) != std::string::npos) {
+                error = "Invalid CIDR range: " + token;
+                return false;
+            }
+            uint64_t count = 1ULL << (32 - prefix);
+            if (hosts.size() + count > max_hosts + 2) {
+                error = token + " has " + std::to_string(count) + " addresses; at most " +
+                        std::to_string(max_hosts) + " hosts can be probed at once";
+                return false;
+            }
+            uint32_t mask = prefix == 0 ? 0 : ~0u << (32 - prefix);
+            uint32_t network = base & mask;
+            // Skip the network and broadcast addresses except in /31 and /32
+            uint64_t first = prefix >= 31 ? 0 : 1;
+            uint64_t last = prefix >= 31 ? count : count - 1;
+            for (uint64_t i = first; i < last; i++) {
+                hosts.push_back(formatIPv4(network + static_cast<uint32_t>(i)));
+            }
+        } else if (dash != std::string::npos && parseIPv4(token.substr(0, dash), base) &&
+                   dash + 1 < token.size() && token.find_first_not_of("0123456789", dash + 1) == std::string::npos) {
+            // "10.0.0.5-20" varies the last octet
+            int end = std::atoi(token.c_str() + dash + 1);
+            int start = static_cast<int>(base & 0xff);
+            if (end > 255 || end < start) {
+                error = "Invalid address range: " + token;
+                return false;
+            }
+            for (int octet = start; octet <= end; octet++) {
+                hosts.push_back(formatIPv4((base & ~0xffu) | static_cast<uint32_t>(octet)));
+            }
+        } else {
+            hosts.push_back(token);
+        }
+
+        if (hosts.size() > max_hosts) {
+            error = "Too many hosts; at most " + std::to_string(max_hosts) + " can be probed at once";
+            return false;
+        }
+    }
+
+    if (hosts.empty()) {
+        error = "No hosts given";
+        return false;
+    }
+    return true;
+}
+
+bool NetProbe::parsePorts(const std::string& spec, std::vector<int>& ports, std::string& error) {
+    if (utils::trim(spec).empty()) {
+        ports = commonPorts();
+        return true;
+    }
+
+    std::string list = spec;
+    std::replace(list.begin(), list.end(), ',', ' ');
+    std::istringstream tokens(list);
+    std::string token;
+    while (tokens >> token) {
+        if (token.find_first_not_of("0123456789-") != std::string::npos) {
+            error = "Invalid port: " + token;
+            return false;
+        }
+        size_t dash = token.find('-');
+        int first = std::atoi(token.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(token.c_str() + dash + 1);
+        if (dash != std::string::npos && dash + 1 == token.size()) last = 65535;
+        if (first < 1 || last > 65535 || last < first) {
+            error = "Invalid port range: " + token;
+            return false;
+        }
+        for (int port = first; port <= last; port++) ports.push_back(port);
+    }
+    std::sort(ports.begin(), ports.end());
+    ports.erase(std::unique(ports.begin(), ports.end()), ports.end());
+    if (ports.empty()) {
+        error = "No ports given";
+        return false;
+    }
+    return true;
+}
+
+std::vector<int> NetProbe::commonPorts() {
+    std::vector<int> ports;
+    for (const auto& service : kServices) ports.push_back(service.first);
+    return ports;
+}
+
+std::vector<NetTarget> NetProbe::resolve(const std::vector<std::string>& hosts) {
+    std::vector<NetTarget> targets(hosts.size());
+    std::vector<size_t> lookups;
+
+    for (size_t i = 0; i < hosts.size(); i++) {
+        NetTarget& target = targets[i];
+        target.name = hosts[i];
+        sockaddr_in* v4 = reinterpret_cast<sockaddr_in*>(&target.addr);
+        sockaddr_in6* v6 = reinterpret_cast<sockaddr_in6*>(&target.addr);
+        if (inet_pton(AF_INET, hosts[i].c_str(), &v4->sin_addr) == 1) {
+            v4->sin_family = AF_INET;
+            target.addr_len = sizeof(sockaddr_in);
+            target.address = hosts[i];
+        } else if (inet_pton(AF_INET6, hosts[i].c_str(), &v6->sin6_addr) == 1) {
+            v6->sin6_family = AF_INET6;
+            target.addr_len = sizeof(sockaddr_in6);
+            target.address = hosts[i];
+        } else {
+            lookups.push_back(i);
+        }
+    }
+    if (lookups.empty()) return targets;
+
+    // getaddrinfo blocks, so names are looked up side by side
+    ThreadPool pool(std::min<size_t>(lookups.size(), 16));
+    for (size_t i : lookups) {
+        pool.submit([&targets, i]() {
+            NetTarget& target = targets[i];
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* found = nullptr;
+            int status = getaddrinfo(target.name.c_str(), nullptr, &hints, &found);
+            if (status != 0 || !found) {
+                target.error = std::string("cannot resolve: ") + gai_strerror(status);
+                return;
+            }
+            // IPv4 first, since ICMP and traceroute only do IPv4
+            const addrinfo* chosen = found;
+            for (const addrinfo* ai = found; ai; ai = ai->ai_next) {
+                if (ai->ai_family == AF_INET) { chosen = ai; break; }
+            }
+            memcpy(&target.addr, chosen->ai_addr, chosen->ai_addrlen);
+            target.addr_len = static_cast<socklen_t>(chosen->ai_addrlen);
+            char text[INET6_ADDRSTRLEN];
+            const void* raw = chosen->ai_family == AF_INET
+                ? static_cast<const void*>(&reinterpret_cast<sockaddr_in*>(chosen->ai_addr)->sin_addr)
+                : static_cast<const void*>(&reinterpret_cast<sockaddr_in6*>(chosen->ai_addr)->sin6_addr);
+            inet_ntop(chosen->ai_family, raw, text, sizeof(text));
+            target.address = text;
+            freeaddrinfo(found);
+        });
+    }
+    pool.wait();
+    return targets;
+}
+
+std::vector<PingResult> NetProbe::ping(const std::vector<NetTarget>& targets, int count, int timeout_ms,
+                                       int interval_ms) {
+    std::vector<PingResult> results(targets.size());
+    count = std::max(1, count);
+
+    // Unprivileged ICMP sockets depend on net.ipv4.ping_group_range; raw ones on root
+    enum Method { ICMP_DGRAM, ICMP_RAW, UDP };
+    Method preferred = ICMP_DGRAM;
+
+    struct Probe {
+        int fd = -1;
+        Method method = UDP;
+        uint16_t ident = 0;
+        std::vector<Clock::time_point> sent_at;
+        std::vector<bool> answered;
+        double total_ms = 0;
+    };
+
+    for (size_t batch = 0; batch < targets.size(); batch += PING_BATCH) {
+        size_t batch_end = std::min(targets.size(), batch + PING_BATCH);
+        std::vector<Probe> probes(batch_end - batch);
+
+        for (size_t i = batch; i < batch_end; i++) {
+            PingResult& result = results[i];
+            Probe& probe = probes[i - batch];
+            result.target = targets[i];
+            if (!targets[i].error.empty()) {
+                result.error = targets[i].error;
+                continue;
+            }
+
+            sockaddr_storage addr = targets[i].addr;
+            if (addr.ss_family == AF_INET && preferred == ICMP_DGRAM) {
+                probe.fd = openSocket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+                if (probe.fd >= 0) probe.method = ICMP_DGRAM;
+                else preferred = ICMP_RAW;
+            }
+            if (probe.fd < 0 && addr.ss_family == AF_INET && preferred == ICMP_RAW) {
+                probe.fd = openSocket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+                if (probe.fd >= 0) probe.method = ICMP_RAW;
+                else preferred = UDP;
+            }
+            if (probe.fd < 0) {
+                probe.fd = openSocket(addr.ss_family, SOCK_DGRAM, 0);
+                probe.method = UDP;
+                setPort(addr, UDP_PROBE_PORT);
+            }
+            if (probe.fd < 0 || connect(probe.fd, reinterpret_cast<const sockaddr*>(&addr), targets[i].addr_len) != 0) {
+                result.error = std::string("cannot open probe socket: ") + strerror(errno);
+                if (probe.fd >= 0) close(probe.fd);
+                probe.fd = -1;
+                continue;
+            }
+            probe.ident = static_cast<uint16_t>((getpid() + i) & 0xffff);
+            probe.sent_at.resize(count);
+            probe.answered.assign(count, false);
+            result.method = probe.method == UDP ? "udp" : "icmp";
+        }
+
+        auto send = [&](Probe& probe, PingResult& result, int seq) {
+            if (probe.fd < 0) return;
+            probe.sent_at[seq] = Clock::now();
+            ssize_t n;
+            if (probe.method == UDP) {
+                n = ::send(probe.fd, "casper", 6, 0);
+                // A refusal left over from the previous probe answers that one
+                if (n < 0 && errno == ECONNREFUSED) n = ::send(probe.fd, "casper", 6, 0);
+            } else {
+                unsigned char packet[24] = {8, 0};
+                packet[4] = static_cast<unsigned char>(probe.ident >> 8);
+                packet[5] = static_cast<unsigned char>(probe.ident & 0xff);
+                packet[6] = static_cast<unsigned char>(seq >> 8);
+                packet[7] = static_cast<unsigned char>(seq & 0xff);
+                memcpy(packet + 8, "casper-ping-probe", 16);
+                uint16_t sum = checksum(packet, sizeof(packet));
+                packet[2] = static_cast<unsigned char>(sum >> 8);
+                packet[3] = static_cast<unsigned char>(sum & 0xff);
+                n = ::send(probe.fd, packet, sizeof(packet), 0);
+            }
+            if (n >= 0) {
+                result.sent++;
+            } else if (result.error.empty()) {
+                result.error = strerror(errno);
+            }
+        };
+
+        auto answer = [&](Probe& probe, PingResult& result, int seq) {
+            if (seq < 0 || seq >= count || probe.answered[seq] || probe.sent_at[seq] == Clock::time_point()) return;
+            double rtt = elapsedMs(probe.sent_at[seq]);
+            probe.answered[seq] = true;
+            result.min_ms = result.received == 0 ? rtt : std::min(result.min_ms, rtt);
+            result.max_ms = std::max(result.max_ms, rtt);
+            probe.total_ms += rtt;
+            result.received++;
+            result.avg_ms = probe.total_ms / result.received;
+        };
+
+        Clock::time_point start = Clock::now();
+        Clock::time_point deadline = start + std::chrono::milliseconds((count - 1) * interval_ms + timeout_ms);
+        int next_seq = 0;
+        unsigned char buffer[2048];
+
+        while (true) {
+            while (next_seq < count && Clock::now() >= start + std::chrono::milliseconds(next_seq * interval_ms)) {
+                for (size_t k = 0; k < probes.size(); k++) send(probes[k], results[batch + k], next_seq);
+                next_seq++;
+            }
+
+            bool waiting = false;
+            std::vector<pollfd> fds;
+            std::vector<size_t> owners;
+            for (size_t k = 0; k < probes.size(); k++) {
+                if (probes[k].fd < 0) continue;
+                if (results[batch + k].received < results[batch + k].sent || next_seq < count) waiting = true;
+                fds.push_back({probes[k].fd, POLLIN, 0});
+                owners.push_back(k);
+            }
+            if (!waiting || Clock::now() >= deadline) break;
+
+            Clock::time_point wake = deadline;
+            if (next_seq < count) wake = std::min(wake, start + std::chrono::milliseconds(next_seq * interval_ms));
+            if (poll(fds.data(), fds.size(), msUntil(wake)) <= 0) continue;
+
+            for (size_t j = 0; j < fds.size(); j++) {
+                if (!(fds[j].revents & (POLLIN | POLLERR))) continue;
+                Probe& probe = probes[owners[j]];
+                PingResult& result = results[batch + owners[j]];
+
+                ssize_t n;
+                while ((n = recv(probe.fd, buffer, sizeof(buffer), 0)) != 0) {
+                    if (n < 0 && errno != ECONNREFUSED) break;
+                    if (probe.method == UDP) {
+                        // "Port unreachable" or any reply means the host is up;
+                        // it answers the oldest probe still outstanding
+                        for (int seq = 0; seq < count; seq++) {
+                            if (!probe.answered[seq] && probe.sent_at[seq] != Clock::time_point()) {
+                                answer(probe, result, seq);
+                                break;
+                            }
+                        }
+                        if (n < 0) break;
+                        continue;
+                    }
+                    if (n < 0) break;
+
+                    // Raw sockets (and macOS ping sockets) include the IP header
+                    const unsigned char* icmp = buffer;
+                    size_t len = static_cast<size_t>(n);
+                    if ((buffer[0] >> 4) == 4) {
+                        size_t header = (buffer[0] & 0x0f) * 4u;
+                        if (len < header + 8) continue;
+                        icmp += header;
+                        len -= header;
+                    }
+                    if (len < 8 || icmp[0] != 0) continue;      // Not an echo reply
+                    uint16_t ident = static_cast<uint16_t>((icmp[4] << 8) | icmp[5]);
+                    // Linux ping sockets replace the identifier with their own
+                    if (probe.method == ICMP_RAW && ident != probe.ident) continue;
+                    answer(probe, result, (icmp[6] << 8) | icmp[7]);
+                }
+            }
+        }
+
+        for (auto& probe : probes) {
+            if (probe.fd >= 0) close(probe.fd);
+        }
+    }
+    return results;
+}
+
+bool NetProbe::tracerouteSupported(const NetTarget& target) {
+#ifdef __linux__
+    return target.error.empty() && target.addr.ss_family == AF_INET;
+#else
+    (void)target;
+    return false;
+#endif
+}
+
+TraceResult NetProbe::traceroute(const NetTarget& target, int max_hops, int probes, int timeout_ms) {
+    TraceResult result;
+    result.target = target;
+    if (!tracerouteSupported(target)) {
+        result.error = target.error.empty() ? "Native traceroute needs Linux and an IPv4 target" : target.error;
+        return result;
+    }
+#ifdef __linux__
+    max_hops = std::max(1, std::min(max_hops, 64));
+    probes = std::max(1, std::min(probes, 5));
+
+    // One socket per TTL, so each error is tied to its hop
+    std::vector<int> fds(max_hops, -1);
+    std::vector<std::vector<Clock::time_point>> sent_at(max_hops, std::vector<Clock::time_point>(probes));
+    result.hops.resize(max_hops);
+    for (int h = 0; h < max_hops; h++) {
+        result.hops[h].ttl = h + 1;
+        int fd = openSocket(AF_INET, SOCK_DGRAM, 0);
+        int ttl = h + 1;
+        int on = 1;
+        sockaddr_storage addr = target.addr;
+        setPort(addr, UDP_PROBE_PORT + h);
+        if (fd < 0 || setsockopt(fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl)) != 0 ||
+            setsockopt(fd, IPPROTO_IP, IP_RECVERR, &on, sizeof(on)) != 0 ||
+            connect(fd, reinterpret_cast<const sockaddr*>(&addr), target.addr_len) != 0) {
+            result.error = std::string("cannot open probe socket: ") + strerror(errno);
+            if (fd >= 0) close(fd);
+            for (int fd_open : fds) if (fd_open >= 0) close(fd_open);
+            return result;
+        }
+        fds[h] = fd;
+    }
+
+    int reached_ttl = max_hops + 1;     // Lowest TTL the destination answered
+    auto record = [&](int h, int probe, const std::string& address, bool reached, const std::string& note) {
+        TraceHop& hop = result.hops[h];
+        if (probe < 0 || probe >= probes || sent_at[h][probe] == Clock::time_point()) return;
+        hop.rtts_ms.push_back(elapsedMs(sent_at[h][probe]));
+        sent_at[h][probe] = Clock::time_point();        // Count each probe once
+        if (hop.address.empty()) hop.address = address;
+        if (reached) {
+            hop.reached = true;
+            hop.note = note;
+            reached_ttl = std::min(reached_ttl, h + 1);
+        }
+    };
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::milliseconds((probes - 1) * TRACE_PROBE_SPACING_MS + timeout_ms);
+    int next_probe = 0;
+    char data[64];
+    char control[512];
+
+    while (Clock::now() < deadline) {
+        while (next_probe < probes && Clock::now() >= start + std::chrono::milliseconds(next_probe * TRACE_PROBE_SPACING_MS)) {
+            unsigned char payload = static_cast<unsigned char>(next_probe);
+            for (int h = 0; h < max_hops && h < reached_ttl; h++) {
+                sent_at[h][next_probe] = Clock::now();
+                send(fds[h], &payload, 1, 0);
+            }
+            next_probe++;
+        }
+
+        // Done when every hop up to the destination has all its answers
+        bool complete = next_probe == probes && reached_ttl <= max_hops;
+        for (int h = 0; complete && h < reached_ttl; h++) {
+            if (static_cast<int>(result.hops[h].rtts_ms.size()) < probes) complete = false;
+        }
+        if (complete) break;
+
+        std::vector<pollfd> pfds;
+        for (int h = 0; h < max_hops; h++) pfds.push_back({fds[h], POLLIN, 0});
+        Clock::time_point wake = deadline;
+        if (next_probe < probes) wake = std::min(wake, start + std::chrono::milliseconds(next_probe * TRACE_PROBE_SPACING_MS));
+        if (poll(pfds.data(), pfds.size(), msUntil(wake)) <= 0) continue;
+
+        for (int h = 0; h < max_hops; h++) {
+            if (pfds[h].revents & POLLIN) {
+                // Something answered the UDP probe itself: that is the destination
+                ssize_t n = recv(fds[h], data, sizeof(data), 0);
+                if (n > 0) {
+                    for (int p = 0; p < probes; p++) {
+                        if (sent_at[h][p] != Clock::time_point()) { record(h, p, target.address, true, ""); break; }
+                    }
+                }
+            }
+            if (!(pfds[h].revents & POLLERR)) continue;
+
+            while (true) {
+                iovec iov = {data, sizeof(data)};
+                sockaddr_in offender_addr = {};
+                msghdr msg = {};
+                msg.msg_name = &offender_addr;
+                msg.msg_namelen = sizeof(offender_addr);
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                ssize_t n = recvmsg(fds[h], &msg, MSG_ERRQUEUE);
+                if (n < 0) break;
+
+                for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+                    if (cm->cmsg_level != IPPROTO_IP || cm->cmsg_type != IP_RECVERR) continue;
+                    const sock_extended_err* ee = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+                    if (ee->ee_origin != SO_EE_ORIGIN_ICMP) continue;
+
+                    const sockaddr_in* from = reinterpret_cast<const sockaddr_in*>(SO_EE_OFFENDER(ee));
+                    char text[INET_ADDRSTRLEN] = "";
+                    inet_ntop(AF_INET, &from->sin_addr, text, sizeof(text));
+                    int probe = n > 0 ? static_cast<unsigned char>(data[0]) : -1;
+
+                    if (ee->ee_type == 11) {                // Time exceeded: an intermediate hop
+                        record(h, probe, text, false, "");
+                    } else if (ee->ee_type == 3) {          // Unreachable: the end of the path
+                        static const char* notes[] = {"!N", "!H", "!P", ""};
+                        std::string note = ee->ee_code < 4 ? notes[ee->ee_code] : "!X";
+                        record(h, probe, text, true, note);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int fd : fds) close(fd);
+
+    result.reached = reached_ttl <= max_hops;
+    if (result.reached) {
+        result.hops.resize(reached_ttl);
+    } else {
+        // Silent hops past the last one that answered add nothing
+        size_t last = 0;
+        for (size_t h = 0; h < result.hops.size(); h++) {
+            if (!result.hops[h].address.empty()) last = h + 1;
+        }
+        result.hops.resize(std::min(result.hops.size(), last + 1));
+    }
+#else
+    (void)max_hops;
+    (void)probes;
+    (void)timeout_ms;
+#endif
+    return result;
+}
+
+std::vector<ScanResult> NetProbe::scan(const std::vector<NetTarget>& targets, const std::vector<int>& ports,
+                                       size_t concurrency, int timeout_ms) {
+    std::vector<ScanResult> results(targets.size());
+    for (size_t t = 0; t < targets.size(); t++) results[t].target = targets[t];
+
+    // Stay well inside the open file limit
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > 64) {
+        concurrency = std::min<size_t>(concurrency, limit.rlim_cur - 48);
+    }
+    concurrency = std::max<size_t>(concurrency, 1);
+
+    struct Attempt {
+        int fd;
+        size_t target;
+        int port;
+        Clock::time_point start;
+    };
+    std::vector<Attempt> active;
+    size_t next_target = 0, next_port = 0;
+
+    auto finish = [&](const Attempt& attempt, PortState state) {
+        PortResult port;
+        port.port = attempt.port;
+        port.state = state;
+        port.rtt_ms = elapsedMs(attempt.start);
+        results[attempt.target].ports.push_back(port);
+    };
+
+    while (true) {
+        // Fill the window, host by host
+        while (active.size() < concurrency && next_target < targets.size()) {
+            const NetTarget& target = targets[next_target];
+            if (!target.error.empty()) {
+                next_target++;
+                next_port = 0;
+                continue;
+            }
+            Attempt attempt = {-1, next_target, ports[next_port], Clock::now()};
+            if (++next_port == ports.size()) {
+                next_target++;
+                next_port = 0;
+            }
+
+            sockaddr_storage addr = target.addr;
+            setPort(addr, attempt.port);
+            attempt.fd = openSocket(addr.ss_family, SOCK_STREAM, 0);
+            if (attempt.fd < 0) {
+                finish(attempt, PortState::Filtered);
+                continue;
+            }
+            // Reset instead of lingering in TIME_WAIT
+            struct linger no_linger = {1, 0};
+            setsockopt(attempt.fd, SOL_SOCKET, SO_LINGER, &no_linger, sizeof(no_linger));
+
+            if (connect(attempt.fd, reinterpret_cast<const sockaddr*>(&addr), target.addr_len) == 0) {
+                finish(attempt, PortState::Open);
+                close(attempt.fd);
+            } else if (errno == EINPROGRESS) {
+                active.push_back(attempt);
+            } else {
+                finish(attempt, errno == ECONNREFUSED ? PortState::Closed : PortState::Filtered);
+                close(attempt.fd);
+            }
+        }
+        if (active.empty()) break;
+
+        std::vector<pollfd> fds;
+        Clock::time_point oldest = active.front().start;
+        for (const auto& attempt : active) {
+            fds.push_back({attempt.fd, POLLOUT, 0});
+            oldest = std::min(oldest, attempt.start);
+        }
+        poll(fds.data(), fds.size(), msUntil(oldest + std::chrono::milliseconds(timeout_ms)));
+
+        std::vector<Attempt> still;
+        Clock::time_point now = Clock::now();
+        for (size_t k = 0; k < active.size(); k++) {
+            const Attempt& attempt = active[k];
+            if (fds[k].revents) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(attempt.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+                finish(attempt, error == 0 ? PortState::Open
+                                           : error == ECONNREFUSED ? PortState::Closed : PortState::Filtered);
+                close(attempt.fd);
+            } else if (now - attempt.start >= std::chrono::milliseconds(timeout_ms)) {
+                finish(attempt, PortState::Filtered);
+                close(attempt.fd);
+            } else {
+                still.push_back(attempt);
+            }
+        }
+        active.swap(still);
+    }
+
+    for (auto& result : results) {
+        std::sort(result.ports.begin(), result.ports.end(),
+                  [](const PortResult& a, const PortResult& b) { return a.port < b.port; });
+    }
+    return results;
+}
+
+std::string NetProbe::formatPing(const std::vector<PingResult>& results, bool replied_only) {
+    std::ostringstream out;
+    size_t up = 0;
+    for (const auto& result : results) {
+        if (result.received > 0) up++;
+        else if (replied_only) continue;
+        out << label(result.target) << ": ";
+        if (result.sent == 0) {
+            out << "ERROR - " << (result.error.empty() ? "nothing sent" : result.error) << "\n";
+            continue;
+        }
+        if (result.received == 0) {
+            out << "no reply (0/" << result.sent << ")";
+        } else {
+            out << result.received << "/" << result.sent << " replies, rtt min/avg/max "
+                << formatMs(result.min_ms) << "/" << formatMs(result.avg_ms) << "/" << formatMs(result.max_ms) << " ms";
+        }
+        out << " [" << result.method << "]\n";
+    }
+    if (results.size() > 1) {
+        out << "[" << results.size() << " hosts: " << up << " up, " << results.size() - up << " down or unreachable]\n";
+    }
+    return out.str();
+}
+
+std::string NetProbe::formatTrace(const TraceResult& result) {
+    std::ostringstream out;
+    out << "traceroute to " << label(result.target) << "\n";
+    if (!result.error.empty()) {
+        out << "ERROR - " << result.error << "\n";
+        return out.str();
+    }
+    for (const auto& hop : result.hops) {
+        out << (hop.ttl < 10 ? " " : "") << hop.ttl << "  ";
+        if (hop.address.empty()) {
+            out << "*\n";
+            continue;
+        }
+        out << hop.address;
+        for (double rtt : hop.rtts_ms) out << "  " << formatMs(rtt) << " ms";
+        if (!hop.note.empty()) out << " " << hop.note;
+        out << "\n";
+    }
+    if (result.reached) {
+        out << "[Reached in " << result.hops.size() << " hops]\n";
+    } else {
+        out << "[Destination not reached; later hops did not answer]\n";
+    }
+    return out.str();
+}
+
+std::string NetProbe::formatScan(const std::vector<ScanResult>& results, bool show_closed) {
+    std::ostringstream out;
+    for (const auto& result : results) {
+        if (!result.target.error.empty()) {
+            out << result.target.name << ": ERROR - " << result.target.error << "\n";
+            continue;
+        }
+        size_t open = 0, closed = 0, filtered = 0;
+        for (const auto& port : result.ports) {
+            if (port.state == PortState::Open) open++;
+            else if (port.state == PortState::Closed) closed++;
+            else filtered++;
+        }
+        out << label(result.target) << ": " << open << " open, " << closed << " closed, " << filtered << " filtered\n";
+        for (const auto& port : result.ports) {
+            if (port.state != PortState::Open && !show_closed) continue;
+            auto service = kServices.find(port.port);
+            char line[128];
+            snprintf(line, sizeof(line), "  %5d/tcp  %-8s  %-14s %s ms\n", port.port,
+                     port.state == PortState::Open ? "open" : port.state == PortState::Closed ? "closed" : "filtered",
+                     service != kServices.end() ? service->second : "", formatMs(port.rtt_ms).c_str());
+            out << line;
+        }
+    }
+    return out.str();
+}
+
+} // namespace casper
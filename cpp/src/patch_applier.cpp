@@ -0,0 +1,360 @@
+#include "patch_applier.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+namespace casper {
+
+// Context lines GNU patch-style fuzz may ignore at each end of a hunk
+static const int MAX_FUZZ = 2;
+
+namespace {
+
+std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t newline = text.find('\n', start);
+        if (newline == std::string::npos) {
+            lines.push_back(text.substr(start));
+            break;
+        }
+        lines.push_back(text.substr(start, newline - start));
+        start = newline + 1;
+    }
+    return lines;
+}
+
+// "a/src/x.cpp\t2024-01-01 ..." -> "a/src/x.cpp"
+std::string headerPath(const std::string& header) {
+    std::string path = header.substr(0, header.find('\t'));
+    return utils::trim(path);
+}
+
+// Level 1 ignores trailing whitespace (and \r), level 2 any whitespace change
+std::string normalize(const std::string& line, int level) {
+    if (level == 1) {
+        size_t end = line.find_last_not_of(" \t\r");
+        return end == std::string::npos ? "" : line.substr(0, end + 1);
+    }
+    std::string out;
+    bool space = false;
+    for (char c : line) {
+        if (c == ' ' || c == '\t' || c == '\r') {
+            space = !out.empty();
+        } else {
+            if (space) out += ' ';
+            out += c;
+            space = false;
+        }
+    }
+    return out;
+}
+
+bool linesEqual(const std::string& a, const std::string& b, int level) {
+    if (level == 0) return a == b;
+    return normalize(a, level) == normalize(b, level);
+}
+
+} // namespace
+
+bool PatchApplier::parse(const std::string& text, std::vector<FilePatch>& patches, std::string& error) {
+    std::vector<std::string> lines = splitLines(text);
+    auto isFileHeader = [&](size_t i) {
+        return utils::startsWith(lines[i], "--- ") && i + 1 < lines.size() && utils::startsWith(lines[i + 1], "+++ ");
+    };
+
+    for (size_t i = 0; i < lines.size(); ) {
+        if (isFileHeader(i)) {
+            FilePatch patch;
+            patch.old_path = headerPath(lines[i].substr(4));
+            patch.new_path = headerPath(lines[i + 1].substr(4));
+
+            // git's a/ and b/ prefixes
+            bool old_prefixed = patch.creates() || utils::startsWith(patch.old_path, "a/");
+            bool new_prefixed = patch.deletes() || utils::startsWith(patch.new_path, "b/");
+            if (old_prefixed && new_prefixed) {
+                if (!patch.creates()) patch.old_path = patch.old_path.substr(2);
+                if (!patch.deletes()) patch.new_path = patch.new_path.substr(2);
+            }
+            patches.push_back(patch);
+            i += 2;
+            continue;
+        }
+
+        if (!utils::startsWith(lines[i], "@@")) {
+            i++;    // diff --git, index, mode lines and surrounding prose
+            continue;
+        }
+
+        if (patches.empty()) {
+            error = "Hunk at line " + std::to_string(i + 1) + " comes before any ---/+++ file header";
+            return false;
+        }
+
+        // @@ -start[,count] +start[,count] @@
+        PatchHunk hunk;
+        long old_count = -1, new_count = -1;
+        size_t minus = lines[i].find('-');
+        size_t plus = lines[i].find('+');
+        if (minus == std::string::npos || plus == std::string::npos) {
+            error = "Malformed hunk header at line " + std::to_string(i + 1) + ": " + lines[i];
+            return false;
+        }
+        char* end = nullptr;
+        hunk.old_start = std::strtoul(lines[i].c_str() + minus + 1, &end, 10);
+        old_count = *end == ',' ? std::strtol(end + 1, nullptr, 10) : 1;
+        std::strtoul(lines[i].c_str() + plus + 1, &end, 10);
+        new_count = *end == ',' ? std::strtol(end + 1, nullptr, 10) : 1;
+        i++;
+
+        // Models miscount often, so the counts only decide where trailing
+        // blank lines belong; a hunk runs until something that is not a hunk line
+        long old_seen = 0, new_seen = 0;
+        while (i < lines.size()) {
+            const std::string& line = lines[i];
+            if (utils::startsWith(line, "@@") || isFileHeader(i) || utils::startsWith(line, "diff ")) break;
+
+            bool counts_done = old_seen >= old_count && new_seen >= new_count;
+            if (line.empty()) {
+                if (counts_done) break;
+                hunk.lines.push_back({' ', ""});
+                old_seen++;
+                new_seen++;
+            } else if (line[0] == '\\') {
+                char previous = hunk.lines.empty() ? ' ' : hunk.lines.back().first;
+                if (previous != '+') hunk.old_no_newline = true;
+                if (previous != '-') hunk.new_no_newline = true;
+            } else if (line[0] == ' ' || line[0] == '-' || line[0] == '+') {
+                hunk.lines.push_back({line[0], line.substr(1)});
+                if (line[0] != '+') old_seen++;
+                if (line[0] != '-') new_seen++;
+            } else {
+                break;
+            }
+            i++;
+        }
+
+        patches.back().hunks.push_back(hunk);
+    }
+
+    if (patches.empty()) {
+        error = "No ---/+++ file headers found; expected a unified diff";
+        return false;
+    }
+    for (const auto& patch : patches) {
+        if (patch.hunks.empty()) {
+            error = "No hunks for " + patch.path();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PatchApplier::applyHunks(const FilePatch& patch, FilePatchResult& result) {
+    std::vector<std::string> work = splitLines(result.content);
+    bool final_newline = result.content.empty() || result.content.back() == '\n';
+    bool all_applied = true;
+    long delta = 0;                 // Lines added minus removed by earlier hunks
+    size_t min_pos = 0;             // Hunks apply in order and must not overlap
+
+    for (const auto& hunk : patch.hunks) {
+        HunkStatus status;
+
+        std::vector<const std::string*> old_block;
+        for (const auto& line : hunk.lines) {
+            if (line.first != '+') old_block.push_back(&line.second);
+        }
+
+        size_t leading = 0, trailing = 0;
+        while (leading < hunk.lines.size() && hunk.lines[leading].first == ' ') leading++;
+        while (trailing < hunk.lines.size() - leading && hunk.lines[hunk.lines.size() - 1 - trailing].first == ' ') trailing++;
+
+        long hint = static_cast<long>(hunk.old_start) + delta - (old_block.empty() ? 0 : 1);
+        bool found = false;
+        size_t pos = 0;
+        size_t skip_front = 0, skip_back = 0;
+
+        if (old_block.empty()) {
+            // Pure insertion: "@@ -5,0 +6,2 @@" adds after line 5
+            pos = static_cast<size_t>(std::max<long>(hint, static_cast<long>(min_pos)));
+            pos = std::min(pos, work.size());
+            found = true;
+        }
+
+        for (int fuzz = 0; fuzz <= MAX_FUZZ && !found; fuzz++) {
+            skip_front = std::min<size_t>(fuzz, leading);
+            skip_back = std::min<size_t>(fuzz, trailing);
+            if (fuzz > 0 && skip_front + skip_back == 0) break;
+            size_t length = old_block.size() - skip_front - skip_back;
+            if (length == 0 || work.size() < length) continue;
+
+            long first = static_cast<long>(min_pos);
+            long last = static_cast<long>(work.size() - length);
+            if (last < first) continue;
+            long target = std::min(std::max(hint + static_cast<long>(skip_front), first), last);
+
+            for (int level = 0; level <= 2 && !found; level++) {
+                auto matches = [&](long at) {
+                    for (size_t k = 0; k < length; k++) {
+                        if (!linesEqual(work[at + k], *old_block[skip_front + k], level)) return false;
+                    }
+                    return true;
+                };
+
+                // Nearest match to where the header says the hunk goes
+                for (long distance = 0; !found; distance++) {
+                    long below = target + distance;
+                    long above = target - distance;
+                    if (below > last && above < first) break;
+                    if (below <= last && matches(below)) {
+                        pos = static_cast<size_t>(below);
+                        found = true;
+                    } else if (distance > 0 && above >= first && matches(above)) {
+                        pos = static_cast<size_t>(above);
+                        found = true;
+                    }
+                }
+                if (found) {
+                    status.fuzz = fuzz;
+                    status.whitespace = level > 0;
+                }
+            }
+        }
+
+        if (!found) {
+            all_applied = false;
+            result.hunks.push_back(status);
+            continue;
+        }
+
+        // Context comes from the file so fuzzy matches keep its whitespace
+        std::vector<std::string> replacement;
+        size_t file_line = pos;
+        size_t old_index = 0;
+        for (const auto& line : hunk.lines) {
+            if (line.first != '+') {
+                bool skipped = old_index < skip_front || old_index >= old_block.size() - skip_back;
+                old_index++;
+                if (skipped) continue;
+                if (line.first == ' ') replacement.push_back(work[file_line]);
+                file_line++;
+            } else {
+                replacement.push_back(line.second);
+            }
+        }
+
+        size_t removed = file_line - pos;
+        work.erase(work.begin() + pos, work.begin() + pos + removed);
+        work.insert(work.begin() + pos, replacement.begin(), replacement.end());
+
+        status.applied = true;
+        status.line = static_cast<size_t>(static_cast<long>(pos) - delta) + 1;
+        status.offset = static_cast<long>(pos) - static_cast<long>(skip_front) - hint;
+        result.hunks.push_back(status);
+
+        if (pos + replacement.size() == work.size()) {
+            // The hunk reaches the end of the file
+            if (hunk.new_no_newline) final_newline = false;
+            else if (hunk.old_no_newline) final_newline = true;
+        }
+        delta += static_cast<long>(replacement.size()) - static_cast<long>(removed);
+        min_pos = pos + replacement.size();
+    }
+
+    std::string content;
+    for (size_t i = 0; i < work.size(); i++) {
+        content += work[i];
+        if (i + 1 < work.size() || final_newline) content += '\n';
+    }
+    result.content = content;
+    return all_applied;
+}
+
+PatchCheck PatchApplier::check(const std::vector<FilePatch>& patches) {
+    PatchCheck check;
+    check.ok = true;
+    std::map<std::string, size_t> seen;     // Path -> result index, for several patches to one file
+
+    for (const auto& patch : patches) {
+        std::string source = patch.creates() ? patch.new_path : patch.old_path;
+        auto earlier = seen.find(source);
+
+        FilePatchResult fresh;
+        FilePatchResult& result = earlier != seen.end() ? check.files[earlier->second] : fresh;
+
+        if (earlier == seen.end()) {
+            result.path = patch.path();
+            result.old_path = source;
+            result.existed = utils::fileExists(source);
+
+            if (patch.creates()) {
+                if (result.existed) {
+                    result.error = "File already exists";
+                }
+            } else if (!result.existed) {
+                result.error = "File not found";
+            } else {
+                result.original = utils::readFile(source);
+                result.content = result.original;
+            }
+        }
+
+        if (result.error.empty()) {
+            bool applied = applyHunks(patch, result);
+            result.ok = applied && (earlier == seen.end() || result.ok);
+            if (patch.deletes()) {
+                result.remove = true;
+                if (result.ok && !result.content.empty()) {
+                    result.ok = false;
+                    result.error = "Deleting patch leaves content behind";
+                }
+            }
+            if (!patch.deletes() && patch.new_path != source) {
+                result.path = patch.new_path;   // Rename
+            }
+        }
+
+        if (!result.ok) check.ok = false;
+        if (earlier == seen.end()) {
+            seen[result.path] = check.files.size();
+            if (result.path != source) seen[source] = check.files.size();
+            check.files.push_back(result);
+        }
+    }
+
+    return check;
+}
+
+std::string PatchApplier::report(const PatchCheck& check) {
+    std::ostringstream out;
+    for (const auto& file : check.files) {
+        out << file.path;
+        if (file.old_path != file.path && !file.old_path.empty()) out << " (from " << file.old_path << ")";
+        if (!file.error.empty()) {
+            out << ": FAILED - " << file.error << "\n";
+            continue;
+        }
+        out << (file.ok ? ": ok" : ": FAILED") << (file.remove ? " (delete)" : "")
+            << (!file.existed && !file.remove ? " (new file)" : "") << "\n";
+
+        for (size_t i = 0; i < file.hunks.size(); i++) {
+            const auto& hunk = file.hunks[i];
+            out << "  hunk " << (i + 1) << ": ";
+            if (!hunk.applied) {
+                out << "FAILED - context not found; Read the file and regenerate this hunk\n";
+                continue;
+            }
+            out << "applied at line " << hunk.line;
+            if (hunk.offset != 0) out << " (offset " << (hunk.offset > 0 ? "+" : "") << hunk.offset << ")";
+            if (hunk.fuzz > 0) out << " (fuzz " << hunk.fuzz << ")";
+            if (hunk.whitespace) out << " (whitespace differs)";
+            out << "\n";
+        }
+    }
+    return out.str();
+}
+
+} // namespace casper
@@ -0,0 +1,286 @@
+#include "persistent_shell.h"
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <random>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace casper {
+
+namespace {
+
+const size_t READ_CHUNK = 64 * 1024;
+const int EXIT_GRACE_MS = 200;
+
+struct ShellStream {
+    int fd;
+    bool is_stderr;
+    std::string pending;         // Read but not yet passed on; may hold part of the marker
+    OutputBuffer buffer;
+    bool done = false;
+
+    ShellStream(int fd, bool is_stderr, size_t limit)
+        : fd(fd), is_stderr(is_stderr), buffer(limit) {}
+};
+
+long elapsedMs(std::chrono::steady_clock::time_point since) {
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Pass on everything before the marker. Without a marker the last
+// marker-sized bytes are held back in case they are its beginning.
+void consume(ShellStream& stream, const std::string& marker,
+             const PersistentShell::OutputCallback& on_output, int& exit_code) {
+    size_t pos = stream.pending.find(marker);
+    size_t emit = pos;
+    if (pos == std::string::npos) {
+        emit = stream.pending.size() > marker.size() ? stream.pending.size() - marker.size() : 0;
+    }
+
+    if (emit > 0) {
+        stream.buffer.append(stream.pending.data(), emit);
+        if (on_output) on_output(stream.pending.data(), emit, stream.is_stderr);
+        stream.pending.erase(0, emit);
+    }
+
+    if (pos == std::string::npos) return;
+
+    // stdout carries "marker:status\n", stderr just "marker\n"
+    size_t newline = stream.pending.find('\n', marker.size());
+    if (newline == std::string::npos) return;
+
+    if (!stream.is_stderr && stream.pending.size() > marker.size() + 1) {
+        exit_code = std::atoi(stream.pending.c_str() + marker.size() + 1);
+    }
+    stream.done = true;
+}
+
+} // namespace
+
+PersistentShell::PersistentShell()
+    : commands_(0)
+{
+}
+
+PersistentShell::~PersistentShell() {
+    stop();
+}
+
+bool PersistentShell::start(std::string& error) {
+    process_ = SpawnedProcess();
+    if (ProcessRunner::spawn({"bash", "--noprofile", "--norc"}, process_, error)) {
+        return true;
+    }
+    return ProcessRunner::spawn({"/bin/sh"}, process_, error);
+}
+
+bool PersistentShell::alive() {
+    if (process_.pid <= 0) return false;
+    if (waitpid(process_.pid, nullptr, WNOHANG) == 0) return true;
+    ProcessRunner::releaseGroup(process_.pid);
+    process_.pid = -1;      // Already reaped
+    return false;
+}
+
+bool PersistentShell::isRunning() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return alive();
+}
+
+std::string PersistentShell::workingDirectory() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!alive()) return "";
+
+    char path[PATH_MAX];
+    std::string link = "/proc/" + std::to_string(process_.pid) + "/cwd";
+    ssize_t length = readlink(link.c_str(), path, sizeof(path) - 1);
+    if (length <= 0) return "";
+    return std::string(path, static_cast<size_t>(length));
+}
+
+void PersistentShell::kill() {
+    if (process_.pid > 0) {
+        ::kill(-process_.pid, SIGKILL);
+        waitpid(process_.pid, nullptr, 0);
+        ProcessRunner::releaseGroup(process_.pid);
+    }
+    if (process_.stdin_fd >= 0) close(process_.stdin_fd);
+    if (process_.stdout_fd >= 0) close(process_.stdout_fd);
+    if (process_.stderr_fd >= 0) close(process_.stderr_fd);
+    process_ = SpawnedProcess();
+}
+
+void PersistentShell::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (process_.pid <= 0) return;
+
+    // EOF on stdin lets bash exit on its own; anything left behind is killed
+    close(process_.stdin_fd);
+    process_.stdin_fd = -1;
+    for (int waited = 0; waited < EXIT_GRACE_MS; waited += 10) {
+        if (waitpid(process_.pid, nullptr, WNOHANG) != 0) {
+            ProcessRunner::releaseGroup(process_.pid);
+            process_.pid = -1;
+            break;
+        }
+        usleep(10 * 1000);
+    }
+    kill();
+}
+
+std::string PersistentShell::newMarker() {
+    static std::random_device rd;
+    static std::mt19937_64 gen(rd());
+
+    char marker[64];
+    snprintf(marker, sizeof(marker), "__casper_%016llx_%lu__",
+             static_cast<unsigned long long>(gen()), ++commands_);
+    return marker;
+}
+
+ShellResult PersistentShell::run(const std::string& command, int timeout_ms,
+                                 const OutputCallback& on_output, size_t max_output_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ShellResult result;
+    auto start_time = std::chrono::steady_clock::now();
+
+    std::string marker = newMarker();
+
+    // The command arrives as the body of a quoted heredoc with a random
+    // delimiter, so it is never parsed together with the lines after it: an
+    // unbalanced quote or unterminated heredoc fails inside eval with status
+    // 2 instead of swallowing the markers. "command eval" keeps sh from
+    // exiting on that syntax error. eval runs in this shell, so cd and export
+    // carry over; stdin comes from /dev/null so the command cannot eat the
+    // lines that follow it on our pipe.
+    std::string script = "__casper_command=$(cat <<'" + marker + "_END'\n" + command + "\n" + marker + "_END\n)\n"
+        "{ command eval \"$__casper_command\"; } < /dev/null\n"
+        "__casper_status=$?\n"
+        "printf '%s:%d\\n' '" + marker + "' \"$__casper_status\"\n"
+        "printf '%s\\n' '" + marker + "' >&2\n";
+
+    // A shell that died since the last call is restarted once
+    bool sent = false;
+    for (int attempt = 0; attempt < 2 && !sent; attempt++) {
+        if (!alive()) {
+            kill();
+            if (!start(result.error)) {
+                return result;
+            }
+        }
+        sent = writeAll(process_.stdin_fd, script);
+        if (!sent) {
+            kill();
+        }
+    }
+    if (!sent) {
+        result.error = "Could not send the command to the shell";
+        return result;
+    }
+    result.started = true;
+
+    ShellStream streams[2] = {
+        ShellStream(process_.stdout_fd, false, max_output_bytes),
+        ShellStream(process_.stderr_fd, true, max_output_bytes),
+    };
+    std::vector<char> chunk(READ_CHUNK);
+    bool eof = false;
+
+    while (!(streams[0].done && streams[1].done) && !eof) {
+        int wait_ms = -1;
+        if (timeout_ms > 0) {
+            wait_ms = timeout_ms - static_cast<int>(elapsedMs(start_time));
+            if (wait_ms <= 0) {
+                result.timed_out = true;
+                break;
+            }
+        }
+
+        struct pollfd fds[2];
+        nfds_t count = 0;
+        ShellStream* polled[2];
+        for (auto& stream : streams) {
+            if (stream.done) continue;
+            fds[count].fd = stream.fd;
+            fds[count].events = POLLIN;
+            fds[count].revents = 0;
+            polled[count++] = &stream;
+        }
+
+        int ready = poll(fds, count, wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (nfds_t i = 0; i < count; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ShellStream& stream = *polled[i];
+
+            ssize_t n = read(stream.fd, chunk.data(), chunk.size());
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) continue;
+                eof = true;
+            } else if (n == 0) {
+                eof = true;
+            } else {
+                stream.pending.append(chunk.data(), static_cast<size_t>(n));
+                consume(stream, marker, on_output, result.exit_code);
+            }
+        }
+    }
+
+    if (eof) {
+        // The command took the shell down with it; keep what it printed
+        for (auto& stream : streams) {
+            if (stream.done || stream.pending.empty()) continue;
+            stream.buffer.append(stream.pending.data(), stream.pending.size());
+            if (on_output) on_output(stream.pending.data(), stream.pending.size(), stream.is_stderr);
+        }
+
+        int status = 0;
+        pid_t reaped = 0;
+        for (int waited = 0; waited < EXIT_GRACE_MS && reaped == 0; waited += 10) {
+            reaped = waitpid(process_.pid, &status, WNOHANG);
+            if (reaped == 0) usleep(10 * 1000);
+        }
+        if (reaped == process_.pid) {
+            result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            ProcessRunner::releaseGroup(process_.pid);
+            process_.pid = -1;
+        }
+        result.shell_exited = true;
+        kill();
+    } else if (result.timed_out || !(streams[0].done && streams[1].done)) {
+        kill();
+    }
+
+    result.stdout_data = streams[0].buffer.str();
+    result.stderr_data = streams[1].buffer.str();
+    result.truncated = streams[0].buffer.truncated() || streams[1].buffer.truncated();
+    result.dropped_bytes = streams[0].buffer.dropped() + streams[1].buffer.dropped();
+    result.duration_ms = elapsedMs(start_time);
+    return result;
+}
+
+} // namespace casper
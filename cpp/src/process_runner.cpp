@@ -0,0 +1,424 @@
+#include "process_runner.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <set>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace casper {
+
+namespace {
+
+const size_t READ_CHUNK = 64 * 1024;
+const int KILL_GRACE_MS = 2000;
+
+// Process groups of commands, jobs and shells that may still be running
+std::mutex groups_mutex;
+std::set<pid_t> live_groups;
+
+void registerGroup(pid_t pgid) {
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    live_groups.insert(pgid);
+}
+
+bool makePipe(int fds[2]) {
+    if (pipe(fds) != 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void closeFd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+long elapsedMs(std::chrono::steady_clock::time_point since) {
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+} // namespace
+
+OutputBuffer::OutputBuffer(size_t limit)
+    : half_(limit / 2)
+    , total_(0)
+{
+}
+
+void OutputBuffer::append(const char* data, size_t size) {
+    total_ += size;
+    if (head_.size() < half_) {
+        size_t take = std::min(size, half_ - head_.size());
+        head_.append(data, take);
+        data += take;
+        size -= take;
+    }
+    if (size == 0) return;
+
+    tail_.append(data, size);
+    if (tail_.size() > 2 * half_) {
+        tail_.erase(0, tail_.size() - half_);
+    }
+}
+
+bool OutputBuffer::truncated() const {
+    return dropped() > 0;
+}
+
+size_t OutputBuffer::dropped() const {
+    return total_ - head_.size() - std::min(tail_.size(), half_);
+}
+
+std::string OutputBuffer::str() const {
+    std::string tail = tail_.size() > half_ ? tail_.substr(tail_.size() - half_) : tail_;
+    size_t omitted = dropped();
+    if (omitted == 0) {
+        return head_ + tail;
+    }
+    return head_ + "\n[... " + std::to_string(omitted) + " bytes omitted ...]\n" + tail;
+}
+
+bool ProcessRunner::spawn(const std::vector<std::string>& args, SpawnedProcess& process, std::string& error) {
+    signal(SIGPIPE, SIG_IGN);
+
+    int in_pipe[2], out_pipe[2], err_pipe[2];
+    if (!makePipe(in_pipe)) {
+        error = std::string("pipe failed: ") + strerror(errno);
+        return false;
+    }
+    if (!makePipe(out_pipe)) {
+        error = std::string("pipe failed: ") + strerror(errno);
+        close(in_pipe[0]); close(in_pipe[1]);
+        return false;
+    }
+    if (!makePipe(err_pipe)) {
+        error = std::string("pipe failed: ") + strerror(errno);
+        close(in_pipe[0]); close(in_pipe[1]);
+        close(out_pipe[0]); close(out_pipe[1]);
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attr, 0);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    sigaddset(&default_signals, SIGINT);
+    sigaddset(&default_signals, SIGQUIT);
+    sigaddset(&default_signals, SIGTERM);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+
+    std::vector<std::string> copy = args;
+    std::vector<char*> argv;
+    for (auto& arg : copy) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = 0;
+    int spawn_error = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+
+    if (spawn_error != 0) {
+        error = "Failed to start " + args[0] + ": " + strerror(spawn_error);
+        close(in_pipe[1]);
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        return false;
+    }
+
+    setNonBlocking(out_pipe[0]);
+    setNonBlocking(err_pipe[0]);
+
+    registerGroup(pid);
+    process.pid = pid;
+    process.stdin_fd = in_pipe[1];
+    process.stdout_fd = out_pipe[0];
+    process.stderr_fd = err_pipe[0];
+    return true;
+}
+
+void ProcessRunner::releaseGroup(pid_t pgid) {
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    live_groups.erase(pgid);
+}
+
+bool ProcessRunner::signalGroups(int sig) {
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    bool any = false;
+    for (pid_t pgid : live_groups) {
+        if (kill(-pgid, sig) == 0) any = true;
+    }
+    return any;
+}
+
+ProcessResult ProcessRunner::run(const ProcessOptions& options) {
+    ProcessResult result;
+
+    // Writes to a child that already exited must fail with EPIPE, not kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    int out_pipe[2] = {-1, -1};
+    int err_pipe[2] = {-1, -1};
+    int in_pipe[2] = {-1, -1};
+    bool feed_stdin = !options.stdin_data.empty();
+
+    if (!makePipe(out_pipe) || (!options.merge_stderr && !makePipe(err_pipe)) ||
+        (feed_stdin && !makePipe(in_pipe))) {
+        result.error = std::string("pipe failed: ") + strerror(errno);
+        for (int fd : {out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1], in_pipe[0], in_pipe[1]}) {
+            if (fd >= 0) close(fd);
+        }
+        return result;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, options.merge_stderr ? out_pipe[1] : err_pipe[1], STDERR_FILENO);
+    if (feed_stdin) {
+        posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    } else if (!options.interactive) {
+        // Commands waiting for input would otherwise hang until the timeout
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (!options.interactive) {
+        // Own process group so a timeout can kill everything the command started
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    sigaddset(&default_signals, SIGINT);
+    sigaddset(&default_signals, SIGQUIT);
+    sigaddset(&default_signals, SIGTERM);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+
+    std::vector<std::string> args = options.argv;
+    if (args.empty()) {
+        args = {"/bin/sh", "-c", options.command};
+    }
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = 0;
+    int spawn_error = options.argv.empty()
+        ? posix_spawn(&pid, argv[0], &actions, &attr, argv.data(), environ)
+        : posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    closeFd(out_pipe[1]);
+    closeFd(err_pipe[1]);
+    closeFd(in_pipe[0]);
+
+    if (spawn_error != 0) {
+        result.error = "Failed to start " + args[0] + ": " + strerror(spawn_error);
+        closeFd(out_pipe[0]);
+        closeFd(err_pipe[0]);
+        closeFd(in_pipe[1]);
+        return result;
+    }
+    result.started = true;
+    if (!options.interactive) {
+        registerGroup(pid);
+    }
+
+    setNonBlocking(out_pipe[0]);
+    if (err_pipe[0] >= 0) setNonBlocking(err_pipe[0]);
+    if (in_pipe[1] >= 0) setNonBlocking(in_pipe[1]);
+
+    OutputBuffer out_buffer(options.max_output_bytes);
+    OutputBuffer err_buffer(options.max_output_bytes);
+    size_t stdin_written = 0;
+    auto last_output = start;
+    std::vector<char> chunk(READ_CHUNK);
+
+    bool killing = false;
+    long kill_started_ms = 0;
+
+    auto killGroup = [&](int sig) {
+        kill(options.interactive ? pid : -pid, sig);
+    };
+
+    while (out_pipe[0] >= 0 || err_pipe[0] >= 0) {
+        long now_ms = elapsedMs(start);
+
+        // Timeouts: SIGTERM first, SIGKILL if the group ignores it
+        if (!killing) {
+            if (options.timeout_ms > 0 && now_ms >= options.timeout_ms) {
+                result.timed_out = true;
+            } else if (options.idle_timeout_ms > 0 && elapsedMs(last_output) >= options.idle_timeout_ms) {
+                result.idle_timed_out = true;
+            }
+            if (result.timed_out || result.idle_timed_out) {
+                killGroup(SIGTERM);
+                killing = true;
+                kill_started_ms = now_ms;
+            }
+        } else if (now_ms - kill_started_ms >= KILL_GRACE_MS) {
+            killGroup(SIGKILL);
+            // Pipes may be held open by orphans that escaped the group
+            break;
+        }
+
+        int wait_ms = 1000;
+        if (killing) {
+            wait_ms = 100;
+        } else {
+            if (options.timeout_ms > 0) {
+                wait_ms = std::min<long>(wait_ms, std::max<long>(0, options.timeout_ms - now_ms));
+            }
+            if (options.idle_timeout_ms > 0) {
+                wait_ms = std::min<long>(wait_ms, std::max<long>(0, options.idle_timeout_ms - elapsedMs(last_output)));
+            }
+        }
+
+        struct pollfd fds[3];
+        int count = 0;
+        int out_index = -1, err_index = -1, in_index = -1;
+        if (out_pipe[0] >= 0) { out_index = count; fds[count++] = {out_pipe[0], POLLIN, 0}; }
+        if (err_pipe[0] >= 0) { err_index = count; fds[count++] = {err_pipe[0], POLLIN, 0}; }
+        if (in_pipe[1] >= 0) { in_index = count; fds[count++] = {in_pipe[1], POLLOUT, 0}; }
+
+        int ready = poll(fds, count, wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready == 0) continue;
+
+        if (in_index >= 0 && fds[in_index].revents) {
+            if (fds[in_index].revents & POLLOUT) {
+                ssize_t n = write(in_pipe[1], options.stdin_data.data() + stdin_written,
+                                  options.stdin_data.size() - stdin_written);
+                if (n > 0) stdin_written += static_cast<size_t>(n);
+            }
+            if (stdin_written >= options.stdin_data.size() || (fds[in_index].revents & (POLLERR | POLLHUP))) {
+                closeFd(in_pipe[1]);
+            }
+        }
+
+        auto drain = [&](int index, int& fd, OutputBuffer& buffer, bool is_stderr) {
+            if (index < 0 || !fds[index].revents) return;
+            while (true) {
+                ssize_t n = read(fd, chunk.data(), chunk.size());
+                if (n > 0) {
+                    buffer.append(chunk.data(), static_cast<size_t>(n));
+                    last_output = std::chrono::steady_clock::now();
+                    if (options.on_output) {
+                        options.on_output(chunk.data(), static_cast<size_t>(n), is_stderr);
+                    }
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+                if (n < 0 && errno == EINTR) continue;
+                closeFd(fd);  // EOF or error
+                return;
+            }
+        };
+        drain(out_index, out_pipe[0], out_buffer, false);
+        drain(err_index, err_pipe[0], err_buffer, true);
+    }
+
+    closeFd(out_pipe[0]);
+    closeFd(err_pipe[0]);
+    closeFd(in_pipe[1]);
+
+    // The command closed its output; it may still be running
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    while (true) {
+        pid_t waited = wait4(pid, &status, WNOHANG, &usage);
+        if (waited == pid || (waited < 0 && errno != EINTR)) break;
+
+        long now_ms = elapsedMs(start);
+        if (!killing && options.timeout_ms > 0 && now_ms >= options.timeout_ms) {
+            result.timed_out = true;
+            killGroup(SIGTERM);
+            killing = true;
+            kill_started_ms = now_ms;
+        } else if (killing && now_ms - kill_started_ms >= KILL_GRACE_MS) {
+            killGroup(SIGKILL);
+        }
+        usleep(10 * 1000);
+    }
+    if (!options.interactive) {
+        releaseGroup(pid);
+    }
+
+    result.duration_ms = elapsedMs(start);
+    if (WIFEXITED(status)) {
+        result.exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        result.term_signal = WTERMSIG(status);
+        result.exit_code = 128 + result.term_signal;
+    }
+
+    result.user_cpu_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    result.system_cpu_seconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+    result.max_rss_kb = usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+    result.max_rss_kb = usage.ru_maxrss;
+#endif
+
+    result.stdout_data = out_buffer.str();
+    result.stderr_data = err_buffer.str();
+    result.stdout_bytes = out_buffer.total();
+    result.stderr_bytes = err_buffer.total();
+    result.truncated = out_buffer.truncated() || err_buffer.truncated();
+    result.dropped_bytes = out_buffer.dropped() + err_buffer.dropped();
+    return result;
+}
+
+} // namespace casper
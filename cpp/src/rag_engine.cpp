@@ -1,13 +1,15 @@
 #include "rag_engine.h"
 #include "search_client.h"
+#include "file_walker.h"
+#include "glob_matcher.h"
+#include "file_cache.h"
+#include "utils.h"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <regex>
-#include <dirent.h>
-#include <sys/stat.h>
+#include <mutex>
 #include <iostream>
-#include <fnmatch.h>
 
 namespace casper {
 
@@ -133,7 +135,18 @@ std::vector<DocumentChunk> RAGEngine::chunkText(const std::string& text, const s
     return chunks;
 }
 
+void RAGEngine::setFileCache(std::shared_ptr<FileCache> cache) {
+    file_cache_ = std::move(cache);
+}
+
 std::string RAGEngine::readFile(const std::string& path) {
+    FileStamp stamp;
+    if (file_cache_ && FileCache::stat(path, stamp) && file_cache_->cacheable(stamp)) {
+        std::string error;
+        std::shared_ptr<const std::string> content = file_cache_->read(path, error);
+        return content ? *content : "";
+    }
+
     std::ifstream file(path);
     if (!file.is_open()) {
         return "";
@@ -146,34 +159,26 @@ std::string RAGEngine::readFile(const std::string& path) {
 
 std::vector<std::string> RAGEngine::listFiles(const std::string& dir_path, const std::string& pattern) {
     std::vector<std::string> files;
-
-    DIR* dir = opendir(dir_path.c_str());
-    if (!dir) return files;
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string name = entry->d_name;
-
-        // Skip hidden files and special directories
-        if (name[0] == '.') continue;
-
-        std::string full_path = dir_path + "/" + name;
-        struct stat st;
-        if (stat(full_path.c_str(), &st) != 0) continue;
-
-        if (S_ISDIR(st.st_mode)) {
-            // Recurse into directories
-            auto sub_files = listFiles(full_path, pattern);
-            files.insert(files.end(), sub_files.begin(), sub_files.end());
-        } else if (S_ISREG(st.st_mode)) {
-            // Check pattern match
-            if (pattern == "*" || fnmatch(pattern.c_str(), name.c_str(), 0) == 0) {
-                files.push_back(full_path);
-            }
+    std::mutex files_mutex;
+    GlobMatcher matcher(pattern.empty() ? "*" : pattern);
+
+    std::string root = dir_path;
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+
+    // Hidden and .gitignored files (build output, node_modules...) are skipped
+    FileWalker walker;
+    walker.walk(root, [&](const WalkEntry& entry) {
+        std::string relative = utils::startsWith(entry.path, root + "/")
+            ? entry.path.substr(root.size() + 1)
+            : entry.path;
+        if (matcher.matches(relative)) {
+            std::lock_guard<std::mutex> lock(files_mutex);
+            files.push_back(entry.path);
         }
-    }
+        return true;
+    });
 
-    closedir(dir);
+    std::sort(files.begin(), files.end());
     return files;
 }
 
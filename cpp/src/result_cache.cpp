@@ -0,0 +1,154 @@
+#include "result_cache.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace casper {
+
+ResultCache::ResultCache(size_t max_entries)
+    : max_entries_(max_entries)
+    , hits_(0)
+    , misses_(0)
+    , invalidations_(0)
+{
+}
+
+int ResultCache::ttlSeconds(const std::string& tool) {
+    // Files can also change outside our tools, so file searches expire soonest
+    static const std::map<std::string, int> ttls = {
+        {"Glob", 60},
+        {"Grep", 60},
+        {"DBSchema", 600},
+        {"WebFetch", 900},
+        {"WebSearch", 900},
+    };
+    auto it = ttls.find(tool);
+    return it == ttls.end() ? 0 : it->second;
+}
+
+std::string ResultCache::key(const ToolCall& call) {
+    std::string key = call.name;
+    for (const auto& param : call.parameters) {
+        if (param.first == "refresh" || param.first == "description") continue;
+        std::string value = utils::trim(param.second);
+        if (param.first == "path") {
+            value = utils::normalizePath(value.empty() ? "." : value);
+        }
+        key += '\0' + param.first + '=' + value;
+    }
+    return key;
+}
+
+bool ResultCache::lookup(const ToolCall& call, ToolResult& result, long& age_seconds) {
+    if (ttlSeconds(call.name) == 0) return false;
+    auto refresh = call.parameters.find("refresh");
+    if (refresh != call.parameters.end() && (refresh->second == "true" || refresh->second == "1")) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key(call));
+    Clock::time_point now = Clock::now();
+    if (it == entries_.end() || now >= it->second.expires) {
+        if (it != entries_.end()) entries_.erase(it);
+        misses_++;
+        return false;
+    }
+    hits_++;
+    result = it->second.result;
+    age_seconds = static_cast<long>(std::chrono::duration_cast<std::chrono::seconds>(now - it->second.stored).count());
+    return true;
+}
+
+void ResultCache::update(const ToolCall& call, const ToolResult& result, bool local_changing) {
+    int ttl = ttlSeconds(call.name);
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (ttl == 0) {
+        ToolAccess changed = ToolScheduler::classify(call);
+        // Jobs change files while they run and MCP servers may change
+        // anything; neither says what
+        bool jobs = std::find(changed.resources.begin(), changed.resources.end(), "jobs") != changed.resources.end();
+        if (jobs || call.name.find("__") != std::string::npos) {
+            changed.barrier = true;
+        }
+        invalidate(changed);
+        return;
+    }
+    if (!result.success || max_entries_ == 0) return;
+
+    ToolAccess access = ToolScheduler::classify(call);
+    if (local_changing && (!access.reads.empty() || !access.resources.empty())) return;
+
+    Clock::time_point now = Clock::now();
+    if (entries_.size() >= max_entries_) {
+        // Expired entries first, then the oldest
+        for (auto it = entries_.begin(); it != entries_.end(); ) {
+            it = now >= it->second.expires ? entries_.erase(it) : std::next(it);
+        }
+        while (entries_.size() >= max_entries_) {
+            auto oldest = entries_.begin();
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (it->second.stored < oldest->second.stored) oldest = it;
+            }
+            entries_.erase(oldest);
+        }
+    }
+
+    Entry& entry = entries_[key(call)];
+    entry.result = result;
+    entry.access = access;
+    entry.stored = now;
+    entry.expires = now + std::chrono::seconds(ttl);
+}
+
+void ResultCache::invalidate(const ToolAccess& changed) {
+    for (auto it = entries_.begin(); it != entries_.end(); ) {
+        const ToolAccess& access = it->second.access;
+        bool stale = false;
+
+        if (changed.barrier) {
+            // Could have changed any file or database; web results stay
+            stale = !access.reads.empty() || !access.resources.empty();
+        } else {
+            for (const auto& written : changed.writes) {
+                for (const auto& read : access.reads) {
+                    if (utils::pathsOverlap(written, read)) stale = true;
+                }
+            }
+            for (const auto& resource : changed.resources) {
+                for (const auto& used : access.resources) {
+                    if (resource == used) stale = true;
+                }
+            }
+        }
+
+        if (stale) {
+            invalidations_++;
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ResultCache::invalidateLocal() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ToolAccess changed;
+    changed.barrier = true;
+    invalidate(changed);
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+ResultCacheStats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ResultCacheStats stats;
+    stats.entries = entries_.size();
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.invalidations = invalidations_;
+    return stats;
+}
+
+} // namespace casper
@@ -0,0 +1,166 @@
+#include "session_archive.h"
+#include "utils.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace casper {
+
+namespace {
+
+#ifdef HAVE_ZLIB
+const char* ARCHIVE_SUFFIX = ".jsonl.gz";
+
+// One complete gzip member
+bool gzipMember(const std::string& data, std::string& out) {
+    z_stream zs = {};
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&zs, static_cast<uLong>(data.size())));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    bool done = deflate(&zs, Z_FINISH) == Z_STREAM_END;
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return done;
+}
+
+bool gunzipMember(const std::string& data, std::string& out) {
+    z_stream zs = {};
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return false;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+
+    char buffer[65536];
+    int rc = Z_OK;
+    while (rc == Z_OK) {
+        zs.next_out = reinterpret_cast<Bytef*>(buffer);
+        zs.avail_out = sizeof(buffer);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+#else
+const char* ARCHIVE_SUFFIX = ".jsonl";
+#endif
+
+} // anonymous namespace
+
+SessionArchive::SessionArchive(const std::string& dir)
+    : dir_(dir)
+{
+}
+
+bool SessionArchive::append(const std::string& month, const std::string& line,
+                            ArchiveLocation& location, std::string& error) {
+    if (!utils::dirExists(dir_) && !utils::createDir(dir_)) {
+        error = "cannot create " + dir_ + ": " + std::strerror(errno);
+        return false;
+    }
+
+    std::string record;
+#ifdef HAVE_ZLIB
+    if (!gzipMember(line + "\n", record)) {
+        error = "compression failed";
+        return false;
+    }
+#else
+    record = line + "\n";
+#endif
+
+    location.file = month + ARCHIVE_SUFFIX;
+    std::string path = utils::joinPath(dir_, location.file);
+    bool created = !utils::fileExists(path);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    // Another casper may archive into the same month; the lock keeps the
+    // size we record as offset, the write and a failed write's truncation together
+    struct stat st;
+    if (fd < 0 || flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    location.offset = static_cast<uint64_t>(st.st_size);
+    location.length = record.size();
+
+    size_t written = 0;
+    bool ok = true;
+    while (ok && written < record.size()) {
+        ssize_t n = write(fd, record.data() + written, record.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = false;
+        else written += static_cast<size_t>(n);
+    }
+    // The session is deleted from the database once this returns
+    if (ok && fsync(fd) != 0) ok = false;
+    if (!ok) {
+        error = "cannot write " + path + ": " + std::strerror(errno);
+        // A torn member would make the rest of the file unreadable with zcat
+        if (ftruncate(fd, static_cast<off_t>(location.offset)) != 0) {
+            // Still unreferenced, as the index is never written
+        }
+    }
+    close(fd);
+
+    if (ok && created) {
+        int dir_fd = open(dir_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+    return ok;
+}
+
+bool SessionArchive::read(const ArchiveLocation& location, std::string& line, std::string& error) const {
+    std::string path = utils::joinPath(dir_, location.file);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    std::string record(location.length, '\0');
+    size_t got = 0;
+    while (got < record.size()) {
+        ssize_t n = pread(fd, &record[got], record.size() - got, static_cast<off_t>(location.offset + got));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += static_cast<size_t>(n);
+    }
+    close(fd);
+    if (got < record.size()) {
+        error = path + " is shorter than its index says";
+        return false;
+    }
+
+    line.clear();
+    if (utils::endsWith(location.file, ".gz")) {
+#ifdef HAVE_ZLIB
+        if (!gunzipMember(record, line)) {
+            error = path + " is corrupt at offset " + std::to_string(location.offset);
+            return false;
+        }
+#else
+        error = path + " is compressed and this build has no zlib";
+        return false;
+#endif
+    } else {
+        line = record;
+    }
+    if (!line.empty() && line.back() == '\n') line.pop_back();
+    return true;
+}
+
+} // namespace casper
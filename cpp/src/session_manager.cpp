@@ -1,4 +1,7 @@
 #include "session_manager.h"
+#include "blob_store.h"
+#include "process_runner.h"
+#include "session_archive.h"
 #include "utils.h"
 #include <iostream>
 #include <fstream>
@@ -6,9 +9,233 @@
 #include <iomanip>
 #include <random>
 #include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <csignal>
+#include <unistd.h>
 
 namespace casper {
 
+namespace {
+
+// The background writer commits whatever is queued this often, or sooner
+// once a group is full
+const auto GROUP_COMMIT_INTERVAL = std::chrono::milliseconds(5);
+const size_t GROUP_COMMIT_MAX = 256;
+
+// Saves block only once this many writes are waiting
+const size_t WRITE_QUEUE_LIMIT = 4096;
+
+// A group that fails to commit (database busy, disk full) goes back to the
+// head of the queue and is retried after a pause that doubles each time.
+// After WRITE_RETRIES failures in a row the user is warned, and flush() and
+// full queues stop waiting on it while the retries go on.
+const auto WRITE_RETRY_INTERVAL = std::chrono::milliseconds(100);
+const auto WRITE_RETRY_MAX_INTERVAL = std::chrono::milliseconds(5000);
+const int WRITE_RETRIES = 5;
+
+// Messages a resumed session starts with
+const int RESUME_MESSAGES = 50;
+
+// Retention starts a little after startup, then archives about
+// RETENTION_STEP_BYTES of sessions per step with a pause between steps, so
+// the REPL's own saves never wait on it for long
+const std::chrono::milliseconds RETENTION_START_DELAY(10000);
+const std::chrono::milliseconds RETENTION_STEP_INTERVAL(1000);
+const std::chrono::milliseconds RETENTION_IDLE_INTERVAL(600000);
+const uint64_t RETENTION_STEP_BYTES = 8 * 1024 * 1024;
+
+// Pages given back to the file system per step, on databases that can
+const int COMPACT_STEP_PAGES = 256;
+
+// User messages kept in an archived session's index entry for search
+const size_t ARCHIVE_EXCERPT_BYTES = 4096;
+
+// A terminating signal hands its number to a watcher thread through this
+// pipe; the watcher passes it on to the commands still running, flushes the
+// queue and then lets the signal take effect.
+std::atomic<SessionManager*> signal_flush_target{nullptr};
+int signal_pipe[2] = {-1, -1};
+
+// Time the commands get to exit on the forwarded signal before SIGKILL
+const int SIGNAL_GRACE_MS = 500;
+
+void onTerminatingSignal(int sig) {
+    unsigned char byte = static_cast<unsigned char>(sig);
+    ssize_t written = write(signal_pipe[1], &byte, 1);
+    (void)written;
+}
+
+void installSignalFlush() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        if (pipe(signal_pipe) != 0) return;
+        std::thread([]() {
+            unsigned char sig;
+            while (read(signal_pipe[0], &sig, 1) == 1) {
+                auto forwarded = std::chrono::steady_clock::now();
+                ProcessRunner::signalGroups(sig);
+                if (SessionManager* manager = signal_flush_target.load()) {
+                    manager->flush();
+                }
+                while (ProcessRunner::signalGroups(0) &&
+                       std::chrono::steady_clock::now() - forwarded < std::chrono::milliseconds(SIGNAL_GRACE_MS)) {
+                    usleep(10 * 1000);
+                }
+                ProcessRunner::signalGroups(SIGKILL);
+                signal(sig, SIG_DFL);
+                raise(sig);
+            }
+        }).detach();
+        for (int sig : {SIGINT, SIGTERM, SIGHUP}) {
+            struct sigaction action = {};
+            action.sa_handler = onTerminatingSignal;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            sigaction(sig, &action, nullptr);
+        }
+    });
+}
+
+// Bytes a batch of appended rows adds to a session, for its summary
+uint64_t rowBytes(const Session& rows) {
+    uint64_t bytes = 0;
+    for (const auto& msg : rows.messages) bytes += msg.content.size();
+    for (const auto& te : rows.tool_executions) bytes += te.parameters.dump().size() + te.output.size();
+    for (const auto& fm : rows.file_modifications) bytes += fm.file_path.size();
+    return bytes;
+}
+
+// Each word of the query as a quoted FTS5 string, so punctuation such as
+// "nginx.conf" or "-t" is matched rather than parsed as query syntax
+std::string ftsQuery(const std::string& query) {
+    std::string fts;
+    std::istringstream words(query);
+    std::string word;
+    while (words >> word) {
+        bool prefix = word.size() > 1 && word.back() == '*';
+        if (prefix) word.pop_back();
+        std::string quoted = "\"";
+        for (char c : word) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        quoted += '"';
+        if (!fts.empty()) fts += " ";
+        fts += quoted + (prefix ? "*" : "");
+    }
+    return fts;
+}
+
+std::string columnText(sqlite3_stmt* stmt, int column) {
+    const unsigned char* value = sqlite3_column_text(stmt, column);
+    return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+}
+
+// Runs each statement with ?1 bound to session_id, stopping at the first failure
+bool runForSession(sqlite3* db, std::initializer_list<const char*> sqls, const std::string& session_id) {
+    for (const char* sql : sqls) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+        if (sqlite3_bind_parameter_count(stmt) > 0) {
+            sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        bool done = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        if (!done) return false;
+    }
+    return true;
+}
+
+// A session's rows, inside the caller's transaction. Foreign keys are not
+// enforced, so they are removed here rather than by ON DELETE CASCADE; their
+// delete triggers drop them from the search index. Blobs the session used
+// go too, unless another session shares them.
+bool removeSessionRows(sqlite3* db, const std::string& session_id) {
+    return runForSession(db, {
+        "CREATE TEMP TABLE IF NOT EXISTS dropped_blobs (hash TEXT PRIMARY KEY)",
+        "DELETE FROM dropped_blobs",
+        "INSERT OR IGNORE INTO dropped_blobs SELECT content_hash FROM messages WHERE session_id = ?1 AND content_hash IS NOT NULL",
+        "INSERT OR IGNORE INTO dropped_blobs SELECT output_hash FROM tool_executions WHERE session_id = ?1 AND output_hash IS NOT NULL",
+        "DELETE FROM messages WHERE session_id = ?1",
+        "DELETE FROM tool_executions WHERE session_id = ?1",
+        "DELETE FROM file_modifications WHERE session_id = ?1",
+        "DELETE FROM sessions WHERE session_id = ?1",
+        R"(DELETE FROM blobs WHERE hash IN (SELECT hash FROM dropped_blobs)
+           AND NOT EXISTS (SELECT 1 FROM messages WHERE content_hash = blobs.hash)
+           AND NOT EXISTS (SELECT 1 FROM tool_executions WHERE output_hash = blobs.hash))",
+    }, session_id);
+}
+
+// The first user messages, for an archived session's search entry
+std::string archiveExcerpt(const Session& session) {
+    std::string excerpt;
+    for (const auto& msg : session.messages) {
+        if (msg.role != "user") continue;
+        excerpt += msg.content + "\n";
+        if (excerpt.size() >= ARCHIVE_EXCERPT_BYTES) break;
+    }
+    if (excerpt.size() > ARCHIVE_EXCERPT_BYTES) {
+        // Not in the middle of a UTF-8 sequence
+        size_t end = ARCHIVE_EXCERPT_BYTES;
+        while (end > 0 && (static_cast<unsigned char>(excerpt[end]) & 0xC0) == 0x80) end--;
+        excerpt.resize(end);
+    }
+    return excerpt;
+}
+
+// A session as one archive line. Payloads it repeats, such as a file read
+// again and again, are written once under "blobs" and referred to by hash
+std::string archiveLine(const Session& session) {
+    json j = session.toJson();
+    json blobs = json::object();
+    auto share = [&blobs](json& entry, const std::string& field) {
+        std::string& text = entry[field].get_ref<std::string&>();
+        if (text.size() < BlobStore::MIN_SIZE) return;
+        std::string hash = utils::sha256Hex(text);
+        if (!blobs.contains(hash)) blobs[hash] = std::move(text);
+        entry[field + "_blob"] = hash;
+        entry.erase(field);
+    };
+    for (auto& msg : j["messages"]) share(msg, "content");
+    for (auto& te : j["tool_executions"]) share(te, "output");
+    j["blobs"] = std::move(blobs);
+    return j.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+bool parseArchiveLine(const std::string& line, Session& session) {
+    json j = json::parse(line, nullptr, false);
+    if (j.is_discarded() || !j.is_object()) return false;
+
+    json blobs = j.contains("blobs") && j["blobs"].is_object() ? j["blobs"] : json::object();
+    auto resolve = [&blobs](json& entry, const std::string& field) {
+        std::string hash = entry.is_object() ? entry.value(field + "_blob", "") : "";
+        if (hash.empty()) return true;
+        auto it = blobs.find(hash);
+        if (it == blobs.end() || !it->is_string()) return false;
+        entry[field] = *it;
+        return true;
+    };
+    for (const char* list : {"messages", "tool_executions"}) {
+        if (!j.contains(list) || !j[list].is_array()) continue;
+        for (auto& entry : j[list]) {
+            if (!resolve(entry, list[0] == 'm' ? "content" : "output")) return false;
+        }
+    }
+    session = Session::fromJson(j);
+    return true;
+}
+
+// Local time, formatted like the session timestamps so the two compare as strings
+std::string timestampDaysAgo(int days) {
+    auto time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() - std::chrono::hours(24 * days));
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+    return ss.str();
+}
+
+} // anonymous namespace
+
 // Message implementation
 json Message::toJson() const {
     return json{
@@ -132,21 +359,86 @@ Session Session::fromJson(const json& j) {
 // SessionManager implementation
 SessionManager::SessionManager()
     : db_(nullptr)
+    , write_db_(nullptr)
+    , durability_("normal")
+    , search_index_(false)
+    , saved_messages_(0)
+    , saved_tool_executions_(0)
+    , saved_file_modifications_(0)
+    , older_messages_(0)
+    , oldest_message_id_(0)
+    , upsert_session_stmt_(nullptr)
+    , insert_message_stmt_(nullptr)
+    , insert_tool_stmt_(nullptr)
+    , insert_file_stmt_(nullptr)
+    , insert_span_stmt_(nullptr)
+    , writing_(false)
+    , stop_writer_(false)
+    , flush_requests_(0)
+    , failed_commits_(0)
+    , archive_db_(nullptr)
+    , stop_retention_(false)
 {
 }
 
 SessionManager::~SessionManager() {
+    stopRetention();
     if (current_session_ && current_session_->is_active) {
         saveSession();
         closeSession();
     }
 
+    stopWriter();
+    finalizeStatements();
+    blobs_.reset();
+    if (archive_db_) {
+        sqlite3_close(archive_db_);
+    }
+    if (write_db_ && write_db_ != db_) {
+        sqlite3_close(write_db_);
+    }
     if (db_) {
         sqlite3_close(db_);
     }
 }
 
-bool SessionManager::initialize(const std::string& db_path) {
+sqlite3_stmt* SessionManager::cachedStatement(sqlite3_stmt*& cached, const char* sql) {
+    if (!write_db_) return nullptr;
+    if (cached) {
+        sqlite3_reset(cached);
+        sqlite3_clear_bindings(cached);
+        return cached;
+    }
+    if (sqlite3_prepare_v2(write_db_, sql, -1, &cached, nullptr) != SQLITE_OK) {
+        cached = nullptr;
+    }
+    return cached;
+}
+
+void SessionManager::finalizeStatements() {
+    for (sqlite3_stmt** stmt : {&upsert_session_stmt_, &insert_message_stmt_, &insert_tool_stmt_,
+                                &insert_file_stmt_, &insert_span_stmt_}) {
+        if (*stmt) {
+            sqlite3_finalize(*stmt);
+            *stmt = nullptr;
+        }
+    }
+}
+
+bool SessionManager::execute(sqlite3* db, const char* sql) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        if (err_msg) {
+            std::cerr << "SQL error: " << err_msg << std::endl;
+            sqlite3_free(err_msg);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool SessionManager::initialize(const std::string& db_path, const std::string& durability) {
+    durability_ = (durability == "full" || durability == "off") ? durability : "normal";
     if (db_path.empty()) {
         db_path_ = getSessionDbPath();
     } else {
@@ -163,7 +455,125 @@ bool SessionManager::initialize(const std::string& db_path) {
     }
 
     initializeDatabase();
-    return db_ != nullptr;
+    if (!db_) return false;
+    archive_ = std::make_unique<SessionArchive>(getArchiveDir());
+
+    // Two connections in write-behind mode wait on each other's locks rather than fail
+    sqlite3_busy_timeout(db_, 5000);
+    if (durability_ == "full") {
+        write_db_ = db_;
+        blobs_ = std::make_unique<BlobStore>(write_db_);
+        execute(db_, "PRAGMA synchronous = FULL");
+        return true;
+    }
+
+    // WAL lets the REPL read while the writer commits
+    execute(db_, "PRAGMA journal_mode = WAL");
+    if (sqlite3_open(db_path_.c_str(), &write_db_) != SQLITE_OK) {
+        std::cerr << "Failed to open session database: " << sqlite3_errmsg(write_db_) << std::endl;
+        sqlite3_close(write_db_);
+        write_db_ = db_;
+        blobs_ = std::make_unique<BlobStore>(write_db_);
+        durability_ = "full";
+        return true;
+    }
+    BlobStore::registerFunctions(write_db_);
+    blobs_ = std::make_unique<BlobStore>(write_db_);
+    sqlite3_busy_timeout(write_db_, 5000);
+    execute(write_db_, durability_ == "off" ? "PRAGMA synchronous = OFF" : "PRAGMA synchronous = NORMAL");
+
+    writer_ = std::thread(&SessionManager::writerLoop, this);
+    signal_flush_target = this;
+    installSignalFlush();
+    return true;
+}
+
+void SessionManager::flush() {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    if (!writer_.joinable()) return;
+    flush_requests_++;
+    queue_cv_.notify_one();
+    drained_cv_.wait(lock, [this]() {
+        return (queue_.empty() && !writing_) || failed_commits_ >= WRITE_RETRIES;
+    });
+    flush_requests_--;
+}
+
+void SessionManager::stopWriter() {
+    if (signal_flush_target == this) signal_flush_target = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!writer_.joinable()) return;
+        stop_writer_ = true;
+    }
+    queue_cv_.notify_one();
+    writer_.join();
+}
+
+void SessionManager::writerLoop() {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    while (true) {
+        queue_cv_.wait(lock, [this]() { return stop_writer_ || !queue_.empty(); });
+        if (queue_.empty()) break;  // Stopping with nothing left
+
+        if (failed_commits_ > 0) {
+            auto pause = WRITE_RETRY_INTERVAL * (1 << std::min(failed_commits_ - 1, 6));
+            queue_cv_.wait_for(lock, std::min<std::chrono::milliseconds>(pause, WRITE_RETRY_MAX_INTERVAL));
+        } else {
+            // Let a group gather, unless it is full or someone is waiting for it
+            queue_cv_.wait_for(lock, GROUP_COMMIT_INTERVAL, [this]() {
+                return stop_writer_ || flush_requests_ > 0 || queue_.size() >= GROUP_COMMIT_MAX;
+            });
+        }
+
+        std::vector<PendingWrite> batch;
+        while (!queue_.empty() && batch.size() < GROUP_COMMIT_MAX) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        writing_ = true;
+        drained_cv_.notify_all();   // Room in the queue again
+        lock.unlock();
+
+        bool written = writeBatch(batch);
+
+        lock.lock();
+        writing_ = false;
+        if (written) {
+            if (failed_commits_ >= WRITE_RETRIES) {
+                utils::terminal::printSuccess("Session history is being saved again");
+            }
+            failed_commits_ = 0;
+        } else if (++failed_commits_ >= WRITE_RETRIES && stop_writer_) {
+            // Exiting: there is no later to retry in
+            utils::terminal::printError("Could not save " + std::to_string(batch.size() + queue_.size()) +
+                                        " session update(s); the database is busy or the disk is full");
+            queue_.clear();
+        } else {
+            // The saves behind it keep their order
+            for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+                queue_.push_front(std::move(*it));
+            }
+            if (failed_commits_ == WRITE_RETRIES) {
+                utils::terminal::printWarning("Session history is not being saved (database busy or disk full?); "
+                                              "still retrying");
+            }
+        }
+        drained_cv_.notify_all();
+    }
+}
+
+void SessionManager::submit(PendingWrite write) {
+    if (!writer_.joinable()) {
+        writeBatch({std::move(write)});
+        return;
+    }
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    drained_cv_.wait(lock, [this]() {
+        return queue_.size() < WRITE_QUEUE_LIMIT || failed_commits_ >= WRITE_RETRIES;
+    });
+    queue_.push_back(std::move(write));
+    queue_cv_.notify_one();
 }
 
 void SessionManager::initializeDatabase() {
@@ -174,6 +584,11 @@ void SessionManager::initializeDatabase() {
         return;
     }
 
+    // Needed by the views and search triggers, so before anything touches them
+    BlobStore::registerFunctions(db_);
+    // Only takes effect on a new database, which can then give the space of
+    // archived sessions back to the file system bit by bit
+    execute(db_, "PRAGMA auto_vacuum = INCREMENTAL");
     createTables();
 }
 
@@ -188,7 +603,10 @@ void SessionManager::createTables() {
             model TEXT NOT NULL,
             working_directory TEXT,
             summary TEXT,
-            is_active INTEGER DEFAULT 1
+            is_active INTEGER DEFAULT 1,
+            message_count INTEGER DEFAULT 0,
+            tool_count INTEGER DEFAULT 0,
+            size_bytes INTEGER DEFAULT 0
         );
     )";
 
@@ -199,6 +617,7 @@ void SessionManager::createTables() {
             role TEXT NOT NULL,
             content TEXT NOT NULL,
             timestamp TEXT NOT NULL,
+            content_hash TEXT,
             FOREIGN KEY (session_id) REFERENCES sessions(session_id) ON DELETE CASCADE
         );
     )";
@@ -212,6 +631,7 @@ void SessionManager::createTables() {
             output TEXT,
             exit_code INTEGER,
             timestamp TEXT NOT NULL,
+            output_hash TEXT,
             FOREIGN KEY (session_id) REFERENCES sessions(session_id) ON DELETE CASCADE
         );
     )";
@@ -227,11 +647,69 @@ void SessionManager::createTables() {
         );
     )";
 
+    const char* create_tool_spans = R"(
+        CREATE TABLE IF NOT EXISTS tool_spans (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            session_id TEXT NOT NULL,
+            tool_name TEXT NOT NULL,
+            parameters TEXT,
+            wall_ms INTEGER NOT NULL,
+            cpu_seconds REAL,
+            thread_cpu_seconds REAL,
+            max_rss_kb INTEGER,
+            output_bytes INTEGER,
+            truncated_bytes INTEGER,
+            cache_hit INTEGER DEFAULT 0,
+            success INTEGER DEFAULT 1,
+            exit_code INTEGER,
+            timestamp TEXT NOT NULL,
+            FOREIGN KEY (session_id) REFERENCES sessions(session_id) ON DELETE CASCADE
+        );
+    )";
+
+    // Content lives here when it is MIN_SIZE or more; messages.content_hash
+    // and tool_executions.output_hash point at it, and content/output are
+    // left empty
+    const char* create_blobs = R"(
+        CREATE TABLE IF NOT EXISTS blobs (
+            id INTEGER PRIMARY KEY,
+            hash TEXT NOT NULL UNIQUE,
+            codec INTEGER NOT NULL,
+            size INTEGER NOT NULL,
+            data BLOB NOT NULL
+        );
+    )";
+
+    // Sessions moved out by retention: where each one is in the archive
+    // files, and enough about it to list and search it without reading them
+    const char* create_archived_sessions = R"(
+        CREATE TABLE IF NOT EXISTS archived_sessions (
+            id INTEGER PRIMARY KEY,
+            session_id TEXT NOT NULL UNIQUE,
+            created_at TEXT NOT NULL,
+            updated_at TEXT NOT NULL,
+            model TEXT,
+            working_directory TEXT,
+            summary TEXT,
+            excerpt TEXT,
+            message_count INTEGER DEFAULT 0,
+            tool_count INTEGER DEFAULT 0,
+            size_bytes INTEGER DEFAULT 0,
+            file TEXT NOT NULL,
+            file_offset INTEGER NOT NULL,
+            file_length INTEGER NOT NULL
+        );
+    )";
+
     const char* create_indices = R"(
         CREATE INDEX IF NOT EXISTS idx_messages_session ON messages(session_id);
         CREATE INDEX IF NOT EXISTS idx_tools_session ON tool_executions(session_id);
+        CREATE INDEX IF NOT EXISTS idx_spans_session ON tool_spans(session_id);
+        CREATE INDEX IF NOT EXISTS idx_spans_tool ON tool_spans(tool_name, wall_ms);
         CREATE INDEX IF NOT EXISTS idx_files_session ON file_modifications(session_id);
-        CREATE INDEX IF NOT EXISTS idx_sessions_active ON sessions(is_active);
+        DROP INDEX IF EXISTS idx_sessions_active;
+        CREATE INDEX IF NOT EXISTS idx_sessions_active_recent ON sessions(is_active, updated_at);
+        CREATE INDEX IF NOT EXISTS idx_sessions_recent ON sessions(updated_at, session_id);
     )";
 
     char* err_msg = nullptr;
@@ -264,11 +742,64 @@ void SessionManager::createTables() {
         err_msg = nullptr;
     }
 
+    sqlite3_exec(db_, create_tool_spans, nullptr, nullptr, &err_msg);
+    if (err_msg) {
+        std::cerr << "SQL error: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        err_msg = nullptr;
+    }
+
+    sqlite3_exec(db_, create_blobs, nullptr, nullptr, &err_msg);
+    if (err_msg) {
+        std::cerr << "SQL error: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        err_msg = nullptr;
+    }
+
+    sqlite3_exec(db_, create_archived_sessions, nullptr, nullptr, &err_msg);
+    if (err_msg) {
+        std::cerr << "SQL error: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        err_msg = nullptr;
+    }
+
     sqlite3_exec(db_, create_indices, nullptr, nullptr, &err_msg);
     if (err_msg) {
         std::cerr << "SQL error: " << err_msg << std::endl;
         sqlite3_free(err_msg);
     }
+
+    addSummaryColumns();
+    createBlobStorage();
+    createSearchIndex();
+}
+
+void SessionManager::addSummaryColumns() {
+    // Databases from before the session list kept counts
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, "SELECT message_count FROM sessions LIMIT 0", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    bool migrated = execute(db_, R"(
+        BEGIN;
+        ALTER TABLE sessions ADD COLUMN message_count INTEGER DEFAULT 0;
+        ALTER TABLE sessions ADD COLUMN tool_count INTEGER DEFAULT 0;
+        ALTER TABLE sessions ADD COLUMN size_bytes INTEGER DEFAULT 0;
+        UPDATE sessions SET
+            message_count = (SELECT COUNT(*) FROM messages m WHERE m.session_id = sessions.session_id),
+            tool_count = (SELECT COUNT(*) FROM tool_executions t WHERE t.session_id = sessions.session_id),
+            size_bytes =
+                (SELECT IFNULL(SUM(LENGTH(CAST(content AS BLOB))), 0) FROM messages m
+                 WHERE m.session_id = sessions.session_id) +
+                (SELECT IFNULL(SUM(LENGTH(CAST(parameters AS BLOB)) + LENGTH(CAST(output AS BLOB))), 0)
+                 FROM tool_executions t WHERE t.session_id = sessions.session_id) +
+                (SELECT IFNULL(SUM(LENGTH(CAST(file_path AS BLOB))), 0) FROM file_modifications f
+                 WHERE f.session_id = sessions.session_id);
+        COMMIT;
+    )");
+    if (!migrated) execute(db_, "ROLLBACK");
 }
 
 std::string SessionManager::generateSessionId() const {
@@ -304,13 +835,39 @@ std::string SessionManager::createSession(const std::string& model, const std::s
     current_session_->model = model;
     current_session_->working_directory = working_dir;
     current_session_->is_active = true;
+    saved_messages_ = 0;
+    saved_tool_executions_ = 0;
+    saved_file_modifications_ = 0;
+    older_messages_ = 0;
+    oldest_message_id_ = 0;
+    setOpenSession(current_session_->session_id);
 
     saveSessionToDb();
     return current_session_->session_id;
 }
 
 bool SessionManager::loadSession(const std::string& session_id) {
-    return loadSessionFromDb(session_id);
+    flush();
+    // Retention waits until the session is open, so it cannot archive it
+    // again between restore and load
+    std::lock_guard<std::recursive_mutex> pin(open_session_mutex_);
+    if (!sessionExists(session_id) && !restoreSession(session_id)) return false;
+    if (current_session_) {
+        closeSession();
+        flush();
+    }
+    if (!loadSessionFromDb(session_id)) return false;
+    // Resumed sessions are recorded to again
+    current_session_->is_active = true;
+    setOpenSession(session_id);
+    return true;
+}
+
+int SessionManager::loadOlderMessages(int count) {
+    if (!current_session_ || older_messages_ == 0) return 0;
+    int loaded = loadMessages(current_session_->session_id, count);
+    saved_messages_ += loaded;
+    return loaded;
 }
 
 bool SessionManager::saveSession() {
@@ -326,9 +883,15 @@ bool SessionManager::closeSession() {
     current_session_->is_active = false;
     saveSession();
     current_session_.reset();
+    setOpenSession("");
     return true;
 }
 
+void SessionManager::setOpenSession(const std::string& session_id) {
+    std::lock_guard<std::recursive_mutex> lock(open_session_mutex_);
+    open_session_id_ = session_id;
+}
+
 void SessionManager::addUserMessage(const std::string& content) {
     if (!current_session_) return;
 
@@ -382,6 +945,165 @@ void SessionManager::recordToolExecution(const std::string& tool_name,
     saveSession();
 }
 
+std::string SessionManager::getToolOutput(const ToolExecution& te) const {
+    if (te.output_loaded || !db_) return te.output;
+
+    sqlite3_stmt* stmt;
+    std::string output;
+    if (sqlite3_prepare_v2(db_, "SELECT output FROM tool_outputs_text WHERE id = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, te.id);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+            output = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    return output;
+}
+
+void SessionManager::recordToolSpan(const ToolSpan& span) {
+    if (!db_ || !current_session_) return;
+
+    PendingWrite write;
+    write.rows.session_id = current_session_->session_id;
+    write.spans.push_back(span);
+    write.spans.back().timestamp = getCurrentTimestamp();
+    submit(std::move(write));
+}
+
+bool SessionManager::saveToolSpans(const std::string& session_id, const std::vector<ToolSpan>& spans) {
+    const char* sql = R"(
+        INSERT INTO tool_spans
+        (session_id, tool_name, parameters, wall_ms, cpu_seconds, thread_cpu_seconds, max_rss_kb,
+         output_bytes, truncated_bytes, cache_hit, success, exit_code, timestamp)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+    )";
+
+    for (const auto& span : spans) {
+        sqlite3_stmt* stmt = cachedStatement(insert_span_stmt_, sql);
+        if (!stmt) return false;
+        sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, span.tool_name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, span.parameters.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, span.wall_ms);
+        sqlite3_bind_double(stmt, 5, span.cpu_seconds);
+        sqlite3_bind_double(stmt, 6, span.thread_cpu_seconds);
+        sqlite3_bind_int64(stmt, 7, span.max_rss_kb);
+        sqlite3_bind_int64(stmt, 8, static_cast<sqlite3_int64>(span.output_bytes));
+        sqlite3_bind_int64(stmt, 9, static_cast<sqlite3_int64>(span.truncated_bytes));
+        sqlite3_bind_int(stmt, 10, span.cache_hit ? 1 : 0);
+        sqlite3_bind_int(stmt, 11, span.success ? 1 : 0);
+        sqlite3_bind_int(stmt, 12, span.exit_code);
+        sqlite3_bind_text(stmt, 13, span.timestamp.c_str(), -1, SQLITE_STATIC);
+        bool done = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+        if (!done) return false;
+    }
+    return true;
+}
+
+std::vector<ToolStats> SessionManager::getToolStats(bool all_sessions) {
+    std::vector<ToolStats> stats;
+    if (!db_ || (!all_sessions && !current_session_)) return stats;
+    flush();
+
+    // Percentiles need the sorted durations, so aggregate here rather than in SQL
+    std::string sql = "SELECT tool_name, wall_ms, cpu_seconds + thread_cpu_seconds, max_rss_kb, "
+                      "output_bytes, truncated_bytes, cache_hit, success FROM tool_spans";
+    if (!all_sessions) sql += " WHERE session_id = ?";
+    sql += " ORDER BY tool_name, wall_ms";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return stats;
+    }
+    if (!all_sessions) {
+        sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    std::vector<long> durations;
+    auto finish = [&]() {
+        if (stats.empty() || durations.empty()) return;
+        ToolStats& tool = stats.back();
+        // Nearest rank
+        auto percentile = [&](double p) {
+            size_t rank = static_cast<size_t>(std::ceil(p * durations.size()));
+            return durations[std::max<size_t>(rank, 1) - 1];
+        };
+        tool.p50_ms = percentile(0.50);
+        tool.p95_ms = percentile(0.95);
+        tool.max_ms = durations.back();
+        durations.clear();
+    };
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (stats.empty() || stats.back().tool_name != name) {
+            finish();
+            stats.emplace_back();
+            stats.back().tool_name = name;
+        }
+        ToolStats& tool = stats.back();
+        long wall_ms = static_cast<long>(sqlite3_column_int64(stmt, 1));
+        durations.push_back(wall_ms);
+        tool.calls++;
+        tool.total_ms += wall_ms;
+        tool.cpu_seconds += sqlite3_column_double(stmt, 2);
+        tool.max_rss_kb = std::max(tool.max_rss_kb, static_cast<long>(sqlite3_column_int64(stmt, 3)));
+        tool.output_bytes += static_cast<uint64_t>(sqlite3_column_int64(stmt, 4));
+        tool.truncated_bytes += static_cast<uint64_t>(sqlite3_column_int64(stmt, 5));
+        if (sqlite3_column_int(stmt, 6)) tool.cache_hits++;
+        if (!sqlite3_column_int(stmt, 7)) tool.failures++;
+    }
+    finish();
+    sqlite3_finalize(stmt);
+
+    std::sort(stats.begin(), stats.end(), [](const ToolStats& a, const ToolStats& b) {
+        return a.total_ms > b.total_ms;
+    });
+    return stats;
+}
+
+std::vector<ToolSpan> SessionManager::getSlowestToolSpans(int limit, bool all_sessions) {
+    std::vector<ToolSpan> spans;
+    if (!db_ || (!all_sessions && !current_session_)) return spans;
+    flush();
+
+    std::string sql = "SELECT tool_name, parameters, wall_ms, cpu_seconds, thread_cpu_seconds, max_rss_kb, "
+                      "output_bytes, truncated_bytes, cache_hit, success, exit_code FROM tool_spans";
+    if (!all_sessions) sql += " WHERE session_id = ?";
+    sql += " ORDER BY wall_ms DESC LIMIT ?";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return spans;
+    }
+    int index = 1;
+    if (!all_sessions) {
+        sqlite3_bind_text(stmt, index++, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    sqlite3_bind_int(stmt, index, limit);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ToolSpan span;
+        span.tool_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        const unsigned char* params = sqlite3_column_text(stmt, 1);
+        span.parameters = params ? reinterpret_cast<const char*>(params) : "";
+        span.wall_ms = static_cast<long>(sqlite3_column_int64(stmt, 2));
+        span.cpu_seconds = sqlite3_column_double(stmt, 3);
+        span.thread_cpu_seconds = sqlite3_column_double(stmt, 4);
+        span.max_rss_kb = static_cast<long>(sqlite3_column_int64(stmt, 5));
+        span.output_bytes = static_cast<size_t>(sqlite3_column_int64(stmt, 6));
+        span.truncated_bytes = static_cast<size_t>(sqlite3_column_int64(stmt, 7));
+        span.cache_hit = sqlite3_column_int(stmt, 8) != 0;
+        span.success = sqlite3_column_int(stmt, 9) != 0;
+        span.exit_code = sqlite3_column_int(stmt, 10);
+        spans.push_back(span);
+    }
+
+    sqlite3_finalize(stmt);
+    return spans;
+}
+
 void SessionManager::recordFileModification(const std::string& file_path,
                                            const std::string& operation) {
     if (!current_session_) return;
@@ -411,36 +1133,90 @@ std::vector<Message> SessionManager::getConversationContext(int max_messages) co
 bool SessionManager::saveSessionToDb() {
     if (!db_ || !current_session_) return false;
 
-    // Save session metadata
-    const char* sql = R"(
-        INSERT OR REPLACE INTO sessions
-        (session_id, created_at, updated_at, model, working_directory, summary, is_active)
-        VALUES (?, ?, ?, ?, ?, ?, ?)
-    )";
-
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return false;
+    const Session& session = *current_session_;
+    PendingWrite write;
+    write.has_session = true;
+    write.rows.session_id = session.session_id;
+    write.rows.created_at = session.created_at;
+    write.rows.updated_at = session.updated_at;
+    write.rows.model = session.model;
+    write.rows.working_directory = session.working_directory;
+    write.rows.summary = session.summary;
+    write.rows.is_active = session.is_active;
+    write.rows.messages.assign(session.messages.begin() + saved_messages_, session.messages.end());
+    write.rows.tool_executions.assign(session.tool_executions.begin() + saved_tool_executions_,
+                                      session.tool_executions.end());
+    write.rows.file_modifications.assign(session.file_modifications.begin() + saved_file_modifications_,
+                                         session.file_modifications.end());
+
+    if (!writer_.joinable()) {
+        // Written here; on failure the rows stay pending for the next save
+        if (!writeBatch({write})) return false;
+    } else {
+        submit(std::move(write));
     }
 
-    sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, current_session_->created_at.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, current_session_->updated_at.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 4, current_session_->model.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 5, current_session_->working_directory.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 6, current_session_->summary.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 7, current_session_->is_active ? 1 : 0);
+    saved_messages_ = session.messages.size();
+    saved_tool_executions_ = session.tool_executions.size();
+    saved_file_modifications_ = session.file_modifications.size();
+    return true;
+}
 
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    sqlite3_finalize(stmt);
+bool SessionManager::writeBatch(const std::vector<PendingWrite>& batch) {
+    // One transaction per batch: a single sync instead of one per row
+    if (!execute(write_db_, "BEGIN")) return false;
 
-    if (success) {
-        saveMessages();
-        saveToolExecutions();
-        saveFileModifications();
+    // Save session metadata. An upsert rather than INSERT OR REPLACE, which
+    // would delete the row and with it, under foreign keys, its children.
+    // The summary counts grow by what this write appends
+    const char* sql = R"(
+        INSERT INTO sessions
+        (session_id, created_at, updated_at, model, working_directory, summary, is_active,
+         message_count, tool_count, size_bytes)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+        ON CONFLICT(session_id) DO UPDATE SET
+            created_at = excluded.created_at,
+            updated_at = excluded.updated_at,
+            model = excluded.model,
+            working_directory = excluded.working_directory,
+            summary = excluded.summary,
+            is_active = excluded.is_active,
+            message_count = message_count + excluded.message_count,
+            tool_count = tool_count + excluded.tool_count,
+            size_bytes = size_bytes + excluded.size_bytes
+    )";
+
+    bool success = true;
+    for (const auto& write : batch) {
+        if (!success) break;
+        const Session& rows = write.rows;
+        if (write.has_session) {
+            sqlite3_stmt* stmt = cachedStatement(upsert_session_stmt_, sql);
+            success = stmt != nullptr;
+            if (success) {
+                sqlite3_bind_text(stmt, 1, rows.session_id.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt, 2, rows.created_at.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt, 3, rows.updated_at.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt, 4, rows.model.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt, 5, rows.working_directory.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt, 6, rows.summary.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int(stmt, 7, rows.is_active ? 1 : 0);
+                sqlite3_bind_int64(stmt, 8, static_cast<sqlite3_int64>(rows.messages.size()));
+                sqlite3_bind_int64(stmt, 9, static_cast<sqlite3_int64>(rows.tool_executions.size()));
+                sqlite3_bind_int64(stmt, 10, static_cast<sqlite3_int64>(rowBytes(rows)));
+                success = sqlite3_step(stmt) == SQLITE_DONE;
+                sqlite3_reset(stmt);
+            }
+            success = success && saveMessages(rows) && saveToolExecutions(rows) && saveFileModifications(rows);
+        }
+        success = success && saveToolSpans(rows.session_id, write.spans);
     }
 
-    return success;
+    if (!success || !execute(write_db_, "COMMIT")) {
+        execute(write_db_, "ROLLBACK");
+        return false;
+    }
+    return true;
 }
 
 bool SessionManager::loadSessionFromDb(const std::string& session_id) {
@@ -471,135 +1247,155 @@ bool SessionManager::loadSessionFromDb(const std::string& session_id) {
     sqlite3_finalize(stmt);
 
     if (found) {
-        loadMessages(session_id);
+        // Only the tail of a long conversation; the rest stays on disk until asked for
+        older_messages_ = SIZE_MAX;
+        oldest_message_id_ = INT64_MAX;
+        loadMessages(session_id, RESUME_MESSAGES);
         loadToolExecutions(session_id);
         loadFileModifications(session_id);
+        saved_messages_ = current_session_->messages.size();
+        saved_tool_executions_ = current_session_->tool_executions.size();
+        saved_file_modifications_ = current_session_->file_modifications.size();
     }
 
     return found;
 }
 
-bool SessionManager::saveMessages() {
-    if (!db_ || !current_session_) return false;
+bool SessionManager::sessionExists(const std::string& session_id) const {
+    if (!db_) return false;
 
-    // Delete old messages for this session
-    const char* delete_sql = "DELETE FROM messages WHERE session_id = ?";
     sqlite3_stmt* stmt;
-
-    if (sqlite3_prepare_v2(db_, delete_sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+    if (sqlite3_prepare_v2(db_, "SELECT 1 FROM sessions WHERE session_id = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
     }
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
 
-    // Insert all messages
-    const char* insert_sql = "INSERT INTO messages (session_id, role, content, timestamp) VALUES (?, ?, ?, ?)";
+bool SessionManager::saveMessages(const Session& rows) {
+    const char* insert_sql = "INSERT INTO messages (session_id, role, content, timestamp, content_hash) VALUES (?, ?, ?, ?, ?)";
 
-    for (const auto& msg : current_session_->messages) {
-        if (sqlite3_prepare_v2(db_, insert_sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 2, msg.role.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 3, msg.content.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 4, msg.timestamp.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+    for (const auto& msg : rows.messages) {
+        std::string hash;
+        if (msg.content.size() >= BlobStore::MIN_SIZE) {
+            hash = blobs_->put(msg.content);
+            if (hash.empty()) return false;
         }
+
+        sqlite3_stmt* stmt = cachedStatement(insert_message_stmt_, insert_sql);
+        if (!stmt) return false;
+        sqlite3_bind_text(stmt, 1, rows.session_id.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, msg.role.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, hash.empty() ? msg.content.c_str() : "", -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, msg.timestamp.c_str(), -1, SQLITE_STATIC);
+        if (!hash.empty()) sqlite3_bind_text(stmt, 5, hash.c_str(), -1, SQLITE_STATIC);
+        bool done = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+        if (!done) return false;
     }
 
     return true;
 }
 
-bool SessionManager::saveToolExecutions() {
-    if (!db_ || !current_session_) return false;
-
-    // Delete old tool executions for this session
-    const char* delete_sql = "DELETE FROM tool_executions WHERE session_id = ?";
-    sqlite3_stmt* stmt;
-
-    if (sqlite3_prepare_v2(db_, delete_sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
-    }
+bool SessionManager::saveToolExecutions(const Session& rows) {
+    const char* insert_sql = "INSERT INTO tool_executions (session_id, tool_name, parameters, output, exit_code, timestamp, output_hash) VALUES (?, ?, ?, ?, ?, ?, ?)";
 
-    // Insert all tool executions
-    const char* insert_sql = "INSERT INTO tool_executions (session_id, tool_name, parameters, output, exit_code, timestamp) VALUES (?, ?, ?, ?, ?, ?)";
-
-    for (const auto& te : current_session_->tool_executions) {
-        if (sqlite3_prepare_v2(db_, insert_sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            std::string params_str = te.parameters.dump();
-            sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 2, te.tool_name.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 3, params_str.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 4, te.output.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_int(stmt, 5, te.exit_code);
-            sqlite3_bind_text(stmt, 6, te.timestamp.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+    for (const auto& te : rows.tool_executions) {
+        // The same file read or build log again costs a hash, not another copy
+        std::string hash;
+        if (te.output.size() >= BlobStore::MIN_SIZE) {
+            hash = blobs_->put(te.output);
+            if (hash.empty()) return false;
         }
+
+        sqlite3_stmt* stmt = cachedStatement(insert_tool_stmt_, insert_sql);
+        if (!stmt) return false;
+        std::string params_str = te.parameters.dump();
+        sqlite3_bind_text(stmt, 1, rows.session_id.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, te.tool_name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, params_str.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, hash.empty() ? te.output.c_str() : "", -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 5, te.exit_code);
+        sqlite3_bind_text(stmt, 6, te.timestamp.c_str(), -1, SQLITE_STATIC);
+        if (!hash.empty()) sqlite3_bind_text(stmt, 7, hash.c_str(), -1, SQLITE_STATIC);
+        bool done = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+        if (!done) return false;
     }
 
     return true;
 }
 
-bool SessionManager::saveFileModifications() {
-    if (!db_ || !current_session_) return false;
-
-    // Delete old file modifications for this session
-    const char* delete_sql = "DELETE FROM file_modifications WHERE session_id = ?";
-    sqlite3_stmt* stmt;
-
-    if (sqlite3_prepare_v2(db_, delete_sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
-    }
-
-    // Insert all file modifications
+bool SessionManager::saveFileModifications(const Session& rows) {
     const char* insert_sql = "INSERT INTO file_modifications (session_id, file_path, operation, timestamp) VALUES (?, ?, ?, ?)";
 
-    for (const auto& fm : current_session_->file_modifications) {
-        if (sqlite3_prepare_v2(db_, insert_sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, current_session_->session_id.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 2, fm.file_path.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 3, fm.operation.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 4, fm.timestamp.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
-        }
+    for (const auto& fm : rows.file_modifications) {
+        sqlite3_stmt* stmt = cachedStatement(insert_file_stmt_, insert_sql);
+        if (!stmt) return false;
+        sqlite3_bind_text(stmt, 1, rows.session_id.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, fm.file_path.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, fm.operation.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, fm.timestamp.c_str(), -1, SQLITE_STATIC);
+        bool done = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+        if (!done) return false;
     }
 
     return true;
 }
 
-bool SessionManager::loadMessages(const std::string& session_id) {
-    if (!db_ || !current_session_) return false;
+int SessionManager::loadMessages(const std::string& session_id, int limit) {
+    if (!db_ || !current_session_) return 0;
 
-    const char* sql = "SELECT role, content, timestamp FROM messages WHERE session_id = ? ORDER BY id";
+    // The page just before what is loaded, newest first
+    const char* sql = "SELECT id, role, content, timestamp FROM messages_text WHERE session_id = ? AND id < ? ORDER BY id DESC LIMIT ?";
     sqlite3_stmt* stmt;
 
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return false;
+        return 0;
     }
 
     sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, oldest_message_id_);
+    sqlite3_bind_int(stmt, 3, limit);
 
+    std::vector<Message> page;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         Message msg;
-        msg.role = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        msg.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        current_session_->messages.push_back(msg);
+        oldest_message_id_ = sqlite3_column_int64(stmt, 0);
+        msg.role = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        msg.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        page.push_back(msg);
     }
 
     sqlite3_finalize(stmt);
-    return true;
+
+    auto& messages = current_session_->messages;
+    messages.insert(messages.begin(), page.rbegin(), page.rend());
+
+    older_messages_ = 0;
+    if (static_cast<int>(page.size()) == limit) {
+        const char* count_sql = "SELECT COUNT(*) FROM messages WHERE session_id = ? AND id < ?";
+        if (sqlite3_prepare_v2(db_, count_sql, -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 2, oldest_message_id_);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                older_messages_ = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
+    return static_cast<int>(page.size());
 }
 
 bool SessionManager::loadToolExecutions(const std::string& session_id) {
     if (!db_ || !current_session_) return false;
 
-    const char* sql = "SELECT tool_name, parameters, output, exit_code, timestamp FROM tool_executions WHERE session_id = ? ORDER BY id";
+    // Outputs are the bulk of a session; getToolOutput() reads one when it is viewed
+    const char* sql = "SELECT id, tool_name, parameters, exit_code, timestamp FROM tool_executions WHERE session_id = ? ORDER BY id";
     sqlite3_stmt* stmt;
 
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
@@ -610,12 +1406,13 @@ bool SessionManager::loadToolExecutions(const std::string& session_id) {
 
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         ToolExecution te;
-        te.tool_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        te.id = sqlite3_column_int64(stmt, 0);
+        te.tool_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
 
-        std::string params_str = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        std::string params_str = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
         te.parameters = json::parse(params_str, nullptr, false);
 
-        te.output = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        te.output_loaded = false;
         te.exit_code = sqlite3_column_int(stmt, 3);
         te.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
         current_session_->tool_executions.push_back(te);
@@ -649,6 +1446,54 @@ bool SessionManager::loadFileModifications(const std::string& session_id) {
     return true;
 }
 
+std::vector<SessionSummary> SessionManager::listSessionPage(int limit, const std::string& after_id) {
+    std::vector<SessionSummary> page;
+    if (!db_) return page;
+    flush();
+
+    // Keyset pagination: each page starts right after the last session of the
+    // previous one, found through idx_sessions_recent, however deep it is
+    const char* first_sql = R"(
+        SELECT session_id, created_at, updated_at, model, working_directory, summary, is_active,
+               message_count, tool_count, size_bytes
+        FROM sessions ORDER BY updated_at DESC, session_id DESC LIMIT ?1
+    )";
+    const char* next_sql = R"(
+        SELECT session_id, created_at, updated_at, model, working_directory, summary, is_active,
+               message_count, tool_count, size_bytes
+        FROM sessions
+        WHERE (updated_at, session_id) < (SELECT updated_at, session_id FROM sessions WHERE session_id = ?2)
+        ORDER BY updated_at DESC, session_id DESC LIMIT ?1
+    )";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, after_id.empty() ? first_sql : next_sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return page;
+    }
+    sqlite3_bind_int(stmt, 1, limit);
+    if (!after_id.empty()) {
+        sqlite3_bind_text(stmt, 2, after_id.c_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        SessionSummary summary;
+        summary.session_id = columnText(stmt, 0);
+        summary.created_at = columnText(stmt, 1);
+        summary.updated_at = columnText(stmt, 2);
+        summary.model = columnText(stmt, 3);
+        summary.working_directory = columnText(stmt, 4);
+        summary.summary = columnText(stmt, 5);
+        summary.is_active = sqlite3_column_int(stmt, 6) == 1;
+        summary.message_count = sqlite3_column_int(stmt, 7);
+        summary.tool_count = sqlite3_column_int(stmt, 8);
+        summary.size_bytes = static_cast<uint64_t>(sqlite3_column_int64(stmt, 9));
+        page.push_back(summary);
+    }
+
+    sqlite3_finalize(stmt);
+    return page;
+}
+
 std::vector<std::string> SessionManager::listSessions() const {
     if (!db_) return {};
 
@@ -702,18 +1547,595 @@ std::string SessionManager::getLastActiveSession() const {
 
 bool SessionManager::deleteSession(const std::string& session_id) {
     if (!db_) return false;
+    flush();
+
+    if (!execute(db_, "BEGIN")) return false;
+    bool success = removeSessionRows(db_, session_id) &&
+                   runForSession(db_, {
+                       "DELETE FROM tool_spans WHERE session_id = ?1",
+                       "DELETE FROM archived_sessions WHERE session_id = ?1",
+                   }, session_id);
+    if (!success || !execute(db_, "COMMIT")) {
+        execute(db_, "ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+std::string SessionManager::getArchiveDir() const {
+    return utils::joinPath(utils::getDirname(db_path_.empty() ? getSessionDbPath() : db_path_), "archive");
+}
+
+bool SessionManager::isArchived(const std::string& session_id) const {
+    if (!db_) return false;
 
-    const char* sql = "DELETE FROM sessions WHERE session_id = ?";
     sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, "SELECT 1 FROM archived_sessions WHERE session_id = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
 
+bool SessionManager::restoreSession(const std::string& session_id) {
+    if (!db_ || !archive_) return false;
+    std::lock_guard<std::recursive_mutex> pin(open_session_mutex_);
+
+    ArchiveLocation location;
+    bool found = false;
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT file, file_offset, file_length FROM archived_sessions WHERE session_id = ?";
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
         sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            location.file = columnText(stmt, 0);
+            location.offset = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
+            location.length = static_cast<uint64_t>(sqlite3_column_int64(stmt, 2));
+            found = true;
+        }
         sqlite3_finalize(stmt);
-        return success;
     }
+    if (!found) return false;
 
-    return false;
+    std::string line;
+    std::string error;
+    if (!archive_->read(location, line, error)) {
+        std::cerr << "Cannot restore " << session_id << ": " << error << std::endl;
+        return false;
+    }
+    PendingWrite write;
+    if (!parseArchiveLine(line, write.rows) || write.rows.session_id != session_id) {
+        std::cerr << "Cannot restore " << session_id << ": " << location.file << " holds something else at offset "
+                  << location.offset << std::endl;
+        return false;
+    }
+
+    // Written like any other save; the archive file keeps its copy, only the
+    // index entry goes
+    write.has_session = true;
+    submit(std::move(write));
+    flush();
+    if (!sessionExists(session_id)) return false;
+    return runForSession(db_, {"DELETE FROM archived_sessions WHERE session_id = ?1"}, session_id);
+}
+
+void SessionManager::startRetention(const RetentionPolicy& policy) {
+    if (!db_ || retention_thread_.joinable()) return;
+    if (policy.max_age_days <= 0 && policy.max_sessions <= 0 && policy.max_bytes == 0) return;
+
+    // Its own connection, so archiving never shares a transaction with the REPL or the writer
+    if (sqlite3_open(db_path_.c_str(), &archive_db_) != SQLITE_OK) {
+        std::cerr << "Failed to open session database: " << sqlite3_errmsg(archive_db_) << std::endl;
+        sqlite3_close(archive_db_);
+        archive_db_ = nullptr;
+        return;
+    }
+    BlobStore::registerFunctions(archive_db_);
+    sqlite3_busy_timeout(archive_db_, 5000);
+
+    retention_ = policy;
+    retention_thread_ = std::thread(&SessionManager::retentionLoop, this);
+}
+
+void SessionManager::stopRetention() {
+    {
+        std::lock_guard<std::mutex> lock(retention_mutex_);
+        if (!retention_thread_.joinable()) return;
+        stop_retention_ = true;
+    }
+    retention_cv_.notify_one();
+    retention_thread_.join();
+}
+
+void SessionManager::retentionLoop() {
+    std::unique_lock<std::mutex> lock(retention_mutex_);
+    std::chrono::milliseconds pause = RETENTION_START_DELAY;
+    while (!retention_cv_.wait_for(lock, pause, [this]() { return stop_retention_; })) {
+        lock.unlock();
+        bool more = archiveStep(RETENTION_STEP_BYTES) > 0;
+        more = compactStep() || more;
+        lock.lock();
+        pause = more ? RETENTION_STEP_INTERVAL : RETENTION_IDLE_INTERVAL;
+    }
+}
+
+int SessionManager::archiveStep(uint64_t byte_budget) {
+    // Oldest first, every session past a limit: last active before the age
+    // cutoff, or beyond the newest max_sessions, or beyond max_bytes counted
+    // from the newest
+    const char* sql = R"(
+        SELECT session_id, updated_at, size_bytes FROM (
+            SELECT session_id, updated_at, size_bytes,
+                   ROW_NUMBER() OVER newest AS n, SUM(size_bytes) OVER newest AS total
+            FROM sessions WINDOW newest AS (ORDER BY updated_at DESC, session_id DESC))
+        WHERE updated_at < ?1 OR (?2 > 0 AND n > ?2) OR (?3 > 0 AND total > ?3)
+        ORDER BY updated_at, session_id LIMIT 64
+    )";
+
+    struct Candidate {
+        std::string session_id;
+        std::string updated_at;
+        uint64_t size_bytes;
+    };
+    std::vector<Candidate> candidates;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(archive_db_, sql, -1, &stmt, nullptr) != SQLITE_OK) return 0;
+    std::string cutoff = retention_.max_age_days > 0 ? timestampDaysAgo(retention_.max_age_days) : "";
+    sqlite3_bind_text(stmt, 1, cutoff.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, retention_.max_sessions);
+    sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(retention_.max_bytes));
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        candidates.push_back({columnText(stmt, 0), columnText(stmt, 1),
+                              static_cast<uint64_t>(sqlite3_column_int64(stmt, 2))});
+    }
+    sqlite3_finalize(stmt);
+
+    // At least one session per step, however large
+    int archived = 0;
+    uint64_t bytes = 0;
+    for (const auto& candidate : candidates) {
+        if (archived > 0 && bytes + candidate.size_bytes > byte_budget) break;
+        {
+            std::lock_guard<std::mutex> lock(retention_mutex_);
+            if (stop_retention_) break;
+        }
+
+        std::lock_guard<std::recursive_mutex> pin(open_session_mutex_);
+        if (candidate.session_id == open_session_id_) continue;
+        // A session closed just now may still have its last save queued
+        flush();
+        if (!archiveSession(candidate.session_id, candidate.updated_at)) break;
+        archived++;
+        bytes += candidate.size_bytes;
+    }
+    return archived;
+}
+
+bool SessionManager::archiveSession(const std::string& session_id, const std::string& updated_at) {
+    Session session;
+    if (!readSession(archive_db_, session_id, session)) return false;
+
+    // Written out and synced before the rows go, so a crash in between
+    // leaves at worst an unreferenced copy in the archive
+    std::string month = session.updated_at.size() >= 7 ? session.updated_at.substr(0, 7) : "undated";
+    std::string line = archiveLine(session);
+    ArchiveLocation location;
+    std::string error;
+    if (!archive_->append(month, line, location, error)) {
+        std::cerr << "Cannot archive " << session_id << ": " << error << std::endl;
+        return false;
+    }
+
+    const char* delete_sql = "DELETE FROM sessions WHERE session_id = ? AND updated_at = ?";
+    const char* index_sql = R"(
+        INSERT INTO archived_sessions
+        (session_id, created_at, updated_at, model, working_directory, summary, excerpt,
+         message_count, tool_count, size_bytes, file, file_offset, file_length)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+    )";
+
+    if (!execute(archive_db_, "BEGIN")) return false;
+
+    // Saved to since it was read: it is no longer old, or will be archived with the new rows next time
+    sqlite3_stmt* stmt;
+    bool success = sqlite3_prepare_v2(archive_db_, delete_sql, -1, &stmt, nullptr) == SQLITE_OK;
+    if (success) {
+        sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, updated_at.c_str(), -1, SQLITE_TRANSIENT);
+        success = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(archive_db_) == 1;
+        sqlite3_finalize(stmt);
+    }
+
+    success = success && removeSessionRows(archive_db_, session_id) &&
+              runForSession(archive_db_, {"DELETE FROM archived_sessions WHERE session_id = ?1"}, session_id);
+
+    if (success && sqlite3_prepare_v2(archive_db_, index_sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        std::string excerpt = archiveExcerpt(session);
+        sqlite3_bind_text(stmt, 1, session.session_id.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, session.created_at.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, session.updated_at.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 4, session.model.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 5, session.working_directory.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 6, session.summary.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 7, excerpt.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 8, static_cast<sqlite3_int64>(session.messages.size()));
+        sqlite3_bind_int64(stmt, 9, static_cast<sqlite3_int64>(session.tool_executions.size()));
+        sqlite3_bind_int64(stmt, 10, static_cast<sqlite3_int64>(rowBytes(session)));
+        sqlite3_bind_text(stmt, 11, location.file.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 12, static_cast<sqlite3_int64>(location.offset));
+        sqlite3_bind_int64(stmt, 13, static_cast<sqlite3_int64>(location.length));
+        success = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+    } else {
+        success = false;
+    }
+
+    if (!success || !execute(archive_db_, "COMMIT")) {
+        execute(archive_db_, "ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+bool SessionManager::compactStep() {
+    // Only a database created with incremental auto-vacuum can shrink; in
+    // older ones the pages archived sessions free are reused by new ones
+    sqlite3_stmt* stmt;
+    int auto_vacuum = 0;
+    if (sqlite3_prepare_v2(archive_db_, "PRAGMA auto_vacuum", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) auto_vacuum = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    if (auto_vacuum != 2) return false;
+
+    std::string vacuum = "PRAGMA incremental_vacuum(" + std::to_string(COMPACT_STEP_PAGES) + ")";
+    if (!execute(archive_db_, vacuum.c_str())) return false;
+
+    int free_pages = 0;
+    if (sqlite3_prepare_v2(archive_db_, "PRAGMA freelist_count", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) free_pages = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return free_pages > 0;
+}
+
+bool SessionManager::readSession(sqlite3* db, const std::string& session_id, Session& session) const {
+    const char* session_sql = "SELECT created_at, updated_at, model, working_directory, summary, is_active FROM sessions WHERE session_id = ?";
+    const char* messages_sql = "SELECT role, content, timestamp FROM messages_text WHERE session_id = ? ORDER BY id";
+    const char* tools_sql = "SELECT tool_name, parameters, output, exit_code, timestamp FROM tool_outputs_text WHERE session_id = ? ORDER BY id";
+    const char* files_sql = "SELECT file_path, operation, timestamp FROM file_modifications WHERE session_id = ? ORDER BY id";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, session_sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        session.session_id = session_id;
+        session.created_at = columnText(stmt, 0);
+        session.updated_at = columnText(stmt, 1);
+        session.model = columnText(stmt, 2);
+        session.working_directory = columnText(stmt, 3);
+        session.summary = columnText(stmt, 4);
+        session.is_active = sqlite3_column_int(stmt, 5) == 1;
+    }
+    sqlite3_finalize(stmt);
+    if (!found) return false;
+
+    if (sqlite3_prepare_v2(db, messages_sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        Message msg;
+        msg.role = columnText(stmt, 0);
+        msg.content = columnText(stmt, 1);
+        msg.timestamp = columnText(stmt, 2);
+        session.messages.push_back(msg);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return false;
+
+    if (sqlite3_prepare_v2(db, tools_sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ToolExecution te;
+        te.tool_name = columnText(stmt, 0);
+        te.parameters = json::parse(columnText(stmt, 1), nullptr, false);
+        if (te.parameters.is_discarded()) te.parameters = json::object();
+        te.output = columnText(stmt, 2);
+        te.exit_code = sqlite3_column_int(stmt, 3);
+        te.timestamp = columnText(stmt, 4);
+        session.tool_executions.push_back(te);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return false;
+
+    if (sqlite3_prepare_v2(db, files_sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        FileModification fm;
+        fm.file_path = columnText(stmt, 0);
+        fm.operation = columnText(stmt, 1);
+        fm.timestamp = columnText(stmt, 2);
+        session.file_modifications.push_back(fm);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+void SessionManager::createBlobStorage() {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, "SELECT content_hash FROM messages LIMIT 0", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_finalize(stmt);
+    } else {
+        // Databases from before the blob store keep their rows inline
+        execute(db_, R"(
+            ALTER TABLE messages ADD COLUMN content_hash TEXT;
+            ALTER TABLE tool_executions ADD COLUMN output_hash TEXT;
+        )");
+    }
+
+    // Rows with their text wherever it is stored. The blob is only read and
+    // inflated when the content or output column is asked for.
+    execute(db_, R"(
+        CREATE INDEX IF NOT EXISTS idx_messages_blob ON messages(content_hash) WHERE content_hash IS NOT NULL;
+        CREATE INDEX IF NOT EXISTS idx_tools_blob ON tool_executions(output_hash) WHERE output_hash IS NOT NULL;
+        CREATE VIEW IF NOT EXISTS messages_text AS
+            SELECT id, session_id, role,
+                   CASE WHEN content_hash IS NULL THEN content
+                        ELSE (SELECT inflate_blob(codec, size, data) FROM blobs WHERE hash = content_hash)
+                   END AS content,
+                   timestamp
+            FROM messages;
+        CREATE VIEW IF NOT EXISTS tool_outputs_text AS
+            SELECT id, session_id, tool_name, parameters,
+                   CASE WHEN output_hash IS NULL THEN output
+                        ELSE (SELECT inflate_blob(codec, size, data) FROM blobs WHERE hash = output_hash)
+                   END AS output,
+                   exit_code, timestamp
+            FROM tool_executions;
+    )");
+}
+
+void SessionManager::createSearchIndex() {
+    sqlite3_stmt* stmt;
+    bool rows_indexed = false;
+    bool blobs_indexed = false;
+    bool archive_indexed = false;
+    const char* tables_sql = "SELECT name FROM sqlite_master WHERE name IN ('messages_fts', 'blobs_fts', 'archive_fts')";
+    if (sqlite3_prepare_v2(db_, tables_sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::string name = columnText(stmt, 0);
+            if (name == "messages_fts") rows_indexed = true;
+            else if (name == "blobs_fts") blobs_indexed = true;
+            else archive_indexed = true;
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (rows_indexed && blobs_indexed && archive_indexed) {
+        search_index_ = true;
+        return;
+    }
+
+    // External-content tables: the index refers to rows instead of holding a
+    // second copy of them, and the triggers keep it up to date as rows are
+    // appended or deleted. Rows whose text is in a blob hold "" and are found
+    // through blobs_fts, which indexes each distinct payload once however
+    // many rows share it.
+    const char* index_rows = R"(
+        CREATE VIRTUAL TABLE messages_fts USING fts5(
+            content, content='messages', content_rowid='id', tokenize='porter unicode61');
+        CREATE VIRTUAL TABLE tool_outputs_fts USING fts5(
+            parameters, output, content='tool_executions', content_rowid='id', tokenize='porter unicode61');
+        CREATE TRIGGER messages_fts_insert AFTER INSERT ON messages BEGIN
+            INSERT INTO messages_fts(rowid, content) VALUES (new.id, new.content);
+        END;
+        CREATE TRIGGER messages_fts_delete AFTER DELETE ON messages BEGIN
+            INSERT INTO messages_fts(messages_fts, rowid, content) VALUES ('delete', old.id, old.content);
+        END;
+        CREATE TRIGGER tool_outputs_fts_insert AFTER INSERT ON tool_executions BEGIN
+            INSERT INTO tool_outputs_fts(rowid, parameters, output) VALUES (new.id, new.parameters, new.output);
+        END;
+        CREATE TRIGGER tool_outputs_fts_delete AFTER DELETE ON tool_executions BEGIN
+            INSERT INTO tool_outputs_fts(tool_outputs_fts, rowid, parameters, output)
+            VALUES ('delete', old.id, old.parameters, old.output);
+        END;
+        INSERT INTO messages_fts(messages_fts) VALUES ('rebuild');
+        INSERT INTO tool_outputs_fts(tool_outputs_fts) VALUES ('rebuild');
+    )";
+    const char* index_blobs = R"(
+        CREATE VIEW IF NOT EXISTS blobs_text AS
+            SELECT id, inflate_blob(codec, size, data) AS content FROM blobs;
+        CREATE VIRTUAL TABLE blobs_fts USING fts5(
+            content, content='blobs_text', content_rowid='id', tokenize='porter unicode61');
+        CREATE TRIGGER blobs_fts_insert AFTER INSERT ON blobs BEGIN
+            INSERT INTO blobs_fts(rowid, content) VALUES (new.id, inflate_blob(new.codec, new.size, new.data));
+        END;
+        CREATE TRIGGER blobs_fts_delete AFTER DELETE ON blobs BEGIN
+            INSERT INTO blobs_fts(blobs_fts, rowid, content)
+            VALUES ('delete', old.id, inflate_blob(old.codec, old.size, old.data));
+        END;
+        INSERT INTO blobs_fts(blobs_fts) VALUES ('rebuild');
+    )";
+    const char* index_archive = R"(
+        CREATE VIRTUAL TABLE archive_fts USING fts5(
+            summary, excerpt, content='archived_sessions', content_rowid='id', tokenize='porter unicode61');
+        CREATE TRIGGER archive_fts_insert AFTER INSERT ON archived_sessions BEGIN
+            INSERT INTO archive_fts(rowid, summary, excerpt) VALUES (new.id, new.summary, new.excerpt);
+        END;
+        CREATE TRIGGER archive_fts_delete AFTER DELETE ON archived_sessions BEGIN
+            INSERT INTO archive_fts(archive_fts, rowid, summary, excerpt)
+            VALUES ('delete', old.id, old.summary, old.excerpt);
+        END;
+        INSERT INTO archive_fts(archive_fts) VALUES ('rebuild');
+    )";
+
+    if (!rows_indexed &&
+        sqlite3_prepare_v2(db_, "SELECT 1 FROM messages LIMIT 1", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::cerr << "Indexing past sessions for search (once)..." << std::endl;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    // SQLite built without FTS5 fails here; search then scans with LIKE
+    search_index_ = sqlite3_exec(db_, "BEGIN", nullptr, nullptr, nullptr) == SQLITE_OK &&
+                    (rows_indexed || sqlite3_exec(db_, index_rows, nullptr, nullptr, nullptr) == SQLITE_OK) &&
+                    (blobs_indexed || sqlite3_exec(db_, index_blobs, nullptr, nullptr, nullptr) == SQLITE_OK) &&
+                    (archive_indexed || sqlite3_exec(db_, index_archive, nullptr, nullptr, nullptr) == SQLITE_OK) &&
+                    sqlite3_exec(db_, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!search_index_) {
+        sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+}
+
+std::vector<SearchHit> SessionManager::searchSessions(const std::string& query, int limit,
+                                                      const std::string& open_mark,
+                                                      const std::string& close_mark) {
+    std::vector<SearchHit> hits;
+    if (!db_ || utils::trim(query).empty()) return hits;
+    flush();
+
+    if (!search_index_) return searchWithLike(query, limit, open_mark, close_mark);
+
+    // The best matches of each table, ranked inside FTS5 so snippets are only
+    // built for rows that are returned; the lists are merged by score. A
+    // matching blob is reported once for each session that refers to it.
+    const char* sqls[] = {
+        R"(
+            SELECT m.session_id, s.updated_at, m.role, hit.snip, m.timestamp, hit.score
+            FROM (SELECT rowid, snippet(messages_fts, 0, ?2, ?3, '...', 16) AS snip, rank AS score
+                  FROM messages_fts WHERE messages_fts MATCH ?1 ORDER BY rank LIMIT ?4) hit
+            JOIN messages m ON m.id = hit.rowid
+            JOIN sessions s ON s.session_id = m.session_id
+        )",
+        R"(
+            SELECT t.session_id, s.updated_at, t.tool_name, hit.snip, t.timestamp, hit.score
+            FROM (SELECT rowid, snippet(tool_outputs_fts, -1, ?2, ?3, '...', 16) AS snip, rank AS score
+                  FROM tool_outputs_fts WHERE tool_outputs_fts MATCH ?1 ORDER BY rank LIMIT ?4) hit
+            JOIN tool_executions t ON t.id = hit.rowid
+            JOIN sessions s ON s.session_id = t.session_id
+        )",
+        R"(
+            SELECT m.session_id, s.updated_at, m.role, hit.snip, MAX(m.timestamp), hit.score
+            FROM (SELECT rowid, snippet(blobs_fts, 0, ?2, ?3, '...', 16) AS snip, rank AS score
+                  FROM blobs_fts WHERE blobs_fts MATCH ?1 ORDER BY rank LIMIT ?4) hit
+            JOIN blobs b ON b.id = hit.rowid
+            JOIN messages m ON m.content_hash = b.hash
+            JOIN sessions s ON s.session_id = m.session_id
+            GROUP BY hit.rowid, m.session_id
+        )",
+        R"(
+            SELECT t.session_id, s.updated_at, t.tool_name, hit.snip, MAX(t.timestamp), hit.score
+            FROM (SELECT rowid, snippet(blobs_fts, 0, ?2, ?3, '...', 16) AS snip, rank AS score
+                  FROM blobs_fts WHERE blobs_fts MATCH ?1 ORDER BY rank LIMIT ?4) hit
+            JOIN blobs b ON b.id = hit.rowid
+            JOIN tool_executions t ON t.output_hash = b.hash
+            JOIN sessions s ON s.session_id = t.session_id
+            GROUP BY hit.rowid, t.session_id
+        )",
+        R"(
+            SELECT a.session_id, a.updated_at, 'archived', hit.snip, a.updated_at, hit.score
+            FROM (SELECT rowid, snippet(archive_fts, -1, ?2, ?3, '...', 16) AS snip, rank AS score
+                  FROM archive_fts WHERE archive_fts MATCH ?1 ORDER BY rank LIMIT ?4) hit
+            JOIN archived_sessions a ON a.id = hit.rowid
+        )",
+    };
+
+    std::string fts = ftsQuery(query);
+    for (const char* sql : sqls) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) continue;
+        sqlite3_bind_text(stmt, 1, fts.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, open_mark.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, close_mark.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 4, limit);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            SearchHit hit;
+            hit.session_id = columnText(stmt, 0);
+            hit.updated_at = columnText(stmt, 1);
+            hit.source = columnText(stmt, 2);
+            hit.snippet = columnText(stmt, 3);
+            hit.timestamp = columnText(stmt, 4);
+            hit.score = sqlite3_column_double(stmt, 5);
+            hits.push_back(hit);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    std::stable_sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) {
+        return a.score < b.score;
+    });
+    if (hits.size() > static_cast<size_t>(limit)) hits.resize(limit);
+    return hits;
+}
+
+std::vector<SearchHit> SessionManager::searchWithLike(const std::string& query, int limit,
+                                                      const std::string& open_mark,
+                                                      const std::string& close_mark) {
+    std::vector<SearchHit> hits;
+    std::string needle = utils::trim(query);
+
+    std::string pattern = "%";
+    for (char c : needle) {
+        if (c == '%' || c == '_' || c == '\\') pattern += '\\';
+        pattern += c;
+    }
+    pattern += "%";
+
+    // Newest first, as there is no ranking
+    const char* sqls[] = {
+        R"(
+            SELECT m.session_id, s.updated_at, m.role, m.content, m.timestamp
+            FROM messages_text m JOIN sessions s ON s.session_id = m.session_id
+            WHERE m.content LIKE ?1 ESCAPE '\' ORDER BY m.id DESC LIMIT ?2
+        )",
+        R"(
+            SELECT t.session_id, s.updated_at, t.tool_name, t.output, t.timestamp
+            FROM tool_outputs_text t JOIN sessions s ON s.session_id = t.session_id
+            WHERE t.output LIKE ?1 ESCAPE '\' OR t.parameters LIKE ?1 ESCAPE '\' ORDER BY t.id DESC LIMIT ?2
+        )",
+        R"(
+            SELECT session_id, updated_at, 'archived', IFNULL(summary, '') || ' ' || IFNULL(excerpt, ''), updated_at
+            FROM archived_sessions
+            WHERE summary LIKE ?1 ESCAPE '\' OR excerpt LIKE ?1 ESCAPE '\' ORDER BY updated_at DESC LIMIT ?2
+        )",
+    };
+
+    std::string lower_needle = utils::toLower(needle);
+    for (const char* sql : sqls) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) continue;
+        sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, limit);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            SearchHit hit;
+            hit.session_id = columnText(stmt, 0);
+            hit.updated_at = columnText(stmt, 1);
+            hit.source = columnText(stmt, 2);
+            hit.timestamp = columnText(stmt, 4);
+
+            // Some context around the first match, like snippet() would give
+            std::string text = columnText(stmt, 3);
+            size_t at = utils::toLower(text).find(lower_needle);
+            if (at == std::string::npos) at = 0;
+            size_t begin = at > 60 ? at - 60 : 0;
+            size_t match_end = std::min(text.size(), at + needle.size());
+            size_t end = std::min(text.size(), match_end + 60);
+            hit.snippet = (begin > 0 ? "..." : "") + text.substr(begin, at - begin) +
+                          open_mark + text.substr(at, match_end - at) + close_mark +
+                          text.substr(match_end, end - match_end) + (end < text.size() ? "..." : "");
+            hits.push_back(hit);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    std::stable_sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) {
+        return a.timestamp > b.timestamp;
+    });
+    if (hits.size() > static_cast<size_t>(limit)) hits.resize(limit);
+    return hits;
 }
 
 void SessionManager::generateSessionSummary(const std::string& summary) {
@@ -729,7 +2151,7 @@ std::string SessionManager::getSessionSummary() const {
 
 int SessionManager::getMessageCount() const {
     if (!current_session_) return 0;
-    return static_cast<int>(current_session_->messages.size());
+    return static_cast<int>(current_session_->messages.size() + older_messages_);
 }
 
 int SessionManager::getToolExecutionCount() const {
@@ -766,11 +2188,42 @@ std::vector<std::string> SessionManager::getExecutedTools() const {
     return tools;
 }
 
+Session SessionManager::fullSession(bool with_outputs) const {
+    Session session = *current_session_;
+
+    if (older_messages_ > 0 && db_) {
+        const char* sql = "SELECT role, content, timestamp FROM messages_text WHERE session_id = ? AND id < ? ORDER BY id";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, session.session_id.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 2, oldest_message_id_);
+            std::vector<Message> older;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                Message msg;
+                msg.role = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+                msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                msg.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+                older.push_back(msg);
+            }
+            sqlite3_finalize(stmt);
+            session.messages.insert(session.messages.begin(), older.begin(), older.end());
+        }
+    }
+
+    if (with_outputs) {
+        for (auto& te : session.tool_executions) {
+            te.output = getToolOutput(te);
+            te.output_loaded = true;
+        }
+    }
+    return session;
+}
+
 bool SessionManager::exportSessionToJson(const std::string& file_path) const {
     if (!current_session_) return false;
 
     try {
-        json session_json = current_session_->toJson();
+        json session_json = fullSession().toJson();
         std::ofstream out(file_path);
         out << session_json.dump(2);
         out.close();
@@ -785,34 +2238,35 @@ bool SessionManager::exportSessionToMarkdown(const std::string& file_path) const
     if (!current_session_) return false;
 
     try {
+        const Session session = fullSession();
         std::ofstream out(file_path);
 
-        out << "# Session: " << current_session_->session_id << "\n\n";
-        out << "**Created:** " << current_session_->created_at << "\n";
-        out << "**Updated:** " << current_session_->updated_at << "\n";
-        out << "**Model:** " << current_session_->model << "\n";
-        out << "**Working Directory:** " << current_session_->working_directory << "\n\n";
+        out << "# Session: " << session.session_id << "\n\n";
+        out << "**Created:** " << session.created_at << "\n";
+        out << "**Updated:** " << session.updated_at << "\n";
+        out << "**Model:** " << session.model << "\n";
+        out << "**Working Directory:** " << session.working_directory << "\n\n";
 
-        if (!current_session_->summary.empty()) {
-            out << "## Summary\n\n" << current_session_->summary << "\n\n";
+        if (!session.summary.empty()) {
+            out << "## Summary\n\n" << session.summary << "\n\n";
         }
 
         out << "## Statistics\n\n";
-        out << "- Messages: " << current_session_->messages.size() << "\n";
-        out << "- Tool Executions: " << current_session_->tool_executions.size() << "\n";
-        out << "- File Modifications: " << current_session_->file_modifications.size() << "\n\n";
+        out << "- Messages: " << session.messages.size() << "\n";
+        out << "- Tool Executions: " << session.tool_executions.size() << "\n";
+        out << "- File Modifications: " << session.file_modifications.size() << "\n\n";
 
-        if (!current_session_->messages.empty()) {
+        if (!session.messages.empty()) {
             out << "## Conversation\n\n";
-            for (const auto& msg : current_session_->messages) {
+            for (const auto& msg : session.messages) {
                 out << "### " << msg.role << " (" << msg.timestamp << ")\n\n";
                 out << msg.content << "\n\n";
             }
         }
 
-        if (!current_session_->tool_executions.empty()) {
+        if (!session.tool_executions.empty()) {
             out << "## Tool Executions\n\n";
-            for (const auto& te : current_session_->tool_executions) {
+            for (const auto& te : session.tool_executions) {
                 out << "### " << te.tool_name << " (" << te.timestamp << ")\n\n";
                 out << "**Parameters:**\n```json\n" << te.parameters.dump(2) << "\n```\n\n";
                 out << "**Output:**\n```\n" << te.output << "\n```\n\n";
@@ -820,9 +2274,9 @@ bool SessionManager::exportSessionToMarkdown(const std::string& file_path) const
             }
         }
 
-        if (!current_session_->file_modifications.empty()) {
+        if (!session.file_modifications.empty()) {
             out << "## File Modifications\n\n";
-            for (const auto& fm : current_session_->file_modifications) {
+            for (const auto& fm : session.file_modifications) {
                 out << "- `" << fm.file_path << "` - " << fm.operation << " (" << fm.timestamp << ")\n";
             }
             out << "\n";
@@ -853,7 +2307,7 @@ bool SessionManager::generateTodoMd(const std::string& output_path) const {
         out << "## Tasks\n\n";
 
         // Extract potential TODOs from conversation
-        for (const auto& msg : current_session_->messages) {
+        for (const auto& msg : fullSession(false).messages) {
             if (msg.role == "assistant" &&
                 (msg.content.find("TODO") != std::string::npos ||
                  msg.content.find("task") != std::string::npos ||
@@ -0,0 +1,215 @@
+#include "ssh_multiplexer.h"
+#include "process_runner.h"
+#include "utils.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace casper {
+
+namespace {
+
+// A failed master is not retried for this long; calls connect directly meanwhile
+const std::time_t RETRY_AFTER_SECONDS = 300;
+
+// ssh binds "<ControlPath>.<16 random chars>" before renaming it into place
+const size_t SSH_TEMP_SUFFIX = 17;
+
+std::string shellQuote(const std::string& value) {
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
+}
+
+bool socketAlive(const std::string& path) {
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    bool alive = connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0;
+    close(fd);
+    return alive;
+}
+
+std::string targetKey(const std::string& user, const std::string& host, int port) {
+    return (user.empty() ? "" : user + "@") + host + ":" + (port > 0 ? std::to_string(port) : "default");
+}
+
+// Sockets in a directory someone else can write to, or that a symlink
+// points elsewhere, could be swapped for theirs
+bool privateDir(const std::string& path) {
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode) &&
+           st.st_uid == getuid() && (st.st_mode & 0777) == 0700;
+}
+
+} // anonymous namespace
+
+SshMultiplexer::SshMultiplexer(const std::string& socket_dir)
+    : socket_dir_(socket_dir)
+{
+    // Unix socket paths are short; a deep home directory does not leave room
+    struct sockaddr_un addr;
+    if (socket_dir_.size() + 1 + 16 + SSH_TEMP_SUFFIX >= sizeof(addr.sun_path)) {
+        socket_dir_ = "/tmp/casper-ssh-" + std::to_string(getuid());
+    }
+}
+
+std::string SshMultiplexer::socketPath(const std::string& target) const {
+    // FNV-1a keeps the name short and stable across runs
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : target) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return socket_dir_ + "/" + name;
+}
+
+std::string SshMultiplexer::options(const std::string& user, const std::string& host, int port, int idle_seconds) {
+    // A leading '-' would be read as an ssh option
+    if (idle_seconds <= 0 || host.empty() || host[0] == '-' || (!user.empty() && user[0] == '-')) return "";
+
+    std::string target = targetKey(user, host, port);
+    std::string socket = socketPath(target);
+
+    std::shared_ptr<std::mutex> target_mutex;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto failed = failed_.find(target);
+        if (failed != failed_.end()) {
+            if (std::time(nullptr) - failed->second < RETRY_AFTER_SECONDS) return "";
+            failed_.erase(failed);
+        }
+        auto& entry = starting_[target];
+        if (!entry) entry = std::make_shared<std::mutex>();
+        target_mutex = entry;
+    }
+
+    std::lock_guard<std::mutex> lock(*target_mutex);
+    if (!socketAlive(socket)) {
+        unlink(socket.c_str());
+        if (!start(user, host, port, socket, idle_seconds)) {
+            std::lock_guard<std::mutex> failed_lock(mutex_);
+            failed_[target] = std::time(nullptr);
+            return "";
+        }
+        utils::writeFile(socket + ".target", target + "\n");
+    }
+    return "-o ControlPath=" + shellQuote(socket);
+}
+
+bool SshMultiplexer::start(const std::string& user, const std::string& host, int port,
+                           const std::string& socket, int idle_seconds) {
+    mkdir(socket_dir_.c_str(), 0700);
+    if (!privateDir(socket_dir_)) return false;
+
+    // -f backgrounds the master once it is authenticated. It must not hold
+    // on to our pipes, so its streams go to /dev/null. Why it failed does not
+    // matter: the direct connection that follows reports the same error.
+    std::string destination = (user.empty() ? "" : user + "@") + host;
+    ProcessOptions options;
+    options.command = "exec ssh -o BatchMode=yes -o ConnectTimeout=10 -o ControlMaster=yes"
+                      " -o ControlPath=" + shellQuote(socket) +
+                      " -o ControlPersist=" + std::to_string(idle_seconds) + "s" +
+                      (port > 0 ? " -p " + std::to_string(port) : "") +
+                      " -N -f " + shellQuote(destination) +
+                      " </dev/null >/dev/null 2>&1";
+    options.timeout_ms = 30000;
+
+    ProcessResult process = ProcessRunner::run(options);
+    return process.started && process.exit_code == 0 && socketAlive(socket);
+}
+
+bool SshMultiplexer::parseRemote(const std::string& operand, std::string& user, std::string& host) {
+    if (operand.empty() || operand[0] == '/' || operand.find("://") != std::string::npos) return false;
+
+    std::string left;
+    size_t bracket = operand.find('[');
+    if (bracket != std::string::npos) {
+        // [v6::addr]:path
+        size_t close = operand.find("]:", bracket);
+        if (close == std::string::npos) return false;
+        left = operand.substr(0, close + 1);
+    } else {
+        size_t colon = operand.find(':');
+        if (colon == std::string::npos || colon == 0) return false;
+        // host::module is the rsync daemon protocol, not ssh
+        if (operand.compare(colon, 2, "::") == 0) return false;
+        left = operand.substr(0, colon);
+    }
+    if (left.find('/') != std::string::npos) return false;
+
+    size_t at = left.rfind('@');
+    user = at == std::string::npos ? "" : left.substr(0, at);
+    host = at == std::string::npos ? left : left.substr(at + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    return !host.empty();
+}
+
+std::vector<SshMaster> SshMultiplexer::list() {
+    std::vector<SshMaster> masters;
+    if (!privateDir(socket_dir_)) return masters;
+    DIR* dir = opendir(socket_dir_.c_str());
+    if (!dir) return masters;
+
+    std::vector<std::string> records;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (utils::endsWith(name, ".target")) records.push_back(name);
+    }
+    closedir(dir);
+
+    for (const auto& name : records) {
+        std::string record = socket_dir_ + "/" + name;
+        SshMaster master;
+        master.socket = record.substr(0, record.size() - 7);
+        if (!socketAlive(master.socket)) {
+            // The master exited after its idle time
+            unlink(master.socket.c_str());
+            unlink(record.c_str());
+            continue;
+        }
+        master.target = utils::trim(utils::readFile(record));
+        masters.push_back(master);
+    }
+    return masters;
+}
+
+int SshMultiplexer::close(const std::string& target) {
+    int closed = 0;
+    for (const auto& master : list()) {
+        // user@host:port, also matched by user@host and host
+        std::string user_host = master.target.substr(0, master.target.rfind(':'));
+        size_t at = user_host.rfind('@');
+        std::string host = at == std::string::npos ? user_host : user_host.substr(at + 1);
+        if (!target.empty() && target != master.target && target != user_host && target != host) continue;
+
+        ProcessOptions options;
+        options.argv = {"ssh", "-o", "ControlPath=" + master.socket, "-O", "exit", user_host};
+        options.timeout_ms = 10000;
+        ProcessResult process = ProcessRunner::run(options);
+        if (process.started && process.exit_code == 0) {
+            closed++;
+            unlink((master.socket + ".target").c_str());
+        }
+    }
+    return closed;
+}
+
+} // namespace casper
@@ -0,0 +1,593 @@
+#include "system_info.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <dirent.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/statvfs.h>
+#ifdef __linux__
+#include <netpacket/packet.h>
+#endif
+#ifdef __APPLE__
+#include <net/if_dl.h>
+#include <sys/mount.h>
+#endif
+
+namespace casper {
+
+// Index is the state number in /proc/net/tcp
+static const char* kTcpStates[] = {
+    "UNKNOWN", "ESTABLISHED", "SYN_SENT", "SYN_RECV", "FIN_WAIT1", "FIN_WAIT2", "TIME_WAIT",
+    "CLOSE", "CLOSE_WAIT", "LAST_ACK", "LISTEN", "CLOSING", "NEW_SYN_RECV",
+};
+
+namespace {
+
+std::vector<std::string> fields(const std::string& line) {
+    std::vector<std::string> out;
+    std::istringstream in(line);
+    std::string field;
+    while (in >> field) out.push_back(field);
+    return out;
+}
+
+unsigned long hexValue(const std::string& text) {
+    return std::strtoul(text.c_str(), nullptr, 16);
+}
+
+// "0100007F:1F90" from /proc/net/tcp; IPv6 is four host-order words
+std::string procAddress(const std::string& text, bool v6) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) return text;
+    std::string hex = text.substr(0, colon);
+    unsigned long port = hexValue(text.substr(colon + 1));
+    char address[INET6_ADDRSTRLEN] = "?";
+
+    if (v6 && hex.size() == 32) {
+        in6_addr addr;
+        for (int i = 0; i < 4; i++) {
+            uint32_t word = static_cast<uint32_t>(hexValue(hex.substr(i * 8, 8)));
+            memcpy(addr.s6_addr + i * 4, &word, 4);
+        }
+        inet_ntop(AF_INET6, &addr, address, sizeof(address));
+        return std::string("[") + address + "]:" + (port ? std::to_string(port) : "*");
+    }
+    in_addr addr;
+    addr.s_addr = static_cast<uint32_t>(hexValue(hex));
+    inet_ntop(AF_INET, &addr, address, sizeof(address));
+    return std::string(address) + ":" + (port ? std::to_string(port) : "*");
+}
+
+int prefixLength(const sockaddr* mask) {
+    if (!mask) return -1;
+    const unsigned char* bytes;
+    size_t size;
+    if (mask->sa_family == AF_INET) {
+        bytes = reinterpret_cast<const unsigned char*>(&reinterpret_cast<const sockaddr_in*>(mask)->sin_addr);
+        size = 4;
+    } else if (mask->sa_family == AF_INET6) {
+        bytes = reinterpret_cast<const sockaddr_in6*>(mask)->sin6_addr.s6_addr;
+        size = 16;
+    } else {
+        return -1;
+    }
+    int bits = 0;
+    for (size_t i = 0; i < size; i++) {
+        for (unsigned char b = bytes[i]; b; b <<= 1) bits += (b & 0x80) ? 1 : 0;
+    }
+    return bits;
+}
+
+std::string macAddress(const unsigned char* bytes, size_t len) {
+    bool zero = true;
+    std::string mac;
+    char part[4];
+    for (size_t i = 0; i < len; i++) {
+        if (bytes[i]) zero = false;
+        snprintf(part, sizeof(part), i ? ":%02x" : "%02x", bytes[i]);
+        mac += part;
+    }
+    return zero ? "" : mac;
+}
+
+// Mount points in /proc/mounts escape spaces and friends as \040
+std::string unescapeMount(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\\' && i + 3 < text.size() && isdigit(static_cast<unsigned char>(text[i + 1]))) {
+            out += static_cast<char>(std::strtol(text.substr(i + 1, 3).c_str(), nullptr, 8));
+            i += 3;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+struct Mount {
+    std::string device;
+    std::string point;
+    std::string type;
+};
+
+std::vector<Mount> mounts() {
+    std::vector<Mount> list;
+#ifdef __APPLE__
+    struct statfs* table = nullptr;
+    int count = getmntinfo(&table, MNT_NOWAIT);
+    for (int i = 0; i < count; i++) {
+        list.push_back({table[i].f_mntfromname, table[i].f_mntonname, table[i].f_fstypename});
+    }
+#else
+    std::ifstream in("/proc/self/mounts");
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> parts = fields(line);
+        if (parts.size() < 3) continue;
+        list.push_back({unescapeMount(parts[0]), unescapeMount(parts[1]), parts[2]});
+    }
+#endif
+    return list;
+}
+
+bool fillUsage(DiskUsage& usage, const std::string& path) {
+    struct statvfs vfs;
+    if (statvfs(path.c_str(), &vfs) != 0) return false;
+    uint64_t unit = vfs.f_frsize ? vfs.f_frsize : vfs.f_bsize;
+    usage.total = static_cast<uint64_t>(vfs.f_blocks) * unit;
+    usage.used = static_cast<uint64_t>(vfs.f_blocks - vfs.f_bfree) * unit;
+    usage.available = static_cast<uint64_t>(vfs.f_bavail) * unit;
+    usage.inodes = vfs.f_files;
+    usage.inodes_used = vfs.f_files >= vfs.f_ffree ? vfs.f_files - vfs.f_ffree : 0;
+    return true;
+}
+
+std::string percent(uint64_t part, uint64_t whole) {
+    if (whole == 0) return "-";
+    // Rounded up, as df does
+    return std::to_string((part * 100 + whole - 1) / whole) + "%";
+}
+
+std::string pad(const std::string& text, size_t width) {
+    return text.size() >= width ? text + " " : text + std::string(width - text.size() + 1, ' ');
+}
+
+} // namespace
+
+bool SystemInfo::sockets(bool tcp, bool udp, bool listening_only, bool pids,
+                         std::vector<SocketEntry>& entries, std::string& error) {
+    std::vector<std::string> files;
+    if (tcp) { files.push_back("tcp"); files.push_back("tcp6"); }
+    if (udp) { files.push_back("udp"); files.push_back("udp6"); }
+
+    bool any = false;
+    for (const auto& file : files) {
+        std::ifstream in("/proc/net/" + file);
+        if (!in) continue;
+        any = true;
+        bool is_tcp = file[0] == 't';
+        bool v6 = file.back() == '6';
+
+        std::string line;
+        std::getline(in, line);     // Header
+        while (std::getline(in, line)) {
+            std::vector<std::string> parts = fields(line);
+            if (parts.size() < 10) continue;
+
+            SocketEntry entry;
+            entry.proto = file;
+            entry.local = procAddress(parts[1], v6);
+            entry.remote = procAddress(parts[2], v6);
+            unsigned long state = hexValue(parts[3]);
+            if (is_tcp) {
+                entry.state = state < sizeof(kTcpStates) / sizeof(kTcpStates[0]) ? kTcpStates[state] : "UNKNOWN";
+            } else {
+                entry.state = state == 1 ? "ESTABLISHED" : "UNCONN";
+            }
+            size_t colon = parts[4].find(':');
+            entry.send_queue = static_cast<uint32_t>(hexValue(parts[4].substr(0, colon)));
+            if (colon != std::string::npos) entry.recv_queue = static_cast<uint32_t>(hexValue(parts[4].substr(colon + 1)));
+            entry.inode = std::strtoul(parts[9].c_str(), nullptr, 10);
+
+            if (listening_only && entry.state != "LISTEN" && entry.state != "UNCONN") continue;
+            entries.push_back(entry);
+        }
+    }
+    if (!any) {
+        error = "/proc/net is not available";
+        return false;
+    }
+
+    if (pids) {
+        // socket:[inode] links under /proc/<pid>/fd; other users' are unreadable without root
+        std::map<unsigned long, SocketEntry*> by_inode;
+        for (auto& entry : entries) {
+            if (entry.inode) by_inode[entry.inode] = &entry;
+        }
+        DIR* proc = opendir("/proc");
+        struct dirent* process;
+        while (proc && !by_inode.empty() && (process = readdir(proc)) != nullptr) {
+            if (!isdigit(static_cast<unsigned char>(process->d_name[0]))) continue;
+            std::string base = std::string("/proc/") + process->d_name;
+            DIR* fds = opendir((base + "/fd").c_str());
+            if (!fds) continue;
+
+            std::string program;
+            struct dirent* fd;
+            char target[64];
+            while ((fd = readdir(fds)) != nullptr) {
+                std::string link = base + "/fd/" + fd->d_name;
+                ssize_t n = readlink(link.c_str(), target, sizeof(target) - 1);
+                if (n <= 8 || strncmp(target, "socket:[", 8) != 0) continue;
+                target[n] = '\0';
+                auto it = by_inode.find(std::strtoul(target + 8, nullptr, 10));
+                if (it == by_inode.end()) continue;
+                if (program.empty()) {
+                    std::ifstream comm(base + "/comm");
+                    std::getline(comm, program);
+                }
+                it->second->pid = std::atoi(process->d_name);
+                it->second->program = program;
+                by_inode.erase(it);
+            }
+            closedir(fds);
+        }
+        if (proc) closedir(proc);
+    }
+    return true;
+}
+
+bool SystemInfo::routes(std::vector<RouteEntry>& entries, std::string& error) {
+    std::ifstream in("/proc/net/route");
+    if (!in) {
+        error = "/proc/net/route is not available";
+        return false;
+    }
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        // Iface Destination Gateway Flags RefCnt Use Metric Mask ...
+        std::vector<std::string> parts = fields(line);
+        if (parts.size() < 8) continue;
+        unsigned long flags = hexValue(parts[3]);
+        if (!(flags & 0x1)) continue;                   // RTF_UP
+
+        in_addr dest, gateway, mask;
+        dest.s_addr = static_cast<uint32_t>(hexValue(parts[1]));
+        gateway.s_addr = static_cast<uint32_t>(hexValue(parts[2]));
+        mask.s_addr = static_cast<uint32_t>(hexValue(parts[7]));
+        char text[INET_ADDRSTRLEN];
+
+        RouteEntry entry;
+        entry.iface = parts[0];
+        entry.metric = std::atoi(parts[6].c_str());
+        sockaddr_in mask_addr = {};
+        mask_addr.sin_family = AF_INET;
+        mask_addr.sin_addr = mask;
+        if (dest.s_addr == 0 && mask.s_addr == 0) {
+            entry.destination = "default";
+        } else {
+            inet_ntop(AF_INET, &dest, text, sizeof(text));
+            entry.destination = std::string(text) + "/" +
+                                std::to_string(prefixLength(reinterpret_cast<const sockaddr*>(&mask_addr)));
+        }
+        if (flags & 0x2) {                              // RTF_GATEWAY
+            inet_ntop(AF_INET, &gateway, text, sizeof(text));
+            entry.gateway = text;
+        }
+        entries.push_back(entry);
+    }
+
+    std::ifstream in6("/proc/net/ipv6_route");
+    while (std::getline(in6, line)) {
+        // dest prefix src src_prefix next_hop metric refcnt use flags iface, addresses in plain hex
+        std::vector<std::string> parts = fields(line);
+        if (parts.size() < 10 || parts[0].size() != 32 || parts[4].size() != 32) continue;
+        unsigned long flags = hexValue(parts[8]);
+        // Skip host-local routes (RTF_LOCAL) and multicast, which ip -6 route hides too
+        if (!(flags & 0x1) || (flags & 0x80000000UL) || parts[0].compare(0, 2, "ff") == 0 || parts[9] == "lo") continue;
+
+        in6_addr dest, next;
+        for (int i = 0; i < 16; i++) {
+            dest.s6_addr[i] = static_cast<unsigned char>(hexValue(parts[0].substr(i * 2, 2)));
+            next.s6_addr[i] = static_cast<unsigned char>(hexValue(parts[4].substr(i * 2, 2)));
+        }
+        char text[INET6_ADDRSTRLEN];
+        RouteEntry entry;
+        entry.iface = parts[9];
+        entry.metric = static_cast<int>(hexValue(parts[5]));
+        unsigned long prefix = hexValue(parts[1]);
+        inet_ntop(AF_INET6, &dest, text, sizeof(text));
+        entry.destination = prefix == 0 ? "default" : std::string(text) + "/" + std::to_string(prefix);
+        if (flags & 0x2) {
+            inet_ntop(AF_INET6, &next, text, sizeof(text));
+            entry.gateway = text;
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool SystemInfo::arpTable(std::vector<ArpEntry>& entries, std::string& error) {
+    std::ifstream in("/proc/net/arp");
+    if (!in) {
+        error = "/proc/net/arp is not available";
+        return false;
+    }
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        // IP address, HW type, Flags, HW address, Mask, Device
+        std::vector<std::string> parts = fields(line);
+        if (parts.size() < 6) continue;
+        unsigned long flags = hexValue(parts[2]);
+        ArpEntry entry;
+        entry.address = parts[0];
+        entry.mac = parts[3] == "00:00:00:00:00:00" ? "" : parts[3];
+        entry.iface = parts[5];
+        entry.state = (flags & 0x4) ? "permanent" : (flags & 0x2) ? "complete" : "incomplete";
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool SystemInfo::interfaces(const std::string& only, std::vector<InterfaceInfo>& entries, std::string& error) {
+    struct ifaddrs* list = nullptr;
+    if (getifaddrs(&list) != 0) {
+        error = std::string("getifaddrs failed: ") + strerror(errno);
+        return false;
+    }
+
+    std::map<std::string, size_t> index;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    for (struct ifaddrs* ifa = list; ifa; ifa = ifa->ifa_next) {
+        if (!only.empty() && only != ifa->ifa_name) continue;
+
+        auto found = index.find(ifa->ifa_name);
+        if (found == index.end()) {
+            InterfaceInfo info;
+            info.name = ifa->ifa_name;
+            static const std::pair<unsigned int, const char*> names[] = {
+                {IFF_UP, "UP"}, {IFF_BROADCAST, "BROADCAST"}, {IFF_LOOPBACK, "LOOPBACK"},
+                {IFF_POINTOPOINT, "POINTOPOINT"}, {IFF_RUNNING, "RUNNING"}, {IFF_MULTICAST, "MULTICAST"},
+                {IFF_PROMISC, "PROMISC"},
+            };
+            for (const auto& flag : names) {
+                if (ifa->ifa_flags & flag.first) info.flags.push_back(flag.second);
+            }
+            struct ifreq request = {};
+            strncpy(request.ifr_name, ifa->ifa_name, IFNAMSIZ - 1);
+            if (sock >= 0 && ioctl(sock, SIOCGIFMTU, &request) == 0) info.mtu = request.ifr_mtu;
+            found = index.emplace(info.name, entries.size()).first;
+            entries.push_back(info);
+        }
+        InterfaceInfo& info = entries[found->second];
+        if (!ifa->ifa_addr) continue;
+
+        int family = ifa->ifa_addr->sa_family;
+        if (family == AF_INET || family == AF_INET6) {
+            char text[INET6_ADDRSTRLEN];
+            const void* raw = family == AF_INET
+                ? static_cast<const void*>(&reinterpret_cast<const sockaddr_in*>(ifa->ifa_addr)->sin_addr)
+                : static_cast<const void*>(&reinterpret_cast<const sockaddr_in6*>(ifa->ifa_addr)->sin6_addr);
+            inet_ntop(family, raw, text, sizeof(text));
+            std::string address = std::string(family == AF_INET ? "inet " : "inet6 ") + text;
+            int prefix = prefixLength(ifa->ifa_netmask);
+            if (prefix >= 0) address += "/" + std::to_string(prefix);
+            info.addresses.push_back(address);
+        }
+#ifdef __linux__
+        else if (family == AF_PACKET) {
+            const sockaddr_ll* link = reinterpret_cast<const sockaddr_ll*>(ifa->ifa_addr);
+            info.mac = macAddress(link->sll_addr, link->sll_halen);
+        }
+#endif
+#ifdef __APPLE__
+        else if (family == AF_LINK) {
+            const sockaddr_dl* link = reinterpret_cast<const sockaddr_dl*>(ifa->ifa_addr);
+            info.mac = macAddress(reinterpret_cast<const unsigned char*>(LLADDR(link)), link->sdl_alen);
+        }
+#endif
+    }
+    if (sock >= 0) close(sock);
+    freeifaddrs(list);
+
+    // Byte and packet counters, where /proc has them
+    std::ifstream dev("/proc/net/dev");
+    std::string line;
+    while (std::getline(dev, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        auto found = index.find(utils::trim(line.substr(0, colon)));
+        if (found == index.end()) continue;
+        std::vector<std::string> parts = fields(line.substr(colon + 1));
+        if (parts.size() < 12) continue;
+        InterfaceInfo& info = entries[found->second];
+        info.has_stats = true;
+        info.rx_bytes = std::strtoull(parts[0].c_str(), nullptr, 10);
+        info.rx_packets = std::strtoull(parts[1].c_str(), nullptr, 10);
+        info.rx_errors = std::strtoull(parts[2].c_str(), nullptr, 10);
+        info.rx_dropped = std::strtoull(parts[3].c_str(), nullptr, 10);
+        info.tx_bytes = std::strtoull(parts[8].c_str(), nullptr, 10);
+        info.tx_packets = std::strtoull(parts[9].c_str(), nullptr, 10);
+        info.tx_errors = std::strtoull(parts[10].c_str(), nullptr, 10);
+        info.tx_dropped = std::strtoull(parts[11].c_str(), nullptr, 10);
+    }
+
+    if (!only.empty() && entries.empty()) {
+        error = "No such interface: " + only;
+        return false;
+    }
+    return true;
+}
+
+bool SystemInfo::diskUsage(const std::string& path, std::vector<DiskUsage>& entries, std::string& error) {
+    std::vector<Mount> table = mounts();
+
+    if (!path.empty()) {
+        char resolved[PATH_MAX];
+        if (!realpath(path.c_str(), resolved)) {
+            error = "Cannot access " + path + ": " + strerror(errno);
+            return false;
+        }
+        // The mount holding path is the longest mount point above it; later mounts shadow earlier ones
+        std::string real = resolved;
+        const Mount* holder = nullptr;
+        for (const auto& mount : table) {
+            const std::string& point = mount.point;
+            bool above = real == point || point == "/" ||
+                         (real.compare(0, point.size(), point) == 0 && real[point.size()] == '/');
+            if (above && (!holder || point.size() >= holder->point.size())) holder = &mount;
+        }
+        DiskUsage usage;
+        usage.mount_point = holder ? holder->point : real;
+        usage.device = holder ? holder->device : "-";
+        usage.fs_type = holder ? holder->type : "-";
+        if (!fillUsage(usage, real)) {
+            error = "statvfs failed for " + path + ": " + strerror(errno);
+            return false;
+        }
+        entries.push_back(usage);
+        return true;
+    }
+
+    if (table.empty()) {
+        error = "Cannot list mounted filesystems";
+        return false;
+    }
+    std::map<std::string, size_t> by_point;
+    for (const auto& mount : table) {
+        DiskUsage usage;
+        usage.device = mount.device;
+        usage.fs_type = mount.type;
+        usage.mount_point = mount.point;
+        // proc, sysfs, cgroup and the like report no blocks
+        if (!fillUsage(usage, mount.point) || usage.total == 0) continue;
+        auto seen = by_point.find(mount.point);
+        if (seen != by_point.end()) {
+            entries[seen->second] = usage;
+        } else {
+            by_point[mount.point] = entries.size();
+            entries.push_back(usage);
+        }
+    }
+    return true;
+}
+
+std::string SystemInfo::formatSockets(const std::vector<SocketEntry>& entries, size_t max_lines) {
+    // Listening sockets first, the rest in kernel order
+    std::vector<const SocketEntry*> sorted;
+    for (const auto& entry : entries) sorted.push_back(&entry);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const SocketEntry* a, const SocketEntry* b) {
+        bool a_listen = a->state == "LISTEN" || a->state == "UNCONN";
+        bool b_listen = b->state == "LISTEN" || b->state == "UNCONN";
+        return a_listen && !b_listen;
+    });
+
+    size_t local_width = 13, remote_width = 14;
+    for (size_t i = 0; i < sorted.size() && i < max_lines; i++) {
+        local_width = std::max(local_width, sorted[i]->local.size());
+        remote_width = std::max(remote_width, sorted[i]->remote.size());
+    }
+
+    std::ostringstream out;
+    out << pad("Proto", 5) << pad("Local Address", local_width) << pad("Remote Address", remote_width)
+        << pad("State", 11) << "Process\n";
+    std::map<std::string, size_t> states;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const SocketEntry& entry = *sorted[i];
+        states[entry.state]++;
+        if (i >= max_lines) continue;
+        out << pad(entry.proto, 5) << pad(entry.local, local_width) << pad(entry.remote, remote_width)
+            << pad(entry.state, 11);
+        if (entry.pid) out << entry.pid << "/" << entry.program;
+        if (entry.recv_queue || entry.send_queue) out << " (queued recv " << entry.recv_queue << ", send " << entry.send_queue << ")";
+        out << "\n";
+    }
+    if (sorted.size() > max_lines) {
+        out << "... " << (sorted.size() - max_lines) << " more sockets not shown (narrow with filter)\n";
+    }
+    out << "[" << sorted.size() << " sockets";
+    for (const auto& state : states) out << ", " << state.second << " " << state.first;
+    out << "]\n";
+    return out.str();
+}
+
+std::string SystemInfo::formatRoutes(const std::vector<RouteEntry>& entries) {
+    std::ostringstream out;
+    for (const auto& entry : entries) {
+        out << entry.destination;
+        if (!entry.gateway.empty()) out << " via " << entry.gateway;
+        out << " dev " << entry.iface;
+        if (entry.metric) out << " metric " << entry.metric;
+        out << "\n";
+    }
+    if (entries.empty()) out << "(no routes)\n";
+    return out.str();
+}
+
+std::string SystemInfo::formatArp(const std::vector<ArpEntry>& entries) {
+    std::ostringstream out;
+    for (const auto& entry : entries) {
+        out << pad(entry.address, 15) << pad(entry.mac.empty() ? "(incomplete)" : entry.mac, 17)
+            << pad(entry.iface, 8) << entry.state << "\n";
+    }
+    out << "[" << entries.size() << " entries]\n";
+    return out.str();
+}
+
+std::string SystemInfo::formatInterfaces(const std::vector<InterfaceInfo>& entries) {
+    std::ostringstream out;
+    for (const auto& info : entries) {
+        out << info.name << ": <";
+        for (size_t i = 0; i < info.flags.size(); i++) out << (i ? "," : "") << info.flags[i];
+        out << ">";
+        if (info.mtu) out << " mtu " << info.mtu;
+        out << "\n";
+        if (!info.mac.empty()) out << "    ether " << info.mac << "\n";
+        for (const auto& address : info.addresses) out << "    " << address << "\n";
+        if (info.has_stats) {
+            out << "    RX " << utils::formatSize(info.rx_bytes) << " (" << info.rx_packets << " packets";
+            if (info.rx_errors || info.rx_dropped) out << ", " << info.rx_errors << " errors, " << info.rx_dropped << " dropped";
+            out << ")  TX " << utils::formatSize(info.tx_bytes) << " (" << info.tx_packets << " packets";
+            if (info.tx_errors || info.tx_dropped) out << ", " << info.tx_errors << " errors, " << info.tx_dropped << " dropped";
+            out << ")\n";
+        }
+    }
+    return out.str();
+}
+
+std::string SystemInfo::formatDiskUsage(const std::vector<DiskUsage>& entries, bool human) {
+    size_t device_width = 10;
+    for (const auto& usage : entries) device_width = std::max(device_width, std::min<size_t>(usage.device.size(), 32));
+
+    auto size = [human](uint64_t bytes) {
+        return human ? utils::formatSize(bytes) : std::to_string(bytes / 1024);
+    };
+    size_t width = human ? 6 : 10;
+    std::ostringstream out;
+    out << pad("Filesystem", device_width) << pad("Type", 8) << pad(human ? "Size" : "1K-blocks", width)
+        << pad("Used", width) << pad("Avail", width) << pad("Use%", 5) << pad("IUse%", 5) << "Mounted on\n";
+    for (const auto& usage : entries) {
+        out << pad(usage.device, device_width) << pad(usage.fs_type, 8) << pad(size(usage.total), width)
+            << pad(size(usage.used), width) << pad(size(usage.available), width)
+            << pad(percent(usage.used, usage.used + usage.available), 5)
+            << pad(percent(usage.inodes_used, usage.inodes), 5) << usage.mount_point << "\n";
+    }
+    return out.str();
+}
+
+} // namespace casper
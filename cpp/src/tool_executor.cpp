@@ -4,6 +4,26 @@
 #include "search_client.h"
 #include "db_client.h"
 #include "rag_engine.h"
+#include "grep_engine.h"
+#include "file_walker.h"
+#include "tool_scheduler.h"
+#include "process_runner.h"
+#include "persistent_shell.h"
+#include "job_manager.h"
+#include "mapped_file.h"
+#include "line_diff.h"
+#include "undo_store.h"
+#include "patch_applier.h"
+#include "thread_pool.h"
+#include "file_cache.h"
+#include "result_cache.h"
+#include "net_probe.h"
+#include "dns_client.h"
+#include "system_info.h"
+#include "file_ops.h"
+#include "archive.h"
+#include "command_registry.h"
+#include "ssh_multiplexer.h"
 #include "utils.h"
 #include <iostream>
 #include <fstream>
@@ -11,10 +31,88 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
-#include <array>
+#include <mutex>
+#include <map>
+#include <set>
+#include <chrono>
+#include <ctime>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace casper {
 
+// Output of a tool running on a worker thread. It is buffered and written to
+// the terminal as one block, headed by the "Tool i/N" banner.
+struct ToolOutput {
+    size_t index;
+    std::string header;
+    std::ostringstream buffer;
+};
+
+static thread_local ToolOutput* current_output = nullptr;
+
+// Resource usage of the commands run by the tool executing on this thread
+struct CommandUsage {
+    long duration_ms = 0;
+    double cpu_seconds = 0;
+    long max_rss_kb = 0;
+    bool timed_out = false;
+    bool truncated = false;
+    size_t dropped_bytes = 0;
+};
+
+static thread_local CommandUsage current_usage;
+
+static double threadCpuSeconds() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Read returns at most this much unless asked for a range
+static const size_t READ_DEFAULT_LINES = 2000;
+static const size_t READ_DEFAULT_BYTES = 256 * 1024;
+static const size_t READ_MAX_BYTES = 4 * 1024 * 1024;
+
+// ReadMany shares one byte budget (READ_DEFAULT_BYTES unless asked) across its files
+static const size_t READ_MANY_DEFAULT_FILES = 50;
+static const size_t READ_MANY_MAX_FILES = 200;
+static const size_t READ_MANY_THREADS = 8;
+
+// Native network probes (Ping, Traceroute, Dig, connect scans)
+static const int NET_PROBE_TIMEOUT_MS = 2000;
+static const int NET_SCAN_TIMEOUT_MS = 1000;
+static const size_t NET_SCAN_CONCURRENCY = 256;
+static const size_t NET_SCAN_MAX_CONCURRENCY = 2048;
+static const size_t NET_SCAN_MAX_PROBES = 256 * 1024;
+static const size_t DIG_MAX_QUESTIONS = 256;
+static const size_t NETSTAT_MAX_LINES = 100;
+static size_t last_printed_tool = static_cast<size_t>(-1);  // Guarded by consoleMutex
+
+static std::string toolHeader(size_t index, size_t total, const std::string& name) {
+    std::ostringstream header;
+    header << utils::terminal::MAGENTA << "═══════════════════════════════════════" << utils::terminal::RESET << "\n";
+    header << utils::terminal::MAGENTA << "Tool " << (index+1) << "/" << total << ": " << name << utils::terminal::RESET << "\n";
+    header << utils::terminal::MAGENTA << "═══════════════════════════════════════" << utils::terminal::RESET << "\n\n";
+    return header.str();
+}
+
+// Write the calling thread's buffered tool output. Caller holds consoleMutex.
+static void flushToolOutput() {
+    if (!current_output) return;
+
+    std::string text = current_output->buffer.str();
+    if (text.empty() && last_printed_tool == current_output->index) return;
+
+    if (last_printed_tool != current_output->index) {
+        std::cout << current_output->header;
+        last_printed_tool = current_output->index;
+    }
+    std::cout << text << std::flush;
+    current_output->buffer.str("");
+}
+
 // Helper function to count lines in a string
 static int countLines(const std::string& str) {
     if (str.empty()) return 0;
@@ -27,15 +125,47 @@ static int countLines(const std::string& str) {
     return count;
 }
 
-// Helper function to split string into lines
-static std::vector<std::string> splitLines(const std::string& str) {
-    std::vector<std::string> lines;
-    std::istringstream iss(str);
-    std::string line;
-    while (std::getline(iss, line)) {
-        lines.push_back(line);
-    }
-    return lines;
+// Files under path matching a glob, sorted; limited is set when there were more than max_results
+static std::vector<std::string> globFiles(const std::string& pattern, std::string path, WalkOptions options,
+                                          size_t max_results, bool& limited) {
+    while (path.size() > 1 && path.back() == '/') path.pop_back();
+    GlobMatcher matcher(pattern);
+
+    // Only walk below the pattern's literal directories ("src/**/*.h" starts in src)
+    std::string root = path;
+    std::string prefix = matcher.literalPrefix();
+    if (!prefix.empty()) {
+        root = utils::joinPath(path, prefix);
+    }
+    if (matcher.maxDepth() >= 0) {
+        int prefix_depth = prefix.empty() ? 0 : static_cast<int>(utils::split(prefix, '/').size());
+        options.max_depth = std::max(0, matcher.maxDepth() - prefix_depth);
+    }
+
+    std::vector<std::string> files;
+    std::mutex files_mutex;
+    bool more = false;
+    FileWalker walker(options);
+    walker.walk(root, [&](const WalkEntry& entry) {
+        std::string relative = entry.path.size() > path.size() && utils::startsWith(entry.path, path)
+            ? entry.path.substr(path == "/" ? 1 : path.size() + 1)
+            : entry.path;
+        if (!matcher.matches(relative)) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(files_mutex);
+        // Stop at the first match past the limit, so exactly max_results is not a cut
+        if (files.size() >= max_results) {
+            more = true;
+            return false;
+        }
+        files.push_back(entry.path);
+        return true;
+    });
+
+    std::sort(files.begin(), files.end());
+    limited = more;
+    return files;
 }
 
 ToolExecutor::ToolExecutor(Config& config)
@@ -45,7 +175,20 @@ ToolExecutor::ToolExecutor(Config& config)
     , search_client_(nullptr)
     , db_client_(nullptr)
     , rag_engine_(nullptr)
+    , jobs_(std::make_unique<JobManager>())
+    , undo_(std::make_unique<UndoStore>())
+    , file_cache_(std::make_shared<FileCache>(static_cast<size_t>(std::max(0, config.getFileCacheMb())) * 1024 * 1024))
+    , result_cache_(std::make_unique<ResultCache>())
+    , ssh_mux_(std::make_unique<SshMultiplexer>(utils::joinPath(Config::getConfigDir(), "ssh")))
 {
+    // Most tools check for a binary first; have the PATH scan ready by then
+    CommandRegistry::instance().warmUp();
+}
+
+ToolExecutor::~ToolExecutor() = default;
+
+void ToolExecutor::resetShell() {
+    shell_.reset();
 }
 
 void ToolExecutor::setMCPClient(MCPClient* client) {
@@ -62,6 +205,9 @@ void ToolExecutor::setDBClient(DBClient* client) {
 
 void ToolExecutor::setRAGEngine(RAGEngine* engine) {
     rag_engine_ = engine;
+    if (rag_engine_) {
+        rag_engine_->setFileCache(file_cache_);
+    }
 }
 
 bool ToolExecutor::isMCPTool(const std::string& tool_name) const {
@@ -86,6 +232,10 @@ bool ToolExecutor::requestConfirmation(const std::string& tool_name, const std::
         return true;
     }
 
+    // One prompt at a time, shown right after the tool's output so far
+    std::lock_guard<std::recursive_mutex> lock(utils::terminal::consoleMutex());
+    flushToolOutput();
+
     if (confirm_callback_) {
         return confirm_callback_(tool_name, description);
     }
@@ -98,61 +248,119 @@ bool ToolExecutor::requestConfirmation(const std::string& tool_name, const std::
     return (response == 'y' || response == 'Y');
 }
 
-std::string ToolExecutor::executeCommand(const std::string& command, int& exit_code) {
-    std::array<char, 128> buffer;
-    std::string result;
+ProcessOptions ToolExecutor::commandOptions(const std::string& command) {
+    ProcessOptions options;
+    options.command = command;
+    options.timeout_ms = config_.getCommandTimeout() * 1000;
+    // sudo asks for the password on the terminal, so keep it attached
+    options.interactive = command.find("sudo ") != std::string::npos;
+    return options;
+}
 
-    FILE* pipe = popen((command + " 2>&1").c_str(), "r");
-    if (!pipe) {
-        exit_code = -1;
-        return "Failed to execute command";
+void ToolExecutor::recordUsage(const ProcessResult& process) {
+    current_usage.duration_ms += process.duration_ms;
+    current_usage.cpu_seconds += process.user_cpu_seconds + process.system_cpu_seconds;
+    current_usage.max_rss_kb = std::max(current_usage.max_rss_kb, process.max_rss_kb);
+    current_usage.timed_out = current_usage.timed_out || process.timed_out || process.idle_timed_out;
+    current_usage.truncated = current_usage.truncated || process.truncated;
+    current_usage.dropped_bytes += process.dropped_bytes;
+}
+
+void ToolExecutor::backupBeforeWrite(const std::string& path, const std::string& tool, bool existed,
+                                     const std::string& previous, const std::string& written) {
+    // The model has seen what it just wrote
+    file_cache_->invalidate(path);
+    FileStamp stamp;
+    if (FileCache::stat(path, stamp)) {
+        file_cache_->noteSeen(path, stamp);
     }
 
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-        result += buffer.data();
+    std::string mode = config_.getEditBackup();
+    if (mode == "undo") {
+        undo_->record(path, tool, existed, previous, written);
+    } else if (mode == "bak" && existed) {
+        utils::writeFileAtomic(path + ".bak", previous);
+    }
+}
+
+bool ToolExecutor::openFile(const std::string& path, MappedFile& file, std::string& error, FileStamp* stamp) {
+    FileStamp current;
+    if (FileCache::stat(path, current) && file_cache_->cacheable(current)) {
+        std::shared_ptr<const std::string> content = file_cache_->read(path, error, stamp);
+        if (!content) return false;
+        file.assign(std::move(content));
+        return true;
     }
+    if (stamp) *stamp = current;
+    return file.open(path, error);
+}
+
+std::string ToolExecutor::executeCommand(const std::string& command, int& exit_code) {
+    ProcessOptions options = commandOptions(command);
+    options.merge_stderr = true;
 
-    exit_code = pclose(pipe);
-    exit_code = WEXITSTATUS(exit_code);
+    ProcessResult process = ProcessRunner::run(options);
+    recordUsage(process);
 
-    return result;
+    if (!process.started) {
+        exit_code = -1;
+        return process.error;
+    }
+
+    exit_code = process.exit_code;
+    std::string output = process.stdout_data;
+    if (process.timed_out) {
+        output += "\n[Command timed out after " + std::to_string(options.timeout_ms / 1000) + "s and was killed]\n";
+    }
+    return output;
 }
 
-std::string ToolExecutor::getInstallCommand(const std::string& package_name) {
+static std::string detectInstallPrefix() {
     if (utils::isMacOS()) {
         if (utils::commandExists("brew")) {
-            return "brew install " + package_name;
+            return "brew install ";
         }
         return "";
     } else if (utils::isLinux()) {
         std::string distro = utils::getLinuxDistro();
         if (distro == "ubuntu" || distro == "debian" || distro == "linuxmint" || distro == "pop") {
-            return "sudo apt install -y " + package_name;
+            return "sudo apt install -y ";
         } else if (distro == "fedora") {
-            return "sudo dnf install -y " + package_name;
+            return "sudo dnf install -y ";
         } else if (distro == "centos" || distro == "rhel" || distro == "rocky" || distro == "almalinux") {
             if (utils::commandExists("dnf")) {
-                return "sudo dnf install -y " + package_name;
+                return "sudo dnf install -y ";
             }
-            return "sudo yum install -y " + package_name;
+            return "sudo yum install -y ";
         } else if (distro == "arch" || distro == "manjaro") {
-            return "sudo pacman -S --noconfirm " + package_name;
+            return "sudo pacman -S --noconfirm ";
         } else if (distro == "opensuse" || distro == "suse" || distro == "sles") {
-            return "sudo zypper install -y " + package_name;
+            return "sudo zypper install -y ";
         } else if (distro == "alpine") {
-            return "sudo apk add " + package_name;
+            return "sudo apk add ";
         }
         // Fallback: try to detect available package manager
-        if (utils::commandExists("apt")) return "sudo apt install -y " + package_name;
-        if (utils::commandExists("dnf")) return "sudo dnf install -y " + package_name;
-        if (utils::commandExists("yum")) return "sudo yum install -y " + package_name;
-        if (utils::commandExists("pacman")) return "sudo pacman -S --noconfirm " + package_name;
-        if (utils::commandExists("zypper")) return "sudo zypper install -y " + package_name;
-        if (utils::commandExists("apk")) return "sudo apk add " + package_name;
+        if (utils::commandExists("apt")) return "sudo apt install -y ";
+        if (utils::commandExists("dnf")) return "sudo dnf install -y ";
+        if (utils::commandExists("yum")) return "sudo yum install -y ";
+        if (utils::commandExists("pacman")) return "sudo pacman -S --noconfirm ";
+        if (utils::commandExists("zypper")) return "sudo zypper install -y ";
+        if (utils::commandExists("apk")) return "sudo apk add ";
     }
     return "";
 }
 
+// Package manager command without the package, e.g. "sudo apt install -y "
+static const std::string& installPrefix() {
+    static const std::string prefix = detectInstallPrefix();
+    return prefix;
+}
+
+std::string ToolExecutor::getInstallCommand(const std::string& package_name) {
+    const std::string& prefix = installPrefix();
+    return prefix.empty() ? "" : prefix + package_name;
+}
+
 bool ToolExecutor::installPackage(const std::string& package_name) {
     std::string install_cmd = getInstallCommand(package_name);
     if (install_cmd.empty()) {
@@ -161,18 +369,20 @@ bool ToolExecutor::installPackage(const std::string& package_name) {
     }
 
     utils::terminal::printInfo("Installing " + package_name + "...");
-    std::cout << utils::terminal::CYAN << "Command: " << install_cmd << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Command: " << install_cmd << utils::terminal::RESET << "\n";
 
     int exit_code;
     std::string output = executeCommand(install_cmd, exit_code);
 
     if (exit_code == 0) {
+        // New binaries are on PATH now
+        CommandRegistry::instance().invalidate();
         utils::terminal::printSuccess(package_name + " installed successfully");
-        std::cout << output << "\n";
+        utils::terminal::out() << output << "\n";
         return true;
     } else {
         utils::terminal::printError("Failed to install " + package_name);
-        std::cout << output << "\n";
+        utils::terminal::out() << output << "\n";
         return false;
     }
 }
@@ -191,10 +401,14 @@ bool ToolExecutor::ensureToolAvailable(const std::string& tool_name, const std::
     }
 
     utils::terminal::printWarning(tool_name + " is not installed.");
+
+    std::unique_lock<std::recursive_mutex> lock(utils::terminal::consoleMutex());
+    flushToolOutput();
     std::cout << utils::terminal::YELLOW << "Install " << pkg << "? (" << install_cmd << ") [y/N]: " << utils::terminal::RESET;
 
     std::string response;
     std::getline(std::cin, response);
+    lock.unlock();
 
     if (response == "y" || response == "Y" || response == "yes" || response == "Yes") {
         return installPackage(pkg);
@@ -222,8 +436,8 @@ ToolResult ToolExecutor::executeBash(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Bash]");
-    std::cout << utils::terminal::CYAN << "Description: " << description << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::MAGENTA << "Command: " << command << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Description: " << description << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::MAGENTA << "Command: " << command << utils::terminal::RESET << "\n\n";
 
     // Safety check
     if (!isCommandSafe(command)) {
@@ -241,19 +455,234 @@ ToolResult ToolExecutor::executeBash(const ToolCall& tool_call) {
         return result;
     }
 
+    auto background_it = tool_call.parameters.find("run_in_background");
+    if (background_it != tool_call.parameters.end() &&
+        (background_it->second == "true" || background_it->second == "1")) {
+        return startBackgroundJob(command);
+    }
+
+    ProcessOptions options = commandOptions(command);
+    auto timeout_it = tool_call.parameters.find("timeout");
+    if (timeout_it != tool_call.parameters.end() && std::atoi(timeout_it->second.c_str()) > 0) {
+        options.timeout_ms = std::atoi(timeout_it->second.c_str()) * 1000;
+    }
+
+    // Stream output as it arrives
+    options.on_output = [](const char* data, size_t size, bool is_stderr) {
+        std::ostream& out = utils::terminal::out();
+        if (is_stderr) out << utils::terminal::RED;
+        out.write(data, static_cast<std::streamsize>(size));
+        if (is_stderr) out << utils::terminal::RESET;
+        out.flush();
+    };
+
+    // Commands share one shell so cd and exports carry over; sudo needs the terminal
+    bool use_shell = config_.getPersistentShell() && !options.interactive;
+    bool shell_reset = false;
+
     // Execute
     utils::terminal::printInfo("Executing...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
+    utils::terminal::out() << "\n=== Output ===\n";
+    ProcessResult process;
+    if (use_shell) {
+        if (!shell_) {
+            shell_ = std::make_unique<PersistentShell>();
+        }
+        ShellResult shell = shell_->run(command, options.timeout_ms, options.on_output, options.max_output_bytes);
+        process.started = shell.started;
+        process.error = shell.error;
+        process.exit_code = shell.exit_code;
+        process.timed_out = shell.timed_out;
+        process.stdout_data = shell.stdout_data;
+        process.stderr_data = shell.stderr_data;
+        process.truncated = shell.truncated;
+        process.dropped_bytes = shell.dropped_bytes;
+        process.duration_ms = shell.duration_ms;
+        shell_reset = shell.timed_out || shell.shell_exited;
+    } else {
+        process = ProcessRunner::run(options);
+    }
+    recordUsage(process);
+    utils::terminal::out() << "==============\n\n";
+
+    if (!process.started) {
+        result.success = false;
+        result.exit_code = -1;
+        result.error = process.error;
+        utils::terminal::printError(result.error);
+        return result;
+    }
+
+    result.exit_code = process.exit_code;
+    result.output = process.stdout_data;
+    if (!process.stderr_data.empty()) {
+        if (!result.output.empty() && result.output.back() != '\n') result.output += "\n";
+        result.output += "[stderr]\n" + process.stderr_data;
+    }
+    if (process.timed_out) {
+        result.error = "Command timed out after " + std::to_string(options.timeout_ms / 1000) + "s and was killed";
+    }
+    if (shell_reset) {
+        if (!result.output.empty() && result.output.back() != '\n') result.output += "\n";
+        result.output += "[shell restarted: working directory and environment were reset]\n";
+    }
+    result.success = (result.exit_code == 0 && !process.timed_out);
 
     if (result.success) {
         utils::terminal::printSuccess("Success");
+    } else if (process.timed_out) {
+        utils::terminal::printError(result.error);
     } else {
         utils::terminal::printError("Failed (exit code: " + std::to_string(result.exit_code) + ")");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    return result;
+}
+
+ToolResult ToolExecutor::startBackgroundJob(const std::string& command) {
+    ToolResult result;
+
+    // Start where the session shell currently is, so "cd build" earlier still applies
+    std::string working_dir;
+    if (shell_ && config_.getPersistentShell()) {
+        working_dir = shell_->workingDirectory();
+    }
+
+    std::string error;
+    int id = jobs_->start(command, working_dir, error);
+    if (id == 0) {
+        result.success = false;
+        result.exit_code = -1;
+        result.error = error;
+        utils::terminal::printError(error);
+        return result;
+    }
 
+    JobInfo info;
+    jobs_->info(id, info);
+    result.success = true;
+    result.exit_code = 0;
+    result.output = "Started background job " + std::to_string(id) + " (pid " + std::to_string(info.pid) + ")\n"
+                    "Use JobOutput with id " + std::to_string(id) + " to read its output, JobStatus to check on it, "
+                    "JobKill to stop it.\n";
+    utils::terminal::printSuccess("Started background job " + std::to_string(id));
+    return result;
+}
+
+static std::string describeJob(const JobInfo& info) {
+    std::string state;
+    if (info.running) {
+        state = "running";
+    } else if (info.term_signal != 0) {
+        state = "killed by signal " + std::to_string(info.term_signal);
+    } else {
+        state = "exited " + std::to_string(info.exit_code);
+    }
+
+    std::ostringstream line;
+    line << "[" << info.id << "] " << state << " after " << info.elapsed_ms / 1000 << "s, "
+         << utils::formatSize(info.output_bytes) << " output: " << info.command;
+    return line.str();
+}
+
+static int jobIdParam(const ToolCall& tool_call) {
+    auto it = tool_call.parameters.find("id");
+    if (it == tool_call.parameters.end()) {
+        it = tool_call.parameters.find("job_id");
+    }
+    return it == tool_call.parameters.end() ? 0 : std::atoi(it->second.c_str());
+}
+
+ToolResult ToolExecutor::executeJobStatus(const ToolCall& tool_call) {
+    ToolResult result;
+    utils::terminal::printInfo("[Tool: JobStatus]");
+
+    std::vector<JobInfo> infos;
+    int id = jobIdParam(tool_call);
+    if (id > 0) {
+        JobInfo info;
+        if (!jobs_->info(id, info)) {
+            result.success = false;
+            result.exit_code = 1;
+            result.error = "No such job: " + std::to_string(id);
+            utils::terminal::printError(result.error);
+            return result;
+        }
+        infos.push_back(info);
+    } else {
+        infos = jobs_->list();
+    }
+
+    for (const auto& info : infos) {
+        result.output += describeJob(info) + "\n";
+    }
+    if (infos.empty()) {
+        result.output = "No background jobs\n";
+    }
+
+    utils::terminal::out() << result.output;
+    result.success = true;
+    result.exit_code = 0;
+    return result;
+}
+
+ToolResult ToolExecutor::executeJobOutput(const ToolCall& tool_call) {
+    ToolResult result;
+
+    int id = jobIdParam(tool_call);
+    int tail = 0;
+    auto tail_it = tool_call.parameters.find("tail");
+    if (tail_it != tool_call.parameters.end()) {
+        tail = std::atoi(tail_it->second.c_str());
+    }
+
+    utils::terminal::printInfo("[Tool: JobOutput]");
+
+    JobInfo info;
+    std::string text;
+    if (!jobs_->info(id, info) || !jobs_->output(id, tail, text)) {
+        result.success = false;
+        result.exit_code = 1;
+        result.error = "No such job: " + std::to_string(id);
+        utils::terminal::printError(result.error);
+        return result;
+    }
+
+    result.output = describeJob(info) + "\n";
+    if (text.empty()) {
+        result.output += tail > 0 ? "(no output)\n" : "(no new output)\n";
+    } else {
+        result.output += text;
+        if (result.output.back() != '\n') result.output += "\n";
+    }
+
+    utils::terminal::out() << result.output;
+    result.success = true;
+    result.exit_code = 0;
+    return result;
+}
+
+ToolResult ToolExecutor::executeJobKill(const ToolCall& tool_call) {
+    ToolResult result;
+
+    int id = jobIdParam(tool_call);
+    utils::terminal::printInfo("[Tool: JobKill]");
+
+    std::string error;
+    if (!jobs_->kill(id, error)) {
+        result.success = false;
+        result.exit_code = 1;
+        result.error = error;
+        utils::terminal::printError(error);
+        return result;
+    }
+
+    JobInfo info;
+    jobs_->info(id, info);
+    result.output = describeJob(info) + "\n";
+    utils::terminal::out() << result.output;
+    result.success = true;
+    result.exit_code = 0;
     return result;
 }
 
@@ -285,7 +714,7 @@ ToolResult ToolExecutor::executeRead(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Read]");
-    std::cout << utils::terminal::CYAN << "File: " << file_path << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "File: " << file_path << utils::terminal::RESET << "\n\n";
 
     if (!utils::fileExists(file_path)) {
         result.success = false;
@@ -294,19 +723,366 @@ ToolResult ToolExecutor::executeRead(const ToolCall& tool_call) {
         return result;
     }
 
-    result.output = utils::readFile(file_path);
-    if (result.output.empty()) {
+    MappedFile file;
+    std::string error;
+    FileStamp stamp;
+    if (!openFile(file_path, file, error, &stamp)) {
         result.success = false;
-        result.error = "Failed to read file or file is empty";
+        result.error = error;
         utils::terminal::printError(result.error);
         return result;
     }
+    file_cache_->noteSeen(file_path, stamp);
 
     result.success = true;
     result.exit_code = 0;
+    size_t size = file.size();
+
+    if (size == 0) {
+        result.output = "[Empty file]\n";
+        utils::terminal::printWarning("Empty file");
+        return result;
+    }
+
+    if (file.isBinary()) {
+        std::string type = file.binaryType();
+        std::ostringstream summary;
+        summary << "[Binary file" << (type.empty() ? "" : ": " + type) << ", "
+                << utils::formatSize(size) << " (" << size << " bytes). Contents not shown.]\n"
+                << "First bytes:";
+        char hex[4];
+        for (size_t i = 0; i < std::min<size_t>(size, 32); i++) {
+            snprintf(hex, sizeof(hex), " %02x", static_cast<unsigned char>(file.data()[i]));
+            summary << hex;
+        }
+        summary << "\n";
+        result.output = summary.str();
+        utils::terminal::out() << result.output << "\n";
+        return result;
+    }
+
+    auto param = [&](const char* name, long& value) {
+        auto it = tool_call.parameters.find(name);
+        if (it == tool_call.parameters.end() || it->second.empty()) return false;
+        value = std::atol(it->second.c_str());
+        return true;
+    };
+    long offset = 0, limit = 0, byte_offset = 0, byte_limit = 0;
+    bool has_offset = param("offset", offset);
+    bool has_limit = param("limit", limit);
+    bool has_byte_offset = param("byte_offset", byte_offset);
+    bool has_byte_limit = param("byte_limit", byte_limit);
+    bool byte_range = has_byte_offset || has_byte_limit;
+
+    size_t byte_cap = byte_limit > 0 ? std::min(static_cast<size_t>(byte_limit), READ_MAX_BYTES)
+                                     : READ_DEFAULT_BYTES;
+    size_t begin = 0;
+    size_t end = size;
+    std::string note;
+
+    if (byte_range) {
+        begin = std::min(static_cast<size_t>(std::max(byte_offset, 0L)), size);
+        end = std::min(size, begin + byte_cap);
+        if (begin > 0 || end < size) {
+            note = "[Bytes " + std::to_string(begin) + "-" + std::to_string(end) + " of " + std::to_string(size) + ".";
+            if (end < size) note += " Use byte_offset=" + std::to_string(end) + " to continue.";
+            note += "]";
+        }
+    } else if (offset < 0) {
+        // Last lines of a log, without touching the rest of it
+        begin = file.tailOffset(static_cast<size_t>(-offset));
+        if (end - begin > byte_cap) {
+            begin = end - byte_cap;
+            const void* newline = memchr(file.data() + begin, '\n', end - begin);
+            if (newline) begin = static_cast<const char*>(newline) - file.data() + 1;
+        }
+        if (begin > 0) {
+            note = "[Last " + std::to_string(countLines(std::string(file.data() + begin, end - begin))) +
+                   " lines, bytes " + std::to_string(begin) + "-" + std::to_string(end) + " of " + std::to_string(size) + "]";
+        }
+    } else {
+        size_t first = has_offset && offset > 0 ? static_cast<size_t>(offset) : 1;
+        size_t lines = has_limit && limit > 0 ? static_cast<size_t>(limit) : READ_DEFAULT_LINES;
+
+        begin = file.lineOffset(first);
+        if (begin >= size) {
+            result.success = false;
+            result.exit_code = 1;
+            result.error = "Offset " + std::to_string(first) + " is past the end of the file (" +
+                           std::to_string(file.indexedLines()) + " lines)";
+            utils::terminal::printError(result.error);
+            return result;
+        }
+        end = file.lineOffset(first + lines);
+
+        bool cut_mid_line = false;
+        if (end - begin > byte_cap) {
+            end = begin + byte_cap;
+            const char* last_newline = nullptr;
+            for (const char* p = file.data() + end; p > file.data() + begin; p--) {
+                if (p[-1] == '\n') { last_newline = p; break; }
+            }
+            if (last_newline) {
+                end = last_newline - file.data();
+            } else {
+                cut_mid_line = true;
+            }
+        }
+
+        if (begin > 0 || end < size) {
+            size_t last = first + countLines(std::string(file.data() + begin, end - begin)) - 1;
+            // The total is only known when the index reached the end
+            std::string total = end == size && file.fullyIndexed()
+                ? std::to_string(file.indexedLines())
+                : "a " + utils::formatSize(size) + " file";
+            note = "[Lines " + std::to_string(first) + "-" + std::to_string(last) + " of " + total + ".";
+            if (cut_mid_line) {
+                note += " Line " + std::to_string(first) + " is longer than " + utils::formatSize(byte_cap) +
+                        "; use byte_offset=" + std::to_string(end) + " to continue.";
+            } else if (end < size) {
+                note += " Use offset=" + std::to_string(last + 1) + " to read more.";
+            }
+            note += "]";
+        }
+    }
+
+    result.output.assign(file.data() + begin, end - begin);
+    if (!note.empty()) {
+        if (!result.output.empty() && result.output.back() != '\n') result.output += "\n";
+        result.output += note + "\n";
+    }
+
+    utils::terminal::out() << "=== File Contents ===\n" << result.output << "\n====================\n\n";
+
+    return result;
+}
+
+ToolResult ToolExecutor::executeReadMany(const ToolCall& tool_call) {
+    ToolResult result;
+
+    auto param = [&](const char* name) -> std::string {
+        auto it = tool_call.parameters.find(name);
+        return it == tool_call.parameters.end() ? "" : it->second;
+    };
+    std::string paths = param("paths");
+    if (paths.empty()) paths = param("files");
+    std::string pattern = param("pattern");
+    std::string root = param("path").empty() ? "." : param("path");
+
+    if (paths.empty() && pattern.empty()) {
+        result.success = false;
+        result.error = "Missing 'paths' or 'pattern' parameter";
+        return result;
+    }
+
+    long max_files_param = std::atol(param("max_files").c_str());
+    size_t max_files = max_files_param > 0 ? std::min(static_cast<size_t>(max_files_param), READ_MANY_MAX_FILES)
+                                           : READ_MANY_DEFAULT_FILES;
+    long max_bytes_param = std::atol(param("max_bytes").c_str());
+    size_t budget = max_bytes_param > 0 ? std::min(static_cast<size_t>(max_bytes_param), READ_MAX_BYTES)
+                                        : READ_DEFAULT_BYTES;
+
+    struct FileRequest {
+        std::string path;
+        size_t first = 1;
+        size_t count = 0;       // 0 = to the end of the file
+    };
+    std::vector<FileRequest> requests;
+    bool limited = false;
+
+    auto addGlob = [&](const std::string& glob, const std::string& base, const FileRequest& range) {
+        bool cut = false;
+        for (const auto& file : globFiles(glob, base, WalkOptions(), max_files + 1, cut)) {
+            FileRequest request = range;
+            request.path = base == "." && utils::startsWith(file, "./") ? file.substr(2) : file;
+            requests.push_back(request);
+        }
+    };
+
+    // Whitespace or comma separated; "src/a.cpp:10-40" reads lines 10 to 40,
+    // "src/a.cpp:10" from line 10 on
+    std::replace(paths.begin(), paths.end(), ',', ' ');
+    std::string entry;
+    std::istringstream entries(paths);
+    while (entries >> entry) {
+        FileRequest request;
+        request.path = entry;
+        size_t colon = entry.rfind(':');
+        if (colon != std::string::npos && colon + 1 < entry.size() && entry[colon + 1] >= '0' && entry[colon + 1] <= '9' &&
+            entry.find_first_not_of("0123456789-", colon + 1) == std::string::npos) {
+            request.path = entry.substr(0, colon);
+            request.first = std::max(1L, std::atol(entry.c_str() + colon + 1));
+            size_t dash = entry.find('-', colon);
+            if (dash != std::string::npos && dash + 1 < entry.size()) {
+                long last = std::atol(entry.c_str() + dash + 1);
+                request.count = last >= static_cast<long>(request.first) ? last - request.first + 1 : 1;
+            }
+        }
+        if (request.path.find_first_of("*?[") != std::string::npos) {
+            addGlob(request.path, ".", request);
+        } else {
+            requests.push_back(request);
+        }
+    }
+    if (!pattern.empty()) {
+        addGlob(pattern, root, FileRequest());
+    }
+    if (requests.size() > max_files) {
+        requests.resize(max_files);
+        limited = true;
+    }
+
+    utils::terminal::printInfo("[Tool: ReadMany]");
+
+    if (requests.empty()) {
+        result.success = true;
+        result.exit_code = 1;
+        result.output = "No files matched\n";
+        utils::terminal::printWarning("No files matched");
+        return result;
+    }
+
+    // Open and index every file concurrently; only ranges are located here
+    struct FileSlice {
+        std::unique_ptr<MappedFile> file;
+        std::string error;
+        std::string binary;     // Summary shown instead of the contents
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    std::vector<FileSlice> slices(requests.size());
+    {
+        ThreadPool pool(std::min(requests.size(), READ_MANY_THREADS));
+        for (size_t i = 0; i < requests.size(); i++) {
+            pool.submit([&, i]() {
+                const FileRequest& request = requests[i];
+                FileSlice& slice = slices[i];
+                slice.file.reset(new MappedFile());
+                FileStamp stamp;
+                if (!openFile(request.path, *slice.file, slice.error, &stamp)) return;
+                file_cache_->noteSeen(request.path, stamp);
+
+                MappedFile& file = *slice.file;
+                if (file.size() > 0 && file.isBinary()) {
+                    std::string type = file.binaryType();
+                    slice.binary = "[Binary file" + (type.empty() ? "" : ": " + type) + ", " +
+                                   utils::formatSize(file.size()) + ". Contents not shown.]";
+                    return;
+                }
+                slice.begin = file.lineOffset(request.first);
+                if (slice.begin >= file.size() && request.first > 1) {
+                    slice.error = "Line " + std::to_string(request.first) + " is past the end of the file (" +
+                                  std::to_string(file.indexedLines()) + " lines)";
+                    return;
+                }
+                slice.end = request.count > 0 ? file.lineOffset(request.first + request.count) : file.size();
+            });
+        }
+        pool.wait();
+    }
+
+    // Split the budget: files smaller than an even share get all they need,
+    // the rest share what is left equally
+    std::vector<size_t> order;
+    for (size_t i = 0; i < slices.size(); i++) {
+        if (slices[i].error.empty() && slices[i].binary.empty()) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return slices[a].end - slices[a].begin < slices[b].end - slices[b].begin;
+    });
+    std::vector<size_t> caps(slices.size(), 0);
+    size_t remaining = budget;
+    for (size_t n = 0; n < order.size(); n++) {
+        const FileSlice& slice = slices[order[n]];
+        size_t share = remaining / (order.size() - n);
+        caps[order[n]] = std::min(slice.end - slice.begin, share);
+        remaining -= caps[order[n]];
+    }
+
+    size_t shown_bytes = 0, failed = 0;
+    std::ostringstream output;
+    for (size_t i = 0; i < slices.size(); i++) {
+        const FileRequest& request = requests[i];
+        FileSlice& slice = slices[i];
+        output << "=== " << request.path << " ===\n";
+
+        if (!slice.error.empty()) {
+            failed++;
+            output << "[Error: " << slice.error << "]\n\n";
+            utils::terminal::out() << utils::terminal::RED << "  " << request.path << ": " << slice.error
+                                   << utils::terminal::RESET << "\n";
+            continue;
+        }
+        if (!slice.binary.empty()) {
+            output << slice.binary << "\n\n";
+            utils::terminal::out() << "  " << request.path << ": binary\n";
+            continue;
+        }
+
+        MappedFile& file = *slice.file;
+        size_t begin = slice.begin;
+        size_t end = slice.end;
+        bool cut_mid_line = false;
+        if (end - begin > caps[i]) {
+            end = begin + caps[i];
+            const char* newline = nullptr;
+            for (const char* p = file.data() + end; p > file.data() + begin; p--) {
+                if (p[-1] == '\n') { newline = p; break; }
+            }
+            if (newline) {
+                end = newline - file.data();
+            } else {
+                cut_mid_line = caps[i] > 0;
+            }
+        }
+
+        std::string text(file.data() + begin, end - begin);
+        shown_bytes += text.size();
+        size_t lines = countLines(text);
+        size_t last = request.first + lines - 1;
+
+        std::string note;
+        if (file.size() == 0) {
+            note = "[Empty file]";
+        } else if (end == begin && !cut_mid_line) {
+            note = "[Not shown: the size budget ran out. Read this file separately.]";
+        } else if (begin > 0 || end < file.size()) {
+            std::string total = end == file.size() && file.fullyIndexed()
+                ? std::to_string(file.indexedLines())
+                : "a " + utils::formatSize(file.size()) + " file";
+            note = "[Lines " + std::to_string(request.first) + "-" + std::to_string(last) + " of " + total + ".";
+            if (cut_mid_line) {
+                note += " Truncated inside line " + std::to_string(request.first) +
+                        "; Read it with byte_offset=" + std::to_string(end) + " to continue.";
+            } else if (end < slice.end) {
+                note += " Truncated to fit the size budget; Read it with offset=" + std::to_string(last + 1) +
+                        " to continue.";
+            }
+            note += "]";
+        }
 
-    std::cout << "=== File Contents ===\n" << result.output << "\n====================\n\n";
+        output << text;
+        if (!text.empty() && text.back() != '\n') output << "\n";
+        if (!note.empty()) output << note << "\n";
+        output << "\n";
+
+        utils::terminal::out() << "  " << request.path << ": " << lines << " lines, "
+                               << utils::formatSize(text.size())
+                               << (end < slice.end ? " (truncated)" : "") << "\n";
+    }
 
+    output << "[" << requests.size() << (requests.size() == 1 ? " file, " : " files, ")
+           << utils::formatSize(shown_bytes) << " shown";
+    if (failed > 0) output << ", " << failed << " could not be read";
+    output << "]\n";
+    if (limited) {
+        output << "[Only the first " << max_files << " files were read; narrow the pattern or raise max_files]\n";
+    }
+    utils::terminal::out() << "\n";
+
+    result.output = output.str();
+    result.success = true;
+    result.exit_code = failed == requests.size() ? 1 : 0;
     return result;
 }
 
@@ -345,7 +1121,7 @@ ToolResult ToolExecutor::executeWrite(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Write]");
-    std::cout << utils::terminal::CYAN << "File: " << file_path << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "File: " << file_path << utils::terminal::RESET << "\n\n";
 
     // Create parent directory if needed
     std::string dir = utils::getDirname(file_path);
@@ -381,35 +1157,36 @@ ToolResult ToolExecutor::executeWrite(const ToolCall& tool_call) {
 
     // Show what will happen
     if (isNewFile) {
-        std::cout << utils::terminal::GREEN << "Creating new file with "
+        utils::terminal::out() << utils::terminal::GREEN << "Creating new file with "
                   << newLineCount << " lines" << utils::terminal::RESET << "\n\n";
     } else {
         int linesDiff = newLineCount - oldLineCount;
-        std::cout << utils::terminal::CYAN << "Overwriting file:"
+        utils::terminal::out() << utils::terminal::CYAN << "Overwriting file:"
                   << utils::terminal::RESET << "\n";
-        std::cout << utils::terminal::RED << "  Old: " << oldLineCount << " lines"
+        utils::terminal::out() << utils::terminal::RED << "  Old: " << oldLineCount << " lines"
                   << utils::terminal::RESET << "\n";
-        std::cout << utils::terminal::GREEN << "  New: " << newLineCount << " lines"
+        utils::terminal::out() << utils::terminal::GREEN << "  New: " << newLineCount << " lines"
                   << utils::terminal::RESET << "\n";
         if (linesDiff > 0) {
-            std::cout << utils::terminal::GREEN << "  Net: +" << linesDiff << " lines"
+            utils::terminal::out() << utils::terminal::GREEN << "  Net: +" << linesDiff << " lines"
                       << utils::terminal::RESET << "\n\n";
         } else if (linesDiff < 0) {
-            std::cout << utils::terminal::RED << "  Net: " << linesDiff << " lines"
+            utils::terminal::out() << utils::terminal::RED << "  Net: " << linesDiff << " lines"
                       << utils::terminal::RESET << "\n\n";
         } else {
-            std::cout << utils::terminal::YELLOW << "  Net: 0 lines (same size)"
+            utils::terminal::out() << utils::terminal::YELLOW << "  Net: 0 lines (same size)"
                       << utils::terminal::RESET << "\n\n";
         }
     }
 
     // Write file
-    if (!utils::writeFile(file_path, content)) {
+    if (!utils::writeFileAtomic(file_path, content, config_.getFsyncWrites())) {
         result.success = false;
-        result.error = "Failed to write file";
+        result.error = "Failed to write file: " + std::string(strerror(errno));
         utils::terminal::printError(result.error);
         return result;
     }
+    backupBeforeWrite(file_path, "Write", !isNewFile, oldContent, content);
 
     result.success = true;
     result.exit_code = 0;
@@ -417,7 +1194,7 @@ ToolResult ToolExecutor::executeWrite(const ToolCall& tool_call) {
     if (isNewFile) {
         result.output = "Created new file with " + std::to_string(newLineCount) + " lines";
         utils::terminal::printSuccess("File created");
-        std::cout << utils::terminal::GREEN << "  +" << newLineCount << " lines"
+        utils::terminal::out() << utils::terminal::GREEN << "  +" << newLineCount << " lines"
                   << utils::terminal::RESET << "\n\n";
     } else {
         int linesDiff = newLineCount - oldLineCount;
@@ -431,7 +1208,7 @@ ToolResult ToolExecutor::executeWrite(const ToolCall& tool_call) {
         output_msg << " lines)";
         result.output = output_msg.str();
         utils::terminal::printSuccess("File written");
-        std::cout << utils::terminal::CYAN << "  " << newLineCount << " lines total"
+        utils::terminal::out() << utils::terminal::CYAN << "  " << newLineCount << " lines total"
                   << utils::terminal::RESET << "\n\n";
     }
 
@@ -484,7 +1261,7 @@ ToolResult ToolExecutor::executeEdit(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Edit]");
-    std::cout << utils::terminal::CYAN << "File: " << file_path << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "File: " << file_path << utils::terminal::RESET << "\n\n";
 
     if (!utils::fileExists(file_path)) {
         result.success = false;
@@ -493,65 +1270,69 @@ ToolResult ToolExecutor::executeEdit(const ToolCall& tool_call) {
         return result;
     }
 
-    // Read file
-    std::string content = utils::readFile(file_path);
-    if (content.empty()) {
+    MappedFile file;
+    std::string error;
+    FileStamp stamp, seen;
+    if (!openFile(file_path, file, error, &stamp)) {
         result.success = false;
-        result.error = "Failed to read file";
+        result.error = error;
         utils::terminal::printError(result.error);
         return result;
     }
+    std::string_view content(file.data(), file.size());
 
-    // Check if old_string exists
-    size_t match_pos = content.find(old_string);
-    if (match_pos == std::string::npos) {
+    // Something other than our tools changed the file since the model read it
+    bool changed_since_read = file_cache_->lastSeen(file_path, seen) && seen != stamp;
+
+    // Find every occurrence in one pass; memmem is linear
+    std::vector<size_t> matches;
+    for (size_t pos = 0; pos + old_string.size() <= content.size(); ) {
+        const void* hit = memmem(content.data() + pos, content.size() - pos, old_string.data(), old_string.size());
+        if (!hit) break;
+        size_t offset = static_cast<const char*>(hit) - content.data();
+        matches.push_back(offset);
+        pos = offset + old_string.size();
+    }
+
+    if (matches.empty()) {
         result.success = false;
         result.error = "String not found in file";
+        if (changed_since_read) {
+            result.error += "; the file changed on disk since you last read it, Read it again";
+        }
         utils::terminal::printError(result.error);
         return result;
     }
 
-    // Count occurrences
-    size_t count = 0;
-    size_t pos = 0;
-    while ((pos = content.find(old_string, pos)) != std::string::npos) {
-        count++;
-        pos += old_string.length();
-    }
-
-    // Calculate line counts for diff display
-    int old_lines = countLines(old_string);
-    int new_lines = countLines(new_string);
-    int lines_removed = old_lines;
-    int lines_added = new_lines;
-
-    // Show diff-style output
-    std::cout << utils::terminal::CYAN << "Changes (" << count << " occurrence(s)):"
-              << utils::terminal::RESET << "\n\n";
-
-    // Show removed lines (red)
-    std::cout << utils::terminal::RED << "--- Removed:" << utils::terminal::RESET << "\n";
-    auto oldLines = splitLines(old_string);
-    for (const auto& line : oldLines) {
-        std::cout << utils::terminal::RED << "- " << line << utils::terminal::RESET << "\n";
+    auto all_it = tool_call.parameters.find("replace_all");
+    bool replace_all = all_it != tool_call.parameters.end() && (all_it->second == "true" || all_it->second == "1");
+    if (matches.size() > 1 && !replace_all) {
+        result.success = false;
+        result.error = "old_string occurs " + std::to_string(matches.size()) +
+                       " times; include more surrounding lines to make it unique, or set replace_all=true";
+        utils::terminal::printError(result.error);
+        return result;
     }
 
-    std::cout << "\n";
-
-    // Show added lines (green)
-    std::cout << utils::terminal::GREEN << "+++ Added:" << utils::terminal::RESET << "\n";
-    auto newLines = splitLines(new_string);
-    for (const auto& line : newLines) {
-        std::cout << utils::terminal::GREEN << "+ " << line << utils::terminal::RESET << "\n";
+    std::string updated;
+    updated.reserve(content.size() + matches.size() * new_string.size() - matches.size() * old_string.size());
+    size_t copied = 0;
+    for (size_t offset : matches) {
+        updated.append(content.data() + copied, offset - copied);
+        updated += new_string;
+        copied = offset + old_string.size();
     }
+    updated.append(content.data() + copied, content.size() - copied);
 
-    std::cout << "\n";
+    DiffResult diff = LineDiff::compute(content, updated);
 
-    // Show summary
-    std::cout << utils::terminal::YELLOW << "Summary: "
-              << utils::terminal::RED << "-" << lines_removed << " lines"
+    utils::terminal::out() << utils::terminal::CYAN << "Changes (" << matches.size() << " occurrence(s)):"
+              << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << LineDiff::unified(diff, "a/" + file_path, "b/" + file_path, true, 200) << "\n";
+    utils::terminal::out() << utils::terminal::YELLOW << "Summary: "
+              << utils::terminal::RED << "-" << diff.removed << " lines"
               << utils::terminal::RESET << " / "
-              << utils::terminal::GREEN << "+" << lines_added << " lines"
+              << utils::terminal::GREEN << "+" << diff.added << " lines"
               << utils::terminal::RESET << "\n\n";
 
     // Confirm
@@ -562,49 +1343,155 @@ ToolResult ToolExecutor::executeEdit(const ToolCall& tool_call) {
         return result;
     }
 
-    // Create backup
-    std::string backup_path = file_path + ".bak";
-    utils::writeFile(backup_path, content);
-
-    // Perform replacement
-    pos = 0;
-    while ((pos = content.find(old_string, pos)) != std::string::npos) {
-        content.replace(pos, old_string.length(), new_string);
-        pos += new_string.length();
-    }
-
-    // Write modified content
-    if (!utils::writeFile(file_path, content)) {
+    std::string previous(content);
+    if (!utils::writeFileAtomic(file_path, updated, config_.getFsyncWrites())) {
         result.success = false;
-        result.error = "Failed to write file";
+        result.error = "Failed to write file: " + std::string(strerror(errno));
         utils::terminal::printError(result.error);
         return result;
     }
+    backupBeforeWrite(file_path, "Edit", true, previous, updated);
 
     result.success = true;
     result.exit_code = 0;
 
     std::ostringstream output_msg;
-    output_msg << "File edited successfully ("
-               << utils::terminal::RED << "-" << lines_removed
-               << utils::terminal::RESET << "/"
-               << utils::terminal::GREEN << "+" << lines_added
-               << utils::terminal::RESET << " lines)";
+    output_msg << "File edited successfully (" << matches.size() << " replacement(s), -"
+               << diff.removed << "/+" << diff.added << " lines)\n"
+               << LineDiff::unified(diff, "a/" + file_path, "b/" + file_path, false, 60);
+    if (changed_since_read) {
+        output_msg << "[Note: the file had changed on disk since you last read it]\n";
+    }
     result.output = output_msg.str();
 
     utils::terminal::printSuccess("Edit complete");
-    std::cout << utils::terminal::CYAN << "  " << count << " replacement(s) made"
+    utils::terminal::out() << utils::terminal::CYAN << "  " << matches.size() << " replacement(s) made"
               << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::RED << "  -" << lines_removed << " lines removed"
+    utils::terminal::out() << utils::terminal::RED << "  -" << diff.removed << " lines removed"
               << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::GREEN << "  +" << lines_added << " lines added"
-              << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "  Backup: " << backup_path
+    utils::terminal::out() << utils::terminal::GREEN << "  +" << diff.added << " lines added"
               << utils::terminal::RESET << "\n\n";
 
     return result;
 }
 
+ToolResult ToolExecutor::executeApplyPatch(const ToolCall& tool_call) {
+    ToolResult result;
+
+    std::string patch_text;
+    for (const auto& alias : {"patch", "diff", "content"}) {
+        auto it = tool_call.parameters.find(alias);
+        if (it != tool_call.parameters.end() && !it->second.empty()) {
+            patch_text = it->second;
+            break;
+        }
+    }
+    if (patch_text.empty()) {
+        result.success = false;
+        result.error = "Missing 'patch' parameter";
+        return result;
+    }
+
+    auto check_it = tool_call.parameters.find("check");
+    bool check_only = check_it != tool_call.parameters.end() && (check_it->second == "true" || check_it->second == "1");
+
+    utils::terminal::printInfo("[Tool: ApplyPatch]");
+
+    std::vector<FilePatch> patches;
+    std::string error;
+    if (!PatchApplier::parse(patch_text, patches, error)) {
+        result.success = false;
+        result.exit_code = 1;
+        result.error = error;
+        utils::terminal::printError(error);
+        return result;
+    }
+
+    // Locate every hunk before touching any file
+    PatchCheck check = PatchApplier::check(patches);
+    std::string report = PatchApplier::report(check);
+
+    for (const auto& file : check.files) {
+        if (!file.ok) continue;
+        DiffResult diff = LineDiff::compute(file.original, file.remove ? "" : file.content);
+        utils::terminal::out() << LineDiff::unified(diff, file.existed ? "a/" + file.old_path : "/dev/null",
+                                                    file.remove ? "/dev/null" : "b/" + file.path, true, 200) << "\n";
+    }
+    utils::terminal::out() << report << "\n";
+
+    if (!check.ok) {
+        result.success = false;
+        result.exit_code = 1;
+        result.error = "Patch not applied; no files were changed";
+        result.output = report;
+        utils::terminal::printError(result.error);
+        return result;
+    }
+
+    if (check_only) {
+        result.success = true;
+        result.exit_code = 0;
+        result.output = "Patch applies cleanly (nothing written):\n" + report;
+        return result;
+    }
+
+    if (!requestConfirmation("ApplyPatch", "Apply patch to " + std::to_string(check.files.size()) + " file(s)?")) {
+        result.success = false;
+        result.error = "Cancelled by user";
+        utils::terminal::printError("Cancelled");
+        return result;
+    }
+
+    // Write everything; on a failure put back what was already written
+    size_t done = 0;
+    for (; done < check.files.size(); done++) {
+        const auto& file = check.files[done];
+        bool ok;
+        if (file.remove) {
+            ok = unlink(file.old_path.c_str()) == 0;
+        } else {
+            std::string dir = utils::getDirname(file.path);
+            if (!utils::dirExists(dir)) utils::createDir(dir);
+            ok = utils::writeFileAtomic(file.path, file.content, config_.getFsyncWrites());
+            if (ok && file.path != file.old_path && file.existed) {
+                ok = unlink(file.old_path.c_str()) == 0;
+            }
+        }
+        if (!ok) {
+            error = file.path + ": " + strerror(errno);
+            break;
+        }
+    }
+
+    if (done < check.files.size()) {
+        for (size_t i = 0; i <= done; i++) {
+            const auto& file = check.files[i];
+            if (file.existed) utils::writeFileAtomic(file.old_path, file.original);
+            if (!file.remove && (file.path != file.old_path || !file.existed)) unlink(file.path.c_str());
+        }
+        result.success = false;
+        result.exit_code = 1;
+        result.error = "Failed to write " + error + "; changes were rolled back";
+        utils::terminal::printError(result.error);
+        return result;
+    }
+
+    for (const auto& file : check.files) {
+        if (file.path != file.old_path && file.existed) {
+            backupBeforeWrite(file.old_path, "ApplyPatch", true, file.original, "");
+            backupBeforeWrite(file.path, "ApplyPatch", false, "", file.content);
+        } else {
+            backupBeforeWrite(file.path, "ApplyPatch", file.existed, file.original, file.remove ? "" : file.content);
+        }
+    }
+
+    result.success = true;
+    result.exit_code = 0;
+    result.output = "Patch applied to " + std::to_string(check.files.size()) + " file(s):\n" + report;
+    utils::terminal::printSuccess("Patch applied to " + std::to_string(check.files.size()) + " file(s)");
+    return result;
+}
+
 ToolResult ToolExecutor::executeGlob(const ToolCall& tool_call) {
     ToolResult result;
 
@@ -623,16 +1510,33 @@ ToolResult ToolExecutor::executeGlob(const ToolCall& tool_call) {
         path = path_it->second;
     }
 
+    size_t max_results = 100;
+    auto max_it = tool_call.parameters.find("max_results");
+    if (max_it != tool_call.parameters.end() && std::atoi(max_it->second.c_str()) > 0) {
+        max_results = static_cast<size_t>(std::atoi(max_it->second.c_str()));
+    }
+
+    WalkOptions options;
+    auto hidden_it = tool_call.parameters.find("hidden");
+    options.include_hidden = hidden_it != tool_call.parameters.end() &&
+                             (hidden_it->second == "true" || hidden_it->second == "1");
+
     utils::terminal::printInfo("[Tool: Glob]");
-    std::cout << utils::terminal::CYAN << "Pattern: " << pattern << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Pattern: " << pattern << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n\n";
 
-    // Use find command
-    std::string command = "find " + path + " -name '" + pattern + "' -type f 2>/dev/null | head -100";
-    result.output = executeCommand(command, result.exit_code);
+    bool limited = false;
+    std::vector<std::string> files = globFiles(pattern, path, options, max_results, limited);
+    for (const auto& file : files) {
+        result.output += file + "\n";
+    }
+    if (limited) {
+        result.output += "[Results limited to " + std::to_string(max_results) + "]\n";
+    }
+    result.exit_code = files.empty() ? 1 : 0;
     result.success = true;
 
-    std::cout << "=== Matching Files ===\n" << result.output << "=====================\n\n";
+    utils::terminal::out() << "=== Matching Files ===\n" << result.output << "=====================\n\n";
 
     return result;
 }
@@ -661,35 +1565,58 @@ ToolResult ToolExecutor::executeGrep(const ToolCall& tool_call) {
         output_mode = mode_it->second;
     }
 
+    GrepOptions options;
+    options.pattern = pattern;
+    options.path = path;
+    options.output_mode = output_mode;
+    options.cache = file_cache_.get();
+
+    auto param = [&](const std::string& name) -> std::string {
+        auto it = tool_call.parameters.find(name);
+        return it != tool_call.parameters.end() ? it->second : "";
+    };
+    auto isTrue = [](const std::string& value) { return value == "true" || value == "1" || value == "yes"; };
+
+    options.ignore_case = isTrue(param("ignore_case")) || isTrue(param("-i"));
+    options.fixed_strings = isTrue(param("fixed_strings"));
+    options.include_hidden = isTrue(param("hidden"));
+    options.glob = param("glob");
+    if (!param("context").empty()) {
+        options.before_context = options.after_context = std::atoi(param("context").c_str());
+    }
+    if (!param("before_context").empty()) options.before_context = std::atoi(param("before_context").c_str());
+    if (!param("after_context").empty()) options.after_context = std::atoi(param("after_context").c_str());
+    if (!param("max_results").empty()) {
+        int max_results = std::atoi(param("max_results").c_str());
+        if (max_results > 0) options.max_results = static_cast<size_t>(max_results);
+    }
+
     utils::terminal::printInfo("[Tool: Grep]");
-    std::cout << utils::terminal::CYAN << "Pattern: " << pattern << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Mode: " << output_mode << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Pattern: " << pattern << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Mode: " << output_mode << utils::terminal::RESET << "\n\n";
 
-    // Build grep command - prefer ripgrep (rg) if available
-    std::string command;
-    bool use_rg = utils::commandExists("rg");
+    GrepEngine engine(options);
+    GrepResult search = engine.search();
 
-    if (use_rg) {
-        std::cout << utils::terminal::CYAN << "Using: ripgrep (rg)" << utils::terminal::RESET << "\n";
-        if (output_mode == "content") {
-            command = "rg -n '" + pattern + "' " + path + " 2>/dev/null | head -100";
-        } else {
-            command = "rg -l '" + pattern + "' " + path + " 2>/dev/null | head -100";
-        }
-    } else {
-        std::cout << utils::terminal::CYAN << "Using: grep" << utils::terminal::RESET << "\n";
-        if (output_mode == "content") {
-            command = "grep -r -n '" + pattern + "' " + path + " 2>/dev/null | head -100";
-        } else {
-            command = "grep -r -l '" + pattern + "' " + path + " 2>/dev/null | head -100";
-        }
+    if (!search.success) {
+        result.success = false;
+        result.exit_code = 2;
+        result.error = search.error;
+        utils::terminal::printError(result.error);
+        return result;
     }
 
-    result.output = executeCommand(command, result.exit_code);
+    result.output = GrepEngine::format(search, output_mode);
+    if (search.truncated) {
+        result.output += "[Results limited to " + std::to_string(options.max_results) + "]\n";
+    }
+    result.exit_code = search.files.empty() ? 1 : 0;
     result.success = true;
 
-    std::cout << "=== Search Results ===\n" << result.output << "=====================\n\n";
+    utils::terminal::out() << "=== Search Results ===\n" << result.output << "=====================\n";
+    utils::terminal::out() << utils::terminal::CYAN << search.files.size() << " file(s) matched, "
+                           << search.files_searched << " searched" << utils::terminal::RESET << "\n\n";
 
     return result;
 }
@@ -729,7 +1656,7 @@ ToolResult ToolExecutor::executeMCPTool(const ToolCall& tool_call) {
         }
     }
 
-    std::cout << utils::terminal::CYAN << "Arguments: " << arguments.dump(2) << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Arguments: " << arguments.dump(2) << utils::terminal::RESET << "\n\n";
 
     // Confirm execution
     if (!requestConfirmation("MCP:" + tool_name, "Execute MCP tool?")) {
@@ -754,7 +1681,7 @@ ToolResult ToolExecutor::executeMCPTool(const ToolCall& tool_call) {
         utils::terminal::printError("MCP tool failed: " + result.error);
     }
 
-    std::cout << "\n=== MCP Output ===\n" << result.output << "\n==================\n\n";
+    utils::terminal::out() << "\n=== MCP Output ===\n" << result.output << "\n==================\n\n";
 
     return result;
 }
@@ -791,8 +1718,8 @@ ToolResult ToolExecutor::executeWebSearch(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: WebSearch]");
-    std::cout << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Max results: " << max_results << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Max results: " << max_results << utils::terminal::RESET << "\n\n";
 
     // Confirmation
     if (!requestConfirmation("WebSearch", "Search the web?")) {
@@ -824,7 +1751,7 @@ ToolResult ToolExecutor::executeWebSearch(const ToolCall& tool_call) {
     result.exit_code = 0;
 
     utils::terminal::printSuccess("Search complete");
-    std::cout << "\n=== Results ===\n" << result.output << "===============\n\n";
+    utils::terminal::out() << "\n=== Results ===\n" << result.output << "===============\n\n";
 
     return result;
 }
@@ -855,7 +1782,7 @@ ToolResult ToolExecutor::executeWebFetch(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: WebFetch]");
-    std::cout << utils::terminal::CYAN << "URL: " << url << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "URL: " << url << utils::terminal::RESET << "\n\n";
 
     // Confirmation
     if (!requestConfirmation("WebFetch", "Fetch web page?")) {
@@ -891,14 +1818,14 @@ ToolResult ToolExecutor::executeWebFetch(const ToolCall& tool_call) {
     result.exit_code = 0;
 
     utils::terminal::printSuccess("Fetch complete");
-    std::cout << "\n=== Content ===\n";
+    utils::terminal::out() << "\n=== Content ===\n";
     // Truncate output for display
     if (page.content.length() > 2000) {
-        std::cout << page.content.substr(0, 2000) << "\n...(truncated)\n";
+        utils::terminal::out() << page.content.substr(0, 2000) << "\n...(truncated)\n";
     } else {
-        std::cout << page.content << "\n";
+        utils::terminal::out() << page.content << "\n";
     }
-    std::cout << "===============\n\n";
+    utils::terminal::out() << "===============\n\n";
 
     return result;
 }
@@ -930,8 +1857,8 @@ ToolResult ToolExecutor::executeDBConnect(const ToolCall& tool_call) {
     std::string connection = conn_it->second;
 
     utils::terminal::printInfo("[Tool: DBConnect]");
-    std::cout << utils::terminal::CYAN << "Type: " << db_type << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Connection: " << connection << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Type: " << db_type << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Connection: " << connection << utils::terminal::RESET << "\n\n";
 
     // Confirmation
     if (!requestConfirmation("DBConnect", "Connect to database?")) {
@@ -983,7 +1910,7 @@ ToolResult ToolExecutor::executeDBQuery(const ToolCall& tool_call) {
     std::string query = query_it->second;
 
     utils::terminal::printInfo("[Tool: DBQuery]");
-    std::cout << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n\n";
 
     // Confirmation
     if (!requestConfirmation("DBQuery", "Execute query?")) {
@@ -1041,7 +1968,7 @@ ToolResult ToolExecutor::executeDBQuery(const ToolCall& tool_call) {
     result.exit_code = 0;
 
     utils::terminal::printSuccess("Query complete");
-    std::cout << "\n=== Results ===\n" << result.output << "===============\n\n";
+    utils::terminal::out() << "\n=== Results ===\n" << result.output << "===============\n\n";
 
     return result;
 }
@@ -1081,8 +2008,8 @@ ToolResult ToolExecutor::executeDBExecute(const ToolCall& tool_call) {
     std::string query = query_it->second;
 
     utils::terminal::printInfo("[Tool: DBExecute]");
-    std::cout << utils::terminal::YELLOW << "WARNING: This will modify the database!" << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::YELLOW << "WARNING: This will modify the database!" << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n\n";
 
     // Always require confirmation for write operations
     if (!requestConfirmation("DBExecute", "Execute WRITE query?")) {
@@ -1136,7 +2063,7 @@ ToolResult ToolExecutor::executeDBSchema(const ToolCall& tool_call) {
 
     utils::terminal::printInfo("[Tool: DBSchema]");
     if (!table.empty()) {
-        std::cout << utils::terminal::CYAN << "Table: " << table << utils::terminal::RESET << "\n\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Table: " << table << utils::terminal::RESET << "\n\n";
     }
 
     auto tables = db_client_->getSchema();
@@ -1171,7 +2098,7 @@ ToolResult ToolExecutor::executeDBSchema(const ToolCall& tool_call) {
     result.exit_code = 0;
 
     utils::terminal::printSuccess("Schema retrieved");
-    std::cout << "\n=== Schema ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Schema ===\n" << result.output << "==============\n\n";
 
     return result;
 }
@@ -1219,11 +2146,11 @@ ToolResult ToolExecutor::executeLearn(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Learn]");
-    std::cout << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
     if (!pattern.empty() && pattern != "*") {
-        std::cout << utils::terminal::CYAN << "Pattern: " << pattern << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Pattern: " << pattern << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     // Confirmation
     if (!requestConfirmation("Learn", "Index content into vector database?")) {
@@ -1269,7 +2196,7 @@ ToolResult ToolExecutor::executeLearn(const ToolCall& tool_call) {
     result.exit_code = 0;
 
     utils::terminal::printSuccess("Learning complete");
-    std::cout << "\n" << result.output << "\n";
+    utils::terminal::out() << "\n" << result.output << "\n";
 
     return result;
 }
@@ -1309,8 +2236,8 @@ ToolResult ToolExecutor::executeRemember(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Remember]");
-    std::cout << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Max results: " << max_results << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Query: " << query << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Max results: " << max_results << utils::terminal::RESET << "\n\n";
 
     utils::terminal::printInfo("Searching memory...");
 
@@ -1329,7 +2256,7 @@ ToolResult ToolExecutor::executeRemember(const ToolCall& tool_call) {
     result.exit_code = 0;
 
     utils::terminal::printSuccess("Found " + std::to_string(context.results.size()) + " relevant chunks");
-    std::cout << "\n" << result.output << "\n";
+    utils::terminal::out() << "\n" << result.output << "\n";
 
     return result;
 }
@@ -1361,7 +2288,7 @@ ToolResult ToolExecutor::executeForget(const ToolCall& tool_call) {
     std::string source = source_it->second;
 
     utils::terminal::printInfo("[Tool: Forget]");
-    std::cout << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n\n";
 
     // Confirmation
     if (!requestConfirmation("Forget", "Remove content from vector database?")) {
@@ -1401,6 +2328,15 @@ ToolResult ToolExecutor::executeForget(const ToolCall& tool_call) {
 // Network Tools Implementation
 // ============================================================================
 
+// "timeout" is in seconds and may be fractional; capped at 30s
+static int probeTimeoutMs(const ToolCall& tool_call, int default_ms) {
+    auto it = tool_call.parameters.find("timeout");
+    if (it == tool_call.parameters.end()) return default_ms;
+    double seconds = std::atof(it->second.c_str());
+    if (seconds <= 0) return default_ms;
+    return static_cast<int>(std::min(seconds, 30.0) * 1000);
+}
+
 ToolResult ToolExecutor::executePing(const ToolCall& tool_call) {
     ToolResult result;
 
@@ -1413,6 +2349,7 @@ ToolResult ToolExecutor::executePing(const ToolCall& tool_call) {
 
     std::string host = host_it->second;
     int count = 4;
+    int timeout_ms = NET_PROBE_TIMEOUT_MS;
 
     auto count_it = tool_call.parameters.find("count");
     if (count_it != tool_call.parameters.end()) {
@@ -1421,11 +2358,19 @@ ToolResult ToolExecutor::executePing(const ToolCall& tool_call) {
             if (count > 20) count = 20;  // Limit max pings
         } catch (...) {}
     }
+    timeout_ms = probeTimeoutMs(tool_call, timeout_ms);
+
+    std::vector<std::string> hosts;
+    if (!NetProbe::parseTargets(host, hosts, result.error)) {
+        result.success = false;
+        return result;
+    }
 
     utils::terminal::printInfo("[Tool: Ping]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Count: " << count << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Host: " << host;
+    if (hosts.size() > 1) utils::terminal::out() << " (" << hosts.size() << " hosts)";
+    utils::terminal::out() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Count: " << count << utils::terminal::RESET << "\n\n";
 
     if (!requestConfirmation("Ping", "Ping " + host + "?")) {
         result.success = false;
@@ -1435,17 +2380,21 @@ ToolResult ToolExecutor::executePing(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Pinging...");
-    std::string command = "ping -c " + std::to_string(count) + " " + host;
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
+    std::vector<PingResult> replies = NetProbe::ping(NetProbe::resolve(hosts), count, timeout_ms);
+    size_t up = std::count_if(replies.begin(), replies.end(), [](const PingResult& r) { return r.received > 0; });
+
+    result.output = NetProbe::formatPing(replies);
+    result.success = up > 0;
+    result.exit_code = up == replies.size() ? 0 : 1;
 
     if (result.success) {
         utils::terminal::printSuccess("Ping complete");
     } else {
+        result.error = replies.size() == 1 ? "Host did not reply" : "No host replied";
         utils::terminal::printError("Ping failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1471,9 +2420,9 @@ ToolResult ToolExecutor::executeTraceroute(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Traceroute]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Max hops: " << max_hops << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Max hops: " << max_hops << utils::terminal::RESET << "\n\n";
 
     if (!requestConfirmation("Traceroute", "Trace route to " + host + "?")) {
         result.success = false;
@@ -1483,21 +2432,38 @@ ToolResult ToolExecutor::executeTraceroute(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Tracing route...");
-    std::string command;
-    if (utils::isLinux() && utils::commandExists("tracepath")) {
-        // tracepath doesn't require root on Linux
-        command = "tracepath -m " + std::to_string(max_hops) + " " + host;
+    std::vector<NetTarget> targets = NetProbe::resolve({host});
+    if (!targets[0].error.empty()) {
+        result.success = false;
+        result.error = host + ": " + targets[0].error;
+        utils::terminal::printError(result.error);
+        return result;
+    }
+
+    if (NetProbe::tracerouteSupported(targets[0])) {
+        // All hops are probed at once instead of one TTL after another
+        TraceResult trace = NetProbe::traceroute(targets[0], max_hops, 3, probeTimeoutMs(tool_call, NET_PROBE_TIMEOUT_MS));
+        result.output = NetProbe::formatTrace(trace);
+        result.success = trace.error.empty();
+        result.exit_code = trace.reached ? 0 : 1;
+        if (!result.success) result.error = trace.error;
     } else {
-        // Ensure traceroute is available
-        if (!ensureToolAvailable("traceroute")) {
-            result.success = false;
-            result.error = "traceroute is not available";
-            return result;
+        std::string command;
+        if (utils::isLinux() && utils::commandExists("tracepath")) {
+            // tracepath doesn't require root on Linux
+            command = "tracepath -m " + std::to_string(max_hops) + " " + host;
+        } else {
+            // Ensure traceroute is available
+            if (!ensureToolAvailable("traceroute")) {
+                result.success = false;
+                result.error = "traceroute is not available";
+                return result;
+            }
+            command = "traceroute -m " + std::to_string(max_hops) + " " + host;
         }
-        command = "traceroute -m " + std::to_string(max_hops) + " " + host;
+        result.output = executeCommand(command, result.exit_code);
+        result.success = (result.exit_code == 0);
     }
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
 
     if (result.success) {
         utils::terminal::printSuccess("Traceroute complete");
@@ -1505,7 +2471,7 @@ ToolResult ToolExecutor::executeTraceroute(const ToolCall& tool_call) {
         utils::terminal::printError("Traceroute failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1538,14 +2504,19 @@ ToolResult ToolExecutor::executeNmap(const ToolCall& tool_call) {
         else if (st == "os") scan_type = "-O";
     }
 
+    // Connect scans and host discovery need no nmap and no root
+    if (scan_type == "-sT" || scan_type == "-sn") {
+        return executeNativeScan(tool_call, target, scan_type == "-sn");
+    }
+
     utils::terminal::printInfo("[Tool: Nmap]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Target: " << target << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Scan type: " << scan_type << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Target: " << target << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Scan type: " << scan_type << utils::terminal::RESET << "\n";
     if (!ports.empty()) {
-        std::cout << utils::terminal::CYAN << "Ports: " << ports << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Ports: " << ports << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     // Check if nmap is installed, offer to install if not
     if (!ensureToolAvailable("nmap")) {
@@ -1572,7 +2543,80 @@ ToolResult ToolExecutor::executeNmap(const ToolCall& tool_call) {
         utils::terminal::printError("Scan failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
+    return result;
+}
+
+ToolResult ToolExecutor::executeNativeScan(const ToolCall& tool_call, const std::string& target, bool discovery) {
+    ToolResult result;
+
+    std::vector<std::string> hosts;
+    if (!NetProbe::parseTargets(target, hosts, result.error)) {
+        result.success = false;
+        return result;
+    }
+
+    std::vector<int> ports;
+    auto ports_it = tool_call.parameters.find("ports");
+    if (!discovery && !NetProbe::parsePorts(ports_it != tool_call.parameters.end() ? ports_it->second : "",
+                                            ports, result.error)) {
+        result.success = false;
+        return result;
+    }
+    if (hosts.size() * ports.size() > NET_SCAN_MAX_PROBES) {
+        result.success = false;
+        result.error = std::to_string(hosts.size()) + " hosts x " + std::to_string(ports.size()) +
+                       " ports is too large a scan; narrow the target or the port list";
+        return result;
+    }
+
+    size_t concurrency = NET_SCAN_CONCURRENCY;
+    auto concurrency_it = tool_call.parameters.find("concurrency");
+    if (concurrency_it != tool_call.parameters.end() && std::atoi(concurrency_it->second.c_str()) > 0) {
+        concurrency = std::min<size_t>(std::atoi(concurrency_it->second.c_str()), NET_SCAN_MAX_CONCURRENCY);
+    }
+    int timeout_ms = probeTimeoutMs(tool_call, discovery ? NET_PROBE_TIMEOUT_MS : NET_SCAN_TIMEOUT_MS);
+
+    utils::terminal::printInfo("[Tool: Nmap]");
+    utils::terminal::out() << utils::terminal::CYAN << "Target: " << target;
+    if (hosts.size() > 1) utils::terminal::out() << " (" << hosts.size() << " hosts)";
+    utils::terminal::out() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Scan type: "
+                           << (discovery ? "host discovery" : "TCP connect") << utils::terminal::RESET << "\n";
+    if (!discovery) {
+        utils::terminal::out() << utils::terminal::CYAN << "Ports: " << ports.size()
+                               << (ports_it == tool_call.parameters.end() ? " common ports" : "")
+                               << utils::terminal::RESET << "\n";
+    }
+    utils::terminal::out() << "\n";
+
+    if (!requestConfirmation("Nmap", "Scan " + target + "?")) {
+        result.success = false;
+        result.error = "Cancelled by user";
+        utils::terminal::printError("Cancelled");
+        return result;
+    }
+
+    utils::terminal::printInfo("Scanning...");
+    std::vector<NetTarget> targets = NetProbe::resolve(hosts);
+
+    if (discovery) {
+        std::vector<PingResult> replies = NetProbe::ping(targets, 1, timeout_ms);
+        result.output = NetProbe::formatPing(replies, true);
+    } else {
+        // Closed ports are worth listing only when a few were asked for
+        bool show_closed = ports.size() <= 10;
+        auto closed_it = tool_call.parameters.find("show_closed");
+        if (closed_it != tool_call.parameters.end()) {
+            show_closed = closed_it->second == "true" || closed_it->second == "1";
+        }
+        result.output = NetProbe::formatScan(NetProbe::scan(targets, ports, concurrency, timeout_ms), show_closed);
+    }
+    result.success = true;
+    result.exit_code = 0;
+
+    utils::terminal::printSuccess("Scan complete");
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1594,21 +2638,60 @@ ToolResult ToolExecutor::executeDig(const ToolCall& tool_call) {
         record_type = type_it->second;
     }
 
-    utils::terminal::printInfo("[Tool: Dig]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Domain: " << domain << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Record type: " << record_type << utils::terminal::RESET << "\n\n";
-
-    // Ensure dig is available (package name varies: dnsutils on Debian, bind-utils on RHEL)
-    if (!utils::commandExists("dig")) {
-        std::string pkg = utils::isMacOS() ? "bind" :
-                         (utils::getLinuxDistro() == "ubuntu" || utils::getLinuxDistro() == "debian") ? "dnsutils" : "bind-utils";
-        if (!ensureToolAvailable("dig", pkg)) {
-            result.success = false;
-            result.error = "dig is not available";
-            return result;
+    std::vector<std::string> servers;
+    auto server_it = tool_call.parameters.find("server");
+    if (server_it != tool_call.parameters.end()) {
+        std::string list = server_it->second;
+        std::replace(list.begin(), list.end(), ',', ' ');
+        std::istringstream tokens(list);
+        std::string server;
+        while (tokens >> server) servers.push_back(server[0] == '@' ? server.substr(1) : server);
+    }
+
+    // Every domain x type pair becomes one question; addresses get a PTR lookup
+    std::vector<DnsQuestion> questions;
+    std::string names = domain, types = record_type;
+    std::replace(names.begin(), names.end(), ',', ' ');
+    std::replace(types.begin(), types.end(), ',', ' ');
+    std::istringstream name_tokens(names);
+    std::string name;
+    while (name_tokens >> name) {
+        std::string reverse = DnsClient::reverseName(name);
+        if (reverse != name) {
+            questions.push_back({reverse, "PTR"});
+            continue;
+        }
+        std::istringstream type_tokens(types);
+        std::string type;
+        while (type_tokens >> type) {
+            std::transform(type.begin(), type.end(), type.begin(), ::toupper);
+            if (DnsClient::typeCode(type) == 0) {
+                result.success = false;
+                result.error = "Unsupported record type: " + type;
+                return result;
+            }
+            questions.push_back({name, type});
         }
     }
+    if (questions.empty()) {
+        result.success = false;
+        result.error = "No domain given";
+        return result;
+    }
+    if (questions.size() > DIG_MAX_QUESTIONS) {
+        result.success = false;
+        result.error = "Too many lookups (" + std::to_string(questions.size()) + "); at most " +
+                       std::to_string(DIG_MAX_QUESTIONS) + " per call";
+        return result;
+    }
+
+    utils::terminal::printInfo("[Tool: Dig]");
+    utils::terminal::out() << utils::terminal::CYAN << "Domain: " << domain << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Record type: " << record_type << utils::terminal::RESET << "\n";
+    if (!servers.empty()) {
+        utils::terminal::out() << utils::terminal::CYAN << "Server: " << server_it->second << utils::terminal::RESET << "\n";
+    }
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Dig", "DNS lookup for " + domain + "?")) {
         result.success = false;
@@ -1618,24 +2701,23 @@ ToolResult ToolExecutor::executeDig(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Looking up...");
-    std::string command = "dig " + domain + " " + record_type + " +short";
-    result.output = executeCommand(command, result.exit_code);
-
-    // Also get full output
-    std::string full_command = "dig " + domain + " " + record_type;
-    int full_exit;
-    std::string full_output = executeCommand(full_command, full_exit);
+    DnsClient client(servers);
+    std::vector<DnsAnswer> answers = client.query(questions, probeTimeoutMs(tool_call, NET_PROBE_TIMEOUT_MS));
+    size_t answered = std::count_if(answers.begin(), answers.end(),
+                                    [](const DnsAnswer& a) { return !a.status.empty(); });
 
-    result.success = (result.exit_code == 0);
+    result.output = DnsClient::format(answers);
+    result.success = answered > 0;
+    result.exit_code = answered == answers.size() ? 0 : 1;
 
     if (result.success) {
         utils::terminal::printSuccess("DNS lookup complete");
     } else {
+        result.error = answers[0].error.empty() ? "No DNS server answered" : answers[0].error;
         utils::terminal::printError("DNS lookup failed");
     }
 
-    std::cout << "\n=== Short Answer ===\n" << result.output << "\n=== Full Output ===\n" << full_output << "==============\n\n";
-    result.output = "Short: " + result.output + "\nFull:\n" + full_output;
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1652,8 +2734,8 @@ ToolResult ToolExecutor::executeWhois(const ToolCall& tool_call) {
     std::string domain = domain_it->second;
 
     utils::terminal::printInfo("[Tool: Whois]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Domain: " << domain << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Domain: " << domain << utils::terminal::RESET << "\n\n";
 
     // Ensure whois is available
     if (!ensureToolAvailable("whois")) {
@@ -1680,7 +2762,7 @@ ToolResult ToolExecutor::executeWhois(const ToolCall& tool_call) {
         utils::terminal::printError("WHOIS lookup failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1701,12 +2783,12 @@ ToolResult ToolExecutor::executeNetstat(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Netstat/SS]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Flags: " << flags << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Flags: " << flags << utils::terminal::RESET << "\n";
     if (!filter.empty()) {
-        std::cout << utils::terminal::CYAN << "Filter: " << filter << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Filter: " << filter << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Netstat", "Show network statistics?")) {
         result.success = false;
@@ -1716,6 +2798,45 @@ ToolResult ToolExecutor::executeNetstat(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Getting network stats...");
+
+    // Read the kernel tables directly where /proc has them
+    std::string native_error;
+    if (flags.find('r') != std::string::npos) {
+        std::vector<RouteEntry> routes;
+        if (SystemInfo::routes(routes, native_error)) {
+            std::istringstream lines(SystemInfo::formatRoutes(routes));
+            std::string line;
+            while (std::getline(lines, line)) {
+                if (filter.empty() || utils::toLower(line).find(utils::toLower(filter)) != std::string::npos) {
+                    result.output += line + "\n";
+                }
+            }
+        }
+    } else {
+        bool tcp = flags.find('t') != std::string::npos;
+        bool udp = flags.find('u') != std::string::npos;
+        std::vector<SocketEntry> sockets;
+        if (SystemInfo::sockets(tcp || !udp, udp || !tcp, flags.find('l') != std::string::npos,
+                                flags.find('p') != std::string::npos, sockets, native_error)) {
+            if (!filter.empty()) {
+                std::string needle = utils::toLower(filter);
+                sockets.erase(std::remove_if(sockets.begin(), sockets.end(), [&](const SocketEntry& entry) {
+                    std::string text = entry.proto + " " + entry.local + " " + entry.remote + " " +
+                                       entry.state + " " + std::to_string(entry.pid) + "/" + entry.program;
+                    return utils::toLower(text).find(needle) == std::string::npos;
+                }), sockets.end());
+            }
+            result.output = SystemInfo::formatSockets(sockets, NETSTAT_MAX_LINES);
+        }
+    }
+    if (native_error.empty()) {
+        result.exit_code = 0;
+        result.success = true;
+        utils::terminal::printSuccess("Network stats complete");
+        utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
+        return result;
+    }
+
     std::string command;
     // On Linux, prefer 'ss' (modern) over 'netstat' (deprecated)
     if (utils::isLinux() && utils::commandExists("ss")) {
@@ -1739,7 +2860,7 @@ ToolResult ToolExecutor::executeNetstat(const ToolCall& tool_call) {
     result.success = true;
 
     utils::terminal::printSuccess("Network stats complete");
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1780,12 +2901,12 @@ ToolResult ToolExecutor::executeCurl(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Curl]");
-    std::cout << utils::terminal::CYAN << "URL: " << url << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Method: " << method << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "URL: " << url << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Method: " << method << utils::terminal::RESET << "\n";
     if (!data.empty()) {
-        std::cout << utils::terminal::CYAN << "Data: " << data.substr(0, 100) << (data.length() > 100 ? "..." : "") << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Data: " << data.substr(0, 100) << (data.length() > 100 ? "..." : "") << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Curl", "Make HTTP request to " + url + "?")) {
         result.success = false;
@@ -1820,7 +2941,7 @@ ToolResult ToolExecutor::executeCurl(const ToolCall& tool_call) {
     if (display.length() > 5000) {
         display = display.substr(0, 5000) + "\n...(truncated)";
     }
-    std::cout << "\n=== Output ===\n" << display << "\n==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << display << "\n==============\n\n";
     return result;
 }
 
@@ -1857,15 +2978,15 @@ ToolResult ToolExecutor::executeSSH(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: SSH]");
-    std::cout << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
     if (!user.empty()) {
-        std::cout << utils::terminal::CYAN << "User: " << user << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "User: " << user << utils::terminal::RESET << "\n";
     }
-    std::cout << utils::terminal::CYAN << "Port: " << port << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Port: " << port << utils::terminal::RESET << "\n";
     if (!command_to_run.empty()) {
-        std::cout << utils::terminal::CYAN << "Command: " << command_to_run << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Command: " << command_to_run << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     if (command_to_run.empty()) {
         result.success = false;
@@ -1882,7 +3003,11 @@ ToolResult ToolExecutor::executeSSH(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Connecting...");
-    std::string ssh_cmd = "ssh -o BatchMode=yes -o ConnectTimeout=10 -p " + std::to_string(port);
+    std::string ssh_cmd = "ssh -o BatchMode=yes -o ConnectTimeout=10";
+    // Port 22 is left to ssh, so a Port in ~/.ssh/config still applies
+    std::string mux = ssh_mux_->options(user, host, port != 22 ? port : 0, config_.getSshMasterIdle());
+    if (!mux.empty()) ssh_cmd += " " + mux;
+    if (port != 22) ssh_cmd += " -p " + std::to_string(port);
     if (!user.empty()) {
         ssh_cmd += " " + user + "@" + host;
     } else {
@@ -1899,7 +3024,7 @@ ToolResult ToolExecutor::executeSSH(const ToolCall& tool_call) {
         utils::terminal::printError("SSH command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1924,8 +3049,8 @@ ToolResult ToolExecutor::executeTelnet(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Telnet]");
-    std::cout << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Port: " << port << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Port: " << port << utils::terminal::RESET << "\n\n";
 
     if (!requestConfirmation("Telnet", "Test connection to " + host + ":" + std::to_string(port) + "?")) {
         result.success = false;
@@ -1947,7 +3072,7 @@ ToolResult ToolExecutor::executeTelnet(const ToolCall& tool_call) {
         utils::terminal::printError("Connection failed - port may be closed or filtered");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -1990,9 +3115,9 @@ ToolResult ToolExecutor::executeNetcat(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Netcat]");
-    std::cout << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Port: " << port << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Mode: " << mode << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Host: " << host << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Port: " << port << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Mode: " << mode << utils::terminal::RESET << "\n\n";
 
     if (!requestConfirmation("Netcat", "Connect to " + host + ":" + std::to_string(port) + "?")) {
         result.success = false;
@@ -2020,7 +3145,7 @@ ToolResult ToolExecutor::executeNetcat(const ToolCall& tool_call) {
         utils::terminal::printError("Netcat failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2034,11 +3159,11 @@ ToolResult ToolExecutor::executeIfconfig(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Ifconfig/IP]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
     if (!interface.empty()) {
-        std::cout << utils::terminal::CYAN << "Interface: " << interface << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Interface: " << interface << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Ifconfig", "Show network interfaces?")) {
         result.success = false;
@@ -2048,6 +3173,25 @@ ToolResult ToolExecutor::executeIfconfig(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Getting interface info...");
+
+    std::vector<InterfaceInfo> interfaces;
+    std::string native_error;
+    if (SystemInfo::interfaces(interface, interfaces, native_error)) {
+        result.output = SystemInfo::formatInterfaces(interfaces);
+        result.exit_code = 0;
+        result.success = true;
+        utils::terminal::printSuccess("Network info retrieved");
+        utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
+        return result;
+    }
+    if (!interface.empty()) {
+        result.success = false;
+        result.exit_code = 1;
+        result.error = native_error;
+        utils::terminal::printError(result.error);
+        return result;
+    }
+
     std::string command;
     // On Linux, prefer 'ip' command (modern) over 'ifconfig' (deprecated)
     if (utils::isLinux() && utils::commandExists("ip")) {
@@ -2068,7 +3212,7 @@ ToolResult ToolExecutor::executeIfconfig(const ToolCall& tool_call) {
         utils::terminal::printError("Failed to get network info");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2082,7 +3226,7 @@ ToolResult ToolExecutor::executeArp(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: ARP]");
-    std::cout << utils::terminal::CYAN << "Flags: " << flags << utils::terminal::RESET << "\n\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Flags: " << flags << utils::terminal::RESET << "\n\n";
 
     if (!requestConfirmation("ARP", "Show ARP table?")) {
         result.success = false;
@@ -2092,6 +3236,20 @@ ToolResult ToolExecutor::executeArp(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Getting ARP table...");
+
+    // Listing flags read /proc/net/arp; anything else (-d, -s) goes to arp itself
+    std::vector<ArpEntry> entries;
+    std::string native_error;
+    bool listing = flags.empty() || flags.find_first_not_of("-an ") == std::string::npos;
+    if (listing && SystemInfo::arpTable(entries, native_error)) {
+        result.output = SystemInfo::formatArp(entries);
+        result.exit_code = 0;
+        result.success = true;
+        utils::terminal::printSuccess("ARP complete");
+        utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
+        return result;
+    }
+
     std::string command = "arp " + flags;
     result.output = executeCommand(command, result.exit_code);
     result.success = (result.exit_code == 0);
@@ -2102,7 +3260,7 @@ ToolResult ToolExecutor::executeArp(const ToolCall& tool_call) {
         utils::terminal::printError("ARP failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2148,11 +3306,11 @@ ToolResult ToolExecutor::executeBrew(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Brew]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     std::string desc = "brew " + action + (package.empty() ? "" : " " + package);
     if (!requestConfirmation("Brew", desc + "?")) {
@@ -2175,7 +3333,7 @@ ToolResult ToolExecutor::executeBrew(const ToolCall& tool_call) {
         utils::terminal::printError("Brew command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2221,11 +3379,11 @@ ToolResult ToolExecutor::executePip(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Pip]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     std::string pip_cmd = use_pip3 ? "pip3" : "pip";
     std::string desc = pip_cmd + " " + action + (package.empty() ? "" : " " + package);
@@ -2253,7 +3411,7 @@ ToolResult ToolExecutor::executePip(const ToolCall& tool_call) {
         utils::terminal::printError("Pip command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2293,14 +3451,14 @@ ToolResult ToolExecutor::executeNpm(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Npm]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
     if (global) {
-        std::cout << utils::terminal::CYAN << "Global: yes" << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Global: yes" << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     std::string desc = "npm " + action + (package.empty() ? "" : " " + package) + (global ? " (global)" : "");
     if (!requestConfirmation("Npm", desc + "?")) {
@@ -2324,7 +3482,7 @@ ToolResult ToolExecutor::executeNpm(const ToolCall& tool_call) {
         utils::terminal::printError("Npm command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2364,11 +3522,11 @@ ToolResult ToolExecutor::executeApt(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Apt]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     std::string desc = "apt " + action + (package.empty() ? "" : " " + package);
     if (!requestConfirmation("Apt", desc + "?")) {
@@ -2391,7 +3549,7 @@ ToolResult ToolExecutor::executeApt(const ToolCall& tool_call) {
         utils::terminal::printError("Apt command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2431,11 +3589,11 @@ ToolResult ToolExecutor::executeDnf(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Dnf]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     std::string desc = "dnf " + action + (package.empty() ? "" : " " + package);
     if (!requestConfirmation("Dnf", desc + "?")) {
@@ -2458,7 +3616,7 @@ ToolResult ToolExecutor::executeDnf(const ToolCall& tool_call) {
         utils::terminal::printError("Dnf command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2498,11 +3656,11 @@ ToolResult ToolExecutor::executeYum(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Yum]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     std::string desc = "yum " + action + (package.empty() ? "" : " " + package);
     if (!requestConfirmation("Yum", desc + "?")) {
@@ -2525,7 +3683,7 @@ ToolResult ToolExecutor::executeYum(const ToolCall& tool_call) {
         utils::terminal::printError("Yum command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2548,11 +3706,11 @@ ToolResult ToolExecutor::executePacman(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Pacman]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     // Map actions to pacman flags
     std::string command;
@@ -2602,7 +3760,7 @@ ToolResult ToolExecutor::executePacman(const ToolCall& tool_call) {
         utils::terminal::printError("Pacman command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2642,11 +3800,11 @@ ToolResult ToolExecutor::executeZypper(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Zypper]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
     if (!package.empty()) {
-        std::cout << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Package: " << package << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     std::string desc = "zypper " + action + (package.empty() ? "" : " " + package);
     if (!requestConfirmation("Zypper", desc + "?")) {
@@ -2669,7 +3827,7 @@ ToolResult ToolExecutor::executeZypper(const ToolCall& tool_call) {
         utils::terminal::printError("Zypper command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2677,6 +3835,37 @@ ToolResult ToolExecutor::executeZypper(const ToolCall& tool_call) {
 // File Operation Tools Implementation
 // ============================================================================
 
+// Deflate level shared by the archive tools
+static ArchiveOptions archiveOptions(const ToolCall& tool_call) {
+    ArchiveOptions options;
+    auto level_it = tool_call.parameters.find("level");
+    if (level_it != tool_call.parameters.end()) {
+        int level = std::atoi(level_it->second.c_str());
+        if (level > 0) options.level = std::min(level, 9);
+    }
+    return options;
+}
+
+static void finishArchive(ToolResult& result, bool ok, const std::string& error, const ArchiveReport& report,
+                          const std::string& output, const std::string& done, const std::string& failed) {
+    result.output = ok || !report.entries.empty() ? output : "";
+    result.success = ok && report.errors.empty();
+    result.exit_code = result.success ? 0 : 1;
+
+    if (result.success) {
+        utils::terminal::printSuccess(done);
+    } else {
+        result.error = !ok ? error : report.errors.front();
+        if (ok && report.errors.size() > 1) {
+            result.error += " (and " + std::to_string(report.errors.size() - 1) + " more)";
+        }
+        if (!ok) result.output += "error: " + error + "\n";
+        utils::terminal::printError(failed);
+    }
+
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
+}
+
 ToolResult ToolExecutor::executeTar(const ToolCall& tool_call) {
     ToolResult result;
 
@@ -2690,6 +3879,7 @@ ToolResult ToolExecutor::executeTar(const ToolCall& tool_call) {
     std::string action = action_it->second;
     std::string archive = "";
     std::string files = "";
+    std::string dest = "";
     std::string compress = "auto";
 
     auto archive_it = tool_call.parameters.find("archive");
@@ -2702,7 +3892,13 @@ ToolResult ToolExecutor::executeTar(const ToolCall& tool_call) {
         files = files_it->second;
     }
 
+    auto dest_it = tool_call.parameters.find("destination");
+    if (dest_it != tool_call.parameters.end()) {
+        dest = dest_it->second;
+    }
+
     auto compress_it = tool_call.parameters.find("compress");
+    if (compress_it == tool_call.parameters.end()) compress_it = tool_call.parameters.find("compression");
     if (compress_it != tool_call.parameters.end()) {
         compress = compress_it->second;
     }
@@ -2714,15 +3910,26 @@ ToolResult ToolExecutor::executeTar(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Tar]");
-    std::cout << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Archive: " << archive << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Action: " << action << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Archive: " << archive << utils::terminal::RESET << "\n";
     if (!files.empty()) {
-        std::cout << utils::terminal::CYAN << "Files: " << files << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Files: " << files << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    if (!dest.empty()) {
+        utils::terminal::out() << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
+    }
+    utils::terminal::out() << "\n";
 
-    std::string command;
-    std::string flags;
+    if (action != "create" && action != "extract" && action != "list") {
+        result.success = false;
+        result.error = "Invalid action. Use: create, extract, list";
+        return result;
+    }
+    if (action == "create" && files.empty()) {
+        result.success = false;
+        result.error = "Create requires 'files' parameter";
+        return result;
+    }
 
     // Determine compression from extension or parameter
     if (compress == "auto") {
@@ -2732,25 +3939,62 @@ ToolResult ToolExecutor::executeTar(const ToolCall& tool_call) {
         else compress = "none";
     }
 
+    // Plain and gzipped tar are handled in-process; reading goes by the data, not the name
+    bool native;
+    if (action == "create") {
+        native = compress == "none" || (compress == "gzip" && Archive::hasZlib());
+    } else {
+        Archive::Format format = Archive::detect(archive);
+        native = format == Archive::Format::Tar || (format == Archive::Format::Gzip && Archive::hasZlib());
+    }
+
+    if (native) {
+        std::string description = action == "create" ? "Create " + archive + " from " + files
+                                : action == "extract" ? "Extract " + archive + " into " + (dest.empty() ? "." : dest)
+                                : "List " + archive;
+        if (!requestConfirmation("Tar", description + "?")) {
+            result.success = false;
+            result.error = "Cancelled by user";
+            utils::terminal::printError("Cancelled");
+            return result;
+        }
+
+        ArchiveOptions options = archiveOptions(tool_call);
+        options.gzip = compress == "gzip";
+        ArchiveReport report;
+        std::string error;
+        if (action == "create") {
+            utils::terminal::printInfo(options.gzip ? "Archiving and compressing..." : "Archiving...");
+            bool ok = Archive::createTar(archive, FileOps::expandPaths(files), options, report, error);
+            finishArchive(result, ok, error, report, Archive::formatSummary(report, "Archived"),
+                          "Archive created", "Tar create failed");
+        } else if (action == "extract") {
+            utils::terminal::printInfo("Extracting...");
+            bool ok = Archive::extractTar(archive, dest.empty() ? "." : dest, report, error);
+            finishArchive(result, ok, error, report, Archive::formatSummary(report, "Extracted"),
+                          "Archive extracted", "Tar extract failed");
+        } else {
+            bool ok = Archive::listTar(archive, report, error);
+            finishArchive(result, ok, error, report, Archive::formatList(report, false),
+                          "Archive listed", "Tar list failed");
+        }
+        return result;
+    }
+
+    std::string command;
+    std::string flags;
+
     if (compress == "gzip") flags = "z";
     else if (compress == "bzip2") flags = "j";
     else if (compress == "xz") flags = "J";
 
     if (action == "create") {
-        if (files.empty()) {
-            result.success = false;
-            result.error = "Create requires 'files' parameter";
-            return result;
-        }
         command = "tar -cv" + flags + "f " + archive + " " + files;
     } else if (action == "extract") {
         command = "tar -xv" + flags + "f " + archive;
-    } else if (action == "list") {
-        command = "tar -tv" + flags + "f " + archive;
+        if (!dest.empty()) command += " -C " + dest;
     } else {
-        result.success = false;
-        result.error = "Invalid action. Use: create, extract, list";
-        return result;
+        command = "tar -tv" + flags + "f " + archive;
     }
 
     if (!requestConfirmation("Tar", command + "?")) {
@@ -2770,7 +4014,7 @@ ToolResult ToolExecutor::executeTar(const ToolCall& tool_call) {
         utils::terminal::printError("Tar command failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2796,11 +4040,11 @@ ToolResult ToolExecutor::executeZip(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Zip]");
-    std::cout << utils::terminal::CYAN << "Archive: " << archive << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Archive: " << archive << utils::terminal::RESET << "\n";
     if (!files.empty()) {
-        std::cout << utils::terminal::CYAN << "Files: " << files << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Files: " << files << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
+    utils::terminal::out() << "\n";
 
     if (files.empty()) {
         result.success = false;
@@ -2808,10 +4052,6 @@ ToolResult ToolExecutor::executeZip(const ToolCall& tool_call) {
         return result;
     }
 
-    std::string command = "zip";
-    if (recursive) command += " -r";
-    command += " " + archive + " " + files;
-
     if (!requestConfirmation("Zip", "Create " + archive + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
@@ -2819,6 +4059,22 @@ ToolResult ToolExecutor::executeZip(const ToolCall& tool_call) {
         return result;
     }
 
+    if (Archive::hasZlib()) {
+        ArchiveOptions options = archiveOptions(tool_call);
+        options.recursive = recursive;
+        ArchiveReport report;
+        std::string error;
+        utils::terminal::printInfo("Creating zip...");
+        bool ok = Archive::createZip(archive, FileOps::expandPaths(files), options, report, error);
+        finishArchive(result, ok, error, report, Archive::formatSummary(report, "Archived"),
+                      "Zip complete", "Zip failed");
+        return result;
+    }
+
+    std::string command = "zip";
+    if (recursive) command += " -r";
+    command += " " + archive + " " + files;
+
     utils::terminal::printInfo("Creating zip...");
     result.output = executeCommand(command, result.exit_code);
     result.success = (result.exit_code == 0);
@@ -2829,7 +4085,7 @@ ToolResult ToolExecutor::executeZip(const ToolCall& tool_call) {
         utils::terminal::printError("Zip failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2858,11 +4114,34 @@ ToolResult ToolExecutor::executeUnzip(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Unzip]");
-    std::cout << utils::terminal::CYAN << "Archive: " << archive << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Archive: " << archive << utils::terminal::RESET << "\n";
     if (!dest.empty()) {
-        std::cout << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
+    }
+    utils::terminal::out() << "\n";
+
+    if (!requestConfirmation("Unzip", list_only ? "List " + archive + "?" : "Extract " + archive + "?")) {
+        result.success = false;
+        result.error = "Cancelled by user";
+        utils::terminal::printError("Cancelled");
+        return result;
+    }
+
+    if (Archive::hasZlib()) {
+        ArchiveReport report;
+        std::string error;
+        if (list_only) {
+            bool ok = Archive::listZip(archive, report, error);
+            finishArchive(result, ok, error, report, Archive::formatList(report, true),
+                          "Unzip complete", "Unzip failed");
+        } else {
+            utils::terminal::printInfo("Extracting...");
+            bool ok = Archive::extractZip(archive, dest.empty() ? "." : dest, archiveOptions(tool_call), report, error);
+            finishArchive(result, ok, error, report, Archive::formatSummary(report, "Extracted"),
+                          "Unzip complete", "Unzip failed");
+        }
+        return result;
     }
-    std::cout << "\n";
 
     std::string command;
     if (list_only) {
@@ -2872,13 +4151,6 @@ ToolResult ToolExecutor::executeUnzip(const ToolCall& tool_call) {
         if (!dest.empty()) command += " -d " + dest;
     }
 
-    if (!requestConfirmation("Unzip", list_only ? "List " + archive + "?" : "Extract " + archive + "?")) {
-        result.success = false;
-        result.error = "Cancelled by user";
-        utils::terminal::printError("Cancelled");
-        return result;
-    }
-
     utils::terminal::printInfo(list_only ? "Listing..." : "Extracting...");
     result.output = executeCommand(command, result.exit_code);
     result.success = (result.exit_code == 0);
@@ -2889,7 +4161,7 @@ ToolResult ToolExecutor::executeUnzip(const ToolCall& tool_call) {
         utils::terminal::printError("Unzip failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2906,25 +4178,32 @@ ToolResult ToolExecutor::executeGzip(const ToolCall& tool_call) {
     std::string file = file_it->second;
     bool decompress = false;
     bool keep = false;
+    bool force = false;
 
     auto decompress_it = tool_call.parameters.find("decompress");
     if (decompress_it != tool_call.parameters.end()) {
         decompress = (decompress_it->second == "true" || decompress_it->second == "1");
     }
 
+    auto action_it = tool_call.parameters.find("action");
+    if (action_it != tool_call.parameters.end()) {
+        decompress = decompress || action_it->second == "decompress";
+    }
+
     auto keep_it = tool_call.parameters.find("keep");
     if (keep_it != tool_call.parameters.end()) {
         keep = (keep_it->second == "true" || keep_it->second == "1");
     }
 
-    utils::terminal::printInfo("[Tool: Gzip]");
-    std::cout << utils::terminal::CYAN << "File: " << file << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Mode: " << (decompress ? "decompress" : "compress") << utils::terminal::RESET << "\n";
-    std::cout << "\n";
+    auto force_it = tool_call.parameters.find("force");
+    if (force_it != tool_call.parameters.end()) {
+        force = (force_it->second == "true" || force_it->second == "1");
+    }
 
-    std::string command = decompress ? "gunzip" : "gzip";
-    if (keep) command += " -k";
-    command += " " + file;
+    utils::terminal::printInfo("[Tool: Gzip]");
+    utils::terminal::out() << utils::terminal::CYAN << "File: " << file << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Mode: " << (decompress ? "decompress" : "compress") << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Gzip", (decompress ? "Decompress " : "Compress ") + file + "?")) {
         result.success = false;
@@ -2933,6 +4212,52 @@ ToolResult ToolExecutor::executeGzip(const ToolCall& tool_call) {
         return result;
     }
 
+    if (Archive::hasZlib()) {
+        ArchiveOptions options = archiveOptions(tool_call);
+        ArchiveReport report;
+        utils::terminal::printInfo(decompress ? "Decompressing..." : "Compressing...");
+        for (const auto& source : FileOps::expandPaths(file)) {
+            std::string dest;
+            if (!decompress) {
+                if (utils::endsWith(source, ".gz") || utils::endsWith(source, ".tgz")) {
+                    report.errors.push_back(source + ": already has a gzip suffix");
+                    continue;
+                }
+                dest = source + ".gz";
+            } else if (utils::endsWith(source, ".tgz")) {
+                dest = source.substr(0, source.size() - 4) + ".tar";
+            } else if (utils::endsWith(source, ".gz") && source.size() > 3) {
+                dest = source.substr(0, source.size() - 3);
+            } else {
+                report.errors.push_back(source + ": unknown suffix, expected .gz or .tgz");
+                continue;
+            }
+
+            ArchiveReport one;
+            std::string error;
+            bool ok = decompress ? Archive::gunzip(source, dest, force, one, error)
+                                 : Archive::gzip(source, dest, force, options, one, error);
+            if (!ok) {
+                report.errors.push_back(error);
+                continue;
+            }
+            if (!keep && unlink(source.c_str()) != 0) {
+                report.errors.push_back(source + ": cannot remove: " + strerror(errno));
+            }
+            report.entries.insert(report.entries.end(), one.entries.begin(), one.entries.end());
+            report.bytes_in += one.bytes_in;
+            report.bytes_out += one.bytes_out;
+        }
+        finishArchive(result, true, "", report, Archive::formatSummary(report, decompress ? "Decompressed" : "Compressed"),
+                      "Gzip complete", "Gzip failed");
+        return result;
+    }
+
+    std::string command = decompress ? "gunzip" : "gzip";
+    if (keep) command += " -k";
+    if (force) command += " -f";
+    command += " " + file;
+
     utils::terminal::printInfo(decompress ? "Decompressing..." : "Compressing...");
     result.output = executeCommand(command, result.exit_code);
     result.success = (result.exit_code == 0);
@@ -2943,7 +4268,7 @@ ToolResult ToolExecutor::executeGzip(const ToolCall& tool_call) {
         utils::terminal::printError("Gzip failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -2975,11 +4300,11 @@ ToolResult ToolExecutor::executeRsync(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Rsync]");
-    std::cout << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Flags: " << flags << utils::terminal::RESET << "\n";
-    std::cout << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "OS: " << utils::getOsName() << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Flags: " << flags << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
     // Ensure rsync is available
     if (!ensureToolAvailable("rsync")) {
@@ -2988,10 +4313,6 @@ ToolResult ToolExecutor::executeRsync(const ToolCall& tool_call) {
         return result;
     }
 
-    std::string command = "rsync " + flags;
-    if (delete_extra) command += " --delete";
-    command += " " + source + " " + dest;
-
     if (!requestConfirmation("Rsync", "Sync " + source + " to " + dest + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
@@ -2999,6 +4320,26 @@ ToolResult ToolExecutor::executeRsync(const ToolCall& tool_call) {
         return result;
     }
 
+    std::string command = "rsync " + flags;
+    if (delete_extra) command += " --delete";
+
+    // Go through the shared connection unless the flags pick a remote shell already
+    bool own_shell = false;
+    for (const auto& flag : utils::split(flags, ' ')) {
+        if (utils::startsWith(flag, "--rsh") ||
+            (flag.size() > 1 && flag[0] == '-' && flag[1] != '-' && flag.find('e') != std::string::npos)) {
+            own_shell = true;
+        }
+    }
+    std::string remote_user, remote_host;
+    bool remote = SshMultiplexer::parseRemote(source, remote_user, remote_host) ||
+                  SshMultiplexer::parseRemote(dest, remote_user, remote_host);
+    if (remote && !own_shell) {
+        std::string mux = ssh_mux_->options(remote_user, remote_host, 0, config_.getSshMasterIdle());
+        if (!mux.empty()) command += " -e \"ssh " + mux + "\"";
+    }
+    command += " " + source + " " + dest;
+
     utils::terminal::printInfo("Syncing...");
     result.output = executeCommand(command, result.exit_code);
     result.success = (result.exit_code == 0);
@@ -3009,7 +4350,7 @@ ToolResult ToolExecutor::executeRsync(const ToolCall& tool_call) {
         utils::terminal::printError("Rsync failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -3043,14 +4384,9 @@ ToolResult ToolExecutor::executeScp(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Scp]");
-    std::cout << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
-    std::cout << "\n";
-
-    std::string command = "scp";
-    if (recursive) command += " -r";
-    if (port != 22) command += " -P " + std::to_string(port);
-    command += " " + source + " " + dest;
+    utils::terminal::out() << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Scp", "Copy " + source + " to " + dest + "?")) {
         result.success = false;
@@ -3059,6 +4395,17 @@ ToolResult ToolExecutor::executeScp(const ToolCall& tool_call) {
         return result;
     }
 
+    std::string command = "scp";
+    std::string remote_user, remote_host;
+    if (SshMultiplexer::parseRemote(source, remote_user, remote_host) ||
+        SshMultiplexer::parseRemote(dest, remote_user, remote_host)) {
+        std::string mux = ssh_mux_->options(remote_user, remote_host, port != 22 ? port : 0, config_.getSshMasterIdle());
+        if (!mux.empty()) command += " " + mux;
+    }
+    if (recursive) command += " -r";
+    if (port != 22) command += " -P " + std::to_string(port);
+    command += " " + source + " " + dest;
+
     utils::terminal::printInfo("Copying...");
     result.output = executeCommand(command, result.exit_code);
     result.success = (result.exit_code == 0);
@@ -3069,10 +4416,43 @@ ToolResult ToolExecutor::executeScp(const ToolCall& tool_call) {
         utils::terminal::printError("Scp failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
+// Flags shared by the native file tools
+static FileOpOptions fileOpOptions(const ToolCall& tool_call) {
+    auto flag = [&](const std::string& name, bool fallback) {
+        auto it = tool_call.parameters.find(name);
+        if (it == tool_call.parameters.end()) return fallback;
+        return it->second == "true" || it->second == "1" || it->second == "yes";
+    };
+    FileOpOptions options;
+    options.recursive = flag("recursive", false);
+    options.force = flag("force", false);
+    options.parents = flag("parents", true);
+    options.dry_run = flag("dry_run", false);
+    return options;
+}
+
+static void finishFileOp(ToolResult& result, const FileOpReport& report,
+                         const std::string& done, const std::string& failed) {
+    result.output = FileOps::format(report);
+    result.success = report.errors.empty();
+    result.exit_code = result.success ? 0 : 1;
+
+    if (result.success) {
+        utils::terminal::printSuccess(report.dry_run ? "Dry run complete" : done);
+    } else {
+        const FileOpError& first = report.errors.front();
+        result.error = first.path + ": " + first.message;
+        if (report.errors.size() > 1) result.error += " (and " + std::to_string(report.errors.size() - 1) + " more)";
+        utils::terminal::printError(failed);
+    }
+
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
+}
+
 ToolResult ToolExecutor::executeCp(const ToolCall& tool_call) {
     ToolResult result;
 
@@ -3087,23 +4467,22 @@ ToolResult ToolExecutor::executeCp(const ToolCall& tool_call) {
 
     std::string source = source_it->second;
     std::string dest = dest_it->second;
-    bool recursive = false;
+    FileOpOptions options = fileOpOptions(tool_call);
 
-    auto recursive_it = tool_call.parameters.find("recursive");
-    if (recursive_it != tool_call.parameters.end()) {
-        recursive = (recursive_it->second == "true" || recursive_it->second == "1");
+    std::vector<std::string> sources = FileOps::expandPaths(source);
+    std::vector<std::string> dests = FileOps::expandPaths(dest);
+    if (sources.empty() || dests.size() != 1) {
+        result.success = false;
+        result.error = sources.empty() ? "No source paths given" : "'destination' must be a single path";
+        return result;
     }
 
     utils::terminal::printInfo("[Tool: Cp]");
-    std::cout << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
-    std::cout << "\n";
-
-    std::string command = "cp -v";
-    if (recursive) command += " -r";
-    command += " " + source + " " + dest;
+    utils::terminal::out() << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
-    if (!requestConfirmation("Cp", "Copy " + source + " to " + dest + "?")) {
+    if (!options.dry_run && !requestConfirmation("Cp", "Copy " + source + " to " + dest + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
         utils::terminal::printError("Cancelled");
@@ -3111,16 +4490,7 @@ ToolResult ToolExecutor::executeCp(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Copying...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
-
-    if (result.success) {
-        utils::terminal::printSuccess("Copy complete");
-    } else {
-        utils::terminal::printError("Copy failed");
-    }
-
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    finishFileOp(result, FileOps::copy(sources, dests[0], options), "Copy complete", "Copy failed");
     return result;
 }
 
@@ -3138,15 +4508,22 @@ ToolResult ToolExecutor::executeMv(const ToolCall& tool_call) {
 
     std::string source = source_it->second;
     std::string dest = dest_it->second;
+    FileOpOptions options = fileOpOptions(tool_call);
 
-    utils::terminal::printInfo("[Tool: Mv]");
-    std::cout << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
-    std::cout << "\n";
+    std::vector<std::string> sources = FileOps::expandPaths(source);
+    std::vector<std::string> dests = FileOps::expandPaths(dest);
+    if (sources.empty() || dests.size() != 1) {
+        result.success = false;
+        result.error = sources.empty() ? "No source paths given" : "'destination' must be a single path";
+        return result;
+    }
 
-    std::string command = "mv -v " + source + " " + dest;
+    utils::terminal::printInfo("[Tool: Mv]");
+    utils::terminal::out() << utils::terminal::CYAN << "Source: " << source << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Destination: " << dest << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
-    if (!requestConfirmation("Mv", "Move " + source + " to " + dest + "?")) {
+    if (!options.dry_run && !requestConfirmation("Mv", "Move " + source + " to " + dest + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
         utils::terminal::printError("Cancelled");
@@ -3154,16 +4531,7 @@ ToolResult ToolExecutor::executeMv(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Moving...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
-
-    if (result.success) {
-        utils::terminal::printSuccess("Move complete");
-    } else {
-        utils::terminal::printError("Move failed");
-    }
-
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    finishFileOp(result, FileOps::move(sources, dests[0], options), "Move complete", "Move failed");
     return result;
 }
 
@@ -3178,31 +4546,21 @@ ToolResult ToolExecutor::executeRm(const ToolCall& tool_call) {
     }
 
     std::string path = path_it->second;
-    bool recursive = false;
-    bool force = false;
-
-    auto recursive_it = tool_call.parameters.find("recursive");
-    if (recursive_it != tool_call.parameters.end()) {
-        recursive = (recursive_it->second == "true" || recursive_it->second == "1");
-    }
-
-    auto force_it = tool_call.parameters.find("force");
-    if (force_it != tool_call.parameters.end()) {
-        force = (force_it->second == "true" || force_it->second == "1");
+    FileOpOptions options = fileOpOptions(tool_call);
+    std::vector<std::string> paths = FileOps::expandPaths(path);
+    if (paths.empty()) {
+        result.success = false;
+        result.error = "No paths given";
+        return result;
     }
 
     utils::terminal::printInfo("[Tool: Rm]");
-    std::cout << utils::terminal::YELLOW << "WARNING: This will delete files!" << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Recursive: " << (recursive ? "yes" : "no") << utils::terminal::RESET << "\n";
-    std::cout << "\n";
-
-    std::string command = "rm -v";
-    if (recursive) command += " -r";
-    if (force) command += " -f";
-    command += " " + path;
+    utils::terminal::out() << utils::terminal::YELLOW << "WARNING: This will delete files!" << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Recursive: " << (options.recursive ? "yes" : "no") << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
-    if (!requestConfirmation("Rm", "DELETE " + path + "?")) {
+    if (!options.dry_run && !requestConfirmation("Rm", "DELETE " + path + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
         utils::terminal::printError("Cancelled");
@@ -3210,16 +4568,7 @@ ToolResult ToolExecutor::executeRm(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Deleting...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
-
-    if (result.success) {
-        utils::terminal::printSuccess("Delete complete");
-    } else {
-        utils::terminal::printError("Delete failed");
-    }
-
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    finishFileOp(result, FileOps::remove(paths, options), "Delete complete", "Delete failed");
     return result;
 }
 
@@ -3234,22 +4583,19 @@ ToolResult ToolExecutor::executeMkdir(const ToolCall& tool_call) {
     }
 
     std::string path = path_it->second;
-    bool parents = true;
-
-    auto parents_it = tool_call.parameters.find("parents");
-    if (parents_it != tool_call.parameters.end()) {
-        parents = (parents_it->second != "false" && parents_it->second != "0");
+    FileOpOptions options = fileOpOptions(tool_call);
+    std::vector<std::string> paths = FileOps::expandPaths(path);
+    if (paths.empty()) {
+        result.success = false;
+        result.error = "No paths given";
+        return result;
     }
 
     utils::terminal::printInfo("[Tool: Mkdir]");
-    std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
-    std::cout << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
-    std::string command = "mkdir -v";
-    if (parents) command += " -p";
-    command += " " + path;
-
-    if (!requestConfirmation("Mkdir", "Create directory " + path + "?")) {
+    if (!options.dry_run && !requestConfirmation("Mkdir", "Create directory " + path + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
         utils::terminal::printError("Cancelled");
@@ -3257,16 +4603,7 @@ ToolResult ToolExecutor::executeMkdir(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Creating directory...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
-
-    if (result.success) {
-        utils::terminal::printSuccess("Directory created");
-    } else {
-        utils::terminal::printError("Failed to create directory");
-    }
-
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    finishFileOp(result, FileOps::makeDirs(paths, options), "Directory created", "Failed to create directory");
     return result;
 }
 
@@ -3283,24 +4620,22 @@ ToolResult ToolExecutor::executeChmod(const ToolCall& tool_call) {
     }
 
     std::string path = path_it->second;
-    std::string mode = mode_it->second;
-    bool recursive = false;
-
-    auto recursive_it = tool_call.parameters.find("recursive");
-    if (recursive_it != tool_call.parameters.end()) {
-        recursive = (recursive_it->second == "true" || recursive_it->second == "1");
+    std::string mode = utils::trim(mode_it->second);
+    FileOpOptions options = fileOpOptions(tool_call);
+    std::vector<std::string> paths = FileOps::expandPaths(path);
+    if (paths.empty() || !FileOps::validMode(mode)) {
+        result.success = false;
+        result.error = paths.empty() ? "No paths given"
+                                     : "Invalid mode '" + mode + "' (use octal like 755 or symbolic like u+x,go-w)";
+        return result;
     }
 
     utils::terminal::printInfo("[Tool: Chmod]");
-    std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Mode: " << mode << utils::terminal::RESET << "\n";
-    std::cout << "\n";
-
-    std::string command = "chmod -v";
-    if (recursive) command += " -R";
-    command += " " + mode + " " + path;
+    utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Mode: " << mode << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
-    if (!requestConfirmation("Chmod", "Change permissions of " + path + " to " + mode + "?")) {
+    if (!options.dry_run && !requestConfirmation("Chmod", "Change permissions of " + path + " to " + mode + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
         utils::terminal::printError("Cancelled");
@@ -3308,16 +4643,7 @@ ToolResult ToolExecutor::executeChmod(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Changing permissions...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
-
-    if (result.success) {
-        utils::terminal::printSuccess("Permissions changed");
-    } else {
-        utils::terminal::printError("Failed to change permissions");
-    }
-
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    finishFileOp(result, FileOps::changeMode(paths, mode, options), "Permissions changed", "Failed to change permissions");
     return result;
 }
 
@@ -3334,24 +4660,26 @@ ToolResult ToolExecutor::executeChown(const ToolCall& tool_call) {
     }
 
     std::string path = path_it->second;
-    std::string owner = owner_it->second;
-    bool recursive = false;
-
-    auto recursive_it = tool_call.parameters.find("recursive");
-    if (recursive_it != tool_call.parameters.end()) {
-        recursive = (recursive_it->second == "true" || recursive_it->second == "1");
+    std::string owner = utils::trim(owner_it->second);
+    auto group_it = tool_call.parameters.find("group");
+    if (group_it != tool_call.parameters.end() && !utils::trim(group_it->second).empty() &&
+        owner.find(':') == std::string::npos) {
+        owner += ":" + utils::trim(group_it->second);
+    }
+    FileOpOptions options = fileOpOptions(tool_call);
+    std::vector<std::string> paths = FileOps::expandPaths(path);
+    if (paths.empty()) {
+        result.success = false;
+        result.error = "No paths given";
+        return result;
     }
 
     utils::terminal::printInfo("[Tool: Chown]");
-    std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
-    std::cout << utils::terminal::CYAN << "Owner: " << owner << utils::terminal::RESET << "\n";
-    std::cout << "\n";
-
-    std::string command = "sudo chown -v";
-    if (recursive) command += " -R";
-    command += " " + owner + " " + path;
+    utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
+    utils::terminal::out() << utils::terminal::CYAN << "Owner: " << owner << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
-    if (!requestConfirmation("Chown", "Change owner of " + path + " to " + owner + "?")) {
+    if (!options.dry_run && !requestConfirmation("Chown", "Change owner of " + path + " to " + owner + "?")) {
         result.success = false;
         result.error = "Cancelled by user";
         utils::terminal::printError("Cancelled");
@@ -3359,16 +4687,29 @@ ToolResult ToolExecutor::executeChown(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Changing ownership...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
-
-    if (result.success) {
-        utils::terminal::printSuccess("Ownership changed");
-    } else {
-        utils::terminal::printError("Failed to change ownership");
+    FileOpReport report = FileOps::changeOwner(paths, owner, options);
+
+    // Giving files away needs root: retry what was refused through sudo
+    bool refused = !report.errors.empty() && geteuid() != 0 &&
+                   std::all_of(report.errors.begin(), report.errors.end(),
+                               [](const FileOpError& error) { return error.code == EPERM; });
+    if (refused) {
+        utils::terminal::printWarning("Permission denied; retrying with sudo");
+        std::string command = "sudo chown -v";
+        if (options.recursive) command += " -R";
+        command += " " + owner + " " + path;
+        result.output = executeCommand(command, result.exit_code);
+        result.success = (result.exit_code == 0);
+        if (result.success) {
+            utils::terminal::printSuccess("Ownership changed");
+        } else {
+            utils::terminal::printError("Failed to change ownership");
+        }
+        utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
+        return result;
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    finishFileOp(result, report, "Ownership changed", "Failed to change ownership");
     return result;
 }
 
@@ -3390,13 +4731,9 @@ ToolResult ToolExecutor::executeDf(const ToolCall& tool_call) {
 
     utils::terminal::printInfo("[Tool: Df]");
     if (!path.empty()) {
-        std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
+        utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
     }
-    std::cout << "\n";
-
-    std::string command = "df";
-    if (human) command += " -h";
-    if (!path.empty()) command += " " + path;
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Df", "Show disk space?")) {
         result.success = false;
@@ -3406,7 +4743,13 @@ ToolResult ToolExecutor::executeDf(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("Getting disk space...");
-    result.output = executeCommand(command, result.exit_code);
+    std::vector<DiskUsage> disks;
+    if (SystemInfo::diskUsage(path, disks, result.error)) {
+        result.output = SystemInfo::formatDiskUsage(disks, human);
+        result.exit_code = 0;
+    } else {
+        result.exit_code = 1;
+    }
     result.success = (result.exit_code == 0);
 
     if (result.success) {
@@ -3415,7 +4758,7 @@ ToolResult ToolExecutor::executeDf(const ToolCall& tool_call) {
         utils::terminal::printError("Df failed");
     }
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
@@ -3450,14 +4793,8 @@ ToolResult ToolExecutor::executeDu(const ToolCall& tool_call) {
     }
 
     utils::terminal::printInfo("[Tool: Du]");
-    std::cout << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
-    std::cout << "\n";
-
-    std::string command = "du";
-    if (human) command += " -h";
-    if (summary) command += " -s";
-    else if (max_depth >= 0) command += " -d " + std::to_string(max_depth);
-    command += " " + path;
+    utils::terminal::out() << utils::terminal::CYAN << "Path: " << path << utils::terminal::RESET << "\n";
+    utils::terminal::out() << "\n";
 
     if (!requestConfirmation("Du", "Show disk usage for " + path + "?")) {
         result.success = false;
@@ -3466,21 +4803,136 @@ ToolResult ToolExecutor::executeDu(const ToolCall& tool_call) {
         return result;
     }
 
+    struct stat root_st;
+    if (lstat(path.c_str(), &root_st) != 0) {
+        result.success = false;
+        result.exit_code = 1;
+        result.error = "Cannot access " + path + ": " + strerror(errno);
+        utils::terminal::printError(result.error);
+        return result;
+    }
+
     utils::terminal::printInfo("Calculating disk usage...");
-    result.output = executeCommand(command, result.exit_code);
-    result.success = (result.exit_code == 0);
 
-    if (result.success) {
-        utils::terminal::printSuccess("Du complete");
-    } else {
-        utils::terminal::printError("Du failed");
+    while (path.size() > 1 && path.back() == '/') path.pop_back();
+
+    // Blocks actually allocated, per containing directory; hard links count once
+    std::map<std::string, unsigned long long> dir_bytes;
+    std::set<std::pair<dev_t, ino_t>> seen_links;
+    std::mutex du_mutex;
+    dir_bytes[path] = static_cast<unsigned long long>(root_st.st_blocks) * 512;
+
+    if (S_ISDIR(root_st.st_mode)) {
+        WalkOptions options;
+        options.respect_gitignore = false;
+        options.include_hidden = true;
+        options.prune_vcs = false;      // .git is often most of a repository's size
+        options.include_dirs = true;
+
+        FileWalker walker(options);
+        walker.walk(path, [&](const WalkEntry& entry) {
+            struct stat st;
+            if (lstat(entry.path.c_str(), &st) != 0) return true;
+            unsigned long long bytes = static_cast<unsigned long long>(st.st_blocks) * 512;
+
+            std::lock_guard<std::mutex> lock(du_mutex);
+            if (!entry.is_dir && st.st_nlink > 1 && !seen_links.insert({st.st_dev, st.st_ino}).second) {
+                return true;
+            }
+            dir_bytes[entry.is_dir ? entry.path : utils::getDirname(entry.path)] += bytes;
+            return true;
+        });
+    }
+
+    // Roll totals up into parents, deepest directories first
+    std::vector<std::pair<std::string, unsigned long long>> dirs(dir_bytes.begin(), dir_bytes.end());
+    auto depthOf = [](const std::string& p) { return std::count(p.begin(), p.end(), '/'); };
+    std::sort(dirs.begin(), dirs.end(), [&](const auto& a, const auto& b) { return depthOf(a.first) > depthOf(b.first); });
+    for (auto& dir : dirs) {
+        dir.second = dir_bytes[dir.first];
+        if (dir.first != path) {
+            dir_bytes[utils::getDirname(dir.first)] += dir.second;
+        }
+    }
+
+    int root_depth = static_cast<int>(depthOf(path));
+    std::vector<std::pair<std::string, unsigned long long>> shown;
+    for (const auto& dir : dir_bytes) {
+        int depth = static_cast<int>(depthOf(dir.first)) - root_depth;
+        if (dir.first == path || summary) continue;
+        if (max_depth >= 0 && depth > max_depth) continue;
+        shown.push_back(dir);
+    }
+
+    // Largest first; the model rarely needs more than the top entries
+    const size_t max_entries = 50;
+    std::sort(shown.begin(), shown.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    std::ostringstream output;
+    for (size_t i = 0; i < shown.size() && i < max_entries; i++) {
+        output << (human ? utils::formatSize(shown[i].second) : std::to_string(shown[i].second / 1024))
+               << "\t" << shown[i].first << "\n";
+    }
+    if (shown.size() > max_entries) {
+        output << "... " << (shown.size() - max_entries) << " smaller directories omitted\n";
     }
+    output << (human ? utils::formatSize(dir_bytes[path]) : std::to_string(dir_bytes[path] / 1024))
+           << "\t" << path << "\n";
 
-    std::cout << "\n=== Output ===\n" << result.output << "==============\n\n";
+    result.output = output.str();
+    result.exit_code = 0;
+    result.success = true;
+    utils::terminal::printSuccess("Du complete");
+
+    utils::terminal::out() << "\n=== Output ===\n" << result.output << "==============\n\n";
     return result;
 }
 
 ToolResult ToolExecutor::execute(const ToolCall& tool_call) {
+    current_usage = CommandUsage();
+    auto start_time = std::chrono::steady_clock::now();
+    double start_cpu = threadCpuSeconds();
+
+    // A background job may change files between any two calls, so while
+    // one runs file and database results are neither served nor kept
+    bool jobs_running = jobs_->anyRunning();
+    if (jobs_running) {
+        result_cache_->invalidateLocal();
+    }
+
+    ToolResult result;
+    long age = 0;
+    if (result_cache_->lookup(tool_call, result, age)) {
+        utils::terminal::printInfo("[Tool: " + tool_call.name + "] cached result from " + std::to_string(age) + "s ago");
+        result.output = "[Cached " + std::to_string(age) +
+                        "s ago; pass refresh=true if files may have changed]\n" +
+                        result.output;
+        utils::terminal::out() << result.output << "\n";
+        result.duration_ms = 0;
+        result.cpu_seconds = 0;
+        result.max_rss_kb = 0;
+        result.truncated_bytes = 0;
+        result.cache_hit = true;
+    } else {
+        result = dispatch(tool_call);
+
+        result.duration_ms = std::max(result.duration_ms, current_usage.duration_ms);
+        result.cpu_seconds = std::max(result.cpu_seconds, current_usage.cpu_seconds);
+        result.max_rss_kb = std::max(result.max_rss_kb, current_usage.max_rss_kb);
+        result.timed_out = result.timed_out || current_usage.timed_out;
+        result.truncated = result.truncated || current_usage.truncated;
+        result.truncated_bytes = current_usage.dropped_bytes;
+
+        result_cache_->update(tool_call, result, jobs_running);
+    }
+
+    result.wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+    result.thread_cpu_seconds = std::max(0.0, threadCpuSeconds() - start_cpu);
+    result.output_bytes = result.output.size() + result.error.size();
+    return result;
+}
+
+ToolResult ToolExecutor::dispatch(const ToolCall& tool_call) {
     // Check if this is an MCP tool
     if (isMCPTool(tool_call.name)) {
         return executeMCPTool(tool_call);
@@ -3498,6 +4950,18 @@ ToolResult ToolExecutor::execute(const ToolCall& tool_call) {
         return executeGlob(tool_call);
     } else if (tool_call.name == "Grep") {
         return executeGrep(tool_call);
+    } else if (tool_call.name == "ReadMany") {
+        return executeReadMany(tool_call);
+    } else if (tool_call.name == "ApplyPatch") {
+        return executeApplyPatch(tool_call);
+    }
+    // Background jobs
+    else if (tool_call.name == "JobStatus") {
+        return executeJobStatus(tool_call);
+    } else if (tool_call.name == "JobOutput") {
+        return executeJobOutput(tool_call);
+    } else if (tool_call.name == "JobKill") {
+        return executeJobKill(tool_call);
     }
     // Search tools
     else if (tool_call.name == "WebSearch") {
@@ -3607,15 +5071,77 @@ ToolResult ToolExecutor::execute(const ToolCall& tool_call) {
 }
 
 std::vector<ToolResult> ToolExecutor::executeAll(const std::vector<ToolCall>& tool_calls) {
-    std::vector<ToolResult> results;
+    std::vector<ToolResult> results(tool_calls.size());
 
-    for (size_t i = 0; i < tool_calls.size(); i++) {
-        std::cout << utils::terminal::MAGENTA << "═══════════════════════════════════════" << utils::terminal::RESET << "\n";
-        std::cout << utils::terminal::MAGENTA << "Tool " << (i+1) << "/" << tool_calls.size() << ": " << tool_calls[i].name << utils::terminal::RESET << "\n";
-        std::cout << utils::terminal::MAGENTA << "═══════════════════════════════════════" << utils::terminal::RESET << "\n\n";
+    if (!config_.getParallelTools() || tool_calls.size() < 2) {
+        for (size_t i = 0; i < tool_calls.size(); i++) {
+            std::cout << toolHeader(i, tool_calls.size(), tool_calls[i].name);
+            results[i] = execute(tool_calls[i]);
+        }
+        return results;
+    }
 
-        results.push_back(execute(tool_calls[i]));
+    // Independent calls run concurrently; calls touching the same paths or
+    // resources keep their order. Results stay in the original order.
+    {
+        std::lock_guard<std::recursive_mutex> lock(utils::terminal::consoleMutex());
+        last_printed_tool = static_cast<size_t>(-1);
+    }
+    std::set<std::string> read_only_mcp;
+    for (const auto& server : config_.getMCPServers()) {
+        if (server.read_only) read_only_mcp.insert(server.name);
+        for (const auto& tool : server.read_only_tools) {
+            read_only_mcp.insert(server.name + "__" + tool);
+        }
     }
+    // An exception would end the worker thread and with it the program;
+    // it fails only its own call instead
+    auto runTool = [&](size_t i) {
+        ToolResult result;
+        try {
+            result = execute(tool_calls[i]);
+        } catch (const std::exception& e) {
+            result.success = false;
+            result.error = tool_calls[i].name + " failed: " + e.what();
+            utils::terminal::printError(result.error);
+        } catch (...) {
+            result.success = false;
+            result.error = tool_calls[i].name + " failed with an unknown error";
+            utils::terminal::printError(result.error);
+        }
+        return result;
+    };
+
+    ToolScheduler scheduler(static_cast<size_t>(std::max(1, config_.getMaxParallelTools())), read_only_mcp);
+    scheduler.run(tool_calls, [&](size_t i) {
+        std::string header = toolHeader(i, tool_calls.size(), tool_calls[i].name);
+
+        if (ToolScheduler::classify(tool_calls[i], read_only_mcp).barrier) {
+            // Runs alone, so output can stream straight to the terminal
+            {
+                std::lock_guard<std::recursive_mutex> lock(utils::terminal::consoleMutex());
+                std::cout << header;
+                last_printed_tool = i;
+            }
+            results[i] = runTool(i);
+            return;
+        }
+
+        ToolOutput output;
+        output.index = i;
+        output.header = header;
+        current_output = &output;
+        utils::terminal::setThreadOutput(&output.buffer);
+
+        results[i] = runTool(i);
+
+        utils::terminal::setThreadOutput(nullptr);
+        {
+            std::lock_guard<std::recursive_mutex> lock(utils::terminal::consoleMutex());
+            flushToolOutput();
+        }
+        current_output = nullptr;
+    });
 
     return results;
 }
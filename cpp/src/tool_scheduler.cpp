@@ -0,0 +1,290 @@
+#include "tool_scheduler.h"
+#include "thread_pool.h"
+#include "patch_applier.h"
+#include "file_ops.h"
+#include "utils.h"
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace casper {
+
+namespace {
+
+std::string param(const ToolCall& call, const std::string& name, const std::string& fallback = "") {
+    auto it = call.parameters.find(name);
+    if (it == call.parameters.end() || it->second.empty()) {
+        return fallback;
+    }
+    return it->second;
+}
+
+std::string firstParam(const ToolCall& call, const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        std::string value = param(call, name);
+        if (!value.empty()) return value;
+    }
+    return "";
+}
+
+bool isRemotePath(const std::string& path) {
+    // scp/rsync style "host:path"
+    size_t colon = path.find(':');
+    return colon != std::string::npos && path.find('/') > colon;
+}
+
+void addPath(std::vector<std::string>& list, const std::string& path) {
+    if (path.empty() || isRemotePath(path)) return;
+    list.push_back(utils::normalizePath(path));
+}
+
+// A glob stands for the directory it starts in
+void addPattern(std::vector<std::string>& list, const std::string& path) {
+    size_t wildcard = path.find_first_of("*?[");
+    if (wildcard == std::string::npos) {
+        addPath(list, path);
+    } else {
+        size_t slash = path.rfind('/', wildcard);
+        addPath(list, slash == std::string::npos ? "." : path.substr(0, slash + 1));
+    }
+}
+
+// Quoted path lists of the file and archive tools
+void addPathList(std::vector<std::string>& list, const std::string& paths) {
+    for (const auto& path : FileOps::splitPaths(paths)) {
+        addPattern(list, path);
+    }
+}
+
+// The file tools' dry_run, parsed as they parse it; a dry run writes nothing
+bool dryRun(const ToolCall& call) {
+    std::string value = param(call, "dry_run");
+    return value == "true" || value == "1" || value == "yes";
+}
+
+bool anyOverlap(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    for (const auto& x : a) {
+        for (const auto& y : b) {
+            if (utils::pathsOverlap(x, y)) return true;
+        }
+    }
+    return false;
+}
+
+const std::set<std::string> kNoSideEffectTools = {
+    "WebSearch", "WebFetch", "Ping", "Traceroute", "Nmap", "Dig", "Whois",
+    "Netstat", "Telnet", "Ifconfig", "ARP"
+};
+
+} // namespace
+
+ToolScheduler::ToolScheduler(size_t max_workers, std::set<std::string> read_only_mcp)
+    : max_workers_(max_workers == 0 ? 1 : max_workers)
+    , read_only_mcp_(std::move(read_only_mcp))
+{
+}
+
+ToolAccess ToolScheduler::classify(const ToolCall& call, const std::set<std::string>& read_only_mcp) {
+    ToolAccess access;
+    const std::string& name = call.name;
+
+    if (name == "Read") {
+        addPath(access.reads, firstParam(call, {"file_path", "path", "filename", "file"}));
+    } else if (name == "ReadMany") {
+        // Globs read below the working directory; ":10-40" line ranges are not part of the path
+        std::string paths = firstParam(call, {"paths", "files"});
+        std::replace(paths.begin(), paths.end(), ',', ' ');
+        std::istringstream iss(paths);
+        std::string entry;
+        while (iss >> entry) {
+            size_t colon = entry.rfind(':');
+            if (colon != std::string::npos && entry.find_first_not_of("0123456789-", colon + 1) == std::string::npos) {
+                entry = entry.substr(0, colon);
+            }
+            addPath(access.reads, entry.find_first_of("*?[") != std::string::npos ? "." : entry);
+        }
+        if (!param(call, "pattern").empty()) {
+            addPath(access.reads, param(call, "path", "."));
+        }
+    } else if (name == "Write" || name == "Edit") {
+        addPath(access.writes, firstParam(call, {"file_path", "path", "filename", "file"}));
+    } else if (name == "ApplyPatch") {
+        std::vector<FilePatch> patches;
+        std::string error;
+        if (!PatchApplier::parse(firstParam(call, {"patch", "diff", "content"}), patches, error)) {
+            return access;  // Fails without touching anything
+        }
+        for (const auto& patch : patches) {
+            if (!patch.creates()) addPath(access.writes, patch.old_path);
+            if (!patch.deletes()) addPath(access.writes, patch.new_path);
+        }
+    } else if (name == "Glob" || name == "Grep" || name == "Df" || name == "Du") {
+        addPath(access.reads, param(call, "path", "."));
+    } else if (name == "Rm" || name == "Mkdir" || name == "Chmod" || name == "Chown") {
+        addPathList(dryRun(call) ? access.reads : access.writes, param(call, "path"));
+    } else if (name == "Cp") {
+        addPathList(access.reads, param(call, "source"));
+        addPathList(dryRun(call) ? access.reads : access.writes, param(call, "destination"));
+    } else if (name == "Rsync" || name == "Scp") {
+        addPath(access.reads, param(call, "source"));
+        addPath(access.writes, param(call, "destination"));
+    } else if (name == "Mv") {
+        std::vector<std::string>& moved = dryRun(call) ? access.reads : access.writes;
+        addPathList(moved, param(call, "source"));
+        addPathList(moved, param(call, "destination"));
+    } else if (name == "Tar") {
+        std::string action = param(call, "action");
+        if (action == "create") {
+            addPathList(access.reads, param(call, "files"));
+            addPath(access.writes, param(call, "archive"));
+        } else if (action == "list") {
+            addPath(access.reads, param(call, "archive"));
+        } else {
+            // Extracts into the working directory unless told otherwise
+            addPath(access.reads, param(call, "archive"));
+            addPath(access.writes, param(call, "destination", "."));
+        }
+    } else if (name == "Zip") {
+        addPathList(access.reads, param(call, "files"));
+        addPath(access.writes, param(call, "archive"));
+    } else if (name == "Unzip") {
+        addPath(access.reads, param(call, "archive"));
+        std::string list = param(call, "list");
+        if (list != "true" && list != "1") {
+            addPath(access.writes, param(call, "destination", "."));
+        }
+    } else if (name == "Gzip") {
+        for (const auto& file : FileOps::splitPaths(param(call, "file"))) {
+            addPattern(access.writes, file);
+            if (utils::endsWith(file, ".gz")) {
+                addPattern(access.writes, file.substr(0, file.size() - 3));
+            } else if (utils::endsWith(file, ".tgz")) {
+                addPattern(access.writes, file.substr(0, file.size() - 4) + ".tar");
+            } else {
+                addPattern(access.writes, file + ".gz");
+            }
+        }
+    } else if (name == "DBConnect" || name == "DBQuery" || name == "DBExecute" || name == "DBSchema") {
+        access.resources.push_back("db");
+    } else if (name == "Learn") {
+        addPath(access.reads, param(call, "source"));
+        access.resources.push_back("rag");
+    } else if (name == "Remember" || name == "Forget") {
+        access.resources.push_back("rag");
+    } else if (name == "JobStatus" || name == "JobOutput" || name == "JobKill") {
+        access.resources.push_back("jobs");
+    } else if (name == "SSH") {
+        access.resources.push_back("ssh:" + param(call, "host"));
+    } else if (name == "Curl") {
+        std::string method = utils::toLower(param(call, "method", "GET"));
+        if (method != "get" && method != "head") {
+            access.resources.push_back("remote:" + param(call, "url"));
+        }
+    } else if (name == "Netcat") {
+        if (!param(call, "data").empty()) {
+            access.resources.push_back("remote:" + param(call, "host") + ":" + param(call, "port"));
+        }
+    } else if (kNoSideEffectTools.count(name)) {
+        // Network queries only
+    } else if (name.find("__") != std::string::npos) {
+        // An MCP tool may do anything unless its server or the tool is
+        // declared read-only; those still take one request at a time over stdio
+        std::string server = name.substr(0, name.find("__"));
+        if (read_only_mcp.count(server) || read_only_mcp.count(name)) {
+            access.resources.push_back("mcp:" + server);
+        } else {
+            access.barrier = true;
+        }
+    } else {
+        // Bash, package managers and anything unknown
+        access.barrier = true;
+    }
+
+    return access;
+}
+
+bool ToolScheduler::conflicts(const ToolAccess& a, const ToolAccess& b) {
+    if (a.barrier || b.barrier) {
+        return true;
+    }
+
+    for (const auto& resource : a.resources) {
+        if (std::find(b.resources.begin(), b.resources.end(), resource) != b.resources.end()) {
+            return true;
+        }
+    }
+
+    return anyOverlap(a.writes, b.writes) ||
+           anyOverlap(a.writes, b.reads) ||
+           anyOverlap(a.reads, b.writes);
+}
+
+std::vector<std::vector<size_t>> ToolScheduler::buildDependencies(const std::vector<ToolCall>& calls,
+                                                                  const std::set<std::string>& read_only_mcp) {
+    std::vector<ToolAccess> access;
+    access.reserve(calls.size());
+    for (const auto& call : calls) {
+        access.push_back(classify(call, read_only_mcp));
+    }
+
+    std::vector<std::vector<size_t>> deps(calls.size());
+    for (size_t j = 0; j < calls.size(); j++) {
+        for (size_t i = 0; i < j; i++) {
+            if (conflicts(access[i], access[j])) {
+                deps[j].push_back(i);
+            }
+        }
+    }
+    return deps;
+}
+
+void ToolScheduler::run(const std::vector<ToolCall>& calls, const std::function<void(size_t)>& task) {
+    if (calls.empty()) return;
+
+    auto deps = buildDependencies(calls, read_only_mcp_);
+    std::vector<size_t> pending(calls.size());
+    std::vector<std::vector<size_t>> dependents(calls.size());
+    for (size_t j = 0; j < calls.size(); j++) {
+        pending[j] = deps[j].size();
+        for (size_t i : deps[j]) {
+            dependents[i].push_back(j);
+        }
+    }
+
+    ThreadPool pool(std::min(max_workers_, calls.size()));
+    std::mutex mutex;
+
+    // Declared before use so a finished task can schedule its dependents
+    std::function<void(size_t)> start = [&](size_t index) {
+        pool.submit([&, index] {
+            task(index);
+
+            std::vector<size_t> ready;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t next : dependents[index]) {
+                    if (--pending[next] == 0) {
+                        ready.push_back(next);
+                    }
+                }
+            }
+            // Submitted before this task counts as finished, so wait() can't return early
+            for (size_t next : ready) {
+                start(next);
+            }
+        });
+    };
+
+    std::vector<size_t> initial;
+    for (size_t j = 0; j < calls.size(); j++) {
+        if (pending[j] == 0) initial.push_back(j);
+    }
+    for (size_t j : initial) {
+        start(j);
+    }
+
+    pool.wait();
+}
+
+} // namespace casper
@@ -0,0 +1,93 @@
+#include "undo_store.h"
+#include "utils.h"
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+
+namespace casper {
+
+UndoStore::UndoStore(size_t max_entries, size_t max_bytes)
+    : max_entries_(max_entries)
+    , max_bytes_(max_bytes)
+    , bytes_(0)
+{
+}
+
+void UndoStore::record(const std::string& path, const std::string& tool, bool existed,
+                       std::string previous, const std::string& written) {
+    UndoEntry entry;
+    entry.path = utils::normalizePath(path);
+    entry.tool = tool;
+    entry.existed = existed;
+    entry.content = std::move(previous);
+    entry.content_size = entry.content.size();
+    entry.written_size = written.size();
+    entry.written_hash = std::hash<std::string>()(written);
+    entry.time = std::time(nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytes_ += entry.content.size();
+    entries_.push_back(std::move(entry));
+
+    // Always keep the newest entry, even when it alone is over the limit
+    while (entries_.size() > 1 && (entries_.size() > max_entries_ || bytes_ > max_bytes_)) {
+        bytes_ -= entries_.front().content.size();
+        entries_.pop_front();
+    }
+}
+
+std::vector<UndoEntry> UndoStore::list() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<UndoEntry> result;
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+        UndoEntry entry;
+        entry.path = it->path;
+        entry.tool = it->tool;
+        entry.existed = it->existed;
+        entry.content_size = it->content_size;
+        entry.time = it->time;
+        result.push_back(entry);
+    }
+    return result;
+}
+
+bool UndoStore::undoLast(std::string& message, bool force) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.empty()) {
+        message = "Nothing to undo";
+        return false;
+    }
+
+    UndoEntry& entry = entries_.back();
+    bool present = utils::fileExists(entry.path);
+
+    if (!force) {
+        // A file the tool deleted counts as empty
+        std::string current = present ? utils::readFile(entry.path) : "";
+        if (current.size() != entry.written_size || std::hash<std::string>()(current) != entry.written_hash) {
+            message = entry.path + " has changed since " + entry.tool + " wrote it; /undo force restores it anyway";
+            return false;
+        }
+    }
+
+    if (!entry.existed) {
+        if (present && unlink(entry.path.c_str()) != 0) {
+            message = "Failed to remove " + entry.path + ": " + strerror(errno);
+            return false;
+        }
+        message = "Removed " + entry.path + " (created by " + entry.tool + ")";
+    } else {
+        if (!utils::writeFileAtomic(entry.path, entry.content)) {
+            message = "Failed to restore " + entry.path + ": " + strerror(errno);
+            return false;
+        }
+        message = "Restored " + entry.path + " to before " + entry.tool;
+    }
+
+    bytes_ -= entry.content.size();
+    entries_.pop_back();
+    return true;
+}
+
+} // namespace casper
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "command_registry.h"
 #include <algorithm>
 #include <sstream>
 #include <fstream>
@@ -9,6 +10,13 @@
 #include <unistd.h>
 #include <pwd.h>
 #include <chrono>
+#include <cstdio>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <cstdint>
 
 namespace casper {
 namespace utils {
@@ -47,6 +55,79 @@ std::string toLower(const std::string& str) {
     return result;
 }
 
+std::string formatSize(unsigned long long bytes) {
+    static const char* units[] = {"K", "M", "G", "T", "P"};
+    if (bytes < 1024) {
+        return std::to_string(bytes);
+    }
+
+    double size = static_cast<double>(bytes) / 1024.0;
+    int unit = 0;
+    while (size >= 1024.0 && unit < 4) {
+        size /= 1024.0;
+        unit++;
+    }
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), size < 10.0 ? "%.1f%s" : "%.0f%s", size, units[unit]);
+    return buffer;
+}
+
+// FIPS 180-4
+std::string sha256Hex(const std::string& data) {
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+    auto compress = [&](const unsigned char* block) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+                   (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+    };
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    size_t full = data.size() / 64 * 64;
+    for (size_t i = 0; i < full; i += 64) compress(bytes + i);
+
+    // Padding: 0x80, zeros, then the length in bits, big-endian
+    unsigned char tail[128] = {0};
+    size_t rest = data.size() - full;
+    std::copy(bytes + full, bytes + data.size(), tail);
+    tail[rest] = 0x80;
+    size_t tail_size = rest < 56 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    for (int i = 0; i < 8; i++) tail[tail_size - 1 - i] = static_cast<unsigned char>(bits >> (i * 8));
+    for (size_t i = 0; i < tail_size; i += 64) compress(tail + i);
+
+    char hex[65];
+    for (int i = 0; i < 8; i++) snprintf(hex + i * 8, 9, "%08x", h[i]);
+    return std::string(hex, 64);
+}
+
 // File utilities
 bool fileExists(const std::string& path) {
     struct stat buffer;
@@ -81,6 +162,68 @@ bool writeFile(const std::string& path, const std::string& content) {
     return file.good();
 }
 
+bool writeFileAtomic(const std::string& path, const std::string& content, bool sync) {
+    static std::atomic<unsigned> counter(0);
+
+    // Replace the file a symlink points to, not the link
+    std::string target = path;
+    struct stat st;
+    char resolved[PATH_MAX];
+    if (lstat(path.c_str(), &st) == 0 && S_ISLNK(st.st_mode) && realpath(path.c_str(), resolved)) {
+        target = resolved;
+    }
+    bool exists = stat(target.c_str(), &st) == 0;
+
+    std::string temp = joinPath(getDirname(target), "." + getBasename(target) + ".tmp" +
+                                std::to_string(getpid()) + "." + std::to_string(counter++));
+
+    // New files get 0666 less the umask, like a plain open() would give them
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0) return false;
+
+    bool ok = true;
+    if (exists) {
+        fchmod(fd, st.st_mode & 07777);
+        if (fchown(fd, st.st_uid, st.st_gid) != 0) {
+            // Only root can give files away; keeping our ownership is fine
+        }
+    }
+
+    size_t written = 0;
+    while (ok && written < content.size()) {
+        ssize_t n = write(fd, content.data() + written, content.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = false;
+        else written += static_cast<size_t>(n);
+    }
+    if (ok && sync && fsync(fd) != 0) ok = false;
+
+    int saved_errno = errno;
+    if (close(fd) != 0 && ok) {
+        ok = false;
+        saved_errno = errno;
+    }
+    if (ok && rename(temp.c_str(), target.c_str()) != 0) {
+        ok = false;
+        saved_errno = errno;
+    }
+    if (!ok) {
+        unlink(temp.c_str());
+        errno = saved_errno;
+        return false;
+    }
+
+    if (sync) {
+        // Make the rename itself durable
+        int dir_fd = open(getDirname(target).c_str(), O_RDONLY | O_CLOEXEC);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+    return true;
+}
+
 // Path utilities
 std::string getHomeDir() {
     const char* home = getenv("HOME");
@@ -114,6 +257,39 @@ std::string getDirname(const std::string& path) {
     return path.substr(0, pos);
 }
 
+std::string normalizePath(const std::string& path) {
+    std::string full = path;
+    if (full.empty() || full[0] != '/') {
+        char cwd[4096];
+        if (getcwd(cwd, sizeof(cwd))) {
+            full = joinPath(cwd, full);
+        }
+    }
+
+    std::vector<std::string> parts;
+    for (const auto& part : split(full, '/')) {
+        if (part.empty() || part == ".") continue;
+        if (part == "..") {
+            if (!parts.empty()) parts.pop_back();
+            continue;
+        }
+        parts.push_back(part);
+    }
+
+    std::string result;
+    for (const auto& part : parts) {
+        result += "/" + part;
+    }
+    return result.empty() ? "/" : result;
+}
+
+bool pathsOverlap(const std::string& a, const std::string& b) {
+    const std::string& shorter = a.size() <= b.size() ? a : b;
+    const std::string& longer = a.size() <= b.size() ? b : a;
+    if (!startsWith(longer, shorter)) return false;
+    return longer.size() == shorter.size() || shorter == "/" || longer[shorter.size()] == '/';
+}
+
 // System utilities
 std::string getUsername() {
     const char* user = getenv("USER");
@@ -139,7 +315,7 @@ std::string getOsName() {
     #endif
 }
 
-std::string getLinuxDistro() {
+static std::string readLinuxDistro() {
     #ifdef __linux__
     // Try to read /etc/os-release
     std::ifstream osRelease("/etc/os-release");
@@ -168,9 +344,14 @@ std::string getLinuxDistro() {
     #endif
 }
 
+std::string getLinuxDistro() {
+    // The distro does not change while we run
+    static const std::string distro = readLinuxDistro();
+    return distro;
+}
+
 bool commandExists(const std::string& cmd) {
-    std::string check = "command -v " + cmd + " > /dev/null 2>&1";
-    return (system(check.c_str()) == 0);
+    return CommandRegistry::instance().exists(cmd);
 }
 
 bool isMacOS() {
@@ -216,6 +397,21 @@ const char* CYAN = "\033[0;36m";
 const char* BOLD = "\033[1m";
 const char* RESET = "\033[0m";
 
+static thread_local std::ostream* thread_output = nullptr;
+
+void setThreadOutput(std::ostream* stream) {
+    thread_output = stream;
+}
+
+std::ostream& out() {
+    return thread_output ? *thread_output : std::cout;
+}
+
+std::recursive_mutex& consoleMutex() {
+    static std::recursive_mutex mutex;
+    return mutex;
+}
+
 void clearScreen() {
     std::cout << "\033[2J\033[1;1H";
 }
@@ -226,23 +422,23 @@ int getTerminalWidth() {
 }
 
 void printColor(const std::string& text, const char* color) {
-    std::cout << color << text << RESET;
+    out() << color << text << RESET;
 }
 
 void printError(const std::string& text) {
-    std::cerr << RED << "✗ " << text << RESET << std::endl;
+    (thread_output ? *thread_output : std::cerr) << RED << "✗ " << text << RESET << std::endl;
 }
 
 void printSuccess(const std::string& text) {
-    std::cout << GREEN << "✓ " << text << RESET << std::endl;
+    out() << GREEN << "✓ " << text << RESET << std::endl;
 }
 
 void printWarning(const std::string& text) {
-    std::cout << YELLOW << "⚠ " << text << RESET << std::endl;
+    out() << YELLOW << "⚠ " << text << RESET << std::endl;
 }
 
 void printInfo(const std::string& text) {
-    std::cout << CYAN << text << RESET << std::endl;
+    out() << CYAN << text << RESET << std::endl;
 }
 
 } // namespace terminal